@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// NTP style clock sync between a BLE client and the device.
+// No hardware dependencies — testable on native platform.
+//
+// Device time is millis(). A client that knows it can stamp stream packets
+// with the device time each point is due (stream_packet version 2), so
+// when a write arrives no longer decides when its points play.
+//
+// The exchange, all fields little endian uint32:
+//
+//   client writes   t0   client time it sent the request
+//   device notifies t0   echoed
+//                   t1   device time the request arrived
+//                   t2   device time the reply left
+//
+// With t3, the client time the reply arrived:
+//
+//   offset     = ((t1 - t0) + (t2 - t3)) / 2   device minus client time
+//   round trip = (t3 - t0) - (t2 - t1)
+//
+// The offset is off by at most half the round trip, by how much the two
+// ways differ. BLE delays vary by whole connection intervals, so a client
+// runs a few exchanges and keeps the one with the shortest round trip, as
+// Estimator does. Clock drift is in the order of 100 ppm, a client syncs
+// again every few seconds while it streams.
+
+namespace clock_sync {
+
+constexpr size_t requestSize = 4;
+constexpr size_t replySize = 12;
+
+namespace detail {
+
+inline uint32_t read32(const uint8_t *bytes) {
+    return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) |
+           (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+inline void write32(uint8_t *bytes, uint32_t value) {
+    bytes[0] = uint8_t(value);
+    bytes[1] = uint8_t(value >> 8);
+    bytes[2] = uint8_t(value >> 16);
+    bytes[3] = uint8_t(value >> 24);
+}
+
+}  // namespace detail
+
+/// Writes the client's request.
+/// @return bytes written
+inline size_t request(uint32_t sent, uint8_t *out) {
+    detail::write32(out, sent);
+    return requestSize;
+}
+
+/// Answers a request, on the device.
+/// @param received device time the request arrived
+/// @param sent device time the reply leaves
+/// @param out receives replySize bytes
+/// @return bytes written, 0 if the request is malformed
+inline size_t reply(const uint8_t *request, size_t size, uint32_t received,
+                    uint32_t sent, uint8_t *out) {
+    if (size != requestSize) return 0;
+    detail::write32(out, detail::read32(request));
+    detail::write32(out + 4, received);
+    detail::write32(out + 8, sent);
+    return replySize;
+}
+
+/// One exchange, as the client sees it.
+struct Sample {
+    int32_t offset;      // device minus client time in ms
+    uint32_t roundTrip;  // ms the request and reply were on the way
+};
+
+/// Reads a reply, on the client. Times may wrap around.
+/// @param received client time the reply arrived
+/// @return false if the reply is malformed
+inline bool sample(const uint8_t *reply, size_t size, uint32_t received,
+                   Sample &out) {
+    if (size != replySize) return false;
+    uint32_t t0 = detail::read32(reply);
+    uint32_t t1 = detail::read32(reply + 4);
+    uint32_t t2 = detail::read32(reply + 8);
+    uint32_t t3 = received;
+    int64_t there = int32_t(t1 - t0);
+    int64_t back = int32_t(t2 - t3);
+    int64_t sum = there + back;
+    out.offset = int32_t(sum >= 0 ? sum / 2 : -((1 - sum) / 2));
+    uint32_t total = t3 - t0;
+    uint32_t held = t2 - t1;
+    out.roundTrip = total > held ? total - held : 0;
+    return true;
+}
+
+/// Keeps the best of the last few exchanges. Its offset turns client time
+/// into device time.
+class Estimator {
+  public:
+    static constexpr size_t Window = 8;
+
+    void add(const Sample &sample) {
+        _samples[_next] = sample;
+        _next = (_next + 1) % Window;
+        if (_count < Window) _count++;
+    }
+
+    void clear() { _count = _next = 0; }
+
+    /// True once an exchange has come back
+    bool synced() const { return _count > 0; }
+
+    /// The sample with the shortest round trip in the window
+    Sample best() const {
+        Sample best = {0, UINT32_MAX};
+        for (size_t i = 0; i < _count; i++) {
+            if (_samples[i].roundTrip < best.roundTrip) best = _samples[i];
+        }
+        return best;
+    }
+
+    /// Device minus client time in ms
+    int32_t offset() const { return best().offset; }
+
+    /// Device time at a client time
+    uint32_t toDevice(uint32_t clientTime) const {
+        return clientTime + uint32_t(offset());
+    }
+
+  private:
+    Sample _samples[Window] = {};
+    size_t _count = 0;
+    size_t _next = 0;
+};
+
+}  // namespace clock_sync
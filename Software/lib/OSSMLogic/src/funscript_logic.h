@@ -0,0 +1,435 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Incremental funscript reader for on-device playback.
+// No hardware dependencies — testable on native platform.
+//
+// A funscript is JSON like {"inverted":false,"actions":[{"at":0,"pos":10},
+// ...],"metadata":{...}}. The tokenizer takes one byte at a time and only
+// keeps the few bytes it needs, so a script is never held in memory as a
+// whole. Actions are expected in ascending "at" order, as every funscript
+// editor writes them.
+
+namespace funscript_logic {
+
+/// A single point of a script.
+struct Action {
+    uint32_t at;  // ms from the start of the script
+    uint8_t pos;  // 0 - 100
+};
+
+/// Push tokenizer for funscript JSON. Everything except the top level
+/// "actions" and "inverted" members is skipped without being stored.
+class Tokenizer {
+  public:
+    /// Maximum nesting of objects and arrays.
+    static constexpr int maxDepth = 32;
+
+    /// Feed the next byte.
+    /// @return true if the byte completed an action, see action()
+    bool feed(char c) {
+        if (_failed) return false;
+
+        switch (_mode) {
+            case Mode::String:
+                _string(c);
+                return false;
+            case Mode::Escape:
+                _mode = Mode::String;
+                _append(c);
+                return false;
+            case Mode::Number:
+                if (_isNumberChar(c)) {
+                    if (_numberLength < sizeof(_number) - 1)
+                        _number[_numberLength++] = c;
+                    return false;
+                }
+                _endNumber();
+                break;
+            case Mode::Literal:
+                if (c >= 'a' && c <= 'z') return false;
+                _endLiteral();
+                break;
+            case Mode::Structure:
+                break;
+        }
+        return _structure(c);
+    }
+
+    /// The action completed by the last feed() that returned true.
+    const Action &action() const { return _done; }
+
+    /// Value of the top level "inverted" member, false if absent.
+    bool inverted() const { return _inverted; }
+
+    /// True after malformed input. Nothing is emitted afterwards.
+    bool failed() const { return _failed; }
+
+  private:
+    enum class Mode : uint8_t { Structure, String, Escape, Number, Literal };
+    enum class Key : uint8_t { Other, Actions, Inverted, At, Pos };
+
+    Mode _mode = Mode::Structure;
+    int8_t _depth = 0;
+    uint32_t _arrays = 0;  // bit n: the container at depth n is an array
+    bool _expectKey = false;
+    bool _stringIsKey = false;
+    bool _failed = false;
+    bool _inverted = false;
+    bool _inActions = false;
+    Key _topKey = Key::Other;
+    Key _fieldKey = Key::Other;
+
+    char _key[12] = {};
+    uint8_t _keyLength = 0;
+    char _number[24] = {};
+    uint8_t _numberLength = 0;
+    char _literal = 0;
+
+    bool _hasAt = false;
+    bool _hasPos = false;
+    Action _current = {0, 0};
+    Action _done = {0, 0};
+
+    static bool _isNumberChar(char c) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+               c == 'e' || c == 'E';
+    }
+
+    bool _isArray(int depth) const { return (_arrays >> depth) & 1u; }
+
+    // Inside an element of the top level "actions" array
+    bool _inAction() const { return _inActions && _depth == 3 && !_isArray(3); }
+
+    void _append(char c) {
+        // Keys we look for are short, longer ones never match
+        if (_stringIsKey && _keyLength < sizeof(_key)) _key[_keyLength++] = c;
+    }
+
+    bool _keyIs(const char *name) const {
+        size_t length = strlen(name);
+        return _keyLength == length && memcmp(_key, name, length) == 0;
+    }
+
+    void _string(char c) {
+        if (c == '\\') {
+            _mode = Mode::Escape;
+        } else if (c == '"') {
+            _mode = Mode::Structure;
+            if (_stringIsKey) {
+                if (_depth == 1) {
+                    _topKey = _keyIs("actions")    ? Key::Actions
+                              : _keyIs("inverted") ? Key::Inverted
+                                                   : Key::Other;
+                } else if (_inAction()) {
+                    _fieldKey = _keyIs("at")    ? Key::At
+                                : _keyIs("pos") ? Key::Pos
+                                                : Key::Other;
+                }
+            }
+        } else {
+            _append(c);
+        }
+    }
+
+    void _endNumber() {
+        _mode = Mode::Structure;
+        _number[_numberLength] = '\0';
+        if (!_inAction()) return;
+
+        char *end = nullptr;
+        double value = strtod(_number, &end);
+        if (end == _number) {
+            _failed = true;
+            return;
+        }
+        if (_fieldKey == Key::At) {
+            _current.at = value <= 0.0 ? 0u : uint32_t(std::lround(value));
+            _hasAt = true;
+        } else if (_fieldKey == Key::Pos) {
+            double pos = value < 0.0 ? 0.0 : (value > 100.0 ? 100.0 : value);
+            _current.pos = uint8_t(std::lround(pos));
+            _hasPos = true;
+        }
+    }
+
+    void _endLiteral() {
+        _mode = Mode::Structure;
+        if (_depth == 1 && _topKey == Key::Inverted) _inverted = _literal == 't';
+    }
+
+    bool _structure(char c) {
+        switch (c) {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                return false;
+            case '"':
+                _mode = Mode::String;
+                _stringIsKey = _depth > 0 && !_isArray(_depth) && _expectKey;
+                _keyLength = 0;
+                return false;
+            case '{':
+            case '[':
+                if (_depth + 1 >= maxDepth) {
+                    _failed = true;
+                    return false;
+                }
+                _depth++;
+                if (c == '[') {
+                    _arrays |= 1u << _depth;
+                    _inActions = _inActions ||
+                                 (_depth == 2 && _topKey == Key::Actions);
+                } else {
+                    _arrays &= ~(1u << _depth);
+                }
+                _expectKey = (c == '{');
+                if (_inAction()) {
+                    _hasAt = false;
+                    _hasPos = false;
+                    _fieldKey = Key::Other;
+                }
+                return false;
+            case '}':
+            case ']': {
+                if (_depth == 0 || _isArray(_depth) != (c == ']')) {
+                    _failed = true;
+                    return false;
+                }
+                bool emit = _inAction() && _hasAt && _hasPos;
+                if (emit) _done = _current;
+                _depth--;
+                if (_depth < 2) _inActions = false;
+                _expectKey = false;
+                return emit;
+            }
+            case ':':
+                _expectKey = false;
+                return false;
+            case ',':
+                _expectKey = !_isArray(_depth);
+                return false;
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    _mode = Mode::Number;
+                    _number[0] = c;
+                    _numberLength = 1;
+                } else if (c >= 'a' && c <= 'z') {
+                    _mode = Mode::Literal;
+                    _literal = c;
+                } else {
+                    _failed = true;
+                }
+                return false;
+        }
+    }
+};
+
+/// Where a reader gets the script bytes from.
+class Source {
+  public:
+    virtual ~Source() = default;
+
+    /// Size of the whole script in bytes.
+    virtual uint32_t size() = 0;
+
+    /// Read up to length bytes at offset. Returns the number of bytes read.
+    virtual size_t read(uint32_t offset, uint8_t *buffer, size_t length) = 0;
+};
+
+/// Reads actions from a source through one chunk buffer into a prefetch
+/// ring of RingSize actions. Memory use is fixed, whatever the script size.
+///
+/// prefetch() tops up the ring and should be called whenever there is time;
+/// next() only parses synchronously (and counts an underrun) if the ring ran
+/// dry. seek() resumes from the closest of a few tokenizer checkpoints that
+/// are taken on the way, so seeking back does not re-parse the whole script.
+template <size_t ChunkSize = 256, size_t RingSize = 32, size_t Checkpoints = 8>
+class Reader {
+  public:
+    /// Start reading a script from the beginning.
+    /// @return false if source is null or empty
+    bool open(Source *source) {
+        _source = source;
+        _checkpointCount = 0;
+        _checkpointSpacing = 1;
+        _restart(Checkpoint{0, Tokenizer(), 0});
+        _underruns = 0;
+        _bytesRead = 0;
+        return _source != nullptr && _source->size() > 0;
+    }
+
+    /// Parse ahead until the ring is full or the script ends.
+    void prefetch() {
+        while (_count < RingSize && _parse()) {
+        }
+    }
+
+    /// Take the next action.
+    /// @return false at the end of the script or on malformed input
+    bool next(Action &action) {
+        if (_count == 0) {
+            prefetch();
+            if (_count == 0) return false;
+            _underruns++;
+        }
+        action = _ring[_head];
+        _head = (_head + 1) % RingSize;
+        _count--;
+        return true;
+    }
+
+    /// Continue with the first action at or after ms.
+    void seek(uint32_t ms) {
+        // Latest checkpoint taken before ms
+        size_t best = 0;
+        for (size_t i = 0; i < _checkpointCount; i++) {
+            if (_checkpoints[i].lastAt < ms) best = i;
+        }
+        // Going forward from where we are is cheaper, if possible
+        bool ahead = _count > 0 ? _ring[_head].at <= ms : _lastAt < ms;
+        if (_checkpointCount == 0 ||
+            (ahead && _checkpoints[best].offset <= _chunkOffset)) {
+            while (_count > 0 && _ring[_head].at < ms) {
+                _head = (_head + 1) % RingSize;
+                _count--;
+            }
+        } else {
+            _restart(_checkpoints[best]);
+        }
+        _skipBefore = ms;
+        prefetch();
+    }
+
+    /// Value of the script's "inverted" member, known once it was parsed.
+    bool inverted() const { return _tokenizer.inverted(); }
+
+    /// True after malformed input.
+    bool failed() const { return _tokenizer.failed(); }
+
+    /// Number of actions waiting in the ring.
+    size_t buffered() const { return _count; }
+
+    /// Number of times next() had to refill the ring itself.
+    uint32_t underruns() const { return _underruns; }
+
+    /// Bytes read from the source, including re-reads after seeks.
+    uint32_t bytesRead() const { return _bytesRead; }
+
+  private:
+    struct Checkpoint {
+        uint32_t offset;  // Start of a chunk
+        Tokenizer tokenizer;  // State before its first byte
+        uint32_t lastAt;  // Last action completed before it
+    };
+
+    Source *_source = nullptr;
+    Tokenizer _tokenizer;
+
+    uint8_t _chunk[ChunkSize];
+    uint32_t _chunkOffset = 0;  // File offset of _chunk[0]
+    size_t _chunkLength = 0;
+    size_t _chunkPosition = 0;
+    bool _end = false;
+
+    Action _ring[RingSize];
+    size_t _head = 0;
+    size_t _count = 0;
+    uint32_t _lastAt = 0;
+    uint32_t _skipBefore = 0;
+
+    Checkpoint _checkpoints[Checkpoints];
+    size_t _checkpointCount = 0;
+    uint32_t _checkpointSpacing = 1;  // In chunks, doubles when full
+
+    uint32_t _underruns = 0;
+    uint32_t _bytesRead = 0;
+
+    void _restart(const Checkpoint &from) {
+        _tokenizer = from.tokenizer;
+        _chunkOffset = from.offset;
+        _chunkLength = 0;
+        _chunkPosition = 0;
+        _end = false;
+        _head = 0;
+        _count = 0;
+        _lastAt = from.lastAt;
+        _skipBefore = 0;
+    }
+
+    void _checkpoint() {
+        uint32_t chunk = _chunkOffset / ChunkSize;
+        if (chunk % _checkpointSpacing != 0) return;
+        if (_checkpointCount > 0 &&
+            _checkpoints[_checkpointCount - 1].offset >= _chunkOffset)
+            return;
+        if (_checkpointCount == Checkpoints) {
+            // Keep every other one and take them half as often from now on
+            for (size_t i = 0; i < Checkpoints / 2; i++)
+                _checkpoints[i] = _checkpoints[2 * i];
+            _checkpointCount = Checkpoints / 2;
+            _checkpointSpacing *= 2;
+            if (chunk % _checkpointSpacing != 0) return;
+        }
+        _checkpoints[_checkpointCount++] = {_chunkOffset, _tokenizer, _lastAt};
+    }
+
+    bool _readChunk() {
+        _chunkOffset += _chunkLength;
+        _chunkPosition = 0;
+        _chunkLength = 0;
+        if (_source == nullptr || _end) return false;
+        _checkpoint();
+        uint32_t size = _source->size();
+        if (_chunkOffset < size) {
+            size_t length = size - _chunkOffset;
+            if (length > ChunkSize) length = ChunkSize;
+            _chunkLength = _source->read(_chunkOffset, _chunk, length);
+            _bytesRead += _chunkLength;
+        }
+        if (_chunkLength == 0) _end = true;
+        return !_end;
+    }
+
+    // Parse until one more action is in the ring
+    bool _parse() {
+        while (!_end) {
+            if (_chunkPosition == _chunkLength && !_readChunk()) break;
+            while (_chunkPosition < _chunkLength) {
+                if (!_tokenizer.feed(char(_chunk[_chunkPosition++]))) continue;
+                const Action &action = _tokenizer.action();
+                _lastAt = action.at;
+                if (action.at < _skipBefore) continue;
+                _ring[(_head + _count) % RingSize] = action;
+                _count++;
+                return true;
+            }
+            if (_tokenizer.failed()) _end = true;
+        }
+        return false;
+    }
+};
+
+/// Turns actions into stream points: the time to the next action is the
+/// time the move to it may take, like stream:pos:time over BLE.
+struct Timeline {
+    uint32_t previousAt = 0;
+
+    /// Restart the timeline at a script time, e.g. after a seek.
+    void reset(uint32_t at) { previousAt = at; }
+
+    /// Duration of the move to action, in ms.
+    uint32_t moveTime(const Action &action) {
+        uint32_t time = action.at > previousAt ? action.at - previousAt : 0;
+        previousAt = action.at;
+        return time;
+    }
+};
+
+}  // namespace funscript_logic
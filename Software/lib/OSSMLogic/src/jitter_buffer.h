@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Playout delay for stream targets stamped in device time.
+// No hardware dependencies — testable on native platform.
+//
+// A client that is clock synced (see clock_sync.h) stamps each point with
+// the device time it wants it played. Writes still reach the device a
+// varying time after that, by whole connection intervals when the radio
+// has to retry. Every point is held back by the same delay, so the motion
+// keeps the spacing the client gave it, and the delay is only as long as
+// the writes need to arrive in time.
+//
+// The delay is a quantile of how late writes arrive, lateness being the
+// arrival minus the due time of a write's first point. Lateness goes into
+// a histogram that forgets old writes bit by bit, as the jitter buffer of
+// WebRTC does. A quantile over the last half minute moves far less than
+// an estimate from the last few writes, and every move of the delay
+// stretches or squeezes the motion. A write later than the delay plays
+// its points late; they still keep their spacing.
+
+namespace jitter_buffer {
+
+class PlayoutDelay {
+  public:
+    /// Width of a histogram bucket in ms. Bucket 0 holds the writes that
+    /// came in time, bucket i those up to i * BucketMs late.
+    static constexpr uint32_t BucketMs = 4;
+    /// Buckets of the histogram, later writes count into the last one
+    static constexpr size_t Buckets = 128;
+    /// Share of writes that should arrive in time
+    static constexpr float Quantile = 0.98f;
+    /// Share of the histogram each write replaces, it remembers about 1000
+    /// writes or 30 s at a 30 ms connection interval
+    static constexpr float Forget = 1.0f / 1024.0f;
+
+    /// @param minimum shortest delay in ms
+    /// @param maximum longest delay in ms, later writes play late
+    explicit PlayoutDelay(uint32_t minimum = 0,
+                          uint32_t maximum = BucketMs * (Buckets - 1))
+        : _minimum(minimum), _maximum(maximum) {
+        reset();
+    }
+
+    /// Forgets the link, e.g. when a new stream starts
+    void reset() {
+        for (float &bucket : _histogram) bucket = 0.0f;
+        _total = 0.0f;
+        _delay = _minimum;
+        _writes = 0;
+        _late = 0;
+    }
+
+    /// Takes in a write, before its points are played back with delay()
+    /// @param lateness ms the write arrived after its first point was due,
+    /// negative if it came early
+    void arrived(int32_t lateness) {
+        size_t bucket = 0;
+        if (lateness > 0) {
+            bucket = (size_t(lateness) + BucketMs - 1) / BucketMs;
+            if (bucket >= Buckets) bucket = Buckets - 1;
+        }
+        for (float &weight : _histogram) weight *= 1.0f - Forget;
+        _histogram[bucket] += Forget;
+        _total = _total * (1.0f - Forget) + Forget;
+        _writes++;
+
+        // Lateness of the bucket the quantile falls into
+        float wanted = Quantile * _total;
+        float sum = 0.0f;
+        size_t quantile = 0;
+        while (quantile + 1 < Buckets) {
+            sum += _histogram[quantile];
+            if (sum >= wanted) break;
+            quantile++;
+        }
+        _delay = uint32_t(quantile) * BucketMs;
+        if (_delay < _minimum) _delay = _minimum;
+        if (_delay > _maximum) _delay = _maximum;
+
+        if (lateness > 0 && uint32_t(lateness) > _delay) _late++;
+    }
+
+    /// Delay to play points back with, after the time they are due, in ms
+    uint32_t delay() const { return _delay; }
+
+    /// Writes taken in
+    uint32_t writes() const { return _writes; }
+
+    /// Writes that arrived after the delay they were played back with
+    uint32_t late() const { return _late; }
+
+  private:
+    uint32_t _minimum;
+    uint32_t _maximum;
+    float _histogram[Buckets];
+    float _total;
+    uint32_t _delay;
+    uint32_t _writes;
+    uint32_t _late;
+};
+
+}  // namespace jitter_buffer
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Fixed capacity queue between tasks, e.g. the BLE callbacks and the
+// streaming task. No hardware dependencies — testable on native platform.
+//
+// Any number of tasks may push, one task pops. Nothing allocates and no
+// call waits for another task. A push only retries after another push has
+// claimed the slot it was after, so some push always gets through. A call
+// that runs into a slot another task holds gives up instead of spinning,
+// so a preempted task can never stall the others. What happens to a push
+// while the ring is full is the overflow policy.
+
+namespace ring_buffer {
+
+/// What a push does while the ring is full.
+enum class Overflow : uint8_t {
+    DropNewest,  // Keep what is queued, the new record is lost
+    DropOldest,  // Make room by dropping the oldest record
+    Coalesce,    // The new record replaces the newest queued one
+};
+
+/// Multi-producer, single-consumer ring. Each slot carries a sequence
+/// number, so producers claim slots with a single compare-and-swap and a
+/// record only becomes visible to the consumer once it is complete. A small
+/// per-slot flag guards the record while it is read, or overwritten by
+/// Coalesce, and lets DropOldest take records from the producer side.
+///
+/// T must be trivially copyable. Capacity must be a power of two.
+template <class T, size_t Capacity>
+class Ring {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Ring needs trivially copyable records");
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Ring capacity must be a power of two");
+
+  public:
+    explicit Ring(Overflow overflow = Overflow::DropNewest)
+        : _overflow(overflow) {
+        for (size_t i = 0; i < Capacity; i++) {
+            _slots[i].sequence.store(uint32_t(i), std::memory_order_relaxed);
+            _slots[i].busy.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /// Number of records the ring holds.
+    static constexpr size_t capacity() { return Capacity; }
+
+    /// Changes the overflow policy. Safe while other tasks push.
+    void setOverflow(Overflow overflow) {
+        _overflow.store(overflow, std::memory_order_relaxed);
+    }
+
+    Overflow overflow() const {
+        return _overflow.load(std::memory_order_relaxed);
+    }
+
+    /// Appends a record. Never blocks.
+    /// @return true if the record was queued, or merged into the newest one
+    ///         with Coalesce. false if it was lost.
+    bool push(const T &record) {
+        for (;;) {
+            uint32_t position = _tail.load(std::memory_order_relaxed);
+            Slot &slot = _slots[position & _mask];
+            uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+            int32_t lag = int32_t(sequence - position);
+            if (lag > 0) {
+                // Another producer claimed it first, try the next one
+                continue;
+            }
+            if (lag == 0) {
+                if (!_tail.compare_exchange_weak(position, position + 1,
+                                                 std::memory_order_relaxed)) {
+                    continue;
+                }
+                slot.record = record;
+                slot.sequence.store(position + 1, std::memory_order_release);
+                _pushed.fetch_add(1, std::memory_order_relaxed);
+                _trackHighWater(position + 1);
+                return true;
+            }
+
+            // Full. Every full push loses one record, one way or another.
+            _overflows.fetch_add(1, std::memory_order_relaxed);
+            switch (overflow()) {
+                case Overflow::DropOldest: {
+                    T oldest;
+                    if (_take(oldest)) {
+                        // Room for one more, unless another producer is
+                        // faster. Then the next round drops again.
+                        continue;
+                    }
+                    return false;
+                }
+                case Overflow::Coalesce:
+                    return _replaceNewest(record, position);
+                case Overflow::DropNewest:
+                default:
+                    return false;
+            }
+        }
+    }
+
+    /// Takes the oldest record. Consumer only.
+    /// @param record receives the record. Left untouched if none was taken.
+    /// @return false if the ring is empty, or the oldest record is being
+    ///         replaced right now. Try again later.
+    bool pop(T &record) { return _take(record); }
+
+    /// Takes up to maxRecords of the oldest records in one go. Consumer
+    /// only.
+    /// @param records array receiving the records, oldest first
+    /// @return number of records taken, 0 if none could be
+    size_t pop(T *records, size_t maxRecords) {
+        size_t count = 0;
+        while (count < maxRecords && _take(records[count])) {
+            count++;
+        }
+        return count;
+    }
+
+    /// Looks at the oldest record without taking it. Consumer only.
+    /// @param record receives the record. Left untouched if none was read.
+    /// @return false if the ring is empty, or the oldest record is busy
+    bool peek(T &record) { return peek(&record, 1) == 1; }
+
+    /// Looks at up to maxRecords of the oldest records without taking them.
+    /// Consumer only.
+    /// @param records array receiving the records, oldest first
+    /// @return number of records copied
+    size_t peek(T *records, size_t maxRecords) {
+        uint32_t position = _head.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (count < maxRecords && _read(position, records[count])) {
+            count++;
+            position++;
+        }
+        return count;
+    }
+
+    /// Drops everything queued. Consumer only.
+    void clear() {
+        T record;
+        while (_take(record)) {
+        }
+    }
+
+    /// Number of records waiting. Only a snapshot while producers are busy.
+    size_t size() const {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        return size_t(tail - head);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /// Number of records queued since construction, not counting merges.
+    uint32_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+
+    /// Number of records lost to a full ring: dropped, or replaced by a
+    /// newer one.
+    uint32_t overflows() const {
+        return _overflows.load(std::memory_order_relaxed);
+    }
+
+    /// Highest fill level seen since construction.
+    uint32_t highWater() const {
+        return _highWater.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr uint32_t _mask = uint32_t(Capacity - 1);
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        std::atomic<bool> busy;
+        T record;
+    };
+
+    Slot _slots[Capacity];
+    std::atomic<uint32_t> _tail{0};
+    std::atomic<uint32_t> _head{0};
+    std::atomic<Overflow> _overflow;
+    std::atomic<uint32_t> _pushed{0};
+    std::atomic<uint32_t> _overflows{0};
+    std::atomic<uint32_t> _highWater{0};
+
+    // Takes the record at the head. The consumer and producers dropping the
+    // oldest record may race for it, the flag decides.
+    bool _take(T &record) {
+        uint32_t position = _head.load(std::memory_order_acquire);
+        Slot &slot = _slots[position & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            // Empty, or a producer has claimed the slot but not finished
+            return false;
+        }
+        if (slot.busy.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        // Someone else may have taken it while we got here
+        if (_head.load(std::memory_order_relaxed) != position ||
+            slot.sequence.load(std::memory_order_relaxed) != position + 1) {
+            slot.busy.store(false, std::memory_order_release);
+            return false;
+        }
+        record = slot.record;
+        slot.sequence.store(position + Capacity, std::memory_order_release);
+        _head.store(position + 1, std::memory_order_release);
+        slot.busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+    // Copies the record at position without taking it. Holding the flag
+    // keeps it from being taken or replaced while it is copied.
+    bool _read(uint32_t position, T &record) {
+        Slot &slot = _slots[position & _mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            return false;
+        }
+        if (slot.busy.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        bool queued =
+            slot.sequence.load(std::memory_order_relaxed) == position + 1;
+        if (queued) {
+            record = slot.record;
+        }
+        slot.busy.store(false, std::memory_order_release);
+        return queued;
+    }
+
+    // Overwrites the newest record, if it is still queued and nobody else
+    // holds it
+    bool _replaceNewest(const T &record, uint32_t tail) {
+        uint32_t position = tail - 1;
+        Slot &slot = _slots[position & _mask];
+        if (slot.busy.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        bool queued =
+            slot.sequence.load(std::memory_order_relaxed) == position + 1 &&
+            _tail.load(std::memory_order_relaxed) == tail;
+        if (queued) {
+            slot.record = record;
+        }
+        slot.busy.store(false, std::memory_order_release);
+        return queued;
+    }
+
+    // Fill level including the record at position, for diagnostics only
+    void _trackHighWater(uint32_t end) {
+        // The consumer moves the head just after freeing the slot
+        uint32_t used = end - _head.load(std::memory_order_relaxed);
+        used = used < Capacity ? used : uint32_t(Capacity);
+        uint32_t highWater = _highWater.load(std::memory_order_relaxed);
+        while (used > highWater &&
+               !_highWater.compare_exchange_weak(highWater, used,
+                                                 std::memory_order_relaxed)) {
+        }
+    }
+};
+
+}  // namespace ring_buffer
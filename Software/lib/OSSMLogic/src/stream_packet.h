@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary stream packets: many stream targets in one BLE write.
+// No hardware dependencies — testable on native platform.
+//
+// The text command stream:<pos>:<ms> carries a single target per write and
+// is matched, copied and parsed twice on its way to the streaming task. A
+// packet carries as many targets as fit the negotiated MTU and is decoded
+// in place, straight into the target queue. Nothing allocates.
+//
+// All fields little endian:
+//
+//   offset  size  field
+//   0       1     version, 1 or 2
+//   1       1     count, number of points (1 - 255)
+//   2       4     base time, when the first point is due:
+//                   version 1: ms after the write arrives
+//                   version 2: device time in ms, see clock_sync.h
+//   6       2     base position, of the first point, 0 - 10000
+//   8       4n    points, each:
+//                   int16   position change since the previous point
+//                   uint16  ms since the previous point
+//
+// The first point's changes are added to the base, so it is usually sent
+// as 0, 0. Positions are hundredths of a percent of the stroke, 0 is all
+// the way out like stream:0.
+//
+// Version 1 points play when their write arrives plus their time, so they
+// carry every delay of the link. Version 2 points play at their device
+// time plus a playout delay the device sizes to the link's jitter, see
+// jitter_buffer.h.
+
+namespace stream_packet {
+
+constexpr uint8_t version = 1;
+constexpr uint8_t versionDeviceTime = 2;
+constexpr size_t headerSize = 8;
+constexpr size_t pointSize = 4;
+constexpr size_t pointsMax = 255;
+constexpr uint16_t positionMax = 10000;
+
+// Bytes of an ATT packet that are not part of the written value
+constexpr size_t attOverhead = 3;
+
+/// A decoded point.
+struct Point {
+    uint16_t position;  // 0 - 10000, hundredths of a percent
+    uint32_t time;      // ms after the packet arrived, or device time
+};
+
+/// Why a packet was rejected. Nothing of a rejected packet is queued.
+enum class Error : uint8_t {
+    None,
+    TooShort,     // Shorter than the header
+    BadVersion,   // Made for another version
+    NoPoints,     // Count is 0
+    BadLength,    // Length does not match the count
+    BadPosition,  // A point outside 0 - 10000
+    BadTime,      // A version 1 point more than 2^32 ms ahead
+    NoRoom,       // More points than the queue has room for right now
+};
+
+inline const char *errorName(Error error) {
+    switch (error) {
+        case Error::None: return "ok";
+        case Error::TooShort: return "too_short";
+        case Error::BadVersion: return "bad_version";
+        case Error::NoPoints: return "no_points";
+        case Error::BadLength: return "bad_length";
+        case Error::BadPosition: return "bad_position";
+        case Error::BadTime: return "bad_time";
+        case Error::NoRoom: return "no_room";
+    }
+    return "unknown";
+}
+
+/// True if the points of a packet are stamped in device time. Only
+/// meaningful for a packet decode() took.
+inline bool deviceTime(const uint8_t *data) {
+    return data[0] == versionDeviceTime;
+}
+
+/// Number of points that fit one write at the given ATT MTU.
+constexpr size_t maxPoints(uint16_t mtu) {
+    return mtu < attOverhead + headerSize + pointSize ? 0
+           : (mtu - attOverhead - headerSize) / pointSize < pointsMax
+               ? (mtu - attOverhead - headerSize) / pointSize
+               : pointsMax;
+}
+
+/// Size of a packet with the given number of points.
+constexpr size_t packetSize(size_t points) {
+    return headerSize + points * pointSize;
+}
+
+namespace detail {
+
+inline uint16_t read16(const uint8_t *bytes) {
+    return uint16_t(bytes[0] | (bytes[1] << 8));
+}
+
+inline uint32_t read32(const uint8_t *bytes) {
+    return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) |
+           (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+}
+
+inline void write16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = uint8_t(value);
+    bytes[1] = uint8_t(value >> 8);
+}
+
+inline void write32(uint8_t *bytes, uint32_t value) {
+    write16(bytes, uint16_t(value));
+    write16(bytes + 2, uint16_t(value >> 16));
+}
+
+// Walks the points, calling visit(point) for each. Stops at the first
+// point out of range. Device times wrap around with millis().
+template <class Visit>
+Error walk(const uint8_t *data, uint8_t count, Visit &&visit) {
+    int32_t position = read16(data + 6);
+    uint64_t time = read32(data + 2);
+    const uint8_t *point = data + headerSize;
+    for (uint8_t i = 0; i < count; i++, point += pointSize) {
+        position += int16_t(read16(point));
+        time += read16(point + 2);
+        if (position < 0 || position > positionMax) return Error::BadPosition;
+        if (time > UINT32_MAX && data[0] != versionDeviceTime) {
+            return Error::BadTime;
+        }
+        visit(Point{uint16_t(position), uint32_t(time)});
+    }
+    return Error::None;
+}
+
+}  // namespace detail
+
+/// Checks a packet and hands its points to sink(const Point &) in order.
+/// The whole packet is checked first, a bad packet reaches the sink not at
+/// all.
+/// @param room points the sink can take without dropping any. A packet
+/// with more is refused whole, so a client sending faster than the queue
+/// drains loses its newest packet instead of targets already queued.
+/// @return Error::None if every point reached the sink
+template <class Sink>
+Error decode(const uint8_t *data, size_t size, size_t room, Sink &&sink) {
+    if (size < headerSize) return Error::TooShort;
+    if (data[0] != version && data[0] != versionDeviceTime) {
+        return Error::BadVersion;
+    }
+    uint8_t count = data[1];
+    if (count == 0) return Error::NoPoints;
+    if (size != packetSize(count)) return Error::BadLength;
+
+    Error error = detail::walk(data, count, [](const Point &) {});
+    if (error != Error::None) return error;
+    if (count > room) return Error::NoRoom;
+    return detail::walk(data, count, sink);
+}
+
+/// decode() into a sink that takes any number of points.
+template <class Sink>
+Error decode(const uint8_t *data, size_t size, Sink &&sink) {
+    return decode(data, size, pointsMax, sink);
+}
+
+/// Writes a packet, as a client would.
+/// @param points points in the order they are due, times ascending. Device
+/// times may wrap around.
+/// @param count number of points, 1 - 255
+/// @param out receives the packet
+/// @param capacity size of out
+/// @param packetVersion version, or versionDeviceTime for device times
+/// @return bytes written, 0 if the points do not fit the format or out
+inline size_t encode(const Point *points, size_t count, uint8_t *out,
+                     size_t capacity, uint8_t packetVersion = version) {
+    if (count == 0 || count > pointsMax || capacity < packetSize(count)) {
+        return 0;
+    }
+    out[0] = packetVersion;
+    out[1] = uint8_t(count);
+    detail::write32(out + 2, points[0].time);
+    detail::write16(out + 6, points[0].position);
+
+    uint16_t position = points[0].position;
+    uint32_t time = points[0].time;
+    uint8_t *point = out + headerSize;
+    for (size_t i = 0; i < count; i++, point += pointSize) {
+        int32_t change = int32_t(points[i].position) - position;
+        uint32_t elapsed = points[i].time - time;
+        bool backwards = points[i].time < time &&
+                         packetVersion != versionDeviceTime;
+        if (points[i].position > positionMax || backwards ||
+            elapsed > UINT16_MAX) {
+            return 0;
+        }
+        detail::write16(point, uint16_t(int16_t(change)));
+        detail::write16(point + 2, uint16_t(elapsed));
+        position = points[i].position;
+        time = points[i].time;
+    }
+    return packetSize(count);
+}
+
+}  // namespace stream_packet
@@ -0,0 +1,192 @@
+/**
+ *   Keyframe file format of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Keyframe files are a 12 byte header followed by variable length records.
+  All numbers are little endian. scripts/keyframe_encoder.py writes them.
+
+  Header
+    0  char[4]  magic "OSKF"
+    4  uint8    version, 1
+    5  uint8    flags, bit 0: loop back to the first keyframe at the end
+    6  uint16   reference time of a full stroke in ms. Durations are scaled
+                by timeOfStroke / reference, so the speed setting still works.
+    8  uint32   number of keyframes
+
+  Record
+    0  uint8    flags, see KEYFRAME_HAS_*
+    1  uint16   position, 0 = depth - stroke (retracted) ... 65535 = depth.
+                Left out for a hold.
+       uint16   duration in ms
+       uint16   acceleration in mm/s^2, if KEYFRAME_HAS_ACCELERATION
+       uint16   jerk in m/s^3, if KEYFRAME_HAS_JERK
+
+  A hold keeps the carriage where it is for its duration.
+*/
+#define KEYFRAME_MAGIC "OSKF"
+#define KEYFRAME_VERSION 1
+#define KEYFRAME_HEADER_SIZE 12
+#define KEYFRAME_RECORD_MAX 9
+
+#define KEYFRAME_LOOP 0x01
+
+#define KEYFRAME_HAS_ACCELERATION 0x01
+#define KEYFRAME_HAS_JERK 0x02
+#define KEYFRAME_HOLD 0x04
+
+/**************************************************************************/
+/*!
+  @brief  Header of a keyframe file
+*/
+/**************************************************************************/
+typedef struct {
+    uint8_t flags;              //!< KEYFRAME_LOOP
+    uint16_t referenceStrokeMs; //!< Full stroke time the file was made for
+    uint32_t count;             //!< Number of keyframes
+} keyframeHeader;
+
+/**************************************************************************/
+/*!
+  @brief  A single keyframe. Acceleration and jerk are 0 if the file does not
+  give them.
+*/
+/**************************************************************************/
+typedef struct {
+    bool hold;             //!< Stand still instead of moving
+    uint16_t position;     //!< Target, fraction of the stroke * 65535
+    uint16_t durationMs;   //!< Time to get there, or time to hold
+    uint16_t acceleration; //!< Acceleration in mm/s^2, 0 to derive
+    uint16_t jerk;         //!< Jerk in m/s^3, 0 for the machine limit
+} keyframe;
+
+namespace keyframe_format {
+
+inline void put16(uint8_t *out, uint16_t value) {
+    out[0] = uint8_t(value);
+    out[1] = uint8_t(value >> 8);
+}
+
+inline uint16_t get16(const uint8_t *in) {
+    return uint16_t(in[0] | (in[1] << 8));
+}
+
+//! Writes a header
+/*!
+  @param header header to write
+  @param out KEYFRAME_HEADER_SIZE bytes
+*/
+inline void encodeHeader(const keyframeHeader &header, uint8_t *out) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = uint8_t(KEYFRAME_MAGIC[i]);
+    }
+    out[4] = KEYFRAME_VERSION;
+    out[5] = header.flags;
+    put16(out + 6, header.referenceStrokeMs);
+    put16(out + 8, uint16_t(header.count));
+    put16(out + 10, uint16_t(header.count >> 16));
+}
+
+//! Reads a header
+/*!
+  @param in KEYFRAME_HEADER_SIZE bytes
+  @param header receives the header
+  @return false if this is not a keyframe file this version can play
+*/
+inline bool decodeHeader(const uint8_t *in, keyframeHeader &header) {
+    for (int i = 0; i < 4; i++) {
+        if (in[i] != uint8_t(KEYFRAME_MAGIC[i])) {
+            return false;
+        }
+    }
+    if (in[4] != KEYFRAME_VERSION) {
+        return false;
+    }
+    header.flags = in[5];
+    header.referenceStrokeMs = get16(in + 6);
+    header.count = uint32_t(get16(in + 8)) | (uint32_t(get16(in + 10)) << 16);
+    return header.referenceStrokeMs > 0;
+}
+
+//! Writes a record
+/*!
+  @param frame keyframe to write
+  @param out at least KEYFRAME_RECORD_MAX bytes
+  @return Number of bytes written
+*/
+inline size_t encode(const keyframe &frame, uint8_t *out) {
+    uint8_t flags = 0;
+    if (frame.hold) flags |= KEYFRAME_HOLD;
+    if (frame.acceleration > 0) flags |= KEYFRAME_HAS_ACCELERATION;
+    if (frame.jerk > 0) flags |= KEYFRAME_HAS_JERK;
+
+    size_t length = 0;
+    out[length++] = flags;
+    if (!frame.hold) {
+        put16(out + length, frame.position);
+        length += 2;
+    }
+    put16(out + length, frame.durationMs);
+    length += 2;
+    if (flags & KEYFRAME_HAS_ACCELERATION) {
+        put16(out + length, frame.acceleration);
+        length += 2;
+    }
+    if (flags & KEYFRAME_HAS_JERK) {
+        put16(out + length, frame.jerk);
+        length += 2;
+    }
+    return length;
+}
+
+//! Length of a record from its flags byte
+inline size_t recordLength(uint8_t flags) {
+    size_t length = (flags & KEYFRAME_HOLD) ? 3 : 5;
+    if (flags & KEYFRAME_HAS_ACCELERATION) length += 2;
+    if (flags & KEYFRAME_HAS_JERK) length += 2;
+    return length;
+}
+
+//! Reads a record
+/*!
+  @param in recordLength(in[0]) bytes
+  @param frame receives the keyframe. The position of a hold is left as is.
+  @return false if the flags are unknown
+*/
+inline bool decode(const uint8_t *in, keyframe &frame) {
+    uint8_t flags = in[0];
+    if (flags & ~(KEYFRAME_HAS_ACCELERATION | KEYFRAME_HAS_JERK |
+                  KEYFRAME_HOLD)) {
+        return false;
+    }
+    size_t offset = 1;
+    frame.hold = (flags & KEYFRAME_HOLD) != 0;
+    if (!frame.hold) {
+        frame.position = get16(in + offset);
+        offset += 2;
+    }
+    frame.durationMs = get16(in + offset);
+    offset += 2;
+    frame.acceleration = 0;
+    frame.jerk = 0;
+    if (flags & KEYFRAME_HAS_ACCELERATION) {
+        frame.acceleration = get16(in + offset);
+        offset += 2;
+    }
+    if (flags & KEYFRAME_HAS_JERK) {
+        frame.jerk = get16(in + offset);
+    }
+    return true;
+}
+
+}  // namespace keyframe_format
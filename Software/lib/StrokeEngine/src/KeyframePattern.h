@@ -0,0 +1,524 @@
+/**
+ *   Keyframe Pattern of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "KeyframeFormat.h"
+#include "SeqLock.h"
+#include "pattern.h"
+
+// Bytes per prefetch block. Two of them are held per keyframe pattern, so
+// 256 keeps about 100 keyframes in RAM.
+#ifndef KEYFRAME_BLOCK_SIZE
+#define KEYFRAME_BLOCK_SIZE 256
+#endif
+
+// Number of recent keyframes kept to answer repeated queries for the same
+// stroke index. Must be larger than STROKE_LOOKAHEAD_MAX + 1, StrokeEngine.h
+// checks it.
+#ifndef KEYFRAME_HISTORY
+#define KEYFRAME_HISTORY 8
+#endif
+
+// Longest path of a keyframe file that can be selected, including the
+// terminating zero
+#ifndef KEYFRAME_PATH_MAX
+#define KEYFRAME_PATH_MAX 64
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  The keyframe file selected for KeyframePattern
+*/
+/**************************************************************************/
+typedef struct {
+    char path[KEYFRAME_PATH_MAX]; //!< Empty if no file is selected
+} keyframeSelection;
+
+/**************************************************************************/
+/*!
+  @brief  Where a keyframe stream reads its bytes from. LittleFSKeyframeSource
+  reads a file on the device, tests provide their own.
+*/
+/**************************************************************************/
+class KeyframeSource {
+  public:
+    virtual ~KeyframeSource() = default;
+
+    //! Size of the whole file in bytes
+    virtual uint32_t size() = 0;
+
+    //! Reads part of the file
+    /*!
+      @param offset position in the file
+      @param buffer receives the bytes
+      @param length number of bytes to read
+      @return Number of bytes actually read
+    */
+    virtual size_t read(uint32_t offset, uint8_t *buffer, size_t length) = 0;
+};
+
+/**************************************************************************/
+/*!
+  @brief  Decodes keyframes from a source through two fixed blocks. One
+  block is being decoded while the other one already holds the following
+  bytes, so running out of a block never waits for the source. The spare
+  block is refilled by prefetch(). If prefetch() wasn't called in time,
+  next() reads synchronously and counts an underrun.
+
+  A looping file wraps around inside the prefetch, so the loop point is
+  seamless as well. Memory use does not depend on the file size.
+*/
+/**************************************************************************/
+class KeyframeStream {
+  public:
+    //! Opens a keyframe file
+    /*!
+      @param source file to read. Must outlive the stream.
+      @return false if the source does not hold a playable keyframe file
+    */
+    bool open(KeyframeSource *source) {
+        _source = nullptr;
+        if (source == nullptr || source->size() <= KEYFRAME_HEADER_SIZE) {
+            return false;
+        }
+        uint8_t bytes[KEYFRAME_HEADER_SIZE];
+        if (source->read(0, bytes, KEYFRAME_HEADER_SIZE) !=
+                KEYFRAME_HEADER_SIZE ||
+            !keyframe_format::decodeHeader(bytes, _header)) {
+            return false;
+        }
+        _source = source;
+        _size = source->size();
+        rewind();
+        return true;
+    }
+
+    //! Starts over at the first keyframe. Reads both blocks synchronously.
+    void rewind() {
+        if (_source == nullptr) {
+            return;
+        }
+        _readOffset = KEYFRAME_HEADER_SIZE;
+        _front = 0;
+        _position = 0;
+        _fill(0);
+        _fill(1);
+    }
+
+    //! Decodes the next keyframe
+    /*!
+      @param frame receives the keyframe. The position of a hold is left as
+      is.
+      @return false at the end of a file that does not loop, or on a broken
+      record
+    */
+    bool next(keyframe &frame) {
+        if (_source == nullptr) {
+            return false;
+        }
+        uint8_t record[KEYFRAME_RECORD_MAX];
+        if (!_readBytes(record, 1)) {
+            return false;
+        }
+        size_t length = keyframe_format::recordLength(record[0]);
+        if (!_readBytes(record + 1, length - 1) ||
+            !keyframe_format::decode(record, frame)) {
+            _source = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    //! Refills the spare block if it has been used up. Call this whenever
+    //! there is time for a read, e.g. while a move is running.
+    void prefetch() {
+        uint8_t spare = _front ^ 1;
+        if (_source != nullptr && !_ready[spare]) {
+            _fill(spare);
+        }
+    }
+
+    //! Header of the open file
+    const keyframeHeader &header() const { return _header; }
+
+    //! Number of times next() had to read synchronously
+    uint32_t underruns() const { return _underruns; }
+
+    //! Number of blocks read from the source
+    uint32_t blockReads() const { return _blockReads; }
+
+  private:
+    KeyframeSource *_source = nullptr;
+    keyframeHeader _header = {0, 1000, 0};
+    uint32_t _size = 0;
+    uint32_t _readOffset = KEYFRAME_HEADER_SIZE;
+    uint8_t _blocks[2][KEYFRAME_BLOCK_SIZE];
+    uint16_t _length[2] = {0, 0};
+    bool _ready[2] = {false, false};
+    uint8_t _front = 0;
+    uint16_t _position = 0;
+    uint32_t _underruns = 0;
+    uint32_t _blockReads = 0;
+
+    void _fill(uint8_t block) {
+        // A block never spans the end of the file, so a looping file simply
+        // continues with the first record in the next block
+        if (_readOffset >= _size && (_header.flags & KEYFRAME_LOOP)) {
+            _readOffset = KEYFRAME_HEADER_SIZE;
+        }
+        uint32_t available = (_readOffset < _size) ? _size - _readOffset : 0;
+        size_t length =
+            (available < KEYFRAME_BLOCK_SIZE) ? available : KEYFRAME_BLOCK_SIZE;
+        if (length > 0) {
+            length = _source->read(_readOffset, _blocks[block], length);
+            _readOffset += length;
+            _blockReads++;
+        }
+        _length[block] = uint16_t(length);
+        _ready[block] = true;
+    }
+
+    bool _readBytes(uint8_t *out, size_t count) {
+        while (count > 0) {
+            if (_position >= _length[_front]) {
+                uint8_t spare = _front ^ 1;
+                if (!_ready[spare]) {
+                    _fill(spare);
+                    if (_length[spare] > 0) {
+                        _underruns++;
+                    }
+                }
+                // An empty block is the end of the file
+                if (_length[spare] == 0) {
+                    return false;
+                }
+                _ready[_front] = false;
+                _front = spare;
+                _position = 0;
+            }
+            *out++ = _blocks[_front][_position++];
+            count--;
+        }
+        return true;
+    }
+};
+
+#if defined(ARDUINO_ARCH_ESP32) && __has_include(<LittleFS.h>)
+#include <LittleFS.h>
+#define KEYFRAME_LITTLEFS 1
+
+/**************************************************************************/
+/*!
+  @brief  Keyframe file on the LittleFS partition (labelled "spiffs" in the
+  partition table). The file stays open while it plays.
+*/
+/**************************************************************************/
+class LittleFSKeyframeSource : public KeyframeSource {
+  public:
+    //! Opens a file, mounting the file system if needed
+    /*!
+      @param path path of the file, e.g. "/patterns/wave.oskf"
+      @return false if the file can't be opened
+    */
+    bool open(const char *path) {
+        if (!LittleFS.begin(false)) {
+            return false;
+        }
+        _file = LittleFS.open(path, "r");
+        return bool(_file);
+    }
+
+    void close() { _file.close(); }
+
+    uint32_t size() { return _file ? uint32_t(_file.size()) : 0; }
+
+    size_t read(uint32_t offset, uint8_t *buffer, size_t length) {
+        if (!_file || !_file.seek(offset)) {
+            return 0;
+        }
+        return _file.read(buffer, length);
+    }
+
+  private:
+    File _file;
+};
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Plays a keyframe file. Every stroke index is one move keyframe;
+  holds in between turn into pauses before the following move. Positions are
+  fractions of the current stroke and durations scale with the speed setting,
+  so depth, stroke and speed work like with any other pattern. Sensation has
+  no effect.
+
+  Holds follow the timeline of the file: a move after a hold starts when
+  the file says it should, so time lost to clipped moves is made up in the
+  next pause. A file that does not loop stays at its last keyframe.
+
+  The file is streamed through a KeyframeStream, multi-hour files play in
+  the same few hundred bytes of RAM.
+
+  On the device the file is picked with select(), e.g. over BLE, and opened
+  when the pattern is selected or restarted. The first stroke index asked
+  for starts the file, so the pattern can be crossfaded into at any stroke.
+*/
+/**************************************************************************/
+class KeyframePattern : public Pattern {
+  public:
+    KeyframePattern(const char *str) : Pattern(str) {}
+
+    //! Selects the file new and restarted instances play
+    /*!
+      Call from one task only.
+      @param path path of the file, e.g. "/patterns/wave.oskf"
+      @return false if the path is empty or too long
+    */
+    static bool select(const char *path) {
+        size_t length = (path != nullptr) ? strlen(path) : 0;
+        if (length == 0 || length >= KEYFRAME_PATH_MAX) {
+            return false;
+        }
+        _selection.write([path, length](keyframeSelection &s) {
+            memcpy(s.path, path, length + 1);
+        });
+        return true;
+    }
+
+    //! Deselects the file, restarted instances stand still
+    static void clear() {
+        _selection.write([](keyframeSelection &s) { s.path[0] = '\0'; });
+    }
+
+    //! Changes with every select() and clear()
+    static uint32_t revision() { return _selection.sequence(); }
+
+    //! Starts playing a keyframe file from the beginning
+    /*!
+      @param source file to play. Must outlive the pattern or the next call.
+      @return false if the source does not hold a playable keyframe file
+    */
+    bool play(KeyframeSource *source) {
+        _newest = -1;
+        _base = -1;
+        _finished = false;
+        _playing = _stream.open(source);
+        return _playing;
+    }
+
+    motionParameter nextTarget(unsigned int index) {
+        _index = index;
+        _nextMove.skip = true;
+        const step *current = _step(int(index));
+        if (current == nullptr) {
+            return _nextMove;
+        }
+
+        // Wait for the end of a hold, timed from the file's timeline
+        if (current->holdMs > 0 &&
+            int32_t(current->startMillis - _millis()) > 0) {
+            return _nextMove;
+        }
+
+        _nextMove = _move(*current);
+        return _nextMove;
+    }
+
+    void prefetch() { _stream.prefetch(); }
+
+    //! The stream, for its counters
+    const KeyframeStream &stream() const { return _stream; }
+
+  protected:
+    // A move keyframe and what happens before it
+    typedef struct {
+        keyframe frame;
+        uint16_t fromPosition; // Position the move starts at
+        uint32_t holdMs;       // Sum of the holds right before the move
+        uint32_t startMillis;  // Planned start of the move
+        uint32_t endMillis;    // Planned end of the move
+    } step;
+
+    static inline SeqLock<keyframeSelection> _selection{keyframeSelection{}};
+
+    KeyframeStream _stream;
+    step _history[KEYFRAME_HISTORY];
+    int _newest = -1;
+    int _base = -1;  // Stroke index the file started at
+    bool _playing = false;
+    bool _finished = false;
+    bool _opened = false;    // The stream reads a file opened by _refresh()
+    uint32_t _revision = 1;  // Odd, never a sequence of a finished write
+#ifdef KEYFRAME_LITTLEFS
+    LittleFSKeyframeSource _file;
+#endif
+
+    // Opens a selected file, NULL if there is none
+    virtual KeyframeSource *_openFile(const char *path) {
+#ifdef KEYFRAME_LITTLEFS
+        return _file.open(path) ? &_file : nullptr;
+#else
+        (void)path;
+        return nullptr;
+#endif
+    }
+
+    virtual void _closeFile() {
+#ifdef KEYFRAME_LITTLEFS
+        _file.close();
+#endif
+    }
+
+    // Takes the selected file, unless a selection is just going on. A
+    // source given to play() stays until a file is selected.
+    void _refresh() {
+        if (_selection.sequence() == _revision) {
+            return;
+        }
+        keyframeSelection latest;
+        uint32_t sequence;
+        if (!_selection.tryRead(latest, sequence)) {
+            return;
+        }
+        _revision = sequence;
+        if (_opened) {
+            _playing = false;
+            _closeFile();
+            _opened = false;
+        }
+        if (latest.path[0] != '\0') {
+            KeyframeSource *source = _openFile(latest.path);
+            _opened = source != nullptr;
+            play(source);
+        }
+    }
+
+    // Current speed setting over the one the file was made for
+    float _timeScale() {
+        return _timeOfStroke * 1000.0f / float(_stream.header().referenceStrokeMs);
+    }
+
+    uint32_t _scaled(uint32_t ms) { return uint32_t(float(ms) * _timeScale()); }
+
+    int _toSteps(uint16_t position) {
+        return (_depth - _stroke) + int(float(_stroke) * position / 65535.0f);
+    }
+
+    // Entry for a stroke index, read from the stream as far as needed
+    const step *_step(int index) {
+        // Started, or restarted by asking for the first index again or an
+        // earlier one: play from the beginning
+        if (_base < 0 || index <= _base) {
+            _refresh();
+            if (_newest > 0) {
+                _stream.rewind();
+                _newest = -1;
+                _finished = false;
+            }
+            _base = index;
+        }
+        if (!_playing) {
+            return nullptr;
+        }
+        index -= _base;
+
+        while (_newest < index && !_finished) {
+            if (!_pull()) {
+                _finished = true;
+            }
+        }
+        if (_newest < 0) {
+            return nullptr;
+        }
+
+        // Past the end of the file, or further back than the history goes
+        int oldest = _newest - KEYFRAME_HISTORY + 1;
+        if (index > _newest) {
+            return nullptr;
+        }
+        if (index < oldest) {
+            index = (oldest > 0) ? oldest : 0;
+        }
+        return &_history[index % KEYFRAME_HISTORY];
+    }
+
+    // Reads the next move and the holds before it into the history
+    bool _pull() {
+        uint32_t holdMs = 0;
+        keyframe frame;
+        while (true) {
+            if (!_stream.next(frame)) {
+                return false;
+            }
+            if (!frame.hold) {
+                break;
+            }
+            holdMs += frame.durationMs;
+        }
+
+        uint32_t now = _millis();
+        uint16_t from = 0;
+        uint32_t start = now;
+        if (_newest >= 0) {
+            const step &previous = _history[_newest % KEYFRAME_HISTORY];
+            from = previous.frame.position;
+            start = previous.endMillis + _scaled(holdMs);
+        }
+        // A hold makes up for lag as far as it can, but the plan never
+        // starts a move in the past, so lag does not pile up over a file
+        if (int32_t(start - now) < 0) {
+            start = now;
+        }
+
+        _newest++;
+        step &next = _history[_newest % KEYFRAME_HISTORY];
+        next.frame = frame;
+        next.fromPosition = from;
+        next.holdMs = holdMs;
+        next.startMillis = start;
+        next.endMillis = next.startMillis + _scaled(frame.durationMs);
+        return true;
+    }
+
+    motionParameter _move(const step &s) {
+        motionParameter move = {0, 0, 0, false, 0};
+        move.stroke = _toSteps(s.frame.position);
+
+        float seconds = fmaxf(float(s.frame.durationMs) * _timeScale() / 1000.0f,
+                              0.001f);
+        float distance = fabsf(float(move.stroke - _toSteps(s.fromPosition)));
+        float acceleration = float(s.frame.acceleration) * float(_stepsPerMM);
+        float speed;
+
+        if (acceleration > 0.0f) {
+            // Trapezoid with the given acceleration that covers the distance
+            // in time. If it can't, a triangle with the given acceleration.
+            float discriminant = acceleration * acceleration * seconds * seconds -
+                                 4.0f * acceleration * distance;
+            speed = (discriminant >= 0.0f)
+                        ? 0.5f * (acceleration * seconds - sqrtf(discriminant))
+                        : sqrtf(acceleration * distance);
+        } else {
+            // 1/3 acceleration, 1/3 coasting, 1/3 deceleration
+            speed = 1.5f * distance / seconds;
+            acceleration = 3.0f * speed / seconds;
+        }
+
+        move.speed = int(fmaxf(speed, 1.0f));
+        move.acceleration = int(fmaxf(acceleration, 1.0f));
+        move.jerk = int(fminf(float(s.frame.jerk) * 1000.0f * float(_stepsPerMM),
+                              2.0e9f));
+        return move;
+    }
+};
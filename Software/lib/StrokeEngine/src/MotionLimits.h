@@ -0,0 +1,152 @@
+/**
+ *   Motion Limits of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "pattern.h"
+
+/*
+  The speed to timeOfStroke conversion, the planning of streamed moves and
+  the clipping of both to the machine limits, as used by StrokeEngine. They
+  live here without any hardware so the pattern sweep in
+  test/test_pattern_sweep and the streaming tests run exactly the code the
+  machine does.
+*/
+
+//! Parts of a motion that were clipped to the machine limits
+enum MotionClip : uint8_t {
+    CLIP_NONE = 0,
+    CLIP_SPEED = 1 << 0,
+    CLIP_ACCELERATION = 1 << 1,
+    CLIP_JERK = 1 << 2,
+};
+
+/**************************************************************************/
+/*!
+  @brief  Time of a stroke that makes a built-in pattern peak at the given
+  share of the machine's maximum speed.
+  Every built-in pattern produces peakStepsPerSec = 3 * stroke / T at
+  neutral sensation. Solve for T given the desired peak as a percentage of
+  the motor's max step rate.
+  @param stroke stroke length in steps
+  @param speedPercent peak speed in percent of maxStepPerSecond
+  @param maxStepPerSecond maximum speed of the machine in steps/s
+  @return time of a full stroke in seconds, 120 s when standing still
+*/
+/**************************************************************************/
+inline float timeOfStrokeForSpeed(int stroke, float speedPercent,
+                                  int maxStepPerSecond) {
+    if (stroke <= 0 || maxStepPerSecond <= 0 || speedPercent <= 0.0f) {
+        return 120.0f;
+    }
+    float desiredPeak = (speedPercent / 100.0f) * float(maxStepPerSecond);
+    float timeOfStroke = 3.0f * float(stroke) / desiredPeak;
+    return timeOfStroke < 0.01f    ? 0.01f
+           : timeOfStroke > 120.0f ? 120.0f
+                                   : timeOfStroke;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Clips a pattern target to the machine limits. Speed and
+  acceleration are lowered to the limit. A pattern may ask for a softer
+  jerk than the machine allows, but never for a harder one.
+  @param motion target of a move, speed and acceleration are clipped in
+  place. The stroke is left to the caller.
+  @param maxSpeed maximum speed in steps/s
+  @param maxAcceleration maximum acceleration in steps/s^2
+  @param maxJerk maximum jerk in steps/s^3, 0 for trapezoidal profiles
+  @param jerk returns the jerk to run the move with, 0 for a trapezoid
+  @return MotionClip flags of what was clipped, CLIP_NONE if nothing
+*/
+/**************************************************************************/
+inline uint8_t limitMotion(motionParameter &motion, int maxSpeed,
+                           int maxAcceleration, int maxJerk, int &jerk) {
+    uint8_t clipped = CLIP_NONE;
+    if (motion.speed > maxSpeed) {
+        motion.speed = maxSpeed;
+        clipped |= CLIP_SPEED;
+    }
+    if (motion.acceleration > maxAcceleration) {
+        motion.acceleration = maxAcceleration;
+        clipped |= CLIP_ACCELERATION;
+    }
+    jerk = maxJerk;
+    if (motion.jerk > 0) {
+        if (maxJerk > 0 && motion.jerk > maxJerk) {
+            clipped |= CLIP_JERK;
+        } else {
+            jerk = motion.jerk;
+        }
+    }
+    return clipped;
+}
+
+/**************************************************************************/
+/*!
+  @brief  Plans a streamed move to arrive in the given time. Speeds up
+  from the current speed and slows down to the end speed with the lowest
+  acceleration that covers the distance in time. If that would need more
+  than maxSpeed the move cruises at maxSpeed and accelerates harder.
+  The acceleration is not limited here. Run the result through
+  limitMotion(), which flags what can not be done in time.
+  @param motion receives speed and acceleration. Stroke, skip and jerk are
+  left to the caller.
+  @param distance distance to travel in steps
+  @param time time to arrival in s
+  @param startSpeed current speed in the direction of travel in steps/s
+  @param endSpeed speed to pass the target with in steps/s, 0 to stop there
+  @param maxSpeed maximum speed in steps/s
+*/
+/**************************************************************************/
+inline void planSegment(motionParameter &motion, int distance, float time,
+                        float startSpeed, float endSpeed, int maxSpeed) {
+    float d = fabsf(float(distance));
+    float v0 = startSpeed < 0.0f ? 0.0f : startSpeed;
+    float ve = endSpeed < 0.0f ? 0.0f : endSpeed;
+    float vmax = float(maxSpeed);
+    if (v0 > vmax) v0 = vmax;
+    if (ve > vmax) ve = vmax;
+    if (time < 0.001f) time = 0.001f;
+
+    // Accelerate to the peak speed and straight back down to the end speed
+    //   d = (2 vp² - v0² - ve²) / 2a,  T = (2 vp - v0 - ve) / a
+    float root = d * d - time * d * (v0 + ve) +
+                 0.5f * time * time * (v0 * v0 + ve * ve);
+    float peak = (d + sqrtf(root > 0.0f ? root : 0.0f)) / time;
+    float acceleration = (2.0f * peak - v0 - ve) / time;
+
+    if (peak > vmax) {
+        if (vmax * time > d) {
+            // Cruise at maxSpeed in between
+            float up = vmax - v0;
+            float down = vmax - ve;
+            peak = vmax;
+            acceleration = (up * up + down * down) / (2.0f * (vmax * time - d));
+        } else {
+            // Too far for the time at any acceleration
+            peak = ceilf(d / time);
+            acceleration = 2.0e9f;
+        }
+    }
+
+    // Whatever the plan, the carriage must be able to slow down in time
+    if (d > 0.0f && v0 > ve) {
+        float brake = (v0 * v0 - ve * ve) / (2.0f * d);
+        if (acceleration < brake) acceleration = brake;
+    }
+
+    motion.speed = int(fminf(ceilf(peak), 2.0e9f));
+    motion.acceleration = int(fminf(ceilf(acceleration), 2.0e9f));
+    if (motion.speed < 1) motion.speed = 1;
+    if (motion.acceleration < 1) motion.acceleration = 1;
+}
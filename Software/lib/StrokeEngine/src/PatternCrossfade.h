@@ -0,0 +1,140 @@
+/**
+ *   Pattern Crossfade of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include "pattern.h"
+
+/**************************************************************************/
+/*!
+  @brief  Blends an outgoing into an incoming pattern over a number of
+  strokes, so a pattern switch neither restarts the motion nor jumps to a
+  far away target.
+
+  Stroke i of the fade is a mix of both patterns' targets, speeds,
+  accelerations and jerks, weighted (i + 1) / (strokes + 1) towards the
+  incoming pattern. The incoming pattern is run with its own index, starting
+  at 0 or 1 so that it moves in the same direction as the outgoing one.
+
+  Pauses are only taken from the pattern that dominates the mix. While the
+  other one pauses, its last target in the same direction stands in for it,
+  so the fade adds no stops of its own.
+
+  Both patterns must stay alive during the fade. With PatternPool this holds
+  until the next PatternPool::prepare().
+*/
+/**************************************************************************/
+class PatternCrossfade {
+  public:
+    //! Starts a fade
+    /*!
+      @param from pattern running so far
+      @param to pattern to fade into
+      @param startIndex index of the first stroke that is blended
+      @param strokes number of blended strokes. 0 switches right away.
+    */
+    void begin(Pattern *from, Pattern *to, unsigned int startIndex,
+               uint8_t strokes) {
+        _from = from;
+        _to = to;
+        _start = startIndex;
+        _strokes = strokes;
+        _offset = startIndex - (startIndex % 2);
+        for (int i = 0; i < 2; i++) {
+            _hasLastFrom[i] = false;
+            _hasLastTo[i] = false;
+        }
+    }
+
+    //! Ends the fade. The incoming pattern continues on its own.
+    void end() { _from = nullptr; }
+
+    //! True while a fade is running
+    bool active() const { return _from != nullptr; }
+
+    //! The outgoing pattern, NULL if no fade is running
+    Pattern *from() const { return _from; }
+
+    //! True if the stroke with this index is no longer blended
+    bool done(unsigned int index) const {
+        return index >= _start + _strokes;
+    }
+
+    //! True if both patterns may be asked ahead, see Pattern::lookahead()
+    bool lookahead() const { return _from->lookahead() && _to->lookahead(); }
+
+    //! Index the incoming pattern uses for a stroke
+    unsigned int toIndex(unsigned int index) const { return index - _offset; }
+
+    //! Target of a stroke, see Pattern::nextTarget()
+    motionParameter nextTarget(unsigned int index) {
+        motionParameter to = _to->nextTarget(toIndex(index));
+        if (done(index)) {
+            return to;
+        }
+
+        // Weight of the incoming pattern
+        float weight = float(index - _start + 1) / float(_strokes + 1);
+        motionParameter from = _from->nextTarget(index);
+        int parity = index % 2;
+        _remember(from, _lastFrom[parity], _hasLastFrom[parity]);
+        _remember(to, _lastTo[parity], _hasLastTo[parity]);
+
+        // Pauses of the dominating pattern are kept, the other one's are
+        // bridged with its last target
+        bool toDominates = weight >= 0.5f;
+        motionParameter &dominant = toDominates ? to : from;
+        motionParameter &other = toDominates ? from : to;
+        if (dominant.skip) {
+            return dominant;
+        }
+        if (other.skip) {
+            bool hasLast =
+                toDominates ? _hasLastFrom[parity] : _hasLastTo[parity];
+            if (!hasLast) {
+                return dominant;
+            }
+            other = toDominates ? _lastFrom[parity] : _lastTo[parity];
+        }
+
+        motionParameter blend;
+        blend.stroke = _mix(from.stroke, to.stroke, weight);
+        blend.speed = _mix(from.speed, to.speed, weight);
+        blend.acceleration = _mix(from.acceleration, to.acceleration, weight);
+        // 0 asks for the machine limit, which is not a value to blend with
+        blend.jerk = (from.jerk == 0 || to.jerk == 0)
+                         ? 0
+                         : _mix(from.jerk, to.jerk, weight);
+        blend.skip = false;
+        return blend;
+    }
+
+  private:
+    Pattern *_from = nullptr;
+    Pattern *_to = nullptr;
+    unsigned int _start = 0;
+    unsigned int _offset = 0;
+    uint8_t _strokes = 0;
+    motionParameter _lastFrom[2];
+    motionParameter _lastTo[2];
+    bool _hasLastFrom[2] = {false, false};
+    bool _hasLastTo[2] = {false, false};
+
+    static int _mix(int a, int b, float weight) {
+        return int(lroundf(a + (b - a) * weight));
+    }
+
+    static void _remember(const motionParameter &target, motionParameter &last,
+                          bool &hasLast) {
+        if (!target.skip) {
+            last = target;
+            hasLast = true;
+        }
+    }
+};
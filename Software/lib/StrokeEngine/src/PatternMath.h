@@ -1,8 +1,35 @@
 #pragma once
 
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 #include <Arduino.h>
 
+/*
+  fscale() comes in three flavours, picked at compile time with
+  -D PATTERN_MATH=...:
+
+  PATTERN_MATH_REFERENCE  The original: two double precision pow() per call.
+                          The ESP32 has no double FPU, so this is done in
+                          software and is by far the slowest.
+  PATTERN_MATH_FLOAT      Single precision powf(). Within 1e-6 of the
+                          reference, relative to |newEnd - newBegin|.
+                          Default.
+  PATTERN_MATH_LUT        No pow() at all: interpolated 65 entry log2/exp2
+                          tables in flash. Within 1e-4 of the reference,
+                          relative to |newEnd - newBegin|, for any curve.
+
+  Both fast versions skip the power entirely for curve = 0, which is what
+  all built-in patterns use, and are exact there.
+*/
+#define PATTERN_MATH_REFERENCE 0
+#define PATTERN_MATH_FLOAT 1
+#define PATTERN_MATH_LUT 2
+
+#ifndef PATTERN_MATH
+#define PATTERN_MATH PATTERN_MATH_FLOAT
+#endif
+
 
 /**************************************************************************/
 /*!
@@ -28,9 +55,11 @@
                      Parameters are from -10 to 10 with 0 being a linear mapping 
                      (which basically takes curve out of the equation)
   @returns the scaled value
+  @note   This is the original double precision implementation. fscale()
+          below picks the implementation selected by PATTERN_MATH.
 */
 /**************************************************************************/
-inline float fscale( float originalMin, float originalMax, float newBegin, float
+inline float fscaleReference( float originalMin, float originalMax, float newBegin, float
 newEnd, float inputValue, float curve){
 
   float OriginalRange = 0;
@@ -89,6 +118,159 @@ newEnd, float inputValue, float curve){
   return rangedValue;
 }
 
+namespace pattern_math {
+
+//! log2(1 + i/64)
+static constexpr float log2Table[65] = {
+    0.000000000f, 0.022367813f, 0.044394119f, 0.066089190f, 0.087462841f,
+    0.108524457f, 0.129283017f, 0.149747120f, 0.169925001f, 0.189824559f,
+    0.209453366f, 0.228818690f, 0.247927513f, 0.266786541f, 0.285402219f,
+    0.303780748f, 0.321928095f, 0.339850003f, 0.357552005f, 0.375039431f,
+    0.392317423f, 0.409390936f, 0.426264755f, 0.442943496f, 0.459431619f,
+    0.475733431f, 0.491853096f, 0.507794640f, 0.523561956f, 0.539158811f,
+    0.554588852f, 0.569855608f, 0.584962501f, 0.599912842f, 0.614709844f,
+    0.629356620f, 0.643856190f, 0.658211483f, 0.672425342f, 0.686500527f,
+    0.700439718f, 0.714245518f, 0.727920455f, 0.741466986f, 0.754887502f,
+    0.768184325f, 0.781359714f, 0.794415866f, 0.807354922f, 0.820178962f,
+    0.832890014f, 0.845490051f, 0.857980995f, 0.870364720f, 0.882643049f,
+    0.894817763f, 0.906890596f, 0.918863237f, 0.930737338f, 0.942514505f,
+    0.954196310f, 0.965784285f, 0.977279923f, 0.988684687f, 1.000000000f};
+
+//! 2^(i/64)
+static constexpr float exp2Table[65] = {
+    1.000000000f, 1.010889286f, 1.021897149f, 1.033024879f, 1.044273782f,
+    1.055645178f, 1.067140401f, 1.078760798f, 1.090507733f, 1.102382583f,
+    1.114386743f, 1.126521619f, 1.138788635f, 1.151189230f, 1.163724859f,
+    1.176396992f, 1.189207115f, 1.202156731f, 1.215247360f, 1.228480536f,
+    1.241857812f, 1.255380757f, 1.269050957f, 1.282870016f, 1.296839555f,
+    1.310961212f, 1.325236643f, 1.339667524f, 1.354255547f, 1.369002423f,
+    1.383909882f, 1.398979673f, 1.414213562f, 1.429613338f, 1.445180807f,
+    1.460917794f, 1.476826146f, 1.492907728f, 1.509164428f, 1.525598151f,
+    1.542210825f, 1.559004400f, 1.575980845f, 1.593142151f, 1.610490332f,
+    1.628027422f, 1.645755478f, 1.663676580f, 1.681792831f, 1.700106354f,
+    1.718619298f, 1.737333835f, 1.756252160f, 1.775376493f, 1.794709075f,
+    1.814252176f, 1.834008086f, 1.853979125f, 1.874167634f, 1.894575982f,
+    1.915206561f, 1.936061793f, 1.957144124f, 1.978456026f, 2.000000000f};
+
+//! log2(x) for x > 0 from the table. Absolute error < 5e-5.
+inline float log2LUT(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exponent = int((bits >> 23) & 0xFF) - 127;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    int index = int(mantissa >> 17);
+    float fraction = float(mantissa & 0x1FFFF) * (1.0f / 131072.0f);
+    return float(exponent) + log2Table[index] +
+           (log2Table[index + 1] - log2Table[index]) * fraction;
+}
+
+//! 2^y from the table. Relative error < 2e-5. Underflows to 0 below -126.
+inline float exp2LUT(float y) {
+    if (y < -126.0f) {
+        return 0.0f;
+    }
+    int whole = int(floorf(y));
+    float position = (y - float(whole)) * 64.0f;
+    int index = int(position);
+    float fraction = position - float(index);
+    float mantissa =
+        exp2Table[index] + (exp2Table[index + 1] - exp2Table[index]) * fraction;
+
+    // Scale by 2^whole by adding to the exponent bits
+    uint32_t bits;
+    memcpy(&bits, &mantissa, sizeof(bits));
+    bits += uint32_t(whole) << 23;
+    memcpy(&mantissa, &bits, sizeof(bits));
+    return mantissa;
+}
+
+//! x^exponent for x in [0, 1] and exponent > 0 from the tables
+inline float powLUT(float x, float exponent) {
+    if (x <= 0.0f) {
+        return 0.0f;
+    }
+    return exp2LUT(exponent * log2LUT(x));
+}
+
+//! fscale() with the power function as a parameter. Same semantics as
+//! fscaleReference() in single precision.
+template <class Power, class Exponent>
+inline float fscaleWith(Power power, Exponent curveExponent, float originalMin,
+                        float originalMax, float newBegin, float newEnd,
+                        float inputValue, float curve) {
+    // Check for originalMin > originalMax
+    if (originalMin > originalMax) {
+        return 0.0f;
+    }
+
+    // Clamp input and curve
+    inputValue = inputValue < originalMin ? originalMin : inputValue;
+    inputValue = inputValue > originalMax ? originalMax : inputValue;
+    curve = curve > 10.0f ? 10.0f : (curve < -10.0f ? -10.0f : curve);
+
+    float normalized = (inputValue - originalMin) / (originalMax - originalMin);
+
+    // curve 0 is a linear mapping, no power needed
+    float scaled = normalized;
+    if (curve != 0.0f) {
+        // positive curve gives more weight to the high end of the output
+        scaled = power(normalized, curveExponent(-0.1f * curve));
+    }
+
+    return newBegin + scaled * (newEnd - newBegin);
+}
+
+}  // namespace pattern_math
+
+/**************************************************************************/
+/*!
+  @brief  fscale() in single precision with powf(). Same parameters as
+  fscaleReference().
+*/
+/**************************************************************************/
+inline float fscaleFloat(float originalMin, float originalMax, float newBegin,
+                         float newEnd, float inputValue, float curve) {
+    return pattern_math::fscaleWith(
+        [](float x, float exponent) { return powf(x, exponent); },
+        [](float y) { return powf(10.0f, y); }, originalMin, originalMax,
+        newBegin, newEnd, inputValue, curve);
+}
+
+/**************************************************************************/
+/*!
+  @brief  fscale() with lookup tables instead of pow(). Same parameters as
+  fscaleReference().
+*/
+/**************************************************************************/
+inline float fscaleLUT(float originalMin, float originalMax, float newBegin,
+                       float newEnd, float inputValue, float curve) {
+    // 10^y = 2^(y * log2(10))
+    return pattern_math::fscaleWith(
+        pattern_math::powLUT,
+        [](float y) { return pattern_math::exp2LUT(3.321928095f * y); },
+        originalMin, originalMax, newBegin, newEnd, inputValue, curve);
+}
+
+/**************************************************************************/
+/*!
+  @brief  Scales one range onto another with a curve, see fscaleReference().
+  Uses the implementation selected with PATTERN_MATH.
+*/
+/**************************************************************************/
+inline float fscale(float originalMin, float originalMax, float newBegin,
+                    float newEnd, float inputValue, float curve) {
+#if PATTERN_MATH == PATTERN_MATH_REFERENCE
+    return fscaleReference(originalMin, originalMax, newBegin, newEnd,
+                           inputValue, curve);
+#elif PATTERN_MATH == PATTERN_MATH_LUT
+    return fscaleLUT(originalMin, originalMax, newBegin, newEnd, inputValue,
+                     curve);
+#else
+    return fscaleFloat(originalMin, originalMax, newBegin, newEnd, inputValue,
+                       curve);
+#endif
+}
+
 /**************************************************************************/
 /*!
   @brief  Float version of Arduino's map() function. 
@@ -119,20 +301,20 @@ inline float fmap(float x, float in_min, float in_max, float out_min, float out_
   @returns the scaled factor
 */
 /**************************************************************************/
-inline float mapSensationToFactor(float maximumFactor, float inputValue, float curve = 0.0) {
-    inputValue = constrain(inputValue, -100.0, 100.0);
-    float fscaledValue = 0.0;
+inline float mapSensationToFactor(float maximumFactor, float inputValue, float curve = 0.0f) {
+    inputValue = constrain(inputValue, -100.0f, 100.0f);
+    float fscaledValue = 0.0f;
 
-    if (inputValue == 0.0) {
-        return 1.0;
+    if (inputValue == 0.0f) {
+        return 1.0f;
     } 
 
-    fscaledValue = fscale(0.0, 100.0, 1.0, maximumFactor, abs(inputValue), curve);
+    fscaledValue = fscale(0.0f, 100.0f, 1.0f, maximumFactor, fabsf(inputValue), curve);
 
     if (inputValue >= 0) {
         return fscaledValue;
     } else {
-        return 1.0/fscaledValue;
+        return 1.0f/fscaledValue;
     }
     
 }
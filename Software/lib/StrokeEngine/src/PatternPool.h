@@ -0,0 +1,108 @@
+/**
+ *   Pattern Pool of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "PatternRegistry.h"
+
+/**************************************************************************/
+/*!
+  @brief  Preallocated storage for the built-in patterns. Two slots, each
+  large enough for any of the pattern classes in PatternRegistry, are used
+  in turns: a new pattern is constructed in the slot that is not in use and
+  then published with a single atomic pointer store. Switching patterns
+  never touches the heap.
+
+  Only one task may call prepare()/activate(). Readers of active() must be
+  done with the previous pattern before the next prepare(), which
+  StrokeEngine guarantees by accessing the pattern under its mutex only.
+*/
+/**************************************************************************/
+class PatternPool {
+  public:
+    //! Number of built-in patterns
+    static constexpr int count = PatternRegistry::count;
+
+    //! Constructor. Starts out with pattern 0 (Simple Stroke) active.
+    PatternPool() {
+        _activeIndex = 0;
+        _active.store(_emplace(0, 0), std::memory_order_release);
+    }
+
+    //! Destructor
+    ~PatternPool() {
+        for (Pattern *pattern : _patterns) {
+            if (pattern != nullptr) {
+                pattern->~Pattern();
+            }
+        }
+    }
+
+    //! Retrives the name of a built-in pattern
+    /*!
+      @param index index of a pattern
+      @return c_string containing the name, or "Invalid" if out of range
+    */
+    static const char *name(int index) { return PatternRegistry::name(index); }
+
+    //! The pattern currently in use
+    Pattern *active() const { return _active.load(std::memory_order_acquire); }
+
+    //! Index of the pattern currently in use
+    int activeIndex() const { return _activeIndex; }
+
+    //! Constructs a fresh instance of a pattern in the spare slot. The
+    //! pattern does not become active until activate() is called.
+    /*!
+      @param index index of a pattern
+      @return Pointer to the new pattern, or NULL if index is out of range
+    */
+    Pattern *prepare(int index) {
+        if (index < 0 || index >= count) {
+            return nullptr;
+        }
+        _preparedIndex = index;
+        return _emplace(_spareSlot(), index);
+    }
+
+    //! Publishes the pattern built by the last prepare()
+    void activate() {
+        Pattern *next = _patterns[_spareSlot()];
+        if (next == nullptr) {
+            return;
+        }
+        _activeIndex = _preparedIndex;
+        _active.store(next, std::memory_order_release);
+    }
+
+  private:
+    struct alignas(PatternRegistry::maxAlignment()) Slot {
+        unsigned char storage[PatternRegistry::maxSize()];
+    };
+
+    Slot _slots[2];
+    Pattern *_patterns[2] = {nullptr, nullptr};
+    std::atomic<Pattern *> _active{nullptr};
+    int _activeIndex = 0;
+    int _preparedIndex = 0;
+
+    int _spareSlot() const { return (active() == _patterns[0]) ? 1 : 0; }
+
+    Pattern *_emplace(int slotIndex, int index) {
+        if (_patterns[slotIndex] != nullptr) {
+            _patterns[slotIndex]->~Pattern();
+        }
+        const PatternInfo &info = PatternRegistry::patterns[index];
+        Pattern *pattern = info.construct(_slots[slotIndex].storage, info.name);
+        _patterns[slotIndex] = pattern;
+        return pattern;
+    }
+};
@@ -0,0 +1,723 @@
+/**
+ *   Pattern Programs of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+  Pattern programs are a small stack bytecode that computes one move per
+  stroke index. scripts/pattern_assembler.py turns their assembly into
+  bytes. All numbers are little endian.
+
+  Header
+    0  char[4]  magic "OSPG"
+    4  uint8    version, 1
+    5  uint8    number of variables, up to PATTERN_PROGRAM_VARIABLES
+    6  uint16   length of the code in bytes, up to PATTERN_PROGRAM_CODE_MAX
+
+  The code follows the header. Execution starts at its first byte for every
+  stroke index and ends with MOVE. Values are signed 32 bit integers that
+  wrap around. Fractions are Q16 fixed point, 65536 is 1.0.
+
+  Variables keep their values from one stroke to the next and start out
+  as 0. Inputs (IN n):
+    0  index of the stroke
+    1  stroke in steps
+    2  depth in steps
+    3  sensation, -65536 ... 65536 for -100 ... 100
+    4  time of a full stroke (in and out) in ms, from the speed setting
+    5  steps per mm
+
+  Instructions, operands follow the opcode:
+    PUSH8 i8, PUSH16 i16, PUSH32 i32    push a constant
+    LOAD v, STORE v                     read, write variable v
+    IN n                                push input n
+    DUP, DROP, SWAP, OVER               stack shuffling
+    ADD, SUB, MUL, DIV, MOD             a b -> a op b, DIV rounds to 0
+    MULQ, DIVQ                          Q16 a * b, a / b
+    MIN, MAX                            a b -> min, max
+    NEG, ABS, NOT                       a -> -a, |a|, a == 0
+    AND, OR, XOR                        a b -> bitwise a op b
+    SHL, SHR                            a b -> a << b, a >> b (arithmetic),
+                                        b taken modulo 32
+    LT, LE, EQ                          a b -> a < b, a <= b, a == b
+    JMP rel16, JZ rel16, JNZ rel16      jump, JZ/JNZ pop the condition.
+                                        Relative to the next instruction.
+    WAIT                                ms ->, pause before the move
+    RAMP                                share ->, Q16 share of the move's
+                                        time spent on each ramp, 1/3 if not
+                                        given
+    MOVE                                position time ->, move to position
+                                        (Q16, 0 = depth - stroke, 65536 =
+                                        depth) in time ms and end
+
+  load() verifies a program once: every reachable instruction is valid,
+  jumps land inside the code, the stack depth at every instruction is the
+  same on all paths and stays within PATTERN_PROGRAM_STACK, and no path
+  runs off the end. run() can then go without any checks but two: division
+  by zero, and the cycle budget that stops endless loops.
+*/
+#define PATTERN_PROGRAM_MAGIC "OSPG"
+#define PATTERN_PROGRAM_VERSION 1
+#define PATTERN_PROGRAM_HEADER_SIZE 8
+
+// Largest program, header included. A BLE write takes up to 512 bytes.
+#ifndef PATTERN_PROGRAM_SIZE_MAX
+#define PATTERN_PROGRAM_SIZE_MAX 512
+#endif
+#define PATTERN_PROGRAM_CODE_MAX \
+    (PATTERN_PROGRAM_SIZE_MAX - PATTERN_PROGRAM_HEADER_SIZE)
+
+// Variables a program may keep between strokes
+#ifndef PATTERN_PROGRAM_VARIABLES
+#define PATTERN_PROGRAM_VARIABLES 16
+#endif
+
+// Depth of the value stack
+#ifndef PATTERN_PROGRAM_STACK
+#define PATTERN_PROGRAM_STACK 16
+#endif
+
+// Budget of a single run. Straight code runs at most once. Every backward
+// jump is charged the bytes it jumps back, which is at least the number of
+// instructions it repeats. So a run executes at most
+// PATTERN_PROGRAM_CYCLES + PATTERN_PROGRAM_CODE_MAX instructions.
+#ifndef PATTERN_PROGRAM_CYCLES
+#define PATTERN_PROGRAM_CYCLES 1024
+#endif
+
+namespace pattern_program {
+
+enum Opcode : uint8_t {
+    PUSH8 = 0x01,
+    PUSH16 = 0x02,
+    PUSH32 = 0x03,
+    LOAD = 0x04,
+    STORE = 0x05,
+    IN = 0x06,
+    DUP = 0x07,
+    DROP = 0x08,
+    SWAP = 0x09,
+    OVER = 0x0A,
+
+    ADD = 0x10,
+    SUB = 0x11,
+    MUL = 0x12,
+    DIV = 0x13,
+    MOD = 0x14,
+    MULQ = 0x15,
+    DIVQ = 0x16,
+    MIN = 0x17,
+    MAX = 0x18,
+    NEG = 0x19,
+    ABS = 0x1A,
+    AND = 0x1B,
+    OR = 0x1C,
+    XOR = 0x1D,
+    SHL = 0x1E,
+    SHR = 0x1F,
+
+    LT = 0x20,
+    LE = 0x21,
+    EQ = 0x22,
+    NOT = 0x23,
+
+    JMP = 0x30,
+    JZ = 0x31,
+    JNZ = 0x32,
+
+    WAIT = 0x40,
+    RAMP = 0x41,
+    MOVE = 0x42,
+};
+
+enum Input : uint8_t {
+    INPUT_INDEX = 0,
+    INPUT_STROKE = 1,
+    INPUT_DEPTH = 2,
+    INPUT_SENSATION = 3,
+    INPUT_STROKE_MS = 4,
+    INPUT_STEPS_PER_MM = 5,
+    INPUT_COUNT = 6,
+};
+
+}  // namespace pattern_program
+
+//! Why load() rejected a program
+enum class ProgramError : uint8_t {
+    None,
+    TooShort,       //!< Shorter than its header says
+    TooLong,        //!< Longer than PATTERN_PROGRAM_SIZE_MAX
+    BadMagic,       //!< Not a pattern program
+    BadVersion,     //!< Made for another version
+    BadVariables,   //!< More variables than PATTERN_PROGRAM_VARIABLES
+    BadOpcode,      //!< Unknown instruction
+    BadOperand,     //!< Variable or input out of range
+    BadJump,        //!< Jump or operand past the end of the code
+    StackUnderflow, //!< An instruction pops more than there is
+    StackOverflow,  //!< Deeper than PATTERN_PROGRAM_STACK
+    StackMismatch,  //!< Paths meet with different stack depths
+    RunsOffEnd,     //!< A path ends without MOVE
+};
+
+//! Why run() stopped a program without a move
+enum class ProgramFault : uint8_t {
+    None,
+    DivideByZero, //!< DIV, MOD or DIVQ by 0
+    OutOfCycles,  //!< Used up PATTERN_PROGRAM_CYCLES
+    BadCode,      //!< Code that did not go through load()
+};
+
+/**************************************************************************/
+/*!
+  @brief  A verified pattern program. Plain data, so it can be copied around
+  and handed between tasks.
+*/
+/**************************************************************************/
+typedef struct {
+    uint8_t variables;                      //!< Number of variables used
+    uint16_t length;                        //!< Bytes of code
+    uint8_t code[PATTERN_PROGRAM_CODE_MAX]; //!< Code, verified by load()
+} patternProgram;
+
+/**************************************************************************/
+/*!
+  @brief  Move computed by a program
+*/
+/**************************************************************************/
+typedef struct {
+    int32_t position; //!< Target, fraction of the stroke in Q16
+    int32_t timeMs;   //!< Time to get there
+    int32_t waitMs;   //!< Pause before the move
+    int32_t ramp;     //!< Q16 share of the time spent on each ramp
+} programMove;
+
+namespace pattern_program {
+
+// Operand bytes, values popped and values pushed per opcode. Popped 0xFF
+// marks an unknown opcode.
+struct OpcodeInfo {
+    uint8_t operands;
+    uint8_t pops;
+    uint8_t pushes;
+};
+
+constexpr OpcodeInfo info(uint8_t opcode) {
+    switch (opcode) {
+        case PUSH8: return {1, 0, 1};
+        case PUSH16: return {2, 0, 1};
+        case PUSH32: return {4, 0, 1};
+        case LOAD: return {1, 0, 1};
+        case STORE: return {1, 1, 0};
+        case IN: return {1, 0, 1};
+        case DUP: return {0, 1, 2};
+        case DROP: return {0, 1, 0};
+        case SWAP: return {0, 2, 2};
+        case OVER: return {0, 2, 3};
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case MOD:
+        case MULQ:
+        case DIVQ:
+        case MIN:
+        case MAX:
+        case AND:
+        case OR:
+        case XOR:
+        case SHL:
+        case SHR:
+        case LT:
+        case LE:
+        case EQ: return {0, 2, 1};
+        case NEG:
+        case ABS:
+        case NOT: return {0, 1, 1};
+        case JMP: return {2, 0, 0};
+        case JZ:
+        case JNZ: return {2, 1, 0};
+        case WAIT:
+        case RAMP: return {0, 1, 0};
+        case MOVE: return {0, 2, 0};
+        default: return {0, 0xFF, 0};
+    }
+}
+
+inline int16_t get16(const uint8_t *in) {
+    return int16_t(uint16_t(in[0] | (in[1] << 8)));
+}
+
+inline int32_t get32(const uint8_t *in) {
+    return int32_t(uint32_t(in[0]) | (uint32_t(in[1]) << 8) |
+                   (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24));
+}
+
+//! Human readable name of a load() error, e.g. for a BLE reply
+inline const char *errorName(ProgramError error) {
+    switch (error) {
+        case ProgramError::None: return "ok";
+        case ProgramError::TooShort: return "too_short";
+        case ProgramError::TooLong: return "too_long";
+        case ProgramError::BadMagic: return "bad_magic";
+        case ProgramError::BadVersion: return "bad_version";
+        case ProgramError::BadVariables: return "bad_variables";
+        case ProgramError::BadOpcode: return "bad_opcode";
+        case ProgramError::BadOperand: return "bad_operand";
+        case ProgramError::BadJump: return "bad_jump";
+        case ProgramError::StackUnderflow: return "stack_underflow";
+        case ProgramError::StackOverflow: return "stack_overflow";
+        case ProgramError::StackMismatch: return "stack_mismatch";
+        case ProgramError::RunsOffEnd: return "runs_off_end";
+    }
+    return "unknown";
+}
+
+//! Checks the code of a program, see the format description above
+/*!
+  @param code code of the program
+  @param length bytes of code, at most PATTERN_PROGRAM_CODE_MAX
+  @param variables number of variables the program uses
+  @return ProgramError::None if run() may execute it
+*/
+inline ProgramError verify(const uint8_t *code, size_t length,
+                           uint8_t variables) {
+    // Stack depth on entry of every reachable instruction, -1 if not
+    // reached (yet). DONE marks the ones already checked.
+    static constexpr int8_t DONE = 0x40;
+    int8_t depth[PATTERN_PROGRAM_CODE_MAX];
+    memset(depth, -1, sizeof(depth));
+
+    if (length == 0) {
+        return ProgramError::RunsOffEnd;
+    }
+    depth[0] = 0;
+
+    // A target reached before must agree on the depth, so loops can't grow
+    // the stack
+    auto reach = [&](size_t target, int value) -> ProgramError {
+        if (target >= length) {
+            return ProgramError::RunsOffEnd;
+        }
+        if (depth[target] < 0) {
+            depth[target] = int8_t(value);
+        } else if ((depth[target] & ~DONE) != value) {
+            return ProgramError::StackMismatch;
+        }
+        return ProgramError::None;
+    };
+
+    // Sweeps the code until every reachable instruction is checked. No
+    // work list, so the stack use stays small enough for the BLE task.
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (size_t pc = 0; pc < length; pc++) {
+            if (depth[pc] < 0 || (depth[pc] & DONE)) {
+                continue;
+            }
+            int value = depth[pc];
+            depth[pc] |= DONE;
+            progress = true;
+
+            uint8_t opcode = code[pc];
+            OpcodeInfo op = info(opcode);
+            if (op.pops == 0xFF) {
+                return ProgramError::BadOpcode;
+            }
+            size_t next = pc + 1 + op.operands;
+            if (next > length) {
+                return ProgramError::BadJump;
+            }
+            const uint8_t *operand = &code[pc + 1];
+            if ((opcode == LOAD || opcode == STORE) &&
+                operand[0] >= variables) {
+                return ProgramError::BadOperand;
+            }
+            if (opcode == IN && operand[0] >= INPUT_COUNT) {
+                return ProgramError::BadOperand;
+            }
+
+            if (value < op.pops) {
+                return ProgramError::StackUnderflow;
+            }
+            value += op.pushes - op.pops;
+            if (value > PATTERN_PROGRAM_STACK) {
+                return ProgramError::StackOverflow;
+            }
+
+            ProgramError error = ProgramError::None;
+            if (opcode == MOVE) {
+                continue;
+            }
+            if (opcode == JMP || opcode == JZ || opcode == JNZ) {
+                long target = long(next) + get16(operand);
+                if (target < 0 || target >= long(length)) {
+                    return ProgramError::BadJump;
+                }
+                error = reach(size_t(target), value);
+                if (error == ProgramError::None && opcode != JMP) {
+                    error = reach(next, value);
+                }
+            } else {
+                error = reach(next, value);
+            }
+            if (error != ProgramError::None) {
+                return error;
+            }
+        }
+    }
+    return ProgramError::None;
+}
+
+//! Whether a verified program can reach WAIT, so its moves may depend on
+//! when they are asked for
+/*!
+  @param program program verified by load()
+  @return True if any reachable instruction is WAIT
+*/
+inline bool waits(const patternProgram &program) {
+    // Reached and checked instructions, a bit each
+    uint8_t reached[(PATTERN_PROGRAM_CODE_MAX + 7) / 8] = {};
+    uint8_t done[(PATTERN_PROGRAM_CODE_MAX + 7) / 8] = {};
+    auto has = [](const uint8_t *bits, size_t pc) {
+        return (bits[pc / 8] >> (pc % 8)) & 1;
+    };
+    auto set = [](uint8_t *bits, size_t pc) {
+        bits[pc / 8] |= uint8_t(1 << (pc % 8));
+    };
+
+    size_t length = program.length;
+    if (length == 0) {
+        return false;
+    }
+    set(reached, 0);
+
+    // Sweeps like verify(), which made sure every target is inside
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (size_t pc = 0; pc < length; pc++) {
+            if (!has(reached, pc) || has(done, pc)) {
+                continue;
+            }
+            set(done, pc);
+            progress = true;
+
+            uint8_t opcode = program.code[pc];
+            if (opcode == WAIT) {
+                return true;
+            }
+            if (opcode == MOVE) {
+                continue;
+            }
+            size_t next = pc + 1 + info(opcode).operands;
+            if (opcode == JMP || opcode == JZ || opcode == JNZ) {
+                set(reached, size_t(long(next) + get16(&program.code[pc + 1])));
+                if (opcode == JMP) {
+                    continue;
+                }
+            }
+            set(reached, next);
+        }
+    }
+    return false;
+}
+
+//! Checks a program file without loading it
+/*!
+  @param bytes program file, header and code
+  @param size number of bytes
+  @return ProgramError::None if load() takes it
+*/
+inline ProgramError check(const uint8_t *bytes, size_t size) {
+    if (size > PATTERN_PROGRAM_SIZE_MAX) {
+        return ProgramError::TooLong;
+    }
+    if (size < PATTERN_PROGRAM_HEADER_SIZE) {
+        return ProgramError::TooShort;
+    }
+    if (memcmp(bytes, PATTERN_PROGRAM_MAGIC, 4) != 0) {
+        return ProgramError::BadMagic;
+    }
+    if (bytes[4] != PATTERN_PROGRAM_VERSION) {
+        return ProgramError::BadVersion;
+    }
+    if (bytes[5] > PATTERN_PROGRAM_VARIABLES) {
+        return ProgramError::BadVariables;
+    }
+    size_t length = uint16_t(get16(bytes + 6));
+    if (length > PATTERN_PROGRAM_CODE_MAX) {
+        return ProgramError::TooLong;
+    }
+    if (size != PATTERN_PROGRAM_HEADER_SIZE + length) {
+        return size < PATTERN_PROGRAM_HEADER_SIZE + length
+                   ? ProgramError::TooShort
+                   : ProgramError::TooLong;
+    }
+    return verify(bytes + PATTERN_PROGRAM_HEADER_SIZE, length, bytes[5]);
+}
+
+//! Reads and verifies a program
+/*!
+  @param bytes program file, header and code
+  @param size number of bytes
+  @param program receives the program. Left untouched unless None is
+         returned.
+  @return ProgramError::None on success
+*/
+inline ProgramError load(const uint8_t *bytes, size_t size,
+                         patternProgram &program) {
+    ProgramError error = check(bytes, size);
+    if (error != ProgramError::None) {
+        return error;
+    }
+    memset(&program, 0, sizeof(program));
+    program.variables = bytes[5];
+    program.length = uint16_t(size - PATTERN_PROGRAM_HEADER_SIZE);
+    memcpy(program.code, bytes + PATTERN_PROGRAM_HEADER_SIZE, program.length);
+    return ProgramError::None;
+}
+
+//! Writes a program back into its file format, e.g. to store it
+/*!
+  @param program verified program
+  @param out at least PATTERN_PROGRAM_HEADER_SIZE + program.length bytes
+  @return Number of bytes written
+*/
+inline size_t save(const patternProgram &program, uint8_t *out) {
+    memcpy(out, PATTERN_PROGRAM_MAGIC, 4);
+    out[4] = PATTERN_PROGRAM_VERSION;
+    out[5] = program.variables;
+    out[6] = uint8_t(program.length);
+    out[7] = uint8_t(program.length >> 8);
+    memcpy(out + PATTERN_PROGRAM_HEADER_SIZE, program.code, program.length);
+    return PATTERN_PROGRAM_HEADER_SIZE + program.length;
+}
+
+//! Runs a program verified by load() for one stroke
+/*!
+  The top of the stack is kept in a local and every instruction jumps
+  straight to the next one through a table (GCC's labels as values), which
+  runs about twice as fast as a switch in a loop.
+  @param program verified program
+  @param inputs INPUT_COUNT values, see Input
+  @param variables program.variables values, kept from the previous run
+  @param move receives the move. waitMs and ramp are preset here.
+  @return ProgramFault::None if the program reached MOVE
+*/
+inline ProgramFault run(const patternProgram &program, const int32_t *inputs,
+                        int32_t *variables, programMove &move) {
+    // Below the top. The first push stores the undefined top, so the
+    // stack holds one item more than the verified depth at most.
+    int32_t stack[PATTERN_PROGRAM_STACK];
+    int32_t *below = stack;
+    int32_t top = 0;
+    const uint8_t *pc = program.code;
+    int32_t budget = PATTERN_PROGRAM_CYCLES;
+    int32_t a;
+    move.waitMs = 0;
+    move.ramp = 65536 / 3;
+
+    // Indexed by opcode. Verified code only holds known opcodes, so the
+    // table ends with the last one.
+    static const void *const dispatch[MOVE + 1] = {
+        &&fault, &&push8, &&push16, &&push32, &&load, &&store, &&in, &&dup,  // 0x00
+        &&drop, &&swap, &&over, &&fault, &&fault, &&fault, &&fault, &&fault,  // 0x08
+        &&add, &&sub, &&mul, &&div, &&mod, &&mulq, &&divq, &&min,  // 0x10
+        &&max, &&neg, &&abs, &&and_, &&or_, &&xor_, &&shl, &&shr,  // 0x18
+        &&lt, &&le, &&eq, &&not_, &&fault, &&fault, &&fault, &&fault,  // 0x20
+        &&fault, &&fault, &&fault, &&fault, &&fault, &&fault, &&fault, &&fault,  // 0x28
+        &&jmp, &&jz, &&jnz, &&fault, &&fault, &&fault, &&fault, &&fault,  // 0x30
+        &&fault, &&fault, &&fault, &&fault, &&fault, &&fault, &&fault, &&fault,  // 0x38
+        &&wait, &&ramp, &&move_,  // 0x40
+    };
+#define NEXT goto *dispatch[*pc++]
+#define PUSH(value)    \
+    *below++ = top;    \
+    top = (value)
+#define POP(into) into = *--below
+// Unsigned arithmetic wraps around without undefined behaviour
+#define WRAP(value) int32_t(uint32_t(value))
+
+    NEXT;
+
+push8:
+    PUSH(int8_t(pc[0]));
+    pc += 1;
+    NEXT;
+push16:
+    PUSH(get16(pc));
+    pc += 2;
+    NEXT;
+push32:
+    PUSH(get32(pc));
+    pc += 4;
+    NEXT;
+load:
+    PUSH(variables[*pc++]);
+    NEXT;
+store:
+    variables[*pc++] = top;
+    POP(top);
+    NEXT;
+in:
+    PUSH(inputs[*pc++]);
+    NEXT;
+dup:
+    PUSH(top);
+    NEXT;
+drop:
+    POP(top);
+    NEXT;
+swap:
+    a = below[-1];
+    below[-1] = top;
+    top = a;
+    NEXT;
+over:
+    a = below[-1];
+    PUSH(a);
+    NEXT;
+
+add:
+    POP(a);
+    top = WRAP(uint32_t(a) + uint32_t(top));
+    NEXT;
+sub:
+    POP(a);
+    top = WRAP(uint32_t(a) - uint32_t(top));
+    NEXT;
+mul:
+    POP(a);
+    top = WRAP(uint32_t(a) * uint32_t(top));
+    NEXT;
+div:
+    if (top == 0) return ProgramFault::DivideByZero;
+    POP(a);
+    // Only INT32_MIN / -1 overflows, negating wraps it around instead
+    top = top == -1 ? WRAP(0u - uint32_t(a)) : a / top;
+    NEXT;
+mod:
+    if (top == 0) return ProgramFault::DivideByZero;
+    POP(a);
+    top = top == -1 ? 0 : a % top;
+    NEXT;
+mulq:
+    POP(a);
+    top = WRAP((int64_t(a) * top) >> 16);
+    NEXT;
+divq:
+    if (top == 0) return ProgramFault::DivideByZero;
+    POP(a);
+    top = WRAP((int64_t(a) * 65536) / top);
+    NEXT;
+min:
+    POP(a);
+    top = a < top ? a : top;
+    NEXT;
+max:
+    POP(a);
+    top = a > top ? a : top;
+    NEXT;
+neg:
+    top = WRAP(0u - uint32_t(top));
+    NEXT;
+abs:
+    top = top < 0 ? WRAP(0u - uint32_t(top)) : top;
+    NEXT;
+and_:
+    POP(a);
+    top = a & top;
+    NEXT;
+or_:
+    POP(a);
+    top = a | top;
+    NEXT;
+xor_:
+    POP(a);
+    top = a ^ top;
+    NEXT;
+shl:
+    POP(a);
+    top = WRAP(uint32_t(a) << (top & 31));
+    NEXT;
+shr:
+    POP(a);
+    top = a >> (top & 31);
+    NEXT;
+
+lt:
+    POP(a);
+    top = a < top;
+    NEXT;
+le:
+    POP(a);
+    top = a <= top;
+    NEXT;
+eq:
+    POP(a);
+    top = a == top;
+    NEXT;
+not_:
+    top = top == 0;
+    NEXT;
+
+jz:
+    a = top;
+    POP(top);
+    if (a != 0) {
+        pc += 2;
+        NEXT;
+    }
+    goto jmp;
+jnz:
+    a = top;
+    POP(top);
+    if (a == 0) {
+        pc += 2;
+        NEXT;
+    }
+jmp: {
+    int16_t offset = get16(pc);
+    pc += 2;
+    if (offset < 0) {
+        budget += offset;
+        if (budget < 0) return ProgramFault::OutOfCycles;
+    }
+    pc += offset;
+    NEXT;
+}
+
+wait:
+    move.waitMs += top;
+    POP(top);
+    NEXT;
+ramp:
+    move.ramp = top;
+    POP(top);
+    NEXT;
+move_:
+    move.timeMs = top;
+    move.position = below[-1];
+    return ProgramFault::None;
+
+fault:
+    return ProgramFault::BadCode;
+
+#undef NEXT
+#undef PUSH
+#undef POP
+#undef WRAP
+}
+
+}  // namespace pattern_program
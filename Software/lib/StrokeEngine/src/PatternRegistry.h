@@ -0,0 +1,180 @@
+/**
+ *   Pattern Registry of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+
+#include "KeyframePattern.h"
+#include "ProgramPattern.h"
+#include "pattern.h"
+
+/**************************************************************************/
+/*!
+  @brief  What the sensation parameter does in a pattern
+*/
+/**************************************************************************/
+enum class SensationEffect : uint8_t {
+    None,            //!< Sensation has no effect
+    SpeedRatio,      //!< Ratio between in and out speed
+    Acceleration,    //!< Share of the stroke spent accelerating
+    RampLength,      //!< Number of strokes until full depth is reached
+    PauseLength,     //!< Length of the pauses between stroke series
+    StrokeFraction,  //!< Fraction of the stroke, the sign picks the end
+    Program,         //!< Whatever the uploaded program makes of it
+};
+
+/**************************************************************************/
+/*!
+  @brief  Everything known about a built-in pattern at compile time. The
+  factory constructs the pattern into caller provided storage of at least
+  size bytes with the given alignment.
+*/
+/**************************************************************************/
+struct PatternInfo {
+    const char *name;          //!< Name shown on the display and over BLE
+    const char *description;   //!< One line description for the display
+    SensationEffect sensation; //!< What the sensation parameter does
+    float defaultSensation;    //!< Sensation a new session starts with
+    size_t size;               //!< sizeof() the pattern class
+    size_t alignment;          //!< alignof() the pattern class
+    Pattern *(*construct)(void *storage, const char *name); //!< Factory
+};
+
+namespace pattern_registry {
+
+template <class P>
+Pattern *construct(void *storage, const char *name) {
+    return new (storage) P(name);
+}
+
+template <class P>
+constexpr PatternInfo describe(const char *name, const char *description,
+                               SensationEffect sensation,
+                               float defaultSensation = 0.0f) {
+    return {name,      description, sensation,    defaultSensation,
+            sizeof(P), alignof(P),  &construct<P>};
+}
+
+}  // namespace pattern_registry
+
+/**************************************************************************/
+/*!
+  @brief  The list of built-in patterns. The index into this table is the
+  pattern number used by StrokeEngine::setPattern(), the settings, MQTT and
+  BLE. The table is constexpr and lives in flash; adding a pattern means
+  adding a line here.
+*/
+/**************************************************************************/
+class PatternRegistry {
+  public:
+    static constexpr PatternInfo patterns[] = {
+        pattern_registry::describe<SimpleStroke>(
+            "Simple Stroke",
+            "Acceleration, coasting, deceleration equally split; no "
+            "sensation.",
+            SensationEffect::None),
+        pattern_registry::describe<TeasingPounding>(
+            "Teasing Pounding",
+            "Speed shifts with sensation; balances faster strokes.",
+            SensationEffect::SpeedRatio),
+        pattern_registry::describe<RoboStroke>(
+            "Robo Stroke",
+            "Sensation varies acceleration; from robotic to gradual.",
+            SensationEffect::Acceleration),
+        pattern_registry::describe<HalfnHalf>(
+            "Half'n'Half",
+            "Full and half depth strokes alternate; sensation affects speed.",
+            SensationEffect::SpeedRatio),
+        pattern_registry::describe<Deeper>(
+            "Deeper", "Stroke depth increases per cycle; sensation sets count.",
+            SensationEffect::RampLength),
+        pattern_registry::describe<StopNGo>(
+            "Stop'n'Go", "Pauses between strokes; sensation adjusts length.",
+            SensationEffect::PauseLength),
+        pattern_registry::describe<Insist>(
+            "Insist",
+            "Modifies length, maintains speed; sensation influences "
+            "direction.",
+            SensationEffect::StrokeFraction),
+        pattern_registry::describe<ProgramPattern>(
+            "Custom Program",
+            "Plays the program uploaded over BLE; Simple Stroke if none.",
+            SensationEffect::Program),
+        pattern_registry::describe<KeyframePattern>(
+            "Keyframes",
+            "Plays the keyframe file selected over BLE; no sensation.",
+            SensationEffect::None),
+    };
+
+    //! Number of built-in patterns
+    static constexpr int count = sizeof(patterns) / sizeof(patterns[0]);
+
+    //! Looks up a pattern
+    /*!
+      @param index index of a pattern
+      @return Pointer to its entry, or NULL if index is out of range
+    */
+    static constexpr const PatternInfo *find(int index) {
+        return (index >= 0 && index < count) ? &patterns[index] : nullptr;
+    }
+
+    //! Looks up the index of a pattern class
+    /*!
+      @return Index of the entry built from P, or -1 if there is none
+    */
+    template <class P>
+    static constexpr int indexOf() {
+        for (int i = 0; i < count; i++) {
+            if (patterns[i].construct == &pattern_registry::construct<P>) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    //! Retrives the name of a pattern
+    /*!
+      @param index index of a pattern
+      @return c_string containing the name, or "Invalid" if out of range
+    */
+    static constexpr const char *name(int index) {
+        return find(index) ? find(index)->name : "Invalid";
+    }
+
+    //! Retrives the description of a pattern
+    /*!
+      @param index index of a pattern
+      @return c_string containing the description, or "" if out of range
+    */
+    static constexpr const char *description(int index) {
+        return find(index) ? find(index)->description : "";
+    }
+
+    //! Storage size needed to hold any of the patterns
+    static constexpr size_t maxSize() {
+        size_t size = 0;
+        for (const PatternInfo &info : patterns) {
+            size = info.size > size ? info.size : size;
+        }
+        return size;
+    }
+
+    //! Alignment needed to hold any of the patterns
+    static constexpr size_t maxAlignment() {
+        size_t alignment = 1;
+        for (const PatternInfo &info : patterns) {
+            alignment = info.alignment > alignment ? info.alignment : alignment;
+        }
+        return alignment;
+    }
+};
@@ -0,0 +1,409 @@
+/**
+ *   Program Pattern of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "PatternProgram.h"
+#include "pattern.h"
+
+// Number of recent strokes whose variables are kept to answer repeated
+// queries for the same stroke index. Must be larger than
+// STROKE_LOOKAHEAD_MAX + 1.
+#ifndef PATTERN_PROGRAM_HISTORY
+#define PATTERN_PROGRAM_HISTORY 8
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Plays a user-defined pattern program, see PatternProgram.h. The
+  program computes each move as a position within the stroke and a time, so
+  depth, stroke and speed work like with any other pattern. What sensation
+  does is up to the program.
+
+  Programs are installed with install(), e.g. after an upload over BLE.
+  There is only the one program, kept in static storage, so a pattern
+  already playing goes on with the new one from its next stroke, with fresh
+  variables. Until one is installed the built-in default program plays:
+  Simple Stroke.
+
+  Each stroke index runs the program once. The variables before every
+  recent index are kept, so asking for an index again, as StrokeEngine does
+  when the settings change, gives the same result as the first time. A
+  program that faults stands still until it is replaced.
+*/
+/**************************************************************************/
+class ProgramPattern : public Pattern {
+  public:
+    ProgramPattern(const char *str) : Pattern(str) {
+        for (snapshot &s : _history) {
+            s.index = -1;
+        }
+        _publish(defaultProgram, sizeof(defaultProgram), false, false);
+        _revision = _published.load(std::memory_order_relaxed);
+    }
+
+    //! Verifies a program and makes it the one new instances play
+    /*!
+      Call from one task only.
+      @param bytes program file, header and code
+      @param size number of bytes
+      @return ProgramError::None if it was installed
+    */
+    static ProgramError install(const uint8_t *bytes, size_t size) {
+        // Checked in place, the program is only copied once it is good
+        ProgramError error = pattern_program::check(bytes, size);
+        if (error == ProgramError::None) {
+            _publish(bytes, size, true, true);
+        }
+        return error;
+    }
+
+    //! Goes back to the default program
+    static void clear() {
+        _publish(defaultProgram, sizeof(defaultProgram), false, true);
+    }
+
+    //! True if a program was installed, false if the default one plays
+    static bool installed() {
+        return _installed.load(std::memory_order_relaxed);
+    }
+
+    //! Built-in program played until one is installed: Simple Stroke
+    /*
+        in index        ; odd strokes move out
+        push8 1
+        and
+        jnz out
+        push32 65536
+        jmp go
+    out: push8 0
+    go: in stroke_ms    ; in and out take half the time each
+        push8 1
+        shr
+        move
+    */
+    static constexpr uint8_t defaultProgram[] = {
+        'O',  'S',  'P',  'G',  0x01, 0x00, 0x18, 0x00, 0x06, 0x00,
+        0x01, 0x01, 0x1B, 0x32, 0x08, 0x00, 0x03, 0x00, 0x00, 0x01,
+        0x00, 0x30, 0x02, 0x00, 0x01, 0x00, 0x06, 0x04, 0x01, 0x01,
+        0x1F, 0x42};
+
+    void setTimeOfStroke(float speed = 0) {
+        _timeOfStroke = speed;
+        _inputs[pattern_program::INPUT_STROKE_MS] =
+            int32_t(speed * 1000.0f + 0.5f);
+    }
+
+    void setStroke(int stroke) {
+        _stroke = stroke;
+        _inputs[pattern_program::INPUT_STROKE] = stroke;
+    }
+
+    void setDepth(int depth) {
+        _depth = depth;
+        _inputs[pattern_program::INPUT_DEPTH] = depth;
+    }
+
+    void setSensation(float sensation) {
+        _sensation = sensation;
+        _inputs[pattern_program::INPUT_SENSATION] =
+            int32_t(sensation * 655.36f);
+    }
+
+    void setSpeedLimit(unsigned int maxSpeed, unsigned int maxAcceleration,
+                       unsigned int stepsPerMM, unsigned int maxJerk = 0) {
+        Pattern::setSpeedLimit(maxSpeed, maxAcceleration, stepsPerMM,
+                               maxJerk);
+        _inputs[pattern_program::INPUT_STEPS_PER_MM] = int32_t(stepsPerMM);
+        for (plannedMove &planned : _planned) {
+            planned.timeMs = -1;
+        }
+    }
+
+    motionParameter nextTarget(unsigned int index) {
+        _index = index;
+        // Started over, pauses count again
+        if (int(index) < _waitIndex) {
+            _waitIndex = -1;
+        }
+        if (int(index) < _waitedIndex) {
+            _waitedIndex = -1;
+        }
+
+        // Being replaced right now, ask again in a moment
+        if (_busy.exchange(true, std::memory_order_acquire)) {
+            _nextMove.skip = true;
+            return _nextMove;
+        }
+        _refresh();
+        programMove move;
+        bool ran = _run(int(index), move);
+        _busy.store(false, std::memory_order_release);
+        if (!ran) {
+            _nextMove.skip = true;
+            return _nextMove;
+        }
+
+        // A pause counts from when the move is first asked for, like
+        // Stop'n'Go's
+        if (move.waitMs > 0 && int(index) != _waitedIndex) {
+            if (int(index) != _waitIndex) {
+                _updateDelay(move.waitMs);
+                _startDelay();
+                _waitIndex = int(index);
+            }
+            if (_isStillDelayed()) {
+                _nextMove.skip = true;
+                return _nextMove;
+            }
+            _waitedIndex = int(index);
+        }
+
+        _nextMove =
+            _plan(move, _history[index % PATTERN_PROGRAM_HISTORY].from);
+        return _nextMove;
+    }
+
+    //! A program that waits is asked at the reversal, its pauses count
+    //! from the query like Stop'n'Go's
+    bool lookahead() const {
+        return !_waits.load(std::memory_order_relaxed);
+    }
+
+    //! Why the program stopped, ProgramFault::None while it runs fine
+    ProgramFault fault() const { return _fault; }
+
+    //! The program playing. Changes under the caller's feet while another
+    //! task installs one.
+    static const patternProgram &program() { return _program; }
+
+  protected:
+    // What the program knew before running a stroke index
+    typedef struct {
+        int index;
+        int32_t from;
+        int32_t variables[PATTERN_PROGRAM_VARIABLES];
+    } snapshot;
+
+    // A move already worked out by _plan(), timeMs -1 if none
+    typedef struct {
+        int distance;
+        int32_t timeMs;
+        int32_t ramp;
+        int speed;
+        int acceleration;
+    } plannedMove;
+
+    // The one verified program. _busy is held while it is run or replaced,
+    // every replacement counts up _published.
+    static inline patternProgram _program = {};
+    static inline std::atomic<bool> _busy{false};
+    static inline std::atomic<uint32_t> _published{0};
+    static inline std::atomic<bool> _installed{false};
+    static inline std::atomic<bool> _waits{false};  // It can reach WAIT
+
+    uint32_t _revision = 0;  // Of the program the variables belong to
+    ProgramFault _fault = ProgramFault::None;
+    int32_t _variables[PATTERN_PROGRAM_VARIABLES] = {};
+    int32_t _from = 0;  // Target of the previous move in Q16
+    int _nextIndex = 0;
+    snapshot _history[PATTERN_PROGRAM_HISTORY];
+    int _waitIndex = -1;
+    int _waitedIndex = -1;
+    int32_t _inputs[pattern_program::INPUT_COUNT] = {};
+    // Most programs repeat a few moves, so the last two are kept
+    plannedMove _planned[2] = {{0, -1, 0, 0, 0}, {0, -1, 0, 0, 0}};
+    int _plannedNext = 0;
+
+    // Replaces the program. The stroking task holds the flag for one run
+    // at most and never waits for it, so spinning here is short.
+    // @param replace false to only load it if there is no program yet
+    static void _publish(const uint8_t *bytes, size_t size, bool installed,
+                         bool replace) {
+        bool idle = false;
+        while (!_busy.compare_exchange_weak(idle, true,
+                                            std::memory_order_acquire)) {
+            idle = false;
+        }
+        if (replace || _published.load(std::memory_order_relaxed) == 0) {
+            pattern_program::load(bytes, size, _program);
+            _waits.store(pattern_program::waits(_program),
+                         std::memory_order_relaxed);
+            _installed.store(installed, std::memory_order_relaxed);
+            _published.fetch_add(1, std::memory_order_relaxed);
+        }
+        _busy.store(false, std::memory_order_release);
+    }
+
+    // Starts over with fresh variables when the program was replaced. Call
+    // holding the flag.
+    void _refresh() {
+        uint32_t published = _published.load(std::memory_order_relaxed);
+        if (published == _revision) {
+            return;
+        }
+        _revision = published;
+        _fault = ProgramFault::None;
+        _nextIndex = 0;
+        for (snapshot &s : _history) {
+            s.index = -1;
+        }
+        for (int32_t &variable : _variables) {
+            variable = 0;
+        }
+    }
+
+    // Runs the program for an index, from the variables it had back then
+    bool _run(int index, programMove &move) {
+        snapshot &before = _history[index % PATTERN_PROGRAM_HISTORY];
+        // Programs use few variables, a loop beats calling memcpy()
+        uint8_t count = _program.variables;
+        if (index == 0) {
+            for (uint8_t i = 0; i < count; i++) {
+                _variables[i] = 0;
+            }
+            _from = 0;
+        } else if (index < _nextIndex && before.index == index) {
+            for (uint8_t i = 0; i < count; i++) {
+                _variables[i] = before.variables[i];
+            }
+            _from = before.from;
+        }
+        before.index = index;
+        before.from = _from;
+        for (uint8_t i = 0; i < count; i++) {
+            before.variables[i] = _variables[i];
+        }
+
+        _inputs[pattern_program::INPUT_INDEX] = index;
+        _fault = pattern_program::run(_program, _inputs, _variables, move);
+        if (_fault != ProgramFault::None) {
+            // Stay at this index, the next query faults the same way
+            for (uint8_t i = 0; i < count; i++) {
+                _variables[i] = before.variables[i];
+            }
+            _nextIndex = index;
+            return false;
+        }
+
+        move.position = move.position < 0       ? 0
+                        : move.position > 65536 ? 65536
+                                                : move.position;
+        _from = move.position;
+        _nextIndex = index + 1;
+        return true;
+    }
+
+    // Rounded, so a position computed from a step count gives it back
+    int _toSteps(int32_t position) {
+        return (_depth - _stroke) +
+               int((int64_t(_stroke) * position + 32768) >> 16);
+    }
+
+    // Speed and acceleration to get there in time with the program's ramps
+    motionParameter _plan(const programMove &move, int32_t from) {
+        motionParameter next = {0, 0, 0, false, 0};
+        next.stroke = _toSteps(move.position);
+        int distance = abs(next.stroke - _toSteps(from));
+        for (const plannedMove &planned : _planned) {
+            if (planned.distance == distance &&
+                planned.timeMs == move.timeMs && planned.ramp == move.ramp) {
+                next.speed = planned.speed;
+                next.acceleration = planned.acceleration;
+                return next;
+            }
+        }
+
+        // slower if the machine can't make it
+        float time = float(move.timeMs > 1 ? move.timeMs : 1) / 1000.0f;
+        time *= _timeScale(distance, time);
+
+        float ramp = float(move.ramp) / 65536.0f;
+        ramp = ramp < 1.0f / 64.0f ? 1.0f / 64.0f : ramp > 0.5f ? 0.5f : ramp;
+        float speed = float(distance) / ((1.0f - ramp) * time);
+        next.speed = int(speed);
+        next.acceleration = int(speed / (ramp * time));
+        _fitMove(next, distance, time);
+
+        if (next.speed < 1) next.speed = 1;
+        if (next.acceleration < 1) next.acceleration = 1;
+        _planned[_plannedNext] = {distance, move.timeMs, move.ramp,
+                                  next.speed, next.acceleration};
+        _plannedNext ^= 1;
+        return next;
+    }
+};
+
+#if defined(ARDUINO_ARCH_ESP32) && __has_include(<Preferences.h>)
+#include <Preferences.h>
+
+/**************************************************************************/
+/*!
+  @brief  Keeps the installed pattern program in NVS, so it survives a
+  restart.
+*/
+/**************************************************************************/
+class PreferencesProgramStorage {
+  public:
+    //! Stores a program file
+    /*!
+      @param bytes program file, as given to ProgramPattern::install()
+      @param size number of bytes
+      @return false if it could not be written
+    */
+    static bool save(const uint8_t *bytes, size_t size) {
+        Preferences preferences;
+        if (!preferences.begin(_namespace, false)) {
+            return false;
+        }
+        bool saved = preferences.putBytes(_key, bytes, size) == size;
+        preferences.end();
+        return saved;
+    }
+
+    //! Removes the stored program
+    static void erase() {
+        Preferences preferences;
+        if (preferences.begin(_namespace, false)) {
+            preferences.remove(_key);
+            preferences.end();
+        }
+    }
+
+    //! Installs the stored program, if there is one
+    /*!
+      @return ProgramError::None if there is none or it was installed
+    */
+    static ProgramError restore() {
+        // Once at start up, from the BLE setup task's roomy stack
+        uint8_t bytes[PATTERN_PROGRAM_SIZE_MAX];
+        Preferences preferences;
+        if (!preferences.begin(_namespace, true)) {
+            return ProgramError::None;
+        }
+        size_t size = preferences.getBytesLength(_key);
+        if (size > 0) {
+            size = preferences.getBytes(_key, bytes, sizeof(bytes));
+        }
+        preferences.end();
+        return size > 0 ? ProgramPattern::install(bytes, size)
+                        : ProgramError::None;
+    }
+
+  private:
+    static constexpr const char *_namespace = "Patterns";
+    static constexpr const char *_key = "program";
+};
+#endif
@@ -0,0 +1,153 @@
+/**
+ *   SeqLock of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+/**************************************************************************/
+/*!
+  @brief  Sequence lock protecting a small block of plain data that is
+  written by one task and read by others. A write never waits for a reader.
+  A reader either gets a consistent snapshot or, with tryRead(), learns that
+  a write is in progress and can carry on with the data it already has. That
+  way a high priority reader never spins on a writer it has preempted.
+
+  Concurrent writers are serialized by spinning against each other, so
+  writes should come from one task.
+
+  The data is stored as 32 bit atomic words, so the copy is free of data
+  races on any core. T must be trivially copyable.
+*/
+/**************************************************************************/
+template <class T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock needs trivially copyable data");
+
+  public:
+    //! Constructor
+    /*!
+      @param initial value of the data
+    */
+    explicit SeqLock(const T &initial = T()) { _store(initial); }
+
+    //! Try to take a consistent snapshot of the data without waiting
+    /*!
+      @param data receives the snapshot. Left untouched on failure.
+      @param sequence receives the sequence number of the snapshot. It
+              changes with every write, so a reader can tell if anything
+              changed since its last read.
+      @return true on success, false if a write was in progress
+    */
+    bool tryRead(T &data, uint32_t &sequence) const {
+        uint32_t before = _sequence.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            T snapshot;
+            _load(snapshot);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) == before) {
+                data = snapshot;
+                sequence = before;
+                return true;
+            }
+        }
+        _retries.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    //! Take a consistent snapshot of the data. Spins while a write is in
+    //! progress, so only use it where the writer can't be preempted by the
+    //! caller.
+    /*!
+      @param data receives the snapshot
+      @return sequence number of the snapshot
+    */
+    uint32_t read(T &data) const {
+        uint32_t sequence;
+        while (!tryRead(data, sequence)) {
+        }
+        return sequence;
+    }
+
+    //! Take a consistent snapshot of the data
+    /*!
+      @return snapshot
+    */
+    T read() const {
+        T data;
+        read(data);
+        return data;
+    }
+
+    //! Modify the data in place. The modification sees the latest data and is
+    //! published to readers as a whole.
+    /*!
+      @param modify callable taking T& that changes the data
+    */
+    template <class F>
+    void write(F modify) {
+        // Claim the write by making the sequence odd
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        while ((sequence & 1) ||
+               !_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed)) {
+            sequence = _sequence.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        T data;
+        _load(data);
+        modify(data);
+        _store(data);
+
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    //! Sequence number of the latest write. Even while no write is going on.
+    uint32_t sequence() const {
+        return _sequence.load(std::memory_order_acquire);
+    }
+
+    //! Number of reads that collided with a write. For diagnostics only.
+    uint32_t retries() const { return _retries.load(std::memory_order_relaxed); }
+
+  private:
+    static constexpr size_t _wordCount = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> _sequence{0};
+    std::atomic<uint32_t> _words[_wordCount] = {};
+    mutable std::atomic<uint32_t> _retries{0};
+
+    // Word by word, so large data needs no second copy on the stack
+    void _load(T &data) const {
+        unsigned char *bytes = reinterpret_cast<unsigned char *>(&data);
+        for (size_t i = 0; i < _wordCount; i++) {
+            uint32_t word = _words[i].load(std::memory_order_relaxed);
+            size_t length = (i + 1) * 4 <= sizeof(T) ? 4 : sizeof(T) - i * 4;
+            memcpy(bytes + i * 4, &word, length);
+        }
+    }
+
+    void _store(const T &data) {
+        const unsigned char *bytes =
+            reinterpret_cast<const unsigned char *>(&data);
+        for (size_t i = 0; i < _wordCount; i++) {
+            uint32_t word = 0;
+            size_t length = (i + 1) * 4 <= sizeof(T) ? 4 : sizeof(T) - i * 4;
+            memcpy(&word, bytes + i * 4, length);
+            _words[i].store(word, std::memory_order_relaxed);
+        }
+    }
+};
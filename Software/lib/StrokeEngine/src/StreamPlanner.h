@@ -0,0 +1,168 @@
+/**
+ *   Stream Planner of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+
+// Number of queued segments the planner looks at beyond the running one
+#ifndef STROKE_STREAM_LOOKAHEAD_MAX
+#define STROKE_STREAM_LOOKAHEAD_MAX 8
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Lookahead planner for streamed segments, after the junction speed
+  planning of grbl. The running segment and the segments queued after it
+  form a window. Each junction between two segments gets the highest speed
+  the carriage may pass it with:
+
+  - 0 where the direction reverses, or a segment holds its position.
+  - Otherwise the lower of the two segments' average speeds, so neither
+    has to rush to make up for the junction. A speed given with the
+    segment replaces this.
+  - No more than the carriage can still brake from to stand still where
+    the window ends, since nothing is known beyond it. This is the
+    backward pass.
+  - No more than it can accelerate to from its current speed. This is the
+    forward pass.
+
+  StrokeEngine uses the exit speed of the running segment, and the room()
+  after its target to aim beyond it. The plan is made afresh when the next
+  segment starts, with whatever is queued by then.
+*/
+/**************************************************************************/
+class StreamPlanner {
+  public:
+    //! Starts a new window
+    void clear() { _count = 0; }
+
+    //! Appends a segment to the window
+    /*!
+      @param distance signed distance of the segment in steps
+      @param time time the segment has in s. 0 or less if it is late.
+      @param exitSpeed speed to pass its target with in steps/s, if the next
+      segment continues in the same direction. Negative to plan it.
+      @return false if the window is full and the segment was not added
+    */
+    bool add(int distance, float time, float exitSpeed = -1.0f) {
+        if (_count >= Capacity) {
+            return false;
+        }
+        _Block &block = _blocks[_count++];
+        block.distance = fabsf(float(distance));
+        block.direction = distance > 0 ? 1 : distance < 0 ? -1 : 0;
+        block.time = time;
+        block.exitLimit = exitSpeed;
+        return true;
+    }
+
+    //! Number of segments in the window
+    size_t count() const { return _count; }
+
+    //! Plans the junction speeds of the window
+    /*!
+      @param startSpeed current speed in the direction of the first segment
+      in steps/s
+      @param maxSpeed maximum speed in steps/s
+      @param maxAcceleration maximum acceleration in steps/s²
+    */
+    void plan(float startSpeed, float maxSpeed, float maxAcceleration) {
+        _start = startSpeed > 0.0f ? fminf(startSpeed, maxSpeed) : 0.0f;
+        if (_count == 0) {
+            return;
+        }
+
+        // Average speed each segment needs
+        for (size_t i = 0; i < _count; i++) {
+            _Block &block = _blocks[i];
+            block.nominal = block.time > 0.0f ? block.distance / block.time
+                                              : maxSpeed;
+            if (block.nominal > maxSpeed) block.nominal = maxSpeed;
+        }
+
+        // Backward pass: junction limits, and brake to a stop by the end
+        float following = 0.0f;
+        _blocks[_count - 1].exit = 0.0f;
+        for (size_t i = _count - 1; i-- > 0;) {
+            _Block &block = _blocks[i];
+            const _Block &next = _blocks[i + 1];
+            float junction = 0.0f;
+            if (block.direction != 0 && block.direction == next.direction) {
+                junction = block.exitLimit >= 0.0f
+                               ? fminf(block.exitLimit, maxSpeed)
+                               : fminf(block.nominal, next.nominal);
+            }
+            following = sqrtf(following * following +
+                              2.0f * maxAcceleration * next.distance);
+            block.exit = fminf(junction, following);
+            following = block.exit;
+        }
+
+        // Forward pass: what the carriage can speed up to
+        float entry = _start;
+        for (size_t i = 0; i < _count; i++) {
+            _Block &block = _blocks[i];
+            float reachable =
+                sqrtf(entry * entry + 2.0f * maxAcceleration * block.distance);
+            if (block.exit > reachable) block.exit = reachable;
+            entry = block.exit;
+        }
+    }
+
+    //! Speed to pass the target of a segment with
+    /*!
+      @param index segment in the window, 0 is the running one
+      @return speed in steps/s, 0 to stop there
+    */
+    float exitSpeed(size_t index) const {
+        return index < _count ? _blocks[index].exit : 0.0f;
+    }
+
+    //! Distance the carriage may run on past the target of a segment
+    /*!
+      The following segments up to the next planned stop. Braking from the
+      exit speed of the segment always fits in.
+      @param index segment in the window, 0 is the running one
+      @return distance in steps, 0 if it stops at the target
+    */
+    float room(size_t index) const {
+        float room = 0.0f;
+        for (size_t i = index; i + 1 < _count && _blocks[i].exit > 0.0f; i++) {
+            room += _blocks[i + 1].distance;
+        }
+        return room;
+    }
+
+    //! Speed a segment starts with
+    /*!
+      @param index segment in the window, 0 is the running one
+      @return speed in steps/s
+    */
+    float entrySpeed(size_t index) const {
+        return index == 0 ? _start : exitSpeed(index - 1);
+    }
+
+    //! Segments the window holds, the running one and the lookahead
+    static constexpr size_t Capacity = STROKE_STREAM_LOOKAHEAD_MAX + 1;
+
+  protected:
+    struct _Block {
+        float distance;  /*> Length in steps */
+        int direction;   /*> 1 out, -1 in, 0 holds the position */
+        float time;      /*> Time it has in s */
+        float exitLimit; /*> Given exit speed, negative to plan it */
+        float nominal;   /*> Average speed it needs */
+        float exit;      /*> Planned exit speed */
+    };
+    _Block _blocks[Capacity];
+    size_t _count = 0;
+    float _start = 0.0f;
+};
@@ -4,6 +4,18 @@
 
 #include "pattern.h"
 
+// Host builds without a pin to interrupt mapping
+#ifndef digitalPinToInterrupt
+#define digitalPinToInterrupt(p) (p)
+#endif
+
+// Host builds have no instruction RAM
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+StrokeEngine *StrokeEngine::_homeingEngine = NULL;
+
 // static pointer to engine and _servo
 void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor,
                          FastAccelStepper *servo) {
@@ -20,18 +32,25 @@ void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor,
         int(0.5 + _motor->maxSpeed * _motor->stepsPerMillimeter);
     _maxStepAcceleration =
         int(0.5 + _motor->maxAcceleration * _motor->stepsPerMillimeter);
+    _maxStepJerk = int(0.5 + _motor->maxJerk * _motor->stepsPerMillimeter);
+    _streamMaxStepPerSecond = _maxStepPerSecond;
+    _streamMaxStepAcceleration = _maxStepAcceleration;
+    _vibration.begin(TICKS_PER_S, STROKE_VIBRATION_PERIOD_US,
+                     _maxStepPerSecond, _maxStepAcceleration, _minStep,
+                     _maxStep);
 
     // Initialize with default values
     _state = UNDEFINED;
     _isHomed = false;
     _index = 0;
-    _depth = _maxStep;
-    _previousDepth = _maxStep;
-    _stroke = _maxStep / 3;
-    _previousStroke = _maxStep / 3;
-    _speedPercent = 0.0f;
-    _sensation = 0.0;
-    _recalcTimeOfStroke();
+    _settings.write([this](strokeSettings &settings) {
+        settings.depth = _maxStep;
+        settings.stroke = _maxStep / 3;
+        settings.speedPercent = 0.0f;
+        settings.sensation = 0.0f;
+        _recalcTimeOfStroke(settings);
+    });
+    _settingsSequence = _settings.read(_appliedSettings);
 
     if (_servo) {
         _servo->setDirectionPin(_motor->directionPin, _motor->invertDirection);
@@ -47,59 +66,47 @@ void StrokeEngine::begin(machineGeometry *physics, motorProperties *motor,
 }
 
 void StrokeEngine::setSpeed(float speedPercent, bool applyNow = false) {
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        _speedPercent = constrain(speedPercent, 0.0f, 100.0f);
-        _recalcTimeOfStroke();
-
-        pattern->setTimeOfStroke(_timeOfStroke);
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("setSpeed: " + String(_speedPercent, 2) +
-                       "% -> T=" + String(_timeOfStroke, 3) + "s");
-#endif
-
-        // When running a pattern and immediate update requested:
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
-
-#ifdef DEBUG_TALKATIVE
-            Serial.println("Apply New Settings Now");
-#endif
+    // Publish the new speed to the stroking task. Never blocks.
+    bool applyUpdate = (_state == PATTERN) && (applyNow == true);
+    _settings.write([&](strokeSettings &settings) {
+        settings.speedPercent = constrain(speedPercent, 0.0f, 100.0f);
+        _recalcTimeOfStroke(settings);
+        if (applyUpdate) {
+            settings.applyRequests++;
         }
+    });
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
+#ifdef DEBUG_TALKATIVE
+    strokeSettings settings = _settings.read();
+    Serial.println("setSpeed: " + String(settings.speedPercent, 2) +
+                   "% -> T=" + String(settings.timeOfStroke, 3) + "s");
+    if (applyUpdate) {
+        Serial.println("Apply New Settings Now");
     }
+#endif
 }
 
-float StrokeEngine::getSpeed() { return _speedPercent; }
+float StrokeEngine::getSpeed() { return _settings.read().speedPercent; }
 
 void StrokeEngine::setDepth(float depth, bool applyNow = false) {
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+    // Publish the new depth to the stroking task. Never blocks.
+    bool applyUpdate = (_state == PATTERN) && (applyNow == true);
+    _settings.write([&](strokeSettings &settings) {
         // Convert depth from mm into steps
         // Constrain depth between minStep and maxStep
-        _depth = constrain(int(depth * _motor->stepsPerMillimeter), _minStep,
-                           _maxStep);
-
-        pattern->setDepth(_depth);
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("setDepth: " + String(_depth));
-#endif
-        // When running a pattern and immediate update requested:
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
-
-#ifdef DEBUG_TALKATIVE
-            Serial.println("Apply New Settings Now");
-#endif
+        settings.depth = constrain(int(depth * _motor->stepsPerMillimeter),
+                                   _minStep, _maxStep);
+        if (applyUpdate) {
+            settings.applyRequests++;
         }
+    });
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setDepth: " + String(_settings.read().depth));
+    if (applyUpdate) {
+        Serial.println("Apply New Settings Now");
     }
+#endif
 
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
@@ -109,40 +116,30 @@ void StrokeEngine::setDepth(float depth, bool applyNow = false) {
 
 float StrokeEngine::getDepth() {
     // Convert depth from steps into mm
-    return _depth / _motor->stepsPerMillimeter;
+    return _settings.read().depth / _motor->stepsPerMillimeter;
 }
 
 void StrokeEngine::setStroke(float stroke, bool applyNow = false) {
-    // Update pattern with new stroke, will be used with the next stroke or on
-    // update request
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+    // Publish the new stroke to the stroking task, will be used with the next
+    // stroke or on update request. Never blocks.
+    bool applyUpdate = (_state == PATTERN) && (applyNow == true);
+    _settings.write([&](strokeSettings &settings) {
         // Convert stroke from mm into steps
         // Constrain stroke between minStep and maxStep
-        _stroke = constrain(int(stroke * _motor->stepsPerMillimeter), _minStep,
-                            _maxStep);
-
-        pattern->setStroke(_stroke);
-
-        _recalcTimeOfStroke();
-        pattern->setTimeOfStroke(_timeOfStroke);
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("setStroke: " + String(_stroke));
-#endif
-
-        // When running a pattern and immediate update requested:
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
-
-#ifdef DEBUG_TALKATIVE
-            Serial.println("Apply New Settings Now");
-#endif
+        settings.stroke = constrain(int(stroke * _motor->stepsPerMillimeter),
+                                    _minStep, _maxStep);
+        _recalcTimeOfStroke(settings);
+        if (applyUpdate) {
+            settings.applyRequests++;
         }
+    });
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setStroke: " + String(_settings.read().stroke));
+    if (applyUpdate) {
+        Serial.println("Apply New Settings Now");
     }
+#endif
 
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
@@ -152,35 +149,27 @@ void StrokeEngine::setStroke(float stroke, bool applyNow = false) {
 
 float StrokeEngine::getStroke() {
     // Convert stroke from steps into mm
-    return _stroke / _motor->stepsPerMillimeter;
+    return _settings.read().stroke / _motor->stepsPerMillimeter;
 }
 
 void StrokeEngine::setSensation(float sensation, bool applyNow = false) {
-    // Update pattern with new sensation, will be used with the next stroke or
-    // on update request
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+    // Publish the new sensation to the stroking task, will be used with the
+    // next stroke or on update request. Never blocks.
+    bool applyUpdate = (_state == PATTERN) && (applyNow == true);
+    _settings.write([&](strokeSettings &settings) {
         // Constrain sensation between -100 and 100
-        _sensation = constrain(sensation, -100, 100);
-
-        pattern->setSensation(_sensation);
-
-#ifdef DEBUG_TALKATIVE
-        Serial.println("setSensation: " + String(_sensation));
-#endif
-
-        // When running a pattern and immediate update requested:
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
-
-#ifdef DEBUG_TALKATIVE
-            Serial.println("Apply New Settings Now");
-#endif
+        settings.sensation = constrain(sensation, -100, 100);
+        if (applyUpdate) {
+            settings.applyRequests++;
         }
+    });
 
-        // give back mutex
-        xSemaphoreGive(_patternMutex);
+#ifdef DEBUG_TALKATIVE
+    Serial.println("setSensation: " + String(_settings.read().sensation));
+    if (applyUpdate) {
+        Serial.println("Apply New Settings Now");
     }
+#endif
 
     // if in state SETUPDEPTH then adjust
     if (_state == SETUPDEPTH) {
@@ -188,52 +177,72 @@ void StrokeEngine::setSensation(float sensation, bool applyNow = false) {
     }
 }
 
-float StrokeEngine::getSensation() { return _sensation; }
-
-bool StrokeEngine::setPattern(Pattern *NextPattern,
-                              bool applyNow = false) {
-    // Free up memory from previous pattern
-
-    delete pattern;
-    pattern = NextPattern;
-
-    // Inject current motion parameters into new pattern
-    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
-        pattern->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration,
-                              _motor->stepsPerMillimeter);
-        pattern->setTimeOfStroke(_timeOfStroke);
-        pattern->setStroke(_stroke);
-        pattern->setDepth(_depth);
-        pattern->setSensation(_sensation);
-
-        // When running a pattern and immediate update requested:
-        if ((_state == PATTERN) && (applyNow == true)) {
-            // set flag to apply update from stroking thread
-            _applyUpdate = true;
+float StrokeEngine::getSensation() { return _settings.read().sensation; }
 
+bool StrokeEngine::setPattern(int patternIndex, bool applyNow = false) {
+    if (patternIndex < 0 || patternIndex >= PatternPool::count) {
 #ifdef DEBUG_TALKATIVE
-            Serial.println("Apply New Settings Now");
+        Serial.println("setPattern: invalid index " + String(patternIndex));
 #endif
-        }
+        return false;
+    }
 
-        // Reset index counter
-        _index = -1;
+    Pattern *nextPattern = NULL;
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        // A running crossfade still reads the outgoing pattern from the spare
+        // slot of the pool. Hand over to the incoming pattern before the slot
+        // is reused.
+        _endCrossfade();
+
+        // Build the new pattern in the spare slot of the pool. This needs no
+        // heap.
+        Pattern *previousPattern = _patterns.active();
+        nextPattern = _patterns.prepare(patternIndex);
+
+        // Inject current motion parameters into new pattern
+        nextPattern->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration,
+                                   _motor->stepsPerMillimeter, _maxStepJerk);
+        _applySettings(nextPattern, _appliedSettings);
+
+        // Swap patterns with a single pointer store
+        _patterns.activate();
+
+        if (_state == PATTERN && applyNow == false && _crossfadeStrokes > 0) {
+            // Blend into the new pattern from the next stroke on. The running
+            // move finishes as planned.
+            _crossfade.begin(previousPattern, nextPattern, _index + 1,
+                             _crossfadeStrokes);
+        } else {
+            // Reset index counter. The running move is no longer the
+            // pattern's to finish.
+            _index = -1;
+            _issuedIndex = -1;
+            _vibrationTakeover = false;
+        }
+        _flushLookahead();
 
         // give back mutex
         xSemaphoreGive(_patternMutex);
     }
 
+    // When running a pattern and immediate update requested:
+    if ((_state == PATTERN) && (applyNow == true)) {
+        // ask the stroking thread to apply the update
+        _settings.write(
+            [](strokeSettings &settings) { settings.applyRequests++; });
+
+#ifdef DEBUG_TALKATIVE
+        Serial.println("Apply New Settings Now");
+#endif
+    }
+
 #ifdef DEBUG_TALKATIVE
-    Serial.println("setPattern: " + String(pattern->getName()));
-    Serial.println("setTimeOfStroke: " + String(_timeOfStroke, 2));
-    Serial.println("setDepth: " + String(_depth));
-    Serial.println("setStroke: " + String(_stroke));
-    Serial.println("setSensation: " + String(_sensation));
+    Serial.println("setPattern: " + String(nextPattern->getName()));
 #endif
     return true;
 }
 
-int StrokeEngine::getPattern() { return 0; }
+int StrokeEngine::getPattern() { return _patterns.activeIndex(); }
 
 bool StrokeEngine::startPattern() {
     // Only valid if state is ready
@@ -249,23 +258,39 @@ bool StrokeEngine::startPattern() {
         // Set state to PATTERN
         _state = PATTERN;
 
+        // The pattern takes over from a pending stop
+        if (xSemaphoreTake(_stopMutex, portMAX_DELAY) == pdTRUE) {
+            _afterStop = AFTER_STOP_NONE;
+            xSemaphoreGive(_stopMutex);
+        }
+
         // Reset Stroke and Motion parameters
         _index = -1;
+        _crossfade.end();
         if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+            Pattern *pattern = _patterns.active();
             pattern->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration,
-                                  _motor->stepsPerMillimeter);
-            pattern->setTimeOfStroke(_timeOfStroke);
-            pattern->setStroke(_stroke);
-            pattern->setDepth(_depth);
-            pattern->setSensation(_sensation);
+                                   _motor->stepsPerMillimeter, _maxStepJerk);
+
+            // Start from the latest settings. Apply requests made before the
+            // start are void.
+            _settingsSequence = _settings.read(_appliedSettings);
+            _applySettings(pattern, _appliedSettings);
+            _flushLookahead();
+
+            // A move still braking from the last session is not resumed
+            _issuedIndex = -1;
+            _vibrationTakeover = false;
             xSemaphoreGive(_patternMutex);
         }
 
 #ifdef DEBUG_TALKATIVE
-        Serial.print(" _timeOfStroke: " + String(_timeOfStroke));
-        Serial.print(" | _depth: " + String(_depth));
-        Serial.print(" | _stroke: " + String(_stroke));
-        Serial.println(" | _sensation: " + String(_sensation));
+        Serial.print(" _timeOfStroke: " +
+                     String(_appliedSettings.timeOfStroke));
+        Serial.print(" | _depth: " + String(_appliedSettings.depth));
+        Serial.print(" | _stroke: " + String(_appliedSettings.stroke));
+        Serial.println(" | _sensation: " +
+                       String(_appliedSettings.sensation));
 #endif
 
         if (_taskStrokingHandle == NULL) {
@@ -300,35 +325,109 @@ bool StrokeEngine::startPattern() {
 }
 
 void StrokeEngine::stopMotion() {
-    // only valid when
-    if (_state == PATTERN || _state == SETUPDEPTH) {
-        // Set state
-        _state = READY;
+    stopMotionAsync(xTaskGetCurrentTaskHandle());
+
+    // Sleep until the stopping task reports the servo at rest. The timeout
+    // covers a notification that went to a later caller of stopMotionAsync().
+    while (_isStopping) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+}
+
+void StrokeEngine::stopMotionAsync(TaskHandle_t notifyTask) {
+    _stop(AFTER_STOP_NONE, 0, 0, notifyTask);
+}
+
+bool StrokeEngine::startStreaming() {
+    // Only valid if state is ready
+    if (_state != READY) {
+#ifdef DEBUG_TALKATIVE
+        Serial.println("Failed to start streaming");
+#endif
+        return false;
+    }
 
-        // Stop _servo motor as fast as legally allowed
+    // Stop current move, should one be pending (moveToMax or moveToMin)
+    if (_servo->isRunning()) {
         _servo->setAcceleration(_maxStepAcceleration);
         _servo->applySpeedAcceleration();
         _servo->stopMove();
+    }
 
-#ifdef DEBUG_TALKATIVE
-        Serial.println("Motion stopped");
-#endif
+    // Start with an empty queue
+    _streamDiscard = _stream.pushed();
+    _index = -1;
+    _state = STREAMING;
 
-        // Wait for _servo stopped
-        while (_servo->isRunning())
-            ;
+    // Streaming takes over from a pending stop
+    if (xSemaphoreTake(_stopMutex, portMAX_DELAY) == pdTRUE) {
+        _afterStop = AFTER_STOP_NONE;
+        xSemaphoreGive(_stopMutex);
+    }
 
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(_servo->getCurrentPosition() /
-                                     _motor->stepsPerMillimeter),
-                               0.0, false);
-        }
+    if (_taskStreamingHandle == NULL) {
+        // Create Streaming Task
+        xTaskCreatePinnedToCore(
+            this->_streamingImpl,   // Function that should be called
+            "Streaming",            // Name of the task (for debugging)
+            4096,                   // Stack size (bytes)
+            this,                   // Pass reference to this class instance
+            24,                     // Pretty high task priority
+            &_taskStreamingHandle,  // Task handle
+            1                       // Pin to application core
+        );
+    } else {
+        // Resume task, if it already exists, and wake it should it still be
+        // waiting for a segment
+        vTaskResume(_taskStreamingHandle);
+        xTaskNotifyGive(_taskStreamingHandle);
     }
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("Stroke Engine State: " + verboseState[_state]);
 #endif
+
+    return true;
+}
+
+bool StrokeEngine::streamTo(float position, uint32_t arrival,
+                            float endSpeed) {
+    if (_state != STREAMING) {
+        return false;
+    }
+
+    streamSegment segment;
+    segment.position = constrain(int(position * _motor->stepsPerMillimeter),
+                                 _minStep, _maxStep);
+    segment.arrival = arrival;
+    segment.endSpeed = endSpeed < 0.0f
+                           ? -1
+                           : int(endSpeed * _motor->stepsPerMillimeter);
+    if (!_stream.push(segment)) {
+        return false;
+    }
+
+    // The streaming task sleeps until there is something to do
+    if (_taskStreamingHandle != NULL) {
+        xTaskNotifyGive(_taskStreamingHandle);
+    }
+    return true;
+}
+
+void StrokeEngine::clearStream() {
+    _streamDiscard = _stream.pushed();
+    if (_taskStreamingHandle != NULL) {
+        xTaskNotifyGive(_taskStreamingHandle);
+    }
+}
+
+void StrokeEngine::setStreamLimits(float maxSpeed, float maxAcceleration) {
+    _streamMaxStepPerSecond = constrain(
+        int(0.5 + maxSpeed * _motor->stepsPerMillimeter), 1,
+        _maxStepPerSecond);
+    _streamMaxStepAcceleration = constrain(
+        int(0.5 + maxAcceleration * _motor->stepsPerMillimeter), 1,
+        _maxStepAcceleration);
 }
 
 void StrokeEngine::enableAndHome(endstopProperties *endstop,
@@ -345,6 +444,7 @@ void StrokeEngine::enableAndHome(endstopProperties *endstop, float speed) {
     _homeingPin = endstop->endstopPin;
     pinMode(_homeingPin, endstop->pinMode);
     _homeingActiveLow = endstop->activeLow;
+    _homeingLatchOnInterrupt = endstop->latchOnInterrupt;
     _homeingSpeed = speed * _motor->stepsPerMillimeter;
 
     // set homing direction so sign can be multiplied
@@ -354,25 +454,12 @@ void StrokeEngine::enableAndHome(endstopProperties *endstop, float speed) {
         _homeingToBack = -1;
     }
 
-    // first stop current motion and delete stroke task
-    stopMotion();
-
     // Enable _servo
     _servo->enableOutputs();
 
-    // Create homing task
-    xTaskCreatePinnedToCore(
-        this->_homingProcedureImpl,  // Function that should be called
-        "Homing",                    // Name of the task (for debugging)
-        2048,                        // Stack size (bytes)
-        this,                        // Pass reference to this class instance
-        20,                          // Pretty high task priority
-        &_taskHomingHandle,          // Task handle
-        1                            // Have it on application core
-    );
-#ifdef DEBUG_TALKATIVE
-    Serial.println("Homing task started");
-#endif
+    // First stop current motion. The homing task starts once it has come
+    // to rest.
+    _stop(AFTER_STOP_HOME, 0, 0, NULL);
 }
 
 void StrokeEngine::thisIsHome(float speed, bool resetOrigin) {
@@ -417,21 +504,11 @@ bool StrokeEngine::moveToMax(float speed) {
 #endif
 
     if (_isHomed) {
-        // Stop motion immediately
-        stopMotion();
-
-        // Set feedrate for safe move
+        // Stop motion immediately. The move starts once it has come to rest.
         // Constrain speed between 1 step/sec and _maxStepPerSecond
-        _servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1,
-                                       _maxStepPerSecond));
-        _servo->setAcceleration(_maxStepAcceleration / 10);
-        _servo->moveTo(_maxStep);
-
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(_maxStep / _motor->stepsPerMillimeter),
-                               speed, false);
-        }
+        int stepSpeed = constrain(speed * _motor->stepsPerMillimeter, 1,
+                                  _maxStepPerSecond);
+        _stop(AFTER_STOP_MOVE, _maxStep, stepSpeed, NULL);
 
 #ifdef DEBUG_TALKATIVE
         Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -452,21 +529,11 @@ bool StrokeEngine::moveToMin(float speed) {
 #endif
 
     if (_isHomed) {
-        // Stop motion immediately
-        stopMotion();
-
-        // Set feedrate for safe move
+        // Stop motion immediately. The move starts once it has come to rest.
         // Constrain speed between 1 step/sec and _maxStepPerSecond
-        _servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1,
-                                       _maxStepPerSecond));
-        _servo->setAcceleration(_maxStepAcceleration / 10);
-        _servo->moveTo(_minStep);
-
-        // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(float(_minStep / _motor->stepsPerMillimeter),
-                               speed, false);
-        }
+        int stepSpeed = constrain(speed * _motor->stepsPerMillimeter, 1,
+                                  _maxStepPerSecond);
+        _stop(AFTER_STOP_MOVE, _minStep, stepSpeed, NULL);
 
 #ifdef DEBUG_TALKATIVE
         Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -493,20 +560,13 @@ bool StrokeEngine::setupDepth(float speed, bool fancy) {
 
     // isHomed is only true in states READY, PATTERN and SETUPDEPTH
     if (_isHomed) {
-        // Stop motion immediately
-        stopMotion();
-
-        // Set feedrate for safe move
+        // Stop motion immediately and enter state SETUPDEPTH. The move to the
+        // current depth position starts once the stop has come to rest.
         // Constrain speed between 1 step/sec and _maxStepPerSecond
-        _servo->setSpeedInHz(constrain(speed * _motor->stepsPerMillimeter, 1,
-                                       _maxStepPerSecond));
-        _servo->setAcceleration(_maxStepAcceleration / 10);
-
-        // Set new state
-        _state = SETUPDEPTH;
-
-        // move to current depth position
-        _setupDepths();
+        _stop(AFTER_STOP_SETUPDEPTH, 0,
+              constrain(speed * _motor->stepsPerMillimeter, 1,
+                        _maxStepPerSecond),
+              NULL);
 
         // set return value to true
         allowed = true;
@@ -523,6 +583,12 @@ void StrokeEngine::disable() {
     _state = UNDEFINED;
     _isHomed = false;
 
+    // Nothing may move once a pending stop has come to rest
+    if (xSemaphoreTake(_stopMutex, portMAX_DELAY) == pdTRUE) {
+        _afterStop = AFTER_STOP_NONE;
+        xSemaphoreGive(_stopMutex);
+    }
+
     // Disable _servo motor
     _servo->disableOutputs();
 
@@ -539,7 +605,7 @@ void StrokeEngine::disable() {
 }
 
 String StrokeEngine::getPatternName(int index) {
-    return String("Invalid");
+    return String(PatternPool::name(index));
 }
 
 void StrokeEngine::setMaxSpeed(float maxSpeed) {
@@ -548,13 +614,18 @@ void StrokeEngine::setMaxSpeed(float maxSpeed) {
         // Convert speed into steps
         _maxStepPerSecond =
             int(0.5 + _motor->maxSpeed * _motor->stepsPerMillimeter);
-        pattern->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration,
-                              _motor->stepsPerMillimeter);
-
-        _recalcTimeOfStroke();
-        pattern->setTimeOfStroke(_timeOfStroke);
+        _patterns.active()->setSpeedLimit(
+            _maxStepPerSecond, _maxStepAcceleration,
+            _motor->stepsPerMillimeter, _maxStepJerk);
+        _vibration.setLimits(_maxStepPerSecond, _maxStepAcceleration);
+        _flushLookahead();
         xSemaphoreGive(_patternMutex);
     }
+
+    // Keep the peak speed percentage, the stroking task picks up the new
+    // timeOfStroke on its next cycle
+    _settings.write(
+        [this](strokeSettings &settings) { _recalcTimeOfStroke(settings); });
 }
 
 float StrokeEngine::getMaxSpeed() {
@@ -567,8 +638,11 @@ void StrokeEngine::setMaxAcceleration(float maxAcceleration) {
         // Convert acceleration into steps
         _maxStepAcceleration =
             int(0.5 + _motor->maxAcceleration * _motor->stepsPerMillimeter);
-        pattern->setSpeedLimit(_maxStepPerSecond, _maxStepAcceleration,
-                              _motor->stepsPerMillimeter);
+        _patterns.active()->setSpeedLimit(
+            _maxStepPerSecond, _maxStepAcceleration,
+            _motor->stepsPerMillimeter, _maxStepJerk);
+        _vibration.setLimits(_maxStepPerSecond, _maxStepAcceleration);
+        _flushLookahead();
         xSemaphoreGive(_patternMutex);
     }
 }
@@ -577,10 +651,74 @@ float StrokeEngine::getMaxAcceleration() {
     return float(_maxStepAcceleration / _motor->stepsPerMillimeter);
 }
 
-void StrokeEngine::registerTelemetryCallback(void (*callbackTelemetry)(float,
-                                                                       float,
-                                                                       bool)) {
-    _callbackTelemetry = callbackTelemetry;
+void StrokeEngine::setMaxJerk(float maxJerk) {
+    // Update pattern with new jerk limit
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        // Convert jerk into steps
+        _maxStepJerk = int(0.5 + fmaxf(maxJerk, 0.0f) *
+                                     _motor->stepsPerMillimeter);
+        _patterns.active()->setSpeedLimit(
+            _maxStepPerSecond, _maxStepAcceleration,
+            _motor->stepsPerMillimeter, _maxStepJerk);
+        _flushLookahead();
+        xSemaphoreGive(_patternMutex);
+    }
+}
+
+float StrokeEngine::getMaxJerk() {
+    return float(_maxStepJerk / _motor->stepsPerMillimeter);
+}
+
+size_t StrokeEngine::readTelemetry(telemetryRecord *records,
+                                   size_t maxRecords) {
+    return _telemetry.pop(records, maxRecords);
+}
+
+uint32_t StrokeEngine::getTelemetryOverflows() { return _telemetry.dropped(); }
+
+uint32_t StrokeEngine::getTelemetryHighWater() {
+    return _telemetry.highWater();
+}
+
+void StrokeEngine::setVibration(float amplitude, float frequency) {
+    // Picked up by the stroking task with its next cycle
+    _vibrationAmplitude = fmaxf(amplitude, 0.0f) * _motor->stepsPerMillimeter;
+    _vibrationFrequency = fmaxf(frequency, 0.0f);
+    _vibrationRequests++;
+}
+
+float StrokeEngine::getVibrationAmplitude() {
+    float amplitude = fminf(_vibrationAmplitude,
+                            _vibration.maxAmplitude(_vibrationFrequency));
+    return amplitude / _motor->stepsPerMillimeter;
+}
+
+float StrokeEngine::getVibrationFrequency() { return _vibrationFrequency; }
+
+float StrokeEngine::getMaxVibrationAmplitude(float frequency) {
+    return _vibration.maxAmplitude(frequency) / _motor->stepsPerMillimeter;
+}
+
+void StrokeEngine::setTempo(float bpm, uint32_t beatMicros) {
+    // Picked up by the stroking task with its next cycle
+    _tempoBpm = fmaxf(bpm, 0.0f);
+    _tempoBeat = beatMicros;
+    _tempoRequests++;
+}
+
+void StrokeEngine::setCrossfade(uint8_t strokes) {
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        _crossfadeStrokes = strokes;
+        xSemaphoreGive(_patternMutex);
+    }
+}
+
+void StrokeEngine::setLookahead(uint8_t depth) {
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        _lookaheadDepth = constrain(depth, 0, STROKE_LOOKAHEAD_MAX);
+        _flushLookahead();
+        xSemaphoreGive(_patternMutex);
+    }
 }
 
 void StrokeEngine::_homingProcedure() {
@@ -589,6 +727,7 @@ void StrokeEngine::_homingProcedure() {
     _servo->setAcceleration(_maxStepAcceleration / 10);
 
     // Check if we are already at the homing switch
+    bool backedOff = false;
     if (digitalRead(_homeingPin) == !_homeingActiveLow) {
         // back off 5 mm from switch
         _servo->move(_motor->stepsPerMillimeter * 2 *
@@ -599,7 +738,18 @@ void StrokeEngine::_homingProcedure() {
             // Pause the task for 100ms while waiting for move to complete
             vTaskDelay(100 / portTICK_PERIOD_MS);
         }
+        backedOff = true;
+    }
+
+    // Arm the latch before approaching the switch, so the first edge counts
+    if (_homeingLatchOnInterrupt) {
+        _homeingLatched = false;
+        _homeingEngine = this;
+        attachInterrupt(digitalPinToInterrupt(_homeingPin), _endstopISR,
+                        _homeingActiveLow ? FALLING : RISING);
+    }
 
+    if (backedOff) {
         // move back towards endstop
         _servo->move(-_motor->stepsPerMillimeter * 4 *
                      _physics->keepoutBoundary * _homeingToBack);
@@ -612,25 +762,54 @@ void StrokeEngine::_homingProcedure() {
 
     // Poll homing switch
     while (_servo->isRunning()) {
-        // Switch is active low
-        if (digitalRead(_homeingPin) == !_homeingActiveLow) {
-            // Set home position
-            if (_homeingToBack == 1) {
-                // Switch is at -KEEPOUT_BOUNDARY
-                _servo->forceStopAndNewPosition(-_motor->stepsPerMillimeter *
-                                                _physics->keepoutBoundary);
-
-                // drive free of switch and set axis to lower end
-                _servo->moveTo(_minStep);
+        // Read the level before the latch. A pressed switch that isn't
+        // latched yet has its interrupt still on the way, wait for it
+        // rather than force a stop wherever the carriage is by now.
+        bool pressed = digitalRead(_homeingPin) == !_homeingActiveLow;
+        bool latched = _homeingLatched;
+        if (pressed && !latched && _homeingLatchOnInterrupt) {
+            ulTaskNotifyTake(pdTRUE, 2 / portTICK_PERIOD_MS);
+            latched = _homeingLatched;
+        }
 
+        if (latched || pressed) {
+            // Set home position
+            int switchPosition =
+                _homeingToBack == 1
+                    // Switch is at -KEEPOUT_BOUNDARY
+                    ? -_motor->stepsPerMillimeter * _physics->keepoutBoundary
+                    : _motor->stepsPerMillimeter * (_physics->physicalTravel -
+                                                    _physics->keepoutBoundary);
+
+            if (latched) {
+                // The ISR only stamps the time of the edge. The carriage runs
+                // at homing speed past the switch, so step back from where it
+                // is now by how far it went since.
+                uint32_t since = micros() - _homeingLatchMicros;
+                int32_t position = _servo->getCurrentPosition();
+                float stepsPerMicro =
+                    _servo->getCurrentSpeedInMilliHz() / 1.0e9f;
+                _homeingLatch = position - lroundf(stepsPerMicro * since);
+
+                // Brake as fast as legally allowed. The carriage comes to
+                // rest a little past the switch, so shift the counter by how
+                // far it went on after the edge.
+                _servo->setAcceleration(_maxStepAcceleration);
+                _servo->applySpeedAcceleration();
+                _servo->stopMove();
+                while (_servo->isRunning()) {
+                    vTaskDelay(1);
+                }
+                _servo->setCurrentPosition(switchPosition +
+                                           _servo->getCurrentPosition() -
+                                           _homeingLatch);
+                _servo->setAcceleration(_maxStepAcceleration / 10);
             } else {
-                _servo->forceStopAndNewPosition(
-                    _motor->stepsPerMillimeter *
-                    (_physics->physicalTravel - _physics->keepoutBoundary));
-
-                // drive free of switch and set axis to front end
-                _servo->moveTo(_maxStep);
+                _servo->forceStopAndNewPosition(switchPosition);
             }
+
+            // drive free of switch and set axis to the end of the travel
+            _servo->moveTo(_homeingToBack == 1 ? _minStep : _maxStep);
             _isHomed = true;
 
             // drive free of switch and set axis to 0
@@ -640,8 +819,18 @@ void StrokeEngine::_homingProcedure() {
             break;
         }
 
-        // Pause the task for 20ms to allow other tasks
-        vTaskDelay(20 / portTICK_PERIOD_MS);
+        // Pause the task for 20ms to allow other tasks. The endstop
+        // interrupt wakes it right away.
+        if (_homeingLatchOnInterrupt) {
+            ulTaskNotifyTake(pdTRUE, 20 / portTICK_PERIOD_MS);
+        } else {
+            vTaskDelay(20 / portTICK_PERIOD_MS);
+        }
+    }
+
+    if (_homeingLatchOnInterrupt) {
+        detachInterrupt(digitalPinToInterrupt(_homeingPin));
+        _homeingEngine = NULL;
     }
 
     // disable _servo if homing has not found the homing switch
@@ -668,9 +857,7 @@ void StrokeEngine::_homingProcedure() {
     }
 
     // Set first point for telemetry
-    if (_callbackTelemetry != NULL) {
-        _callbackTelemetry(0.0, 0.0, false);
-    }
+    _sendTelemetry(0, 0, 0, -1, CLIP_NONE);
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("Stroke Engine State: " + verboseState[_state]);
@@ -681,22 +868,250 @@ void StrokeEngine::_homingProcedure() {
     vTaskDelete(NULL);
 }
 
+void StrokeEngine::_stop(afterStop then, int position, int speed,
+                         TaskHandle_t notifyTask) {
+    bool running = false;
+    if (xSemaphoreTake(_stopMutex, portMAX_DELAY) == pdTRUE) {
+        if (_state == PATTERN || _state == SETUPDEPTH || _state == STREAMING) {
+            // Set state
+            _state = READY;
+
+            // Queued segments are void
+            _streamDiscard = _stream.pushed();
+        }
+        if (then == AFTER_STOP_SETUPDEPTH) {
+            _state = SETUPDEPTH;
+        }
+
+        // A later request replaces the follow-up of an earlier one
+        _afterStop = then;
+        _afterStopPosition = position;
+        _afterStopSpeed = speed;
+        _stopNotifyTask = notifyTask;
+        _isStopping = true;
+
+        // Without power the servo can not be running
+        running = _state != UNDEFINED && _servo->isRunning();
+        if (running) {
+            // Stop _servo motor as fast as legally allowed
+            _servo->setAcceleration(_maxStepAcceleration);
+            _servo->applySpeedAcceleration();
+            _servo->stopMove();
+
+#ifdef DEBUG_TALKATIVE
+            Serial.println("Motion stopped");
+#endif
+        }
+        xSemaphoreGive(_stopMutex);
+    }
+
+    if (!running) {
+        // Already at rest, carry on right here
+        _stopped();
+        return;
+    }
+
+    // Leave waiting for the servo to the stopping task
+    if (_taskStoppingHandle == NULL) {
+        xTaskCreatePinnedToCore(
+            this->_stoppingImpl,   // Function that should be called
+            "Stopping",            // Name of the task (for debugging)
+            2048,                  // Stack size (bytes)
+            this,                  // Pass reference to this class instance
+            24,                    // Pretty high task priority
+            &_taskStoppingHandle,  // Task handle
+            1                      // Pin to application core
+        );
+    } else {
+        xTaskNotifyGive(_taskStoppingHandle);
+    }
+}
+
+void StrokeEngine::_stopping() {
+    while (1) {  // infinite loop
+        // Poll once per tick until the servo is at rest, or until a pattern
+        // or stream has taken over from the stop
+        while (_servo->isRunning() && _state != PATTERN &&
+               _state != STREAMING) {
+            vTaskDelay(1);
+        }
+        _stopped();
+
+        // Sleep until the next stop
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+void StrokeEngine::_stopped() {
+    TaskHandle_t notifyTask = NULL;
+    if (xSemaphoreTake(_stopMutex, portMAX_DELAY) == pdTRUE) {
+        // Somebody else already finished this stop
+        if (!_isStopping) {
+            xSemaphoreGive(_stopMutex);
+            return;
+        }
+        afterStop then = _afterStop;
+        notifyTask = _stopNotifyTask;
+        _afterStop = AFTER_STOP_NONE;
+        _stopNotifyTask = NULL;
+        _isStopping = false;
+
+        switch (then) {
+            case AFTER_STOP_MOVE:
+                // Unless a pattern or stream has been started meanwhile
+                if (_state == READY) {
+                    // Set feedrate for safe move
+                    _servo->setSpeedInHz(_afterStopSpeed);
+                    _servo->setAcceleration(_maxStepAcceleration / 10);
+                    _servo->moveTo(_afterStopPosition);
+
+                    // Send telemetry data
+                    _sendTelemetry(_afterStopPosition, _afterStopSpeed,
+                                   _maxStepAcceleration / 10, -1, CLIP_NONE);
+                }
+                break;
+
+            case AFTER_STOP_SETUPDEPTH:
+                if (_state == SETUPDEPTH) {
+                    // Set feedrate for safe move
+                    _servo->setSpeedInHz(_afterStopSpeed);
+                    _servo->setAcceleration(_maxStepAcceleration / 10);
+
+                    // move to current depth position
+                    _setupDepths();
+                }
+                break;
+
+            case AFTER_STOP_HOME:
+                // Create homing task
+                xTaskCreatePinnedToCore(
+                    this->_homingProcedureImpl,  // Function that should be
+                                                 // called
+                    "Homing",            // Name of the task (for debugging)
+                    2048,                // Stack size (bytes)
+                    this,                // Pass reference to this class
+                    20,                  // Pretty high task priority
+                    &_taskHomingHandle,  // Task handle
+                    1                    // Have it on application core
+                );
+#ifdef DEBUG_TALKATIVE
+                Serial.println("Homing task started");
+#endif
+                break;
+
+            default:
+                // Send telemetry data
+                if (_state == READY) {
+                    _sendTelemetry(_servo->getCurrentPosition(), 0, 0, -1,
+                                   CLIP_NONE);
+                }
+                break;
+        }
+        xSemaphoreGive(_stopMutex);
+    }
+
+#ifdef DEBUG_TALKATIVE
+    Serial.println("Stroke Engine State: " + verboseState[_state]);
+#endif
+
+    if (notifyTask != NULL) {
+        xTaskNotifyGive(notifyTask);
+    }
+}
+
+void IRAM_ATTR StrokeEngine::_endstopISR() {
+    StrokeEngine *engine = _homeingEngine;
+    if (engine == NULL || engine->_homeingLatched) {
+        return;
+    }
+
+    // Only the first edge counts, a bouncing switch changes nothing. The
+    // stepper lives in flash, the homing task reads it.
+    engine->_homeingLatchMicros = micros();
+    engine->_homeingLatched = true;
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(engine->_taskHomingHandle, &woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
 void StrokeEngine::_stroking() {
-    motionParameter currentMotion;
+    motionParameter currentMotion = {0, 0, 0, true, 0};
 
     while (1) {  // infinite loop
 
-        // Suspend task, if not in PATTERN state
+        // Suspend task, if not in PATTERN state. A vibration brakes to a
+        // stop through the step queue first.
         if (_state != PATTERN) {
+            if (_vibration.active()) {
+                _stopVibration();
+                vTaskDelay(1);
+                continue;
+            }
+            // The move a restart begins with is planned afresh
+            _tempo.cancel();
+            _issuedIndex = -1;
+            _vibrationTakeover = false;
             vTaskSuspend(_taskStrokingHandle);
         }
 
-        // Take mutex to ensure no interference / race condition with
-        // communication threat on other core
-        if (xSemaphoreTake(_patternMutex, 0) == pdTRUE) {
-            if (_applyUpdate == true) {
+        // Poll every 10ms, or sooner if the running move is about to arrive
+        TickType_t ticksToWait = 10 / portTICK_PERIOD_MS;
+
+        // Take mutex to ensure no interference / race condition with a
+        // pattern switch on the other core. The setters don't take it, so
+        // this only ever waits for setPattern() and alike.
+        if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+            // Pick up new settings. Reading them never waits for a setter:
+            // while one is writing, this cycle keeps the current settings.
+            bool applyUpdate = false;
+            strokeSettings settings;
+            uint32_t sequence;
+            if (_settings.sequence() != _settingsSequence &&
+                _settings.tryRead(settings, sequence)) {
+                _settingsSequence = sequence;
+                applyUpdate = (settings.applyRequests !=
+                               _appliedSettings.applyRequests);
+                _appliedSettings.applyRequests = settings.applyRequests;
+
+                // Prepared targets were computed with the old settings
+                if (memcmp(&settings, &_appliedSettings, sizeof(settings)) !=
+                    0) {
+                    _applySettings(_patterns.active(), settings);
+                    if (_crossfade.active()) {
+                        _applySettings(_crossfade.from(), settings);
+                    }
+                    _appliedSettings = settings;
+                    _flushLookahead();
+                }
+            }
+
+            uint32_t vibrationRequests = _vibrationRequests;
+            if (vibrationRequests != _vibrationApplied) {
+                _vibrationApplied = vibrationRequests;
+                _vibration.setVibration(_vibrationAmplitude,
+                                        _vibrationFrequency);
+            }
+
+            uint32_t tempoRequests = _tempoRequests;
+            if (tempoRequests != _tempoApplied) {
+                _tempoApplied = tempoRequests;
+                _tempo.setTempo(_tempoBpm, _tempoBeat);
+            }
+
+            if (applyUpdate == true) {
+                _flushLookahead();
+                _vibrationTakeover = false;
+
                 // Ask pattern for update on motion parameters
-                currentMotion = pattern->nextTarget(_index);
+                currentMotion = _nextTarget(_index);
+
+                // Still aim for the beat the move was planned to end on
+                if (_tempo.active()) {
+                    _lockToTempo(currentMotion, false);
+                }
 
                 // Increase deceleration if required to avoid crash
                 if (_servo->getAcceleration() > currentMotion.acceleration) {
@@ -710,26 +1125,58 @@ void StrokeEngine::_stroking() {
 
                 // Apply new trapezoidal motion profile to _servo
                 _applyMotionProfile(&currentMotion);
-
-                // clear update flag
-                _applyUpdate = false;
+                if (currentMotion.skip == false) {
+                    _issuedMotion = currentMotion;
+                    _issuedIndex = _index;
+                }
             }
 
             // If motor has stopped issue moveTo command to next position
-            else if (_servo->isRunning() == false) {
+            else if (_strokeArrived()) {
+                if (_tempo.planned()) {
+                    _tempo.arrived(micros());
+                    _tempoPhaseError = _tempo.phaseError();
+                }
+
+                // The vibration takes over from standstill
+                if (!_vibration.active() && _vibration.amplitude() > 0.0f) {
+                    _vibration.start(_servo->getCurrentPosition());
+                    _vibrationPending = false;
+                    _vibrationTakeover = false;
+                }
+
                 // Increment index for pattern
                 _index++;
 
-                // Querey new set of pattern parameters
-                currentMotion = pattern->nextTarget(_index);
+                // Take the prepared target or querey new set of pattern
+                // parameters
+                if (_lookaheadCount > 0) {
+                    currentMotion = _lookahead[_lookaheadHead];
+                    _lookaheadHead =
+                        (_lookaheadHead + 1) % STROKE_LOOKAHEAD_MAX;
+                    _lookaheadCount--;
+                } else {
+                    currentMotion = _nextTarget(_index);
+                }
 
                 // Pattern may introduce pauses between strokes
                 if (currentMotion.skip == false) {
 #ifdef DEBUG_STROKE
                     Serial.println("Stroking Index: " + String(_index));
 #endif
+                    if (_tempo.active()) {
+                        _lockToTempo(currentMotion, true);
+                    }
+
                     // Apply new trapezoidal motion profile to _servo
                     _applyMotionProfile(&currentMotion);
+                    _issuedMotion = currentMotion;
+                    _issuedIndex = _index;
+
+                    // The following strokes belong to the new pattern alone
+                    if (_crossfade.active() && _crossfade.done(_index + 1)) {
+                        _endCrossfade();
+                    }
 
                 } else {
                     // decrement _index so that it stays the same until the next
@@ -738,15 +1185,250 @@ void StrokeEngine::_stroking() {
                 }
             }
 
+            // The step queue can only take over from standstill. Cut the
+            // running move short and finish it once the vibration runs. Only
+            // a move this session issued is finished, anything else (a move
+            // still braking from a stop) just comes to rest.
+            if (!_vibration.active() && _vibration.amplitude() > 0.0f &&
+                !_vibrationTakeover && _servo->isRunning()) {
+                _servo->setAcceleration(_maxStepAcceleration);
+                _servo->applySpeedAcceleration();
+                _servo->stopMove();
+                if (_issuedIndex >= 0) {
+                    _index = _issuedIndex - 1;
+                    _flushLookahead();
+                    _lookahead[_lookaheadHead] = _issuedMotion;
+                    _lookaheadCount = 1;
+                }
+                _vibrationTakeover = true;
+            }
+
+            // Keep the step queue filled. Come back right away when a
+            // stroke arrived, so the next one follows without a gap.
+            if (_vibration.active()) {
+                bool arrived = _feedVibration();
+                ticksToWait =
+                    arrived ? 0
+                            : pdMS_TO_TICKS(QUEUE_LEN *
+                                            STROKE_VIBRATION_PERIOD_US / 4000);
+            }
+
+            // Prepare the following targets while the move is running and
+            // wake up right when it arrives
+            else if (_lookaheadDepth > 0) {
+                _fillLookahead();
+                TickType_t ticksToArrival = _ticksUntilArrival();
+                if (ticksToArrival < ticksToWait) {
+                    ticksToWait = ticksToArrival;
+                }
+            }
+
+            // Notice the arrival on the tick it is due, so the next move
+            // starts on the beat
+            if (_tempo.planned() && !_vibration.active()) {
+                TickType_t ticksToBeat = _tempo.microsUntilArrival(micros()) /
+                                         (1000 * portTICK_PERIOD_MS);
+                ticksToBeat = (ticksToBeat > 1) ? ticksToBeat : 1;
+                if (ticksToBeat < ticksToWait) {
+                    ticksToWait = ticksToBeat;
+                }
+            }
+
+            // The move is on its way, the pattern may read ahead now
+            _patterns.active()->prefetch();
+            if (_crossfade.active()) {
+                _crossfade.from()->prefetch();
+            }
+
             // give back mutex
             xSemaphoreGive(_patternMutex);
         }
 
-        // Delay 10ms
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        vTaskDelay(ticksToWait);
+    }
+}
+
+bool StrokeEngine::_strokeArrived() {
+    if (!_vibration.active()) {
+        return _servo->isRunning() == false;
+    }
+    if (_vibration.moving()) {
+        return false;
+    }
+
+    // The next stroke carries on in the step queue
+    if (_vibration.amplitude() > 0.0f) {
+        return true;
+    }
+
+    // The vibration is switched off. Hand the carriage back to the ramp
+    // generator once it has faded out and the queue has run empty.
+    if (!_vibration.atRest() || _servo->isRunning()) {
+        return false;
+    }
+    _vibration.end();
+    return true;
+}
+
+bool StrokeEngine::_feedVibration() {
+    while (true) {
+        bool arrived = false;
+        if (!_vibrationPending) {
+            // Stop feeding at rest, so the queue can run empty
+            if (_vibration.atRest()) {
+                return false;
+            }
+            bool moving = _vibration.moving();
+            _vibrationCommand = _vibration.next();
+            _vibrationPending = true;
+            arrived = moving && !_vibration.moving();
+        }
+
+        stepper_command_s command;
+        command.ticks = _vibrationCommand.ticks;
+        command.steps = _vibrationCommand.steps;
+        command.count_up = _vibrationCommand.countUp;
+        if (_servo->addQueueEntry(&command) != AQE_OK) {
+            // Queue is full, try again with the next cycle
+            return false;
+        }
+        _vibrationPending = false;
+        if (arrived) {
+            return true;
+        }
+    }
+}
+
+void StrokeEngine::_stopVibration() {
+    if (xSemaphoreTake(_patternMutex, portMAX_DELAY) == pdTRUE) {
+        // Brake the stroke and fade out the vibration. Once everything is
+        // planned the queue runs empty by itself.
+        _vibration.stop();
+        _feedVibration();
+        if (_vibration.atRest()) {
+            _vibration.end();
+        }
+
+        // A restarted pattern picks up the set vibration again
+        _vibrationApplied = _vibrationRequests - 1;
+        xSemaphoreGive(_patternMutex);
+    }
+}
+
+void StrokeEngine::_fillLookahead() {
+    if (!_lookaheadAllowed()) {
+        return;
+    }
+    while (_lookaheadCount < _lookaheadDepth) {
+        unsigned int index = _index + _lookaheadCount + 1;
+        motionParameter next = _nextTarget(index);
+
+        // A pause depends on when it is asked for, so it is never prepared.
+        // The pattern is queried again once the carriage stands still.
+        if (next.skip == true) {
+            return;
+        }
+
+        uint8_t tail =
+            (_lookaheadHead + _lookaheadCount) % STROKE_LOOKAHEAD_MAX;
+        _lookahead[tail] = next;
+        _lookaheadCount++;
     }
 }
 
+bool StrokeEngine::_lookaheadAllowed() {
+    if (_crossfade.active()) {
+        return _crossfade.lookahead();
+    }
+    return _patterns.active()->lookahead();
+}
+
+motionParameter StrokeEngine::_nextTarget(unsigned int index) {
+    if (_crossfade.active()) {
+        return _crossfade.nextTarget(index);
+    }
+    return _patterns.active()->nextTarget(index);
+}
+
+void StrokeEngine::_endCrossfade() {
+    if (_crossfade.active()) {
+        // Continue with the index the new pattern was given
+        _index = int(_crossfade.toIndex(_index));
+        _crossfade.end();
+    }
+}
+
+void StrokeEngine::_lockToTempo(motionParameter &motion, bool replan) {
+    int target = constrain(motion.stroke, _minStep, _maxStep);
+    int distance = abs(target - _servo->getCurrentPosition());
+    uint32_t now = micros();
+
+    float time;
+    if (replan || !_tempo.planned()) {
+        float speed = fminf(float(motion.speed), float(_maxStepPerSecond));
+        float acceleration =
+            fminf(float(motion.acceleration), float(_maxStepAcceleration));
+        time = _tempo.plan(now,
+                           TempoLock::moveTime(distance, speed, acceleration));
+    } else {
+        time = _tempo.remaining(now);
+    }
+    _tempo.fit(motion, distance, time, _maxStepPerSecond, _maxStepAcceleration);
+}
+
+TickType_t StrokeEngine::_ticksUntilArrival() {
+    // A pattern that is only asked at the reversal is asked right when the
+    // move arrives
+    if (!_lookaheadAllowed()) {
+        return _servo->isRunning() ? _ticksUntilStop()
+                                   : 10 / portTICK_PERIOD_MS;
+    }
+    // Nothing prepared (e.g. a pause is coming up): keep the normal polling
+    if (_lookaheadCount == 0) {
+        return 10 / portTICK_PERIOD_MS;
+    }
+    return _ticksUntilStop();
+}
+
+TickType_t StrokeEngine::_ticksUntilStop() {
+    if (_servo->isRunning() == false) {
+        return 1;
+    }
+
+    float distance =
+        float(_servo->targetPos() - _servo->getCurrentPosition());
+    float speed = _servo->getCurrentSpeedInMilliHz() / 1000.0f;
+    float maxSpeed = _servo->getSpeedInMilliHz() / 1000.0f;
+    float acceleration = float(_servo->getAcceleration());
+
+    // Still braking from a move in the other direction
+    if (distance * speed < 0.0f || acceleration <= 0.0f || maxSpeed <= 0.0f) {
+        return 1;
+    }
+    distance = fabs(distance);
+    speed = fabs(speed);
+
+    // Remaining time of the trapezoidal profile from the current state
+    float seconds;
+    if (speed * speed >= 2.0f * acceleration * distance) {
+        // Already in the final deceleration
+        seconds = (speed > 0.0f) ? 2.0f * distance / speed : 0.0f;
+    } else {
+        // Peak speed of the rest of the move
+        float peak = fminf(maxSpeed, sqrtf(acceleration * distance +
+                                          0.5f * speed * speed));
+        float rampDistance = (2.0f * peak * peak - speed * speed) /
+                             (2.0f * acceleration);
+        seconds = (2.0f * peak - speed) / acceleration +
+                  fmaxf(0.0f, distance - rampDistance) / peak;
+    }
+
+    // vTaskDelay() wakes up within the last tick, so rounding down never
+    // oversleeps the arrival
+    TickType_t ticks = TickType_t(seconds * 1000.0f / portTICK_PERIOD_MS);
+    return (ticks > 1) ? ticks : 1;
+}
+
 void StrokeEngine::_streaming() {
     while (1) {  // infinite loop
 
@@ -755,56 +1437,231 @@ void StrokeEngine::_streaming() {
             vTaskSuspend(_taskStreamingHandle);
         }
 
-        // Delay 10ms
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        // Discard the segments queued before clearStream(). Only this task
+        // takes segments from the queue, so it does that itself.
+        uint32_t discard = _streamDiscard.load();
+        if (int32_t(_streamTaken - discard) < 0) {
+            streamSegment discarded;
+            while (int32_t(_streamTaken - discard) < 0 &&
+                   _stream.pop(discarded)) {
+                _streamTaken++;
+            }
+            _streamActive = false;
+        }
+
+        // Start the next segment once the running one is done
+        streamSegment segment;
+        if ((!_streamActive || _streamSegmentDone()) && _stream.pop(segment)) {
+            _streamTaken++;
+            _startStreamSegment(segment);
+
+            void (*callBack)() = _callBackStream;
+            if (callBack != NULL) {
+                callBack();
+            }
+        }
+
+        // Sleep until the running segment may be done. streamTo() and
+        // clearStream() wake the task earlier.
+        ulTaskNotifyTake(pdTRUE, _ticksUntilStreamSegmentDone());
+    }
+}
+
+TickType_t StrokeEngine::_ticksUntilStreamSegmentDone() {
+    // Nothing to start next, wait for streamTo()
+    streamSegment next;
+    if (!_stream.peek(next)) {
+        return portMAX_DELAY;
+    }
+    if (!_streamActive || _servo->isRunning() == false) {
+        return 1;
+    }
+
+    // A reversal waits for the carriage to stop
+    TickType_t ticks = _ticksUntilStop();
+    int following = next.position - _streamRunning.position;
+    if (following * _streamDirection < 0) {
+        return ticks;
+    }
+
+    // Otherwise it is done when the time is up, at the latest. The ticks
+    // are rounded down like in _ticksUntilStop().
+    int32_t remaining = int32_t(_streamRunning.arrival - micros());
+    TickType_t arrival =
+        remaining > 0 ? TickType_t(remaining / 1000 / portTICK_PERIOD_MS) : 0;
+    if (arrival < ticks) {
+        ticks = arrival;
+    }
+
+    // Passing through the target takes no less than the distance left at
+    // the top speed. Waking early only means a shorter sleep after.
+    if (_streamRunning.endSpeed > 0) {
+        int left = (_streamRunning.position - _servo->getCurrentPosition()) *
+                   _streamDirection;
+        float topSpeed =
+            fmaxf(float(_servo->getSpeedInMilliHz()),
+                  fabsf(float(_servo->getCurrentSpeedInMilliHz()))) /
+            1000.0f;
+        TickType_t passing = 0;
+        if (left > 0 && topSpeed > 0.0f) {
+            passing = TickType_t(float(left) / topSpeed * 1000.0f /
+                                 portTICK_PERIOD_MS);
+        }
+        if (passing < ticks) {
+            ticks = passing;
+        }
+    }
+    return (ticks > 1) ? ticks : 1;
+}
+
+bool StrokeEngine::_streamSegmentDone() {
+    streamSegment next;
+    if (!_stream.peek(next)) {
+        return false;
     }
+    if (_servo->isRunning() == false) {
+        return true;
+    }
+
+    // A reversal has to wait for the carriage to stop
+    int following = next.position - _streamRunning.position;
+    if (following * _streamDirection < 0) {
+        return false;
+    }
+
+    // Time is up, carry on from wherever the carriage is
+    if (int32_t(micros() - _streamRunning.arrival) >= 0) {
+        return true;
+    }
+
+    // Passing through the target on the way to the next one
+    if (_streamRunning.endSpeed > 0) {
+        int passed = _servo->getCurrentPosition() - _streamRunning.position;
+        return passed * _streamDirection >= 0;
+    }
+    return false;
+}
+
+void StrokeEngine::_startStreamSegment(const streamSegment &segment) {
+    _streamRunning = segment;
+    _streamRunning.endSpeed = 0;
+    _streamActive = true;
+    _index++;
+
+    int position = _servo->getCurrentPosition();
+    int distance = segment.position - position;
+    if (abs(distance) <= 1) {
+        return;
+    }
+    _streamDirection = distance > 0 ? 1 : -1;
+    float time = int32_t(segment.arrival - micros()) / 1.0e6f;
+
+    // Speed along the way to the target. Moving away counts as standing still,
+    // the plan makes sure the carriage can still stop in time.
+    float speed =
+        _streamDirection * _servo->getCurrentSpeedInMilliHz() / 1000.0f;
+
+    // Plan the speed to pass the target with over the queued segments. It
+    // stays 0 unless the next segment continues this way.
+    streamSegment window[STROKE_STREAM_LOOKAHEAD_MAX];
+    size_t queued = _stream.peek(window, _streamLookahead);
+    _streamPlanner.clear();
+    _streamPlanner.add(distance, time, float(segment.endSpeed));
+    const streamSegment *previous = &segment;
+    for (size_t i = 0; i < queued; i++) {
+        _streamPlanner.add(
+            window[i].position - previous->position,
+            int32_t(window[i].arrival - previous->arrival) / 1.0e6f,
+            float(window[i].endSpeed));
+        previous = &window[i];
+    }
+    _streamPlanner.plan(speed, float(_streamMaxStepPerSecond),
+                        float(_streamMaxStepAcceleration));
+    float endSpeed = _streamPlanner.exitSpeed(0);
+
+    motionParameter motion = {segment.position, 0, 0, false, 0};
+    planSegment(motion, distance, time, speed, endSpeed,
+                _streamMaxStepPerSecond);
+    int jerk = 0;
+    uint8_t clipped =
+        limitMotion(motion, _streamMaxStepPerSecond,
+                    _streamMaxStepAcceleration, _maxStepJerk, jerk);
+
+    // FastAccelStepper stops at its target. Aim beyond by the distance it
+    // takes to brake from the end speed, so the carriage passes the real
+    // target at that speed. The next segment takes over right there. The
+    // planned speeds make sure the run ahead has room for that.
+    if (endSpeed > 0.0f) {
+        float braking = endSpeed * endSpeed / (2.0f * motion.acceleration);
+        float room = _streamPlanner.room(0);
+        motion.stroke += _streamDirection * int(fminf(braking, room));
+        _streamRunning.endSpeed = int(endSpeed);
+    }
+    _applyMotionProfile(&motion, clipped);
 }
 
-void StrokeEngine::_applyMotionProfile(motionParameter *motion) {
-    bool clipping = false;
+void StrokeEngine::_applyMotionProfile(motionParameter *motion,
+                                       uint8_t clipped) {
     float speed = 0.0;
     float position = 0.0;
 
     // Apply new trapezoidal motion profile to _servo if pattern does not skip
     if (motion->skip == false) {
-        // Constrain speed to below _maxStepPerSecond
-        if (motion->speed > _maxStepPerSecond) {
 #ifdef DEBUG_CLIPPING
+        motionParameter requested = *motion;
+#endif
+        int jerk = 0;
+        clipped |= limitMotion(*motion, _maxStepPerSecond,
+                               _maxStepAcceleration, _maxStepJerk, jerk);
+
+#ifdef DEBUG_CLIPPING
+        if (clipped & CLIP_SPEED) {
             Serial.println(
                 "Max Speed Exceeded: " +
-                String(float(motion->speed / _motor->stepsPerMillimeter), 2) +
+                String(float(requested.speed / _motor->stepsPerMillimeter),
+                       2) +
                 "mm/s --> Limit: " +
                 String(float(_maxStepPerSecond / _motor->stepsPerMillimeter),
                        2) +
                 "mm/s");
-#endif
-            motion->speed = _maxStepPerSecond;
-            clipping = true;
         }
-
-        // Constrain acceleration between 1 step/sec^2 and _maxStepAcceleration
-        if (motion->acceleration > _maxStepAcceleration) {
-#ifdef DEBUG_CLIPPING
+        if (clipped & CLIP_ACCELERATION) {
             Serial.println(
                 "Max Acceleration Exceeded: " +
-                String(float(motion->acceleration / _motor->stepsPerMillimeter),
+                String(float(requested.acceleration /
+                             _motor->stepsPerMillimeter),
                        2) +
                 "mm/s² --> Limit: " +
                 String(float(_maxStepAcceleration / _motor->stepsPerMillimeter),
                        2) +
                 "mm/s²");
-#endif
-            motion->acceleration = _maxStepAcceleration;
-            clipping = true;
         }
+        if (clipped & CLIP_JERK) {
+            Serial.println(
+                "Max Jerk Exceeded: " +
+                String(float(requested.jerk / _motor->stepsPerMillimeter), 0) +
+                "mm/s³ --> Limit: " +
+                String(float(_maxStepJerk / _motor->stepsPerMillimeter), 0) +
+                "mm/s³");
+        }
+#endif
 
         // Constrain stroke to motion envelope
         int pos = constrain((motion->stroke), _minStep, _maxStep);
 
-        // write values to _servo
-        _servo->setSpeedInHz(motion->speed);
-        _servo->setAcceleration(motion->acceleration);
-        _servo->moveTo(pos);
+        if (_vibration.active()) {
+            // The stroke is planned with the vibration on top
+            _vibration.moveTo(pos, motion->speed, motion->acceleration);
+        } else {
+            // write values to _servo
+            _servo->setSpeedInHz(motion->speed);
+            _servo->setAcceleration(motion->acceleration);
+            // FastAccelStepper keeps the previous acceleration if it rejects
+            // the new one, so shape the ramp for the one actually in use
+            _servo->setLinearAcceleration(
+                _linearAccelerationSteps(_servo->getAcceleration(), jerk));
+            _servo->moveTo(pos);
+        }
 
         // Compile speed telemetry data
         speed = float(motion->speed / _motor->stepsPerMillimeter);
@@ -821,39 +1678,76 @@ void StrokeEngine::_applyMotionProfile(motionParameter *motion) {
 #endif
 
         // Send telemetry data
-        if (_callbackTelemetry != NULL) {
-            _callbackTelemetry(position, speed, clipping);
-        }
+        _sendTelemetry(pos, motion->speed, motion->acceleration,
+                       _state == PATTERN || _state == STREAMING ? _index : -1,
+                       clipped);
     }
 }
 
-void StrokeEngine::_recalcTimeOfStroke() {
-    // Every built-in pattern produces peakStepsPerSec = 3 * stroke / T at
-    // neutral sensation. Solve for T given the desired peak as a percentage
-    // of the motor's max step rate.
-    if (_stroke <= 0 || _maxStepPerSecond <= 0 || _speedPercent <= 0.0f) {
-        _timeOfStroke = 120.0f;
-        return;
+uint32_t StrokeEngine::_linearAccelerationSteps(int acceleration, int jerk) {
+    // FastAccelStepper shapes the S-curve by the distance over which the
+    // acceleration ramps up from zero. With constant jerk j the full
+    // acceleration a is reached after a/j seconds and a³/(6j²) steps.
+    if (jerk <= 0 || acceleration <= 0) {
+        return 0;
     }
-    float desiredPeak = (_speedPercent / 100.0f) * float(_maxStepPerSecond);
-    _timeOfStroke =
-        constrain(3.0f * float(_stroke) / desiredPeak, 0.01f, 120.0f);
+    // Round up so the jerk stays below the limit. At least one step, 0
+    // would switch back to the trapezoid.
+    float a = float(acceleration);
+    float j = float(jerk);
+    float steps = ceilf(a * a * a / (6.0f * j * j));
+    return uint32_t(constrain(steps, 1.0f, 1.0e9f));
+}
+
+void StrokeEngine::_sendTelemetry(int position, int speed, int acceleration,
+                                  int index, uint8_t clipping) {
+    // Queued for the reader, so the calling task never waits on it
+    telemetryRecord record;
+    record.micros = micros();
+    record.position = float(position / _motor->stepsPerMillimeter);
+    record.speed = float(speed / _motor->stepsPerMillimeter);
+    record.acceleration = float(acceleration / _motor->stepsPerMillimeter);
+    record.index = index;
+    record.clipping = clipping;
+    _telemetry.push(record);
+}
+
+void StrokeEngine::_recalcTimeOfStroke(strokeSettings &settings) {
+    settings.timeOfStroke = timeOfStrokeForSpeed(
+        settings.stroke, settings.speedPercent, _maxStepPerSecond);
+}
+
+void StrokeEngine::_applySettings(Pattern *pattern,
+                                  const strokeSettings &settings) {
+    pattern->setTimeOfStroke(settings.timeOfStroke);
+    pattern->setStroke(settings.stroke);
+    pattern->setDepth(settings.depth);
+    pattern->setSensation(settings.sensation);
 }
 
 void StrokeEngine::_setupDepths() {
-    // set depth to _depth
-    int depth = _depth;
+    // A pending stop moves on to the latest depth once it has come to rest
+    if (_isStopping) {
+        return;
+    }
+
+    strokeSettings settings = _settings.read();
+
+    // start from the set depth
+    int depth = settings.depth;
 
     // in fancy mode we need to calculate exact position based on sensation,
     // stroke & depth
     if (_fancyAdjustment == true) {
         // map sensation into the interval [depth-stroke, depth]
-        depth = map(_sensation, -100, 100, _depth - _stroke, _depth);
+        depth = map(settings.sensation, -100, 100,
+                    settings.depth - settings.stroke, settings.depth);
 
 #ifdef DEBUG_TALKATIVE
-        Serial.println("map sensation " + String(_sensation) +
-                       " to interval [" + String(_depth - _stroke) + ", " +
-                       String(_depth) + "] = " + String(depth));
+        Serial.println("map sensation " + String(settings.sensation) +
+                       " to interval [" +
+                       String(settings.depth - settings.stroke) + ", " +
+                       String(settings.depth) + "] = " + String(depth));
 #endif
     }
 
@@ -861,12 +1755,8 @@ void StrokeEngine::_setupDepths() {
     _servo->moveTo(depth);
 
     // Send telemetry data
-    if (_callbackTelemetry != NULL) {
-        _callbackTelemetry(float(depth / _motor->stepsPerMillimeter),
-                           float(_servo->getSpeedInMilliHz() * 1000 /
-                                 _motor->stepsPerMillimeter),
-                           false);
-    }
+    _sendTelemetry(depth, _servo->getSpeedInMilliHz() / 1000,
+                   _servo->getAcceleration(), -1, CLIP_NONE);
 
 #ifdef DEBUG_TALKATIVE
     Serial.println("setup new depth: " + String(depth));
@@ -14,6 +14,14 @@
 #include <Arduino.h>
 
 #include "FastAccelStepper.h"
+#include "MotionLimits.h"
+#include "PatternCrossfade.h"
+#include "PatternPool.h"
+#include "SeqLock.h"
+#include "StreamPlanner.h"
+#include "TelemetryRing.h"
+#include "TempoLock.h"
+#include "VibrationOverlay.h"
 #include "pattern.h"
 
 // Debug Levels
@@ -23,6 +31,41 @@
 #define DEBUG_CLIPPING  // Show debug messages when motions violating the
                         // machine physics are commanded
 
+// Maximum number of pattern targets that can be prepared ahead of the running
+// move. See StrokeEngine::setLookahead().
+#ifndef STROKE_LOOKAHEAD_MAX
+#define STROKE_LOOKAHEAD_MAX 4
+#endif
+
+// Patterns that keep a history answer repeated queries for every prepared
+// index
+static_assert(KEYFRAME_HISTORY > STROKE_LOOKAHEAD_MAX + 1,
+              "KEYFRAME_HISTORY must cover the lookahead");
+static_assert(PATTERN_PROGRAM_HISTORY > STROKE_LOOKAHEAD_MAX + 1,
+              "PATTERN_PROGRAM_HISTORY must cover the lookahead");
+
+// Number of telemetry records buffered until they are read. Must be a power
+// of two. See StrokeEngine::readTelemetry().
+#ifndef STROKE_TELEMETRY_CAPACITY
+#define STROKE_TELEMETRY_CAPACITY 32
+#endif
+
+// Number of streamed segments that can be queued ahead of the running one.
+// Must be a power of two. See StrokeEngine::streamTo().
+#ifndef STROKE_STREAM_CAPACITY
+#define STROKE_STREAM_CAPACITY 32
+#endif
+
+// Length of one step queue entry while a vibration is overlaid, in µs. The
+// highest vibration frequency spans 8 entries. See
+// StrokeEngine::setVibration().
+#ifndef STROKE_VIBRATION_PERIOD_US
+#define STROKE_VIBRATION_PERIOD_US 500
+#endif
+
+// End speed letting the engine choose how to pass a streamed target
+#define STROKE_STREAM_END_SPEED_AUTO -1.0f
+
 /**************************************************************************/
 /*!
   @brief  Struct defining the physical properties of the stroking machine.
@@ -57,6 +100,9 @@ typedef struct {
     int stepPin;              /*> Pin connected to the STEP input */
     int directionPin;         /*> Pin connected to the DIR input */
     int enablePin;            /*> Pin connected to the ENA input */
+    float maxJerk;            /*> Maximum jerk in mm/s^3. Moves start and
+                               *  stop with an S-curve limited to this jerk.
+                               *  0 runs plain trapezoidal profiles. */
 } motorProperties;
 
 /**************************************************************************/
@@ -72,8 +118,63 @@ typedef struct {
     int endstopPin;  /*> Pin connected to home switch */
     uint8_t pinMode; /*> Pinmode of the switch INPUT, INPUT_PULLUP,
                         INPUT_PULLDOWN */
+    bool latchOnInterrupt; /*> Latch the position on the switch edge with a
+                            *  GPIO interrupt instead of polling the switch
+                            *  every 20 ms. Homing is as exact at any speed,
+                            *  as long as the carriage can stop within the
+                            *  keepout boundary. */
 } endstopProperties;
 
+/**************************************************************************/
+/*!
+  @brief  Struct holding the stroke settings handed from the setters to the
+  stroking task. It is published as a whole through a SeqLock, so the
+  stroking task always sees a matching set of values and a setter never
+  waits for the stroking task.
+*/
+/**************************************************************************/
+typedef struct {
+    float speedPercent;     /*> Peak motor speed in % of maxSpeed */
+    float timeOfStroke;     /*> Derived from speedPercent, stroke & max speed */
+    int depth;              /*> Depth in steps */
+    int stroke;             /*> Stroke length in steps */
+    float sensation;        /*> Sensation in [-100, 100] */
+    uint32_t applyRequests; /*> Incremented whenever a setter asks for the
+                             *  settings to take effect immediately */
+} strokeSettings;
+
+/**************************************************************************/
+/*!
+  @brief  Struct holding the telemetry of one move commanded by a pattern
+  or a manual command. Records are queued by the task issuing the move and
+  read with StrokeEngine::readTelemetry().
+*/
+/**************************************************************************/
+typedef struct {
+    uint32_t micros;    /*> micros() when the move was issued */
+    float position;     /*> Target position of the move in mm */
+    float speed;        /*> Top speed of the move in mm/s */
+    float acceleration; /*> Acceleration of the move in mm/s^2 */
+    int32_t index;      /*> Pattern index of the move. -1 for moves not
+                         *  issued by a pattern. */
+    uint8_t clipping;   /*> MotionClip flags of the limits the move was
+                         *  clipped to, CLIP_NONE if it was not */
+} telemetryRecord;
+
+/**************************************************************************/
+/*!
+  @brief  Struct holding one streamed segment: where the carriage has to be
+  at what time. Queued by StrokeEngine::streamTo() and run by the streaming
+  task in the order they were queued.
+*/
+/**************************************************************************/
+typedef struct {
+    int position;     /*> Target position in steps */
+    uint32_t arrival; /*> micros() at which the target should be reached */
+    int endSpeed;     /*> Speed to pass the target with in steps/s. 0 stops
+                       *  there, negative lets the engine choose. */
+} streamSegment;
+
 /**************************************************************************/
 /*!
   @brief  Enum containing the states of the state machine
@@ -85,9 +186,21 @@ typedef enum {
     PATTERN,     //!< Stroke Engine is running and servo is moving according to
                  //!< defined pattern.
     SETUPDEPTH,  //!< Interactive adjustment mode to setup depth and stroke
-    STREAMING    //!< Tracks the depth-position whenever depth is updated.
+    STREAMING    //!< Servo follows the segments queued by streamTo().
 } ServoState;
 
+/**************************************************************************/
+/*!
+  @brief  Enum of what StrokeEngine does once a stop has come to rest
+*/
+/**************************************************************************/
+typedef enum {
+    AFTER_STOP_NONE,        //!< Stay where the stop ended
+    AFTER_STOP_MOVE,        //!< Move to a position, see moveToMax()
+    AFTER_STOP_SETUPDEPTH,  //!< Move to the depth, see setupDepth()
+    AFTER_STOP_HOME         //!< Start the homing task, see enableAndHome()
+} afterStop;
+
 // Verbose strings of states for debugging purposes
 static String verboseState[] = {
     "[0] Servo disabled", "[1] Servo ready", "[2] Servo pattern running",
@@ -124,6 +237,8 @@ class StrokeEngine {
       automatically recomputed whenever setStroke() or setMaxSpeed() is called,
       so changing stroke length keeps the peak motor speed constant. Settings
       take effect with next stroke, or after calling applyNewSettingsNow().
+      Like setDepth(), setStroke() and setSensation() this never blocks: the
+      stroking task picks the new settings up on its next cycle.
       @param speedPercent Peak motor speed as a percentage. Constrained to
                           [0, 100].
       @param applyNow Set to true if changes should take effect immediately
@@ -200,14 +315,19 @@ class StrokeEngine {
     /**************************************************************************/
     /*!
       @brief  Choose a pattern for the StrokeEngine. Settings take effect with
-      next stroke, or after calling applyNewSettingsNow().
+      next stroke, or after calling applyNewSettingsNow(). The pattern is
+      built in preallocated storage, so switching never allocates memory.
+      While a pattern runs and applyNow is false, the old pattern is blended
+      into the new one over the strokes set with setCrossfade(). A switch
+      during a crossfade lets the new pattern take over from the previous
+      incoming one.
       @param patternIndex  Index of a pattern
       @param applyNow Set to true if changes should take effect immediately
       @return TRUE on success, FALSE, if patternIndex is invalid. Previous
                     pattern will be retained.
     */
     /**************************************************************************/
-    bool setPattern(Pattern *nextPattern, bool applyNow);
+    bool setPattern(int patternIndex, bool applyNow);
 
     /**************************************************************************/
     /*!
@@ -229,20 +349,134 @@ class StrokeEngine {
 
     /**************************************************************************/
     /*!
-      @brief  Stops the motion with MAX_ACCEL and deletes the stroking task. Is
-      in state READY afterwards.
+      @brief  Stops the motion with MAX_ACCEL and suspends the stroking task.
+      Is in state READY afterwards. Queued stream segments are discarded.
+      Returns once the servo stands still. The calling task sleeps on a task
+      notification meanwhile, so it does not take any CPU from other tasks.
     */
     /**************************************************************************/
     void stopMotion();
 
+    /**************************************************************************/
+    /*!
+      @brief  Same as stopMotion(), but returns right away. The stop runs on
+      its own and a pending move of moveToMax(), moveToMin() or setupDepth()
+      is void.
+      @param notifyTask task receiving a notification (xTaskNotifyGive())
+      once the servo stands still. Wait for it with ulTaskNotifyTake(). Only
+      the task given last is notified. NULL for no notification.
+    */
+    /**************************************************************************/
+    void stopMotionAsync(TaskHandle_t notifyTask = NULL);
+
+    /**************************************************************************/
+    /*!
+      @brief  Whether a stop is still slowing down the servo
+      @return TRUE until the servo stands still after a stop
+    */
+    /**************************************************************************/
+    bool isStopping() { return _isStopping; }
+
+    /**************************************************************************/
+    /*!
+      @brief  Creates a FreeRTOS task following the segments queued with
+      streamTo(). Only valid in state READY. State is STREAMING afterwards.
+      Segments queued before are discarded.
+      @return TRUE when streaming started, FALSE on failure.
+    */
+    /**************************************************************************/
+    bool startStreaming();
+
+    /**************************************************************************/
+    /*!
+      @brief  Queues a streamed segment. The carriage moves to the position
+      so it arrives at the given time, within the limits of the machine and
+      of setStreamLimits(). Segments run in the order they are queued. A
+      segment is started when the previous one arrived or its time is up.
+      The speed each target is passed with is planned over the queued
+      segments, see setStreamLookahead(). Reversals always wait for the
+      carriage to stop. A target that can not be reached in time is still
+      reached, as fast as the limits allow, and reported as clipped in the
+      telemetry. Later segments catch up, since their arrival times do not
+      move.
+      @param position target position in mm. Constrained to the travel.
+      @param arrival micros() at which the target should be reached
+      @param endSpeed speed in mm/s to pass the target with if the next
+      segment continues in the same direction. 0 stops at the target,
+      STROKE_STREAM_END_SPEED_AUTO lets the engine plan it from the queued
+      segments.
+      @return TRUE if the segment was queued. FALSE if not streaming or the
+      queue of STROKE_STREAM_CAPACITY segments is full.
+    */
+    /**************************************************************************/
+    bool streamTo(float position, uint32_t arrival,
+                  float endSpeed = STROKE_STREAM_END_SPEED_AUTO);
+
+    /**************************************************************************/
+    /*!
+      @brief  Discards the queued stream segments. The running segment
+      completes.
+    */
+    /**************************************************************************/
+    void clearStream();
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the number of stream segments waiting to be started
+      @return number of queued segments
+    */
+    /**************************************************************************/
+    size_t getStreamQueued() { return _stream.size(); }
+
+    /**************************************************************************/
+    /*!
+      @brief  Limits the speed and acceleration of streamed segments below
+      the machine limits, e.g. to follow a speed setting of the user.
+      @param maxSpeed maximum speed in mm/s. Constrained to the machine.
+      @param maxAcceleration maximum acceleration in mm/s². Constrained to
+      the machine.
+    */
+    /**************************************************************************/
+    void setStreamLimits(float maxSpeed, float maxAcceleration);
+
+    /**************************************************************************/
+    /*!
+      @brief  Sets how many queued segments the speeds of streamed segments
+      are planned over. Runs of segments in the same direction flow through
+      their targets, and slow down early enough to stop where the direction
+      reverses or the queue runs out. 0 stops at every target.
+      @param segments number of queued segments to look at. Constrained to
+      STROKE_STREAM_LOOKAHEAD_MAX, which is also the default.
+    */
+    /**************************************************************************/
+    void setStreamLookahead(uint8_t segments) {
+        _streamLookahead = segments < STROKE_STREAM_LOOKAHEAD_MAX
+                               ? segments
+                               : STROKE_STREAM_LOOKAHEAD_MAX;
+    }
+
+    /**************************************************************************/
+    /*!
+      @brief  Registers a function the streaming task calls each time it
+      starts a segment, so a producer that found the queue full knows when
+      streamTo() has room again. Runs on the streaming task, keep it short.
+      @param callBackStream function to call, NULL for none
+    */
+    /**************************************************************************/
+    void setStreamCallback(void (*callBackStream)()) {
+        _callBackStream = callBackStream;
+    }
+
     /**************************************************************************/
     /*!
       @brief  Enable the servo/stepper and do the homing procedure. Drives
       towards the endstop with HOMING_SPEED. Function is non-blocking and backed
-      by a task. Optionally a callback can be given to receive feedback if
-      homing succeeded going in state READY. If homing switch is not found after
-      traveling MAX_TRAVEL it times out, disables the servo and goes into
-      UNDEFINED.
+      by a task, which starts once a running motion has stopped. With
+      endstopProperties.latchOnInterrupt the position is latched on the
+      switch edge and corrected after the carriage has stopped. Optionally a
+      callback can be given to receive feedback if homing succeeded going in
+      state READY. If homing switch is not found after traveling MAX_TRAVEL
+      it times out, disables the servo and goes into UNDEFINED.
       @param endstop Pointer to a endstopProperties struct defining all relevant
                     properties like pin, pinmode, homing direction & signal
                     polarity.
@@ -272,7 +506,8 @@ class StrokeEngine {
     /*!
       @brief  In state PATTERN, SETUPDEPTH and READY this
       moves the endeffector to TRAVEL. Can be used for adjustments. Stops any
-      running pattern and ends in state READY.
+      running pattern and ends in state READY. Returns right away, the move
+      starts once the stop has come to rest.
       @param speed  Speed in mm/s used for driving to max.
                     Defaults to 10.0 mm/s
       @return TRUE on success, FALSE if state does not allow this.
@@ -284,7 +519,8 @@ class StrokeEngine {
     /*!
       @brief  In state PATTERN, SETUPDEPTH and READY this
       moves the endeffector to 0. Can be used for adjustments. Stops any running
-      pattern and ends in state READY.
+      pattern and ends in state READY. Returns right away, the move starts
+      once the stop has come to rest.
       @param speed  Speed in mm/s used for driving to min.
                     Defaults to 10.0 mm/s
       @return TRUE on success, FALSE if state does not allow this.
@@ -297,7 +533,8 @@ class StrokeEngine {
       @brief  In state PATTERN and READY this moves the endeffector
       to DEPTH and enters state SETUPDEPTH. Follows the DEPTH postion
       whenever setDepth() is called. Can be used for adjustments. Stops any
-      running pattern.
+      running pattern. Returns right away, the move starts once the stop has
+      come to rest.
       @param speed  Speed in mm/s used for driving to min.
                     Defaults to 10.0 mm/s
       @param fancy  In fancy mode sensation allows to adjust both, depth and
@@ -343,7 +580,7 @@ class StrokeEngine {
       @return The number of pattern available.
     */
     /**************************************************************************/
-    unsigned int getNumberOfPattern() { return 0; };
+    unsigned int getNumberOfPattern() { return PatternPool::count; };
 
     /**************************************************************************/
     /*!
@@ -381,17 +618,169 @@ class StrokeEngine {
 
     /**************************************************************************/
     /*!
-      @brief  Register a callback function that will update telemetry
-      information about StrokeEngine. The provided function will be called
-      whenever a motion is executed by a manual command or by a pattern. The
-      returned values are the target position of this move, its top speed and
-      wether clipping occurred.
-      @param callbackTelemetry Function must be of type:
-      void callbackTelemetry(float position, float speed, bool clipping)
+      @brief  Updates the maximum jerk of StrokeEngine. Every move then starts
+      and stops with an S-curve: the acceleration ramps up from and down to
+      zero with this jerk instead of jumping. Patterns may ask for a lower
+      jerk with motionParameter.jerk.
+      @param maxJerk maximum jerk in mm/s³. 0 runs trapezoidal profiles.
+    */
+    /**************************************************************************/
+    void setMaxJerk(float maxJerk);
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the current set maximum jerk
+      @return maximum jerk in mm/s³. 0 if trapezoidal profiles are used.
+    */
+    /**************************************************************************/
+    float getMaxJerk();
+
+    /**************************************************************************/
+    /*!
+      @brief  Overlays a vibration on the running pattern. The carriage
+      oscillates around the stroke with a sine of the given amplitude and
+      frequency. Changes fade in over 100 ms, 0 fades the vibration out.
+      While vibrating the stroking task writes the steps to the step queue
+      itself, as one moveTo() per half wave would be far too slow.
+      The vibration may use up to half the maximum speed and acceleration,
+      strokes are slowed down to what it leaves. See VibrationOverlay.
+      @param amplitude amplitude in mm, constrained to
+                       getMaxVibrationAmplitude(frequency)
+      @param frequency frequency in Hz
+    */
+    /**************************************************************************/
+    void setVibration(float amplitude, float frequency);
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the amplitude of the vibration as set
+      @return amplitude in mm, 0 if no vibration is overlaid
+    */
+    /**************************************************************************/
+    float getVibrationAmplitude();
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the frequency of the vibration as set
+      @return frequency in Hz
+    */
+    /**************************************************************************/
+    float getVibrationFrequency();
+
+    /**************************************************************************/
+    /*!
+      @brief  Largest vibration amplitude the machine can do at a frequency
+      @param frequency frequency in Hz
+      @return amplitude in mm, 0 above the highest possible frequency
+    */
+    /**************************************************************************/
+    float getMaxVibrationAmplitude(float frequency);
+
+    /**************************************************************************/
+    /*!
+      @brief  Locks the stroking to an external tempo, e.g. the beat of
+      music or a video. Each move is trimmed to take a power of two beats and
+      to end on a beat, or on a subdivision of it for moves shorter than a
+      beat, so the reversals stay on the beat however long it plays. The
+      speed setting still picks how many beats a move takes. See TempoLock.
+      Takes effect with the next move.
+      @param bpm beats per minute, 0 to let the pattern run free
+      @param beatMicros micros() at one of the beats
+    */
+    /**************************************************************************/
+    void setTempo(float bpm, uint32_t beatMicros);
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the tempo the stroking is locked to
+      @return beats per minute, 0 if the pattern runs free
+    */
+    /**************************************************************************/
+    float getTempo() { return _tempoBpm; }
+
+    /**************************************************************************/
+    /*!
+      @brief  How far off the beat the last move arrived
+      @return phase error in ms, positive if late
+    */
+    /**************************************************************************/
+    float getTempoPhaseError() { return _tempoPhaseError / 1000.0f; }
+
+    /**************************************************************************/
+    /*!
+      @brief  Reads the telemetry of the latest moves. Whenever a move is
+      executed by a manual command or by a pattern a record is queued. Queuing
+      takes constant time and never waits, so a slow reader can not hold up
+      the motion. Read from a single low priority task, often enough that the
+      queue of STROKE_TELEMETRY_CAPACITY records does not fill up. Records
+      arriving while it is full are dropped and counted.
+      @param records array receiving the records, oldest first
+      @param maxRecords size of the array
+      @return number of records read, 0 if there were none
     */
     /**************************************************************************/
-    void registerTelemetryCallback(void (*callbackTelemetry)(float, float,
-                                                             bool));
+    size_t readTelemetry(telemetryRecord *records, size_t maxRecords);
+
+    /**************************************************************************/
+    /*!
+      @brief  Number of telemetry records dropped because nobody read them
+      in time
+      @return number of dropped records
+    */
+    /**************************************************************************/
+    uint32_t getTelemetryOverflows();
+
+    /**************************************************************************/
+    /*!
+      @brief  Most telemetry records that were waiting to be read at once.
+      Getting close to STROKE_TELEMETRY_CAPACITY means the reader should run
+      more often.
+      @return highest fill level of the telemetry queue
+    */
+    /**************************************************************************/
+    uint32_t getTelemetryHighWater();
+
+    /**************************************************************************/
+    /*!
+      @brief  Sets how many pattern targets are prepared ahead of the running
+      move. With a lookahead the stroking task predicts when the running move
+      arrives and issues the next prepared target on the first tick after it,
+      instead of noticing the stop with the next 10 ms poll. Prepared targets
+      are discarded whenever a setting changes, so settings still take effect
+      with the next stroke.
+      @param depth Number of prepared targets. 0 restores plain polling.
+                   Constrained to [0, STROKE_LOOKAHEAD_MAX].
+    */
+    /**************************************************************************/
+    void setLookahead(uint8_t depth);
+
+    /**************************************************************************/
+    /*!
+      @brief  Sets over how many strokes setPattern() blends the running
+      pattern into the new one. Targets, speeds and accelerations move from
+      one pattern to the other a bit with each stroke, so the motion keeps
+      going without a jump. See PatternCrossfade.
+      @param strokes Number of blended strokes. 0 switches right away and
+                     restarts the new pattern's sequence.
+    */
+    /**************************************************************************/
+    void setCrossfade(uint8_t strokes);
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the number of strokes a pattern switch is blended over
+      @return Number of blended strokes, 0 if patterns switch right away
+    */
+    /**************************************************************************/
+    uint8_t getCrossfade() { return _crossfadeStrokes; }
+
+    /**************************************************************************/
+    /*!
+      @brief  Get the current lookahead depth
+      @return Number of pattern targets prepared ahead of the running move
+    */
+    /**************************************************************************/
+    uint8_t getLookahead() { return _lookaheadDepth; }
 
   protected:
     ServoState _state = UNDEFINED;
@@ -402,18 +791,15 @@ class StrokeEngine {
     int _maxStep;
     int _maxStepPerSecond;
     int _maxStepAcceleration;
-    Pattern *pattern = new SimpleStroke("Simple Stroke");
+    int _maxStepJerk;
+    PatternPool _patterns;
     bool _isHomed = false;
     int _index = 0;
-    int _depth;
-    int _previousDepth;
-    int _stroke;
-    int _previousStroke;
-    float _timeOfStroke;
-    float _speedPercent = 0.0f;
-    float _sensation;
-    bool _applyUpdate = false;
-    void _recalcTimeOfStroke();
+    SeqLock<strokeSettings> _settings;
+    uint32_t _settingsSequence = 0;
+    strokeSettings _appliedSettings = {};
+    void _recalcTimeOfStroke(strokeSettings &settings);
+    void _applySettings(Pattern *pattern, const strokeSettings &settings);
     static void _homingProcedureImpl(void *_this) {
         static_cast<StrokeEngine *>(_this)->_homingProcedure();
     }
@@ -426,17 +812,88 @@ class StrokeEngine {
         static_cast<StrokeEngine *>(_this)->_streaming();
     }
     void _streaming();
+    static void _stoppingImpl(void *_this) {
+        static_cast<StrokeEngine *>(_this)->_stopping();
+    }
+    void _stopping();
     TaskHandle_t _taskStrokingHandle = NULL;
     TaskHandle_t _taskHomingHandle = NULL;
     TaskHandle_t _taskStreamingHandle = NULL;
+    TaskHandle_t _taskStoppingHandle = NULL;
     SemaphoreHandle_t _patternMutex = xSemaphoreCreateMutex();
-    void _applyMotionProfile(motionParameter *motion);
+    void _applyMotionProfile(motionParameter *motion,
+                             uint8_t clipped = CLIP_NONE);
+    uint32_t _linearAccelerationSteps(int acceleration, int jerk);
     void (*_callBackHomeing)(bool) = NULL;
-    void (*_callbackTelemetry)(float, float, bool) = NULL;
+    std::atomic<void (*)()> _callBackStream{NULL};
+    TelemetryRing<telemetryRecord, STROKE_TELEMETRY_CAPACITY> _telemetry;
+    void _sendTelemetry(int position, int speed, int acceleration, int index,
+                        uint8_t clipping);
     int _homeingSpeed;
     int _homeingPin;
     int _homeingToBack;
     bool _homeingActiveLow; /*> Polarity of the homing signal*/
+    bool _homeingLatchOnInterrupt = false;
+    std::atomic<bool> _homeingLatched{false};
+    uint32_t _homeingLatchMicros = 0; /*> micros() at the switch edge */
+    int32_t _homeingLatch = 0;        /*> Position at the switch edge */
+    static StrokeEngine *_homeingEngine; /*> Owner of the endstop interrupt */
+    static void _endstopISR();
     bool _fancyAdjustment;
     void _setupDepths();
+    motionParameter _lookahead[STROKE_LOOKAHEAD_MAX];
+    uint8_t _lookaheadDepth = 0;
+    uint8_t _lookaheadHead = 0;
+    uint8_t _lookaheadCount = 0;
+    void _fillLookahead();
+    void _flushLookahead() { _lookaheadCount = 0; }
+    bool _lookaheadAllowed();
+    PatternCrossfade _crossfade;
+    uint8_t _crossfadeStrokes = 0;
+    motionParameter _nextTarget(unsigned int index);
+    void _endCrossfade();
+    TickType_t _ticksUntilArrival();
+    TickType_t _ticksUntilStop();
+    TickType_t _ticksUntilStreamSegmentDone();
+    TelemetryRing<streamSegment, STROKE_STREAM_CAPACITY> _stream;
+    std::atomic<uint32_t> _streamDiscard{0};
+    uint32_t _streamTaken = 0;
+    streamSegment _streamRunning;
+    bool _streamActive = false;
+    int _streamDirection = 1;
+    int _streamMaxStepPerSecond = 0;
+    int _streamMaxStepAcceleration = 0;
+    std::atomic<uint8_t> _streamLookahead{STROKE_STREAM_LOOKAHEAD_MAX};
+    StreamPlanner _streamPlanner;
+    bool _streamSegmentDone();
+    void _startStreamSegment(const streamSegment &segment);
+    SemaphoreHandle_t _stopMutex = xSemaphoreCreateMutex();
+    std::atomic<bool> _isStopping{false};
+    afterStop _afterStop = AFTER_STOP_NONE;
+    int _afterStopPosition = 0;
+    int _afterStopSpeed = 0;
+    TaskHandle_t _stopNotifyTask = NULL;
+    void _stop(afterStop then, int position, int speed,
+               TaskHandle_t notifyTask);
+    void _stopped();
+    VibrationOverlay _vibration;
+    std::atomic<float> _vibrationAmplitude{0.0f}; /*> Set amplitude in steps */
+    std::atomic<float> _vibrationFrequency{0.0f}; /*> Set frequency in Hz */
+    std::atomic<uint32_t> _vibrationRequests{0};
+    uint32_t _vibrationApplied = 0;
+    stepCommand _vibrationCommand;
+    bool _vibrationPending = false; /*> _vibrationCommand waits for room */
+    bool _vibrationTakeover = false; /*> Running move cut short to start */
+    motionParameter _issuedMotion = {0, 0, 0, true, 0}; /*> Running move */
+    int _issuedIndex = -1; /*> Index of _issuedMotion, -1 if none running */
+    bool _strokeArrived();
+    bool _feedVibration();
+    void _stopVibration();
+    TempoLock _tempo;
+    std::atomic<float> _tempoBpm{0.0f};
+    std::atomic<uint32_t> _tempoBeat{0}; /*> micros() at a beat */
+    std::atomic<uint32_t> _tempoRequests{0};
+    uint32_t _tempoApplied = 0;
+    std::atomic<int32_t> _tempoPhaseError{0}; /*> µs, of the last arrival */
+    void _lockToTempo(motionParameter &motion, bool replan);
 };
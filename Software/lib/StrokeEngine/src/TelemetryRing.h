@@ -0,0 +1,46 @@
+/**
+ *   Telemetry Ring of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ring_buffer.h"
+
+/**************************************************************************/
+/*!
+  @brief  Fixed size ring buffer handing records from the motion tasks to
+  one slower consumer. A write takes constant time and never waits for the
+  reader: when the ring is full the new record is dropped and counted. The
+  reader drains the ring in batches whenever it gets around to it.
+
+  StrokeEngine queues its telemetry and the streamed segments this way.
+  Mostly the stroking task writes the telemetry, but stopMotion(),
+  moveToMax() and the homing task write from their own tasks. This is the
+  multi-producer ring_buffer::Ring that carries the stream targets, fixed to
+  drop the newest record when full.
+  Reads must come from one task.
+
+  T must be trivially copyable. Capacity must be a power of two.
+*/
+/**************************************************************************/
+template <class T, size_t Capacity>
+class TelemetryRing : public ring_buffer::Ring<T, Capacity> {
+  public:
+    TelemetryRing() : ring_buffer::Ring<T, Capacity>(
+                          ring_buffer::Overflow::DropNewest) {}
+
+    //! Number of records dropped because the ring was full
+    uint32_t dropped() const { return this->overflows(); }
+
+  private:
+    // The policy is fixed, a dropped record is the only kind of overflow
+    using ring_buffer::Ring<T, Capacity>::setOverflow;
+};
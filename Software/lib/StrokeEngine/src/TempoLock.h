@@ -0,0 +1,228 @@
+/**
+ *   Tempo Lock of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+#include "pattern.h"
+
+// Share of the phase error of an arrival the loop filter takes over into
+// the next moves. Higher locks faster, lower rides out jitter better.
+#ifndef TEMPO_LOCK_GAIN
+#define TEMPO_LOCK_GAIN 0.3f
+#endif
+
+/**************************************************************************/
+/*!
+  @brief  Phase-locked loop that trims each move of a pattern so the
+  reversals land on the beats of an external tempo.
+
+  The pattern keeps choosing targets, speeds and accelerations. When a move
+  starts, plan() rounds its time to a power of two beats (1/8 to 16) and
+  picks the beat or, for moves shorter than a beat, the subdivision closest
+  to where it would end. fit() then stretches or squeezes the move's speed
+  and acceleration so it takes exactly the time to that point. Rounding to
+  whole subdivisions acts as the proportional part of the loop: a late
+  arrival makes the next move shorter.
+
+  What the trimming can't predict, e.g. the time to notice an arrival or
+  the jerk of S-curves, shows up as the phase error measured by arrived().
+  The loop filter integrates it into the lateness that later moves start
+  early by. Moves that could not be fit within the machine limits don't
+  count, so the filter does not wind up while the machine can't keep up.
+
+  Times are micros() timestamps. They may wrap around, they are extended
+  to 64 bit internally. Not thread safe, StrokeEngine only uses it from the
+  stroking task.
+*/
+/**************************************************************************/
+class TempoLock {
+  public:
+    //! Sets the tempo and the time of one of its beats
+    /*!
+      @param bpm beats per minute, 0 to let the pattern run free
+      @param beatMicros micros() at a beat, up to half an hour in the past
+    */
+    void setTempo(float bpm, uint32_t beatMicros) {
+        if (!(bpm > 0.0f)) {
+            _period = 0.0;
+            _planned = false;
+            return;
+        }
+        _bpm = bpm;
+        _period = 60.0e6 / double(bpm);
+        _beat = _extend(beatMicros);
+    }
+
+    //! True while locked to a tempo
+    bool active() const { return _period > 0.0; }
+
+    //! Beats per minute, 0 if not locked
+    float bpm() const { return active() ? _bpm : 0.0f; }
+
+    //! Picks the beat a move that starts now ends on
+    /*!
+      @param now micros() at the start of the move
+      @param time time the pattern planned for the move in seconds
+      @return time the move must take in seconds
+    */
+    float plan(uint32_t now, float time) {
+        int64_t start = _extend(now);
+        double beats = double(time) * 1.0e6 / _period;
+        double share = beats > 0.0 ? exp2(round(log2(beats))) : 0.0;
+        share = share < 0.125 ? 0.125 : share > 16.0 ? 16.0 : share;
+
+        // Moves of a beat or more end on a beat, shorter ones on a
+        // subdivision of the beat
+        double grid = _period * (share < 1.0 ? share : 1.0);
+        double end = double(start - _beat) + share * _period;
+        _target = _beat + int64_t(llround(round(end / grid) * grid));
+        _grid = grid;
+        _planned = true;
+        _saturated = false;
+        return _secondsLeft(start);
+    }
+
+    //! Time left until the beat of the running move, for a move that is
+    //! changed on its way
+    /*!
+      @param now micros()
+      @return time in seconds, 0 if no move was planned
+    */
+    float remaining(uint32_t now) {
+        return _planned ? _secondsLeft(_extend(now)) : 0.0f;
+    }
+
+    //! Time until the running move should arrive
+    /*!
+      @param now micros()
+      @return µs until the expected arrival, 0 if overdue or not planned
+    */
+    uint32_t microsUntilArrival(uint32_t now) {
+        if (!_planned) {
+            return 0;
+        }
+        double left = double(_target - _extend(now)) - _lateness;
+        return left > 0.0 ? uint32_t(left) : 0;
+    }
+
+    //! Reshapes a move to take the planned time
+    /*!
+      The move keeps the proportions of its trapezoid, speed scales with
+      1/t and acceleration with 1/t². Speed and acceleration beyond the
+      limits are cut, the move then arrives late.
+      @param motion move to reshape, speed and acceleration change in place
+      @param distance distance of the move in steps
+      @param time time from plan() or remaining()
+      @param maxSpeed speed limit of the machine in steps/s
+      @param maxAcceleration acceleration limit of the machine in steps/s²
+      @return false if the limits made it late
+    */
+    bool fit(motionParameter &motion, int distance, float time, int maxSpeed,
+             int maxAcceleration) {
+        float speed = float(motion.speed < maxSpeed ? motion.speed : maxSpeed);
+        float acceleration =
+            float(motion.acceleration < maxAcceleration ? motion.acceleration
+                                                        : maxAcceleration);
+        float planned = moveTime(distance, speed, acceleration);
+        if (planned <= 0.0f || time <= 0.0f) {
+            // Nothing to time, e.g. the carriage is already there
+            _saturated = true;
+            return true;
+        }
+
+        float k = planned / time;
+        float highest = fminf(float(maxSpeed) / speed,
+                              sqrtf(float(maxAcceleration) / acceleration));
+        if (k > highest) {
+            k = highest;
+            _saturated = true;
+        }
+        motion.speed = int(speed * k);
+        motion.acceleration = int(acceleration * k * k);
+        if (motion.speed < 1) motion.speed = 1;
+        if (motion.acceleration < 1) motion.acceleration = 1;
+        return !_saturated;
+    }
+
+    //! Forgets the running move, e.g. when the pattern stops
+    void cancel() { _planned = false; }
+
+    //! Measures the phase error of the move that just arrived
+    /*!
+      @param now micros() when the arrival was noticed
+    */
+    void arrived(uint32_t now) {
+        if (!_planned) {
+            return;
+        }
+        _planned = false;
+        _error = int32_t(_extend(now) - _target);
+        if (_saturated) {
+            return;
+        }
+        _lateness += TEMPO_LOCK_GAIN * double(_error);
+        double bound = 0.25 * _grid;
+        _lateness = _lateness > bound ? bound : _lateness < -bound ? -bound
+                                                                   : _lateness;
+    }
+
+    //! Phase error of the last arrival in µs, positive if it was late
+    int32_t phaseError() const { return _error; }
+
+    //! True while a move planned with plan() is on its way
+    bool planned() const { return _planned; }
+
+    //! Time of a trapezoidal move from standstill to standstill
+    /*!
+      @param distance distance in steps
+      @param speed top speed in steps/s
+      @param acceleration acceleration in steps/s²
+      @return time in seconds, 0 if there is nothing to move
+    */
+    static float moveTime(int distance, float speed, float acceleration) {
+        float d = fabsf(float(distance));
+        if (d == 0.0f || speed <= 0.0f || acceleration <= 0.0f) {
+            return 0.0f;
+        }
+        // Triangle if the move is too short to reach full speed
+        if (d <= speed * speed / acceleration) {
+            return 2.0f * sqrtf(d / acceleration);
+        }
+        return d / speed + speed / acceleration;
+    }
+
+  protected:
+    float _bpm = 0.0f;
+    double _period = 0.0; /*> µs per beat, 0 if not locked */
+    int64_t _beat = 0;    /*> Extended time of a beat */
+    int64_t _target = 0;  /*> Extended time the running move should end */
+    double _grid = 0.0;   /*> Grid the running move ends on in µs */
+    double _lateness = 0.0; /*> µs arrivals come late, from the filter */
+    int32_t _error = 0;
+    bool _planned = false;
+    bool _saturated = false;
+    uint32_t _last = 0;
+    int64_t _clock = 0;
+
+    // Extends micros() to 64 bit. Times up to half a wrap in the past work
+    // as well, for the beat that was given.
+    int64_t _extend(uint32_t micros) {
+        _clock += int32_t(micros - _last);
+        _last = micros;
+        return _clock;
+    }
+
+    float _secondsLeft(int64_t now) const {
+        double left = double(_target - now) - _lateness;
+        return left > 1000.0 ? float(left * 1.0e-6) : 0.001f;
+    }
+};
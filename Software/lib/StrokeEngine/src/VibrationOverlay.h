@@ -0,0 +1,313 @@
+/**
+ *   Vibration Overlay of the StrokeEngine
+ *   A library to create a variety of stroking motions with a stepper or servo
+ * motor on an ESP32. https://github.com/theelims/StrokeEngine
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+/**************************************************************************/
+/*!
+  @brief  One entry of the stepper's step queue, laid out like
+  FastAccelStepper's stepper_command_s: steps pulses ticks apart, or a pause
+  of ticks if steps is 0.
+*/
+/**************************************************************************/
+typedef struct {
+    uint16_t ticks; /*> Ticks between two steps, or length of the pause */
+    uint8_t steps;  /*> Number of steps, 0 for a pause */
+    bool countUp;   /*> Direction of the steps */
+} stepCommand;
+
+/**************************************************************************/
+/*!
+  @brief  Superimposes a sine vibration on the stroke and turns both into
+  step queue entries of a fixed period.
+
+  A reversal every few milliseconds is far too often for one moveTo() per
+  half wave. While the overlay runs it therefore plans the whole motion
+  itself: the stroke follows its targets with a trapezoidal profile, the
+  vibration adds A sin(phase) on top, and every period the sum is rounded to
+  whole steps and spread evenly over the period.
+
+  The vibration may use half the machine's speed and acceleration. Strokes
+  get what the vibration leaves, so together they never exceed the limits.
+  This gives the envelope
+
+      A(f) = min(vmax / 2w, amax / 2w²),  w = 2 pi f,
+
+  up to maxFrequency(), where a period of the sine spans 8 queue entries.
+  Amplitude and frequency changes fade in over 100 ms. A lower amplitude at
+  a higher frequency first fades the amplitude, then switches the
+  frequency, so the envelope holds throughout.
+
+  Positions and limits are in steps, steps/s and steps/s². Not thread safe,
+  StrokeEngine only uses it from the stroking task.
+*/
+/**************************************************************************/
+class VibrationOverlay {
+  public:
+    //! Sets the timing of the queue entries and the machine limits
+    /*!
+      @param ticksPerSecond tick rate of the step queue
+      @param periodMicros length of one queue entry in µs
+      @param maxSpeed maximum speed of the machine
+      @param maxAcceleration maximum acceleration of the machine
+      @param minStep lowest position the carriage may reach
+      @param maxStep highest position the carriage may reach
+    */
+    void begin(uint32_t ticksPerSecond, uint32_t periodMicros, float maxSpeed,
+               float maxAcceleration, int minStep, int maxStep) {
+        _periodTicks = uint32_t(uint64_t(ticksPerSecond) * periodMicros /
+                                1000000UL);
+        _periodMicros = periodMicros;
+        _period = float(periodMicros) * 1.0e-6f;
+        _minStep = minStep;
+        _maxStep = maxStep;
+        setLimits(maxSpeed, maxAcceleration);
+    }
+
+    //! Updates the machine limits. Takes effect with the next period.
+    void setLimits(float maxSpeed, float maxAcceleration) {
+        _maxSpeed = maxSpeed;
+        _maxAcceleration = maxAcceleration;
+        setVibration(_setAmplitude, _setFrequency);
+    }
+
+    //! Takes over a carriage standing still at position
+    void start(int position) {
+        _base = float(position);
+        _target = position;
+        _velocity = 0.0f;
+        _emitted = position;
+        _carry = 0;
+        _amplitude = 0.0f;
+        _phase = 0.0f;
+        _frequency = _setFrequency;
+        _resting = false;
+        _active = true;
+    }
+
+    //! Hands the carriage back. Only call once atRest().
+    void end() { _active = false; }
+
+    //! True between start() and end()
+    bool active() const { return _active; }
+
+    //! Sets the vibration to fade to
+    /*!
+      @param amplitude amplitude in steps, constrained to the envelope
+      @param frequency frequency in Hz
+    */
+    void setVibration(float amplitude, float frequency) {
+        frequency = fminf(fmaxf(frequency, 0.0f), maxFrequency());
+        amplitude = fminf(fmaxf(amplitude, 0.0f), maxAmplitude(frequency));
+        if (frequency <= 0.0f) amplitude = 0.0f;
+        _setFrequency = frequency;
+        _setAmplitude = amplitude;
+        _fadeStep = fmaxf(fabsf(amplitude - _amplitude), 1.0f) * _period /
+                    kFadeSeconds;
+        _resting = false;
+    }
+
+    //! Amplitude being faded to
+    float amplitude() const { return _setAmplitude; }
+
+    //! Frequency being faded to
+    float frequency() const { return _setFrequency; }
+
+    //! Highest frequency with at least 8 queue entries per period of the
+    //! sine
+    float maxFrequency() const {
+        return _periodMicros > 0 ? 1.0e6f / float(8 * _periodMicros) : 0.0f;
+    }
+
+    //! Largest amplitude the vibration may use at the given frequency
+    float maxAmplitude(float frequency) const {
+        if (frequency <= 0.0f || frequency > maxFrequency()) {
+            return 0.0f;
+        }
+        float w = 2.0f * float(M_PI) * frequency;
+        return fminf(0.5f * _maxSpeed / w, 0.5f * _maxAcceleration / (w * w));
+    }
+
+    //! Starts a stroke to target, replacing the one under way
+    /*!
+      @param target target position
+      @param speed top speed of the stroke
+      @param acceleration acceleration of the stroke
+    */
+    void moveTo(int target, float speed, float acceleration) {
+        _target = target < _minStep ? _minStep
+                  : target > _maxStep ? _maxStep
+                                      : target;
+        _speed = speed;
+        _acceleration = acceleration;
+        _resting = false;
+    }
+
+    //! Target of the running stroke
+    int target() const { return _target; }
+
+    //! True until the stroke has arrived at its target
+    bool moving() const {
+        return _velocity != 0.0f || _base != float(_target);
+    }
+
+    //! Fades out the vibration and brakes the stroke as hard as allowed
+    void stop() {
+        setVibration(0.0f, _setFrequency);
+        float braking = _velocity * _velocity / (2.0f * _strokeAcceleration());
+        moveTo(int(lroundf(_base + copysignf(braking, _velocity))),
+               fabsf(_velocity), _maxAcceleration);
+    }
+
+    //! True once the stroke arrived, the vibration faded out and a full
+    //! period went by without a step
+    bool atRest() const { return _resting; }
+
+    //! Plans the next period
+    /*!
+      @return queue entry carrying the carriage through the period
+    */
+    stepCommand next() {
+        _advanceStroke();
+        _advanceVibration();
+
+        float position = _base + _amplitude * sinf(_phase);
+        position = fminf(fmaxf(position, float(_minStep)), float(_maxStep));
+        int32_t steps = int32_t(lroundf(position)) - _emitted;
+
+        stepCommand command;
+        if (steps == 0) {
+            command.ticks = uint16_t(_periodTicks + _carry);
+            command.steps = 0;
+            command.countUp = true;
+            _carry = 0;
+            _resting = !moving() && _setAmplitude == 0.0f &&
+                       _amplitude == 0.0f;
+            return command;
+        }
+
+        // Spread the steps evenly over the period. What does not divide
+        // evenly is carried over, so the queue keeps the exact time.
+        uint32_t count = uint32_t(steps < 0 ? -steps : steps);
+        if (count > 255) count = 255;
+        uint32_t ticks = _periodTicks + _carry;
+        command.ticks = uint16_t(ticks / count);
+        command.steps = uint8_t(count);
+        command.countUp = steps > 0;
+        _carry = ticks - command.ticks * count;
+        _emitted += command.countUp ? int32_t(count) : -int32_t(count);
+        _resting = false;
+        return command;
+    }
+
+  private:
+    static constexpr float kFadeSeconds = 0.1f;
+
+    // What the vibration uses of the limits at most, fading included
+    float _vibrationSpeed() const {
+        float w = 2.0f * float(M_PI) * fmaxf(_frequency, _setFrequency);
+        return fmaxf(_amplitude, _setAmplitude) * w;
+    }
+    float _vibrationAcceleration() const {
+        float w = 2.0f * float(M_PI) * fmaxf(_frequency, _setFrequency);
+        return fmaxf(_amplitude, _setAmplitude) * w * w;
+    }
+
+    // The stroke gets what the vibration leaves
+    float _strokeSpeed() const {
+        return fmaxf(fminf(_speed, _maxSpeed - _vibrationSpeed()), 1.0f);
+    }
+    float _strokeAcceleration() const {
+        return fmaxf(fminf(_acceleration,
+                           _maxAcceleration - _vibrationAcceleration()),
+                     1.0f);
+    }
+
+    void _advanceStroke() {
+        float distance = float(_target) - _base;
+        if (distance == 0.0f && _velocity == 0.0f) {
+            return;
+        }
+
+        // Speed up to the top speed, or brake just in time for the target
+        float acceleration = _strokeAcceleration();
+        float allowed = fminf(_strokeSpeed(),
+                              sqrtf(2.0f * acceleration * fabsf(distance)));
+        allowed = copysignf(allowed, distance);
+        float change = allowed - _velocity;
+        float limit = acceleration * _period;
+        change = fminf(fmaxf(change, -limit), limit);
+
+        float velocity = _velocity + change;
+        float travel = 0.5f * (_velocity + velocity) * _period;
+        if (travel * distance > 0.0f && fabsf(travel) >= fabsf(distance)) {
+            // Arrives within this period
+            _base = float(_target);
+            _velocity = 0.0f;
+            return;
+        }
+        _base += travel;
+        _velocity = velocity;
+    }
+
+    void _advanceVibration() {
+        // A lower envelope is only entered once the amplitude fits it
+        if (_frequency != _setFrequency &&
+            _amplitude <= maxAmplitude(_setFrequency)) {
+            _frequency = _setFrequency;
+        }
+        float target = fminf(_setAmplitude, maxAmplitude(_frequency));
+        if (_frequency != _setFrequency) {
+            target = fminf(target, maxAmplitude(_setFrequency));
+        }
+        if (_amplitude < target) {
+            _amplitude = fminf(_amplitude + _fadeStep, target);
+        } else if (_amplitude > target) {
+            _amplitude = fmaxf(_amplitude - _fadeStep, target);
+        }
+
+        // Keep the phase running so a new frequency continues smoothly
+        _phase += 2.0f * float(M_PI) * _frequency * _period;
+        if (_phase >= 2.0f * float(M_PI)) {
+            _phase -= 2.0f * float(M_PI);
+        }
+    }
+
+    bool _active = false;
+    bool _resting = false;
+    uint32_t _periodTicks = 0;
+    uint32_t _periodMicros = 0;
+    float _period = 0.0f;
+    int _minStep = 0;
+    int _maxStep = 0;
+    float _maxSpeed = 0.0f;
+    float _maxAcceleration = 0.0f;
+
+    // Stroke
+    float _base = 0.0f;
+    float _velocity = 0.0f;
+    int _target = 0;
+    float _speed = 0.0f;
+    float _acceleration = 0.0f;
+
+    // Vibration
+    float _setAmplitude = 0.0f;
+    float _setFrequency = 0.0f;
+    float _amplitude = 0.0f;
+    float _frequency = 0.0f;
+    float _fadeStep = 0.0f;
+    float _phase = 0.0f;
+
+    // Steps handed to the queue so far and ticks left over
+    int32_t _emitted = 0;
+    uint32_t _carry = 0;
+};
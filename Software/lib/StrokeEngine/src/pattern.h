@@ -16,7 +16,7 @@
 
 #include "PatternMath.h"
 
-#define DEBUG_PATTERN  // Print some debug informations over Serial
+// #define DEBUG_PATTERN  // Print some debug informations over Serial
 
 #ifndef STRING_LEN
 #define STRING_LEN \
@@ -27,7 +27,7 @@
 /**************************************************************************/
 /*!
   @brief  struct to return all parameters FastAccelStepper needs to calculate
-  the trapezoidal profile.
+  the trapezoidal profile, or the jerk-limited S-curve if a jerk is given.
 */
 /**************************************************************************/
 typedef struct {
@@ -37,8 +37,18 @@ typedef struct {
     int acceleration;  //!< Acceleration to get to speed or halt
     bool skip;  //!< no valid stroke, skip this set an query for the next -->
                 //!< allows pauses between strokes
+    int jerk;   //!< Jerk limit of the move in Steps/second^3. 0 uses the
+                //!< machine limit.
 } motionParameter;
 
+/**************************************************************************/
+/*!
+  @brief  Time source of the patterns in milliseconds. Only differences of
+  its values are used, so it may wrap around at 2^32 like millis() does.
+*/
+/**************************************************************************/
+typedef unsigned long (*patternClock)();
+
 /**************************************************************************/
 /*!
   @class Pattern
@@ -106,21 +116,49 @@ class Pattern {
         return _nextMove;
     }
 
+    //! Sets the time source of all patterns. millis() is used unless a
+    //! simulation installs its own clock, e.g. to run hours of patterns on
+    //! the host in an instant.
+    /*!
+      @param clock function returning the time in ms, NULL restores millis()
+    */
+    static void setClock(patternClock clock) {
+        _clock = (clock != NULL) ? clock : millis;
+    }
+
+    //! Gives a pattern time for slow work like reading ahead from flash.
+    //! Called by the stroking task while a move is running, never between
+    //! a move arriving and the next one being issued.
+    virtual void prefetch() {}
+
+    //! Whether StrokeEngine may ask for the targets of the following
+    //! strokes while a move is still running. A pattern whose targets
+    //! depend on when they are asked for, like a pause that starts with the
+    //! query, answers false and is only asked once the carriage arrived.
+    virtual bool lookahead() const { return true; }
+
     //! Communicates the maximum possible speed and acceleration limits of the
-    //! machine to a pattern.
+    //! machine to a pattern. The built-in patterns plan their moves within
+    //! these limits: a move the machine cannot make in time is slowed down
+    //! together with the rest of the stroke, so the timing between in and out
+    //! keeps its proportions instead of StrokeEngine clipping single moves.
     /*!
       @param maxSpeed maximum speed which is possible. Higher speeds get
       truncated inside StrokeEngine anyway.
       @param maxAcceleration maximum possible acceleration. Get also truncated,
       if impossible.
       @param stepsPerMM
+      @param maxJerk maximum jerk of the machine. 0 if the machine runs
+      trapezoidal profiles.
     */
     virtual void setSpeedLimit(unsigned int maxSpeed,
                                unsigned int maxAcceleration,
-                               unsigned int stepsPerMM) {
+                               unsigned int stepsPerMM,
+                               unsigned int maxJerk = 0) {
         _maxSpeed = maxSpeed;
         _maxAcceleration = maxAcceleration;
         _stepsPerMM = stepsPerMM;
+        _maxJerk = maxJerk;
     }
 
   protected:
@@ -130,34 +168,132 @@ class Pattern {
     float _sensation = 0.0;
     int _index = -1;
     char _name[STRING_LEN];
-    motionParameter _nextMove = {0, 0, 0, false};
-    int _startDelayMillis = 0;
-    int _delayInMillis = 0;
+    motionParameter _nextMove = {0, 0, 0, false, 0};
+    uint32_t _startDelayMillis = 0;
+    uint32_t _delayInMillis = 0;
+    bool _delayStarted = false;
     unsigned int _maxSpeed = 0;
     unsigned int _maxAcceleration = 0;
+    unsigned int _maxJerk = 0;
     unsigned int _stepsPerMM = 0;
 
+    /*!
+      @brief Current time of the pattern clock, see setClock()
+      @return Time in milliseconds, wrapping around at 2^32
+    */
+    static uint32_t _millis() { return uint32_t(_clock()); }
+
     /*!
       @brief Start a delay timer which can be polled by calling
-      _isStillDelayed(). Uses internally the millis()-function.
+      _isStillDelayed(). Uses the pattern clock.
     */
-    void _startDelay() { _startDelayMillis = millis(); }
+    void _startDelay() {
+        _startDelayMillis = _millis();
+        _delayStarted = true;
+    }
 
     /*!
       @brief Update a delay timer which can be polled by calling
-      _isStillDelayed(). Uses internally the millis()-function.
+      _isStillDelayed().
       @param delayInMillis delay in milliseconds
     */
-    void _updateDelay(int delayInMillis) { _delayInMillis = delayInMillis; }
+    void _updateDelay(int delayInMillis) {
+        _delayInMillis = (delayInMillis > 0) ? delayInMillis : 0;
+    }
 
     /*!
       @brief Poll the state of a internal timer to create pauses between
-      strokes. Uses internally the millis()-function.
-      @return True, if the timer is running, false if it is expired.
+      strokes. Uses the pattern clock and keeps working when it wraps around.
+      @return True, if the timer is running, false if it is expired or was
+      never started.
     */
     bool _isStillDelayed() {
-        return (millis() > (_startDelayMillis + _delayInMillis)) ? false : true;
+        return _delayStarted &&
+               uint32_t(_millis() - _startDelayMillis) <= _delayInMillis;
+    }
+
+    /*!
+      @brief Shortest time a move can take within the limits given by
+      setSpeedLimit()
+      @param distance length of the move in steps
+      @return Time in seconds, 0 if the limits are unknown
+    */
+    float _minimumMoveTime(int distance) {
+        if (_maxSpeed == 0 || _maxAcceleration == 0) {
+            return 0.0f;
+        }
+        float d = fabsf(float(distance));
+        float v = float(_maxSpeed);
+        float a = float(_maxAcceleration);
+        // Triangle if the move is too short to reach full speed
+        if (d <= v * v / a) {
+            return 2.0f * sqrtf(d / a);
+        }
+        return d / v + v / a;
     }
+
+    /*!
+      @brief Factor to stretch the timing of a pattern with, so that a move
+      fits the limits given by setSpeedLimit(). Applying it to all moves of
+      a stroke keeps their proportions.
+      @param distance length of the move in steps
+      @param time time the pattern has planned for the move in seconds
+      @return 1 if the move fits in time, more than 1 if it needs longer
+    */
+    float _timeScale(int distance, float time) {
+        float minimum = _minimumMoveTime(distance);
+        return (time > 0.0f && minimum > time) ? minimum / time : 1.0f;
+    }
+
+    /*!
+      @brief Reshapes a trapezoidal move that exceeds the limits given by
+      setSpeedLimit() so it still takes the planned time. The ramps get
+      longer or shorter as little as needed. A move that fits is left
+      untouched.
+      @param move move with the speed and acceleration the pattern asks for
+      @param distance length of the move in steps
+      @param time time planned for the move in seconds, see _timeScale()
+    */
+    void _fitMove(motionParameter &move, int distance, float time) {
+        if (_maxSpeed == 0 || _maxAcceleration == 0 ||
+            (move.speed <= int(_maxSpeed) &&
+             move.acceleration <= int(_maxAcceleration))) {
+            return;
+        }
+        float d = fabsf(float(distance));
+        if (d == 0.0f || time <= 0.0f || move.speed <= 0 ||
+            move.acceleration <= 0) {
+            // Nothing to shape, stay within the limits
+            if (move.speed > int(_maxSpeed)) {
+                move.speed = _maxSpeed;
+            }
+            if (move.acceleration > int(_maxAcceleration)) {
+                move.acceleration = _maxAcceleration;
+            }
+            return;
+        }
+        // Each ramp takes the share x of the time:
+        // speed = d / ((1 - x) * time), acceleration = speed / (x * time)
+        float x = float(move.speed) / (float(move.acceleration) * time);
+        // The speed limit caps x, the acceleration limit needs
+        // x * (1 - x) >= d / (maxAcceleration * time^2)
+        float xHigh = fminf(0.5f, 1.0f - d / (float(_maxSpeed) * time));
+        float root =
+            fmaxf(0.0f, 1.0f - 4.0f * d / (float(_maxAcceleration) * time *
+                                           time));
+        float xLow = 0.5f * (1.0f - sqrtf(root));
+        x = fmaxf(xLow, fminf(x, xHigh));
+        if (x <= 0.0f) {
+            return;
+        }
+        float speed = d / ((1.0f - x) * time);
+        float acceleration = speed / (x * time);
+        move.speed = int(fminf(speed, float(_maxSpeed)));
+        move.acceleration = int(fminf(acceleration, float(_maxAcceleration)));
+    }
+
+  private:
+    static inline patternClock _clock = millis;
 };
 
 /**************************************************************************/
@@ -177,11 +313,15 @@ class SimpleStroke : public Pattern {
     }
 
     motionParameter nextTarget(unsigned int index) {
+        // slower if the machine can't make it
+        float time = _timeOfStroke * _timeScale(_stroke, _timeOfStroke);
+
         // maximum speed of the trapezoidal motion
-        _nextMove.speed = int(1.5 * _stroke / _timeOfStroke);
+        _nextMove.speed = int(1.5 * _stroke / time);
 
         // acceleration to meet the profile
-        _nextMove.acceleration = int(3.0 * _nextMove.speed / _timeOfStroke);
+        _nextMove.acceleration = int(3.0 * _nextMove.speed / time);
+        _fitMove(_nextMove, _stroke, time);
 
         // odd stroke is moving out
         if (index % 2) {
@@ -218,23 +358,33 @@ class TeasingPounding : public Pattern {
         _updateStrokeTiming();
     }
     motionParameter nextTarget(unsigned int index) {
+        // If the faster move is out of reach both slow down alike, so the
+        // ratio between in and out stays. The faster one then takes the
+        // shortest time the machine makes, the slower one keeps its share.
+        float fastest = fminf(_timeOfInStroke, _timeOfOutStroke);
+        float scale = _timeScale(_stroke, fastest);
+
         // odd stroke is moving out
         if (index % 2) {
+            float time = _timeOfOutStroke * scale;
+
             // maximum speed of the trapezoidal motion
-            _nextMove.speed = int(1.5 * _stroke / _timeOfOutStroke);
+            _nextMove.speed = int(1.5 * _stroke / time);
 
             // acceleration to meet the profile
-            _nextMove.acceleration =
-                int(3.0 * float(_nextMove.speed) / _timeOfOutStroke);
+            _nextMove.acceleration = int(3.0 * float(_nextMove.speed) / time);
+            _fitMove(_nextMove, _stroke, time);
             _nextMove.stroke = _depth - _stroke;
             // even stroke is moving in
         } else {
+            float time = _timeOfInStroke * scale;
+
             // maximum speed of the trapezoidal motion
-            _nextMove.speed = int(1.5 * _stroke / _timeOfInStroke);
+            _nextMove.speed = int(1.5 * _stroke / time);
 
             // acceleration to meet the profile
-            _nextMove.acceleration =
-                int(3.0 * float(_nextMove.speed) / _timeOfInStroke);
+            _nextMove.acceleration = int(3.0 * float(_nextMove.speed) / time);
+            _fitMove(_nextMove, _stroke, time);
             _nextMove.stroke = _depth;
         }
         _index = index;
@@ -298,12 +448,16 @@ class RoboStroke : public Pattern {
     }
 
     motionParameter nextTarget(unsigned int index) {
+        // slower if the machine can't make it
+        float time = _timeOfStroke * _timeScale(_stroke, _timeOfStroke);
+
         // maximum speed of the trapezoidal motion
-        float speed = float(_stroke) / ((1 - _x) * _timeOfStroke);
+        float speed = float(_stroke) / ((1 - _x) * time);
         _nextMove.speed = int(speed);
 
         // acceleration to meet the profile
-        _nextMove.acceleration = int(speed / (_x * _timeOfStroke));
+        _nextMove.acceleration = int(speed / (_x * time));
+        _fitMove(_nextMove, _stroke, time);
 
         // odd stroke is moving out
         if (index % 2) {
@@ -344,39 +498,45 @@ class HalfnHalf : public Pattern {
         _updateStrokeTiming();
     }
     motionParameter nextTarget(unsigned int index) {
-        // check if this is the very first
-        if (index == 0) {
-            // pattern started for the very fist time, so we start gentle with a
-            // half move
-            _half = true;
-        }
+        // Starts gentle with a half stroke, then every second in and out is
+        // half. Taken from the index alone, so asking for a stroke again
+        // gives the same move.
+        bool half = (index / 2) % 2 == 0;
 
         // set-up the stroke length
         int stroke = _stroke;
-        if (_half == true) {
+        if (half == true) {
             // half the stroke length
             stroke = _stroke / 2;
         }
 
+        // If the faster move of this in and out is out of reach both slow
+        // down alike, so the ratio between them stays. Half strokes are
+        // scaled for their own length and mostly keep their time.
+        float fastest = fminf(_timeOfInStroke, _timeOfOutStroke);
+        float scale = _timeScale(stroke, fastest);
+
         // odd stroke is moving out
         if (index % 2) {
+            float time = _timeOfOutStroke * scale;
+
             // maximum speed of the trapezoidal motion
-            _nextMove.speed = int(1.5 * stroke / _timeOfOutStroke);
+            _nextMove.speed = int(1.5 * stroke / time);
 
             // acceleration to meet the profile
-            _nextMove.acceleration =
-                int(3.0 * float(_nextMove.speed) / _timeOfOutStroke);
+            _nextMove.acceleration = int(3.0 * float(_nextMove.speed) / time);
+            _fitMove(_nextMove, stroke, time);
             _nextMove.stroke = _depth - _stroke;
-            // every second move is half
-            _half = !_half;
             // even stroke is moving in
         } else {
+            float time = _timeOfInStroke * scale;
+
             // maximum speed of the trapezoidal motion
-            _nextMove.speed = int(1.5 * stroke / _timeOfInStroke);
+            _nextMove.speed = int(1.5 * stroke / time);
 
             // acceleration to meet the profile
-            _nextMove.acceleration =
-                int(3.0 * float(_nextMove.speed) / _timeOfInStroke);
+            _nextMove.acceleration = int(3.0 * float(_nextMove.speed) / time);
+            _fitMove(_nextMove, stroke, time);
             _nextMove.stroke = (_depth - _stroke) + stroke;
         }
         _index = index;
@@ -387,7 +547,6 @@ class HalfnHalf : public Pattern {
     float _timeOfFastStroke = 1.0;
     float _timeOfInStroke = 1.0;
     float _timeOfOutStroke = 1.0;
-    bool _half = true;
     void _updateStrokeTiming() {
         // calculate the time it takes to complete the faster stroke
         // Division by 2 because reference is a half stroke
@@ -458,11 +617,16 @@ class Deeper : public Pattern {
                        " cycleIndex: " + String(cycleIndex));
 #endif
 
+        // In and out take the same time, slower if the machine can't make
+        // this depth. Shallower moves of the ramp keep their pace.
+        float time = _timeOfStroke * _timeScale(amplitude, _timeOfStroke);
+
         // maximum speed of the trapezoidal motion
-        _nextMove.speed = int(1.5 * amplitude / _timeOfStroke);
+        _nextMove.speed = int(1.5 * amplitude / time);
 
         // acceleration to meet the profile
-        _nextMove.acceleration = int(3.0 * _nextMove.speed / _timeOfStroke);
+        _nextMove.acceleration = int(3.0 * _nextMove.speed / time);
+        _fitMove(_nextMove, amplitude, time);
 
         // odd stroke is moving out
         if (index % 2) {
@@ -504,12 +668,19 @@ class StopNGo : public Pattern {
         _updateDelay(map(sensation, -100, 100, 100, 10000));
     }
 
+    // The pause starts when the move out is asked for
+    bool lookahead() const { return false; }
+
     motionParameter nextTarget(unsigned int index) {
+        // slower if the machine can't make it
+        float time = _timeOfStroke * _timeScale(_stroke, _timeOfStroke);
+
         // maximum speed of the trapezoidal motion
-        _nextMove.speed = int(1.5 * _stroke / _timeOfStroke);
+        _nextMove.speed = int(1.5 * _stroke / time);
 
         // acceleration to meet the profile
-        _nextMove.acceleration = int(3.0 * _nextMove.speed / _timeOfStroke);
+        _nextMove.acceleration = int(3.0 * _nextMove.speed / time);
+        _fitMove(_nextMove, _stroke, time);
 
         // adds a delay between each stroke
         if (_isStillDelayed() == false) {
@@ -601,6 +772,13 @@ class Insist : public Pattern {
         _updateStrokeTiming();
     }
 
+    void setSpeedLimit(unsigned int maxSpeed, unsigned int maxAcceleration,
+                       unsigned int stepsPerMM, unsigned int maxJerk = 0) {
+        Pattern::setSpeedLimit(maxSpeed, maxAcceleration, stepsPerMM,
+                               maxJerk);
+        _updateStrokeTiming();
+    }
+
     motionParameter nextTarget(unsigned int index) {
         // acceleration & speed to meet the profile
         _nextMove.acceleration = _acceleration;
@@ -639,14 +817,28 @@ class Insist : public Pattern {
     float _strokeFraction = 1.0;
     bool _strokeInFront = false;
     void _updateStrokeTiming() {
-        // maximum speed of the longest trapezoidal motion (full stroke)
-        _speed = int(1.5 * _stroke / _timeOfStroke);
-
-        // Acceleration to hold 1/3 profile with fractional strokes
-        _acceleration =
-            int(3.0 * _nextMove.speed / (_timeOfStroke * _strokeFraction));
-
         // Calculate fractional stroke length
         _realStroke = int((float)_stroke * _strokeFraction);
+
+        // The fractional stroke takes its share of the time. Slower if the
+        // machine can't make the full or the fractional stroke.
+        float scale = fmaxf(_timeScale(_stroke, _timeOfStroke),
+                            _timeScale(_realStroke,
+                                       _timeOfStroke * _strokeFraction));
+        float time = _timeOfStroke * scale;
+
+        // maximum speed of the longest trapezoidal motion (full stroke)
+        _speed = int(1.5 * _stroke / time);
+
+        // Acceleration to hold 1/3 profile with fractional strokes. Without
+        // a fraction there is no move to shape.
+        _acceleration = (_strokeFraction > 0.0f)
+                            ? int(3.0 * _speed / (time * _strokeFraction))
+                            : int(3.0 * _speed / time);
+
+        motionParameter move = {0, _speed, _acceleration, false, 0};
+        _fitMove(move, _realStroke, time * _strokeFraction);
+        _speed = move.speed;
+        _acceleration = move.acceleration;
     }
 };
@@ -0,0 +1,321 @@
+#include "FastAccelStepper.h"
+
+#include <algorithm>
+#include <cmath>
+
+int8_t FastAccelStepper::setSpeedInHz(uint32_t speedHz) {
+    if (speedHz == 0) return MOVE_ERR_SPEED_IS_UNDEFINED;
+    _speedHz = speedHz;
+    return MOVE_OK;
+}
+
+int8_t FastAccelStepper::setAcceleration(int32_t stepsPerSecondSquared) {
+    if (stepsPerSecondSquared <= 0) return MOVE_ERR_ACCELERATION_IS_UNDEFINED;
+    _acceleration = stepsPerSecondSquared;
+    return MOVE_OK;
+}
+
+void FastAccelStepper::applySpeedAcceleration() {
+    _advance();
+    _latchRamp();
+}
+
+void FastAccelStepper::_latchRamp() {
+    _braking = false;
+    _activeSpeed = _speedHz;
+    _activeAcceleration = _acceleration;
+
+    // Full acceleration a is reached after linearAccelerationSteps s with
+    // constant jerk j: s = a³ / (6 j²)
+    double a = _acceleration;
+    _activeJerk = _linearAccelerationSteps > 0
+                      ? std::sqrt(a * a * a / (6.0 * _linearAccelerationSteps))
+                      : 0.0;
+}
+
+int8_t FastAccelStepper::moveTo(int32_t position, bool blocking) {
+    if (_speedHz == 0) return MOVE_ERR_SPEED_IS_UNDEFINED;
+    if (_acceleration == 0) return MOVE_ERR_ACCELERATION_IS_UNDEFINED;
+
+    _advance();
+    _latchRamp();
+    _target = position;
+    _start();
+
+    while (blocking && isRunning()) {
+        vTaskDelay(1);
+    }
+    return MOVE_OK;
+}
+
+int8_t FastAccelStepper::move(int32_t steps, bool blocking) {
+    _advance();
+    int32_t origin = _running ? _target : int32_t(std::lround(_position));
+    return moveTo(origin + steps, blocking);
+}
+
+void FastAccelStepper::stopMove() {
+    _advance();
+    // Raw queue entries are not touched by the ramp generator
+    if (!_running || _raw) return;
+
+    // Ramp down with the current acceleration; the carriage comes to rest
+    // wherever the ramp ends.
+    _braking = false;
+    double brakingDistance = _brakingDistance(std::fabs(_velocity));
+    double direction = _velocity >= 0 ? 1.0 : -1.0;
+    _target = int32_t(std::lround(_position + direction * brakingDistance));
+}
+
+void FastAccelStepper::forceStop() {
+    _advance();
+    forceStopAndNewPosition(int32_t(std::lround(_position)));
+}
+
+void FastAccelStepper::forceStopAndNewPosition(int32_t newPosition) {
+    _advance();
+    if (_running) {
+        _stop(int32_t(std::lround(_position)));
+    }
+    _queue.clear();
+    _raw = false;
+    _velocity = 0.0;
+    _counterOffset += newPosition - _position;
+    _position = newPosition;
+    _target = newPosition;
+}
+
+bool FastAccelStepper::isRunning() {
+    // Polling costs CPU time on the real thing; charging for it lets
+    // busy-wait loops make progress in virtual time.
+    sim::spin(1);
+    _advance();
+    return _running;
+}
+
+int32_t FastAccelStepper::getCurrentPosition() {
+    _advance();
+    return int32_t(std::lround(_position));
+}
+
+void FastAccelStepper::setCurrentPosition(int32_t newPosition) {
+    _advance();
+    double delta = newPosition - std::lround(_position);
+    _position += delta;
+    _counterOffset += delta;
+    _target += int32_t(delta);
+}
+
+int32_t FastAccelStepper::getCurrentSpeedInMilliHz() {
+    _advance();
+    return int32_t(_velocity * 1000.0);
+}
+
+int8_t FastAccelStepper::addQueueEntry(const struct stepper_command_s *cmd,
+                                      bool start) {
+    _advance();
+    if (_queue.size() >= QUEUE_LEN) return AQE_QUEUE_FULL;
+    uint32_t duration = cmd->steps > 0 ? uint32_t(cmd->ticks) * cmd->steps
+                                       : cmd->ticks;
+    if (duration < MIN_CMD_TICKS) return AQE_ERROR_TICKS_TOO_LOW;
+    if (_running && !_raw) return AQE_QUEUE_FULL;
+
+    _queue.push_back(*cmd);
+    if (!_running) {
+        // The queue starts right away
+        _running = true;
+        _raw = true;
+        _commandStart = sim::nowMicros() * (TICKS_PER_S / 1000000);
+        _commandSteps = 0;
+        _events.push_back({sim::MotionEvent::START, sim::nowMicros(),
+                           int32_t(std::lround(_position))});
+    }
+    return AQE_OK;
+}
+
+void FastAccelStepper::_advanceQueue(uint64_t now) {
+    const uint64_t ticksPerMicro = TICKS_PER_S / 1000000;
+    const uint64_t nowTicks = now * ticksPerMicro;
+    while (!_queue.empty()) {
+        const stepper_command_s &cmd = _queue.front();
+        const double direction = cmd.count_up ? 1.0 : -1.0;
+        const uint64_t duration =
+            cmd.steps > 0 ? uint64_t(cmd.ticks) * cmd.steps : cmd.ticks;
+
+        // Steps fall at the end of their interval
+        uint64_t elapsed = nowTicks - _commandStart;
+        uint8_t done = cmd.steps > 0
+                           ? uint8_t(std::min<uint64_t>(elapsed / cmd.ticks,
+                                                        cmd.steps))
+                           : 0;
+        _position += direction * (done - _commandSteps);
+        _commandSteps = done;
+
+        // Only the step rate is tracked. The acceleration between entries
+        // is dominated by the rounding to whole steps.
+        double velocity =
+            cmd.steps > 0 ? direction * double(TICKS_PER_S) / cmd.ticks : 0.0;
+        if (std::fabs(velocity) > _stats.peakSpeed) {
+            _stats.peakSpeed = float(std::fabs(velocity));
+        }
+
+        if (elapsed < duration) {
+            _velocity = velocity;
+            break;
+        }
+        _commandStart += duration;
+        _commandSteps = 0;
+        _velocity = velocity;
+        bool moving = cmd.steps > 0;
+        _queue.pop_front();
+
+        if (_queue.empty()) {
+            // Ran dry with the carriage in motion
+            if (moving) _underruns++;
+            _raw = false;
+            _running = false;
+            _velocity = 0.0;
+            _target = int32_t(std::lround(_position));
+            _events.push_back({sim::MotionEvent::STOP,
+                               _commandStart / ticksPerMicro, _target});
+        }
+    }
+    _lastMicros = now - now % kStepMicros;
+}
+
+void FastAccelStepper::_start() {
+    if (_running) return;
+    if (std::fabs(_target - _position) < 0.5) return;
+    _running = true;
+    _events.push_back({sim::MotionEvent::START, _lastMicros,
+                       int32_t(std::lround(_position))});
+
+    // The carriage stood still before
+    for (double &a : _accelerationHistory) a = 0.0;
+}
+
+void FastAccelStepper::_stop(int32_t position) {
+    _recordJerk(0.0, 0.0);
+    _running = false;
+    _velocity = 0.0;
+    _events.push_back({sim::MotionEvent::STOP, _lastMicros, position});
+}
+
+double FastAccelStepper::_accelerationLimit(double speed, double dt) const {
+    const double a = _activeAcceleration;
+    if (_activeJerk <= 0.0) return a;
+
+    // Below the speed reached by the constant jerk ramp the acceleration is
+    // a = sqrt(2 j v). The floor gets the carriage off standstill.
+    const double j = _activeJerk;
+    return std::fmin(a, std::fmax(j * dt, std::sqrt(2.0 * j * speed)));
+}
+
+double FastAccelStepper::_brakingDistance(double speed) const {
+    const double a = _activeAcceleration > 0 ? _activeAcceleration : 1.0;
+    if (_activeJerk <= 0.0) return speed * speed / (2.0 * a);
+
+    // Constant deceleration down to vLinear, then the constant jerk tail
+    const double j = _activeJerk;
+    const double vLinear = a * a / (2.0 * j);
+    if (speed <= vLinear) {
+        return 2.0 / 3.0 * std::pow(speed, 1.5) / std::sqrt(2.0 * j);
+    }
+    return (speed * speed - vLinear * vLinear) / (2.0 * a) +
+           a * a * a / (6.0 * j * j);
+}
+
+void FastAccelStepper::_recordJerk(double acceleration, double speed) {
+    double previous = _accelerationHistory[_historyIndex];
+    _accelerationHistory[_historyIndex] = acceleration;
+    _historyIndex = (_historyIndex + 1) % kJerkWindow;
+
+    float jerk = float(std::fabs(acceleration - previous) /
+                       (kJerkWindowMicros * 1e-6));
+    if (jerk > _stats.peakJerk) {
+        _stats.peakJerk = jerk;
+    }
+    if (speed < 0.05 * _activeSpeed && jerk > _stats.peakStartStopJerk) {
+        _stats.peakStartStopJerk = jerk;
+    }
+}
+
+void FastAccelStepper::_advance() {
+    uint64_t now = sim::nowMicros();
+    if (now < _lastMicros || !_running) {
+        // Idle (or the clock was rewound): nothing to integrate
+        _lastMicros = now - now % kStepMicros;
+        return;
+    }
+    if (_raw) {
+        _advanceQueue(now);
+        return;
+    }
+    while (_running && _lastMicros + kStepMicros <= now) {
+        _lastMicros += kStepMicros;
+        _integrate(kStepMicros * 1e-6);
+    }
+    if (!_running) _lastMicros = now - now % kStepMicros;
+}
+
+void FastAccelStepper::_integrate(double dt) {
+    const double vMax = _activeSpeed;
+    const double distance = _target - _position;
+    const double direction = distance > 0 ? 1.0 : -1.0;
+    const double speed = std::fabs(_velocity);
+    const double a = _accelerationLimit(speed, dt);
+    double accel = 0.0;
+
+    if (_velocity * direction < 0.0) {
+        // Moving away from the target: brake before turning around
+        accel = direction * a;
+        _braking = false;
+    } else {
+        double remaining = std::fabs(distance);
+        double brakingDistance = _brakingDistance(speed);
+        // Once braking, keep braking. Rounding would otherwise let it
+        // accelerate again for single steps.
+        if ((_braking || brakingDistance >= remaining) && speed > 0.0) {
+            _braking = true;
+            // Braking towards the target. Scale the deceleration so it lands
+            // on it, unless that is impossible and we must overshoot. In the
+            // constant jerk tail a = 2v² / 3s lands exactly.
+            double needed = a * brakingDistance / remaining;
+            if (_activeJerk > 0.0 &&
+                speed * 2.0 * _activeJerk <=
+                    _activeAcceleration * _activeAcceleration) {
+                needed = 2.0 / 3.0 * speed * speed / remaining;
+            }
+            if (needed * dt >= speed || remaining <= speed * dt) {
+                // Arrives within this integration step
+                _position = _target;
+                _stop(_target);
+                return;
+            }
+            accel = -direction * (needed > 1.05 * a ? a : needed);
+        } else if (speed < vMax) {
+            accel = direction * std::fmin(a, (vMax - speed) / dt);
+        } else if (speed > vMax) {
+            accel = -direction * std::fmin(a, (speed - vMax) / dt);
+        }
+    }
+
+    double velocity = _velocity + accel * dt;
+    _position += 0.5 * (_velocity + velocity) * dt;
+    _velocity = velocity;
+
+    if (std::fabs(_velocity) > _stats.peakSpeed) {
+        _stats.peakSpeed = float(std::fabs(_velocity));
+    }
+    if (std::fabs(accel) > _stats.peakAcceleration) {
+        _stats.peakAcceleration = float(std::fabs(accel));
+    }
+    _recordJerk(accel, speed);
+
+    // Creeping up on the target from standstill
+    if (!_braking && std::fabs(_target - _position) < 0.5 &&
+        std::fabs(_velocity) < _activeAcceleration * dt) {
+        _position = _target;
+        _stop(_target);
+    }
+}
@@ -0,0 +1,228 @@
+/**
+ *   FastAccelStepper (simulated)
+ *   Drop-in replacement for the parts of gin66/FastAccelStepper used by
+ *   StrokeEngine. Instead of generating STEP pulses it integrates the same
+ *   trapezoidal ramp in virtual time (see SimFreeRTOS.h), so a pattern can be
+ *   run for minutes on the host in a fraction of a second. With
+ *   setLinearAcceleration() the ramp starts from and ends in standstill with
+ *   constant jerk, like the real ramp generator.
+ *
+ *   Raw queue entries from addQueueEntry() bypass the ramp and step the
+ *   carriage exactly as commanded, like the real step queue does.
+ *
+ *   The motion is advanced lazily to sim::nowMicros() whenever the stepper is
+ *   queried or commanded. Every start and stop of the carriage is recorded so
+ *   benchmarks can measure reversal dead time and stroke periods.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "SimFreeRTOS.h"
+
+#define MOVE_OK 0
+#define MOVE_ERR_NO_DIRECTION_PIN -1
+#define MOVE_ERR_SPEED_IS_UNDEFINED -2
+#define MOVE_ERR_ACCELERATION_IS_UNDEFINED -3
+
+#define PIN_UNDEFINED 0xff
+
+#define AQE_OK 0
+#define AQE_QUEUE_FULL 1
+#define AQE_ERROR_TICKS_TOO_LOW -1
+#define AQE_ERROR_EMPTY_QUEUE_TO_START -2
+
+#define TICKS_PER_S 16000000L
+#define QUEUE_LEN 32
+#define MIN_CMD_TICKS (TICKS_PER_S / 5000)
+
+//! One entry of the step queue: steps at ticks apart, or a pause of ticks
+//! if steps is 0
+struct stepper_command_s {
+    uint16_t ticks;
+    uint8_t steps;
+    bool count_up;
+};
+
+namespace sim {
+
+/**************************************************************************/
+/*!
+  @brief  A change in the motion state of the simulated carriage.
+*/
+/**************************************************************************/
+struct MotionEvent {
+    enum Type : uint8_t {
+        START,  //!< Carriage left standstill
+        STOP    //!< Carriage came to standstill
+    };
+    Type type;
+    uint64_t micros;   //!< Virtual time of the event
+    int32_t position;  //!< Position in steps at the event
+};
+
+/**************************************************************************/
+/*!
+  @brief  Peak values reached by the simulated carriage since the last
+  clearStats().
+*/
+/**************************************************************************/
+struct MotionStats {
+    float peakSpeed = 0.0f;         //!< steps/s
+    float peakAcceleration = 0.0f;  //!< steps/s²
+    float peakJerk = 0.0f;          //!< steps/s³, over kJerkWindowMicros
+    float peakStartStopJerk = 0.0f;  //!< steps/s³, only close to standstill
+};
+
+}  // namespace sim
+
+class FastAccelStepper {
+  public:
+    //! Integration step of the motion model in microseconds
+    static constexpr uint32_t kStepMicros = 10;
+
+    //! Jerk is measured as the change of acceleration over this window. A
+    //! step change of the acceleration thus reads as a / window instead of
+    //! depending on the integration step.
+    static constexpr uint32_t kJerkWindowMicros = 1000;
+
+    void setDirectionPin(uint8_t directionPin, bool dirHighCountsUp = true) {
+        _directionPin = directionPin;
+    }
+    void setEnablePin(uint8_t enablePin, bool lowActiveEnables = true) {}
+    void setAutoEnable(bool autoEnable) {}
+    bool enableOutputs() {
+        _enabled = true;
+        return true;
+    }
+    bool disableOutputs() {
+        _enabled = false;
+        return true;
+    }
+
+    int8_t setSpeedInHz(uint32_t speedHz);
+    uint32_t getSpeedInMilliHz() { return _speedHz * 1000; }
+    int8_t setAcceleration(int32_t stepsPerSecondSquared);
+    int32_t getAcceleration() { return _acceleration; }
+    void setLinearAcceleration(uint32_t linearAccelerationSteps) {
+        _linearAccelerationSteps = linearAccelerationSteps;
+    }
+    void applySpeedAcceleration();
+
+    int8_t moveTo(int32_t position, bool blocking = false);
+    int8_t move(int32_t steps, bool blocking = false);
+    void stopMove();
+    void forceStop();
+    void forceStopAndNewPosition(int32_t newPosition);
+
+    bool isRunning();
+    int32_t getCurrentPosition();
+    void setCurrentPosition(int32_t newPosition);
+    int32_t targetPos() { return _target; }
+    int32_t getCurrentSpeedInMilliHz();
+
+    int8_t addQueueEntry(const struct stepper_command_s *cmd,
+                         bool start = true);
+    bool isQueueEmpty() {
+        _advance();
+        return _queue.empty();
+    }
+    bool isQueueFull() {
+        _advance();
+        return _queue.size() >= QUEUE_LEN;
+    }
+
+    // ─── Simulation only ───────────────────────────────────────────────
+
+    //! All START/STOP events since the last clearEvents()
+    const std::vector<sim::MotionEvent> &events() const { return _events; }
+    void clearEvents() { _events.clear(); }
+
+    //! Peak speed/acceleration since the last clearStats()
+    const sim::MotionStats &stats() const { return _stats; }
+    void clearStats() { _stats = sim::MotionStats(); }
+
+    //! Exact (fractional) position of the carriage in steps
+    double exactPosition() {
+        _advance();
+        return _position;
+    }
+
+    //! Exact position of the carriage on the rail in steps. Unlike the
+    //! counter it is not moved by setCurrentPosition() and friends, so it
+    //! tells where the carriage really is, e.g. relative to a home switch.
+    double carriagePosition() {
+        _advance();
+        return _position - _counterOffset;
+    }
+
+    //! Returns true while the driver is enabled
+    bool isEnabled() const { return _enabled; }
+
+    //! Number of times the step queue ran dry while raw entries were
+    //! queued, i.e. the carriage stopped because nobody refilled it
+    uint32_t queueUnderruns() const { return _underruns; }
+
+  private:
+    void _advance();
+    void _advanceQueue(uint64_t now);
+    void _integrate(double dt);
+    void _start();
+    void _stop(int32_t position);
+    void _latchRamp();
+    double _accelerationLimit(double speed, double dt) const;
+    double _brakingDistance(double speed) const;
+    void _recordJerk(double acceleration, double speed);
+
+    uint8_t _directionPin = PIN_UNDEFINED;
+    bool _enabled = false;
+
+    // Commanded profile. Like the real ramp generator, speed and
+    // acceleration only take effect with the next move or
+    // applySpeedAcceleration().
+    uint32_t _speedHz = 0;
+    int32_t _acceleration = 0;
+    uint32_t _linearAccelerationSteps = 0;
+    double _activeSpeed = 0.0;
+    double _activeAcceleration = 0.0;
+    double _activeJerk = 0.0;  // 0: trapezoidal ramp
+    int32_t _target = 0;
+
+    // Integrated state
+    double _position = 0.0;
+    double _counterOffset = 0.0;  // counter minus carriage position
+    double _velocity = 0.0;
+    bool _running = false;
+    bool _braking = false;
+    uint64_t _lastMicros = 0;
+
+    // Raw step queue. Time is kept in ticks of TICKS_PER_S.
+    std::deque<stepper_command_s> _queue;
+    bool _raw = false;
+    uint64_t _commandStart = 0;
+    uint8_t _commandSteps = 0;  // steps of the front entry done so far
+    uint32_t _underruns = 0;
+
+    std::vector<sim::MotionEvent> _events;
+    sim::MotionStats _stats;
+
+    // Acceleration history over the jerk window
+    static constexpr int kJerkWindow = kJerkWindowMicros / kStepMicros;
+    double _accelerationHistory[kJerkWindow] = {};
+    int _historyIndex = 0;
+};
+
+class FastAccelStepperEngine {
+  public:
+    void init() {}
+    FastAccelStepper *stepperConnectToPin(uint8_t stepPin) {
+        _stepper = new FastAccelStepper();
+        return _stepper;
+    }
+
+  private:
+    FastAccelStepper *_stepper = nullptr;
+};
@@ -0,0 +1,422 @@
+#include "SimFreeRTOS.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct tskTaskControlBlock {
+    std::string name;
+    TaskFunction_t code = nullptr;
+    void *parameters = nullptr;
+    UBaseType_t priority = 1;
+    uint64_t sequence = 0;  // creation order, breaks ties between equals
+    uint64_t wakeAt = 0;    // virtual time at which the task is runnable
+    uint64_t busy = 0;      // virtual time consumed by spin()
+    uint64_t wakeups = 0;   // times it got the CPU back after sleeping
+    QueueDefinition *waitingOn = nullptr;
+    uint32_t notifications = 0;  // task notification value
+    bool waitingForNotification = false;
+    bool suspended = false;
+    bool finished = false;
+    bool killed = false;
+    std::condition_variable cv;
+    std::thread thread;
+};
+
+struct QueueDefinition {
+    bool isMutex = false;
+    UBaseType_t count = 0;
+    TaskHandle_t holder = nullptr;
+};
+
+namespace {
+
+constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+constexpr uint64_t kMicrosPerTick = 1000000 / configTICK_RATE_HZ;
+
+// Thrown inside a task thread to unwind it when the task gets deleted.
+struct TaskKilled {};
+
+std::mutex gLock;
+uint64_t gNow = 0;
+uint64_t gSequence = 0;
+tskTaskControlBlock gHost;
+TaskHandle_t gRunning = &gHost;
+std::vector<TaskHandle_t> gTasks;
+
+// Function-local so mutexes created during static initialisation (e.g. by a
+// global StrokeEngine) find it constructed.
+std::vector<SemaphoreHandle_t> &semaphores() {
+    static std::vector<SemaphoreHandle_t> list;
+    return list;
+}
+thread_local TaskHandle_t tSelf = nullptr;
+
+TaskHandle_t current() { return tSelf != nullptr ? tSelf : &gHost; }
+
+bool isRunnable(TaskHandle_t task) {
+    return !task->suspended && !task->finished && task->wakeAt != kNever;
+}
+
+// Earliest runnable task; higher priority first, then creation order.
+TaskHandle_t pickNext() {
+    TaskHandle_t next = isRunnable(&gHost) ? &gHost : nullptr;
+    for (TaskHandle_t task : gTasks) {
+        if (!isRunnable(task)) continue;
+        if (next == nullptr || task->wakeAt < next->wakeAt ||
+            (task->wakeAt == next->wakeAt &&
+             (task->priority > next->priority ||
+              (task->priority == next->priority &&
+               task->sequence < next->sequence)))) {
+            next = task;
+        }
+    }
+    if (next == nullptr) {
+        fprintf(stderr, "SimFreeRTOS: deadlock, no runnable task left\n");
+        abort();
+    }
+    return next;
+}
+
+// Hand the CPU to whichever task is due next and return once `self` is
+// scheduled again. The caller has already updated self->wakeAt.
+void handOver(std::unique_lock<std::mutex> &lock, TaskHandle_t self) {
+    TaskHandle_t next = pickNext();
+    if (next->wakeAt > gNow) gNow = next->wakeAt;
+    if (next == self) return;
+
+    gRunning = next;
+    next->cv.notify_one();
+    if (self->finished) return;
+
+    self->cv.wait(lock, [self] { return gRunning == self || self->killed; });
+    if (self->killed) throw TaskKilled{};
+}
+
+void taskEntry(TaskHandle_t self) {
+    tSelf = self;
+    {
+        std::unique_lock<std::mutex> lock(gLock);
+        self->cv.wait(lock,
+                      [self] { return gRunning == self || self->killed; });
+        if (self->killed) return;
+    }
+
+    try {
+        self->code(self->parameters);
+    } catch (const TaskKilled &) {
+    }
+
+    // A task that returned or deleted itself still owns the CPU and must
+    // pass it on. A task deleted by someone else never had it.
+    std::unique_lock<std::mutex> lock(gLock);
+    if (!self->killed) {
+        self->finished = true;
+        handOver(lock, self);
+    }
+}
+
+void block(TaskHandle_t self, uint64_t wakeAt) {
+    std::unique_lock<std::mutex> lock(gLock);
+    self->wakeAt = wakeAt;
+    handOver(lock, self);
+}
+
+// Like block(), for the calls a task sleeps in rather than spins
+void sleep(TaskHandle_t self, uint64_t wakeAt) {
+    block(self, wakeAt);
+    std::lock_guard<std::mutex> guard(gLock);
+    self->wakeups++;
+}
+
+}  // namespace
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode,
+                                   const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority,
+                                   TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID) {
+    (void)usStackDepth;
+    (void)xCoreID;
+
+    TaskHandle_t task = new tskTaskControlBlock();
+    task->name = pcName != nullptr ? pcName : "";
+    task->code = pxTaskCode;
+    task->parameters = pvParameters;
+    task->priority = uxPriority;
+
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        task->sequence = ++gSequence;
+        task->wakeAt = gNow;
+        gTasks.push_back(task);
+    }
+
+    // The thread parks until the scheduler hands it the CPU.
+    task->thread = std::thread(taskEntry, task);
+
+    if (pxCreatedTask != nullptr) *pxCreatedTask = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName,
+                       uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask) {
+    return xTaskCreatePinnedToCore(pxTaskCode, pcName, usStackDepth,
+                                   pvParameters, uxPriority, pxCreatedTask,
+                                   tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+    TaskHandle_t self = current();
+    if (xTaskToDelete == nullptr || xTaskToDelete == self) {
+        if (self == &gHost) {
+            fprintf(stderr, "SimFreeRTOS: the host task cannot be deleted\n");
+            abort();
+        }
+        throw TaskKilled{};
+    }
+
+    std::lock_guard<std::mutex> guard(gLock);
+    xTaskToDelete->killed = true;
+    xTaskToDelete->finished = true;
+    xTaskToDelete->cv.notify_one();
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    TaskHandle_t self = current();
+    uint64_t wakeAt;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        // Like FreeRTOS, the delay counts tick interrupts, so the first tick
+        // is a partial one.
+        wakeAt = (gNow / kMicrosPerTick + xTicksToDelay) * kMicrosPerTick;
+        if (wakeAt < gNow) wakeAt = gNow;
+    }
+    sleep(self, wakeAt);
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime,
+                     TickType_t xTimeIncrement) {
+    *pxPreviousWakeTime += xTimeIncrement;
+    uint64_t wakeAt = uint64_t(*pxPreviousWakeTime) * kMicrosPerTick;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        if (wakeAt < gNow) wakeAt = gNow;
+    }
+    sleep(current(), wakeAt);
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend) {
+    TaskHandle_t self = current();
+    std::unique_lock<std::mutex> lock(gLock);
+    TaskHandle_t task = xTaskToSuspend != nullptr ? xTaskToSuspend : self;
+    task->suspended = true;
+    if (task == self) {
+        handOver(lock, self);
+        self->wakeups++;
+    }
+}
+
+void vTaskResume(TaskHandle_t xTaskToResume) {
+    std::lock_guard<std::mutex> guard(gLock);
+    if (xTaskToResume == nullptr || !xTaskToResume->suspended) return;
+    xTaskToResume->suspended = false;
+    if (xTaskToResume->wakeAt < gNow) xTaskToResume->wakeAt = gNow;
+}
+
+TickType_t xTaskGetTickCount() {
+    std::lock_guard<std::mutex> guard(gLock);
+    return TickType_t(gNow / kMicrosPerTick);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return current(); }
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+    std::lock_guard<std::mutex> guard(gLock);
+    xTaskToNotify->notifications++;
+    if (xTaskToNotify->waitingForNotification) xTaskToNotify->wakeAt = gNow;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify,
+                            BaseType_t *pxHigherPriorityTaskWoken) {
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken != nullptr) {
+        *pxHigherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit,
+                          TickType_t xTicksToWait) {
+    TaskHandle_t self = current();
+    std::unique_lock<std::mutex> lock(gLock);
+    uint64_t deadline = xTicksToWait == portMAX_DELAY
+                            ? kNever - 1
+                            : gNow + uint64_t(xTicksToWait) * kMicrosPerTick;
+
+    while (true) {
+        if (self->notifications > 0) {
+            uint32_t value = self->notifications;
+            self->notifications = xClearCountOnExit ? 0 : value - 1;
+            return value;
+        }
+        if (gNow >= deadline) return 0;
+
+        // Sleep until the deadline; xTaskNotifyGive() wakes us earlier.
+        self->waitingForNotification = true;
+        self->wakeAt = deadline;
+        handOver(lock, self);
+        self->waitingForNotification = false;
+        self->wakeups++;
+    }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    SemaphoreHandle_t semaphore = new QueueDefinition();
+    semaphore->isMutex = true;
+    semaphore->count = 1;
+    std::lock_guard<std::mutex> guard(gLock);
+    semaphores().push_back(semaphore);
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    SemaphoreHandle_t semaphore = new QueueDefinition();
+    std::lock_guard<std::mutex> guard(gLock);
+    semaphores().push_back(semaphore);
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore,
+                          TickType_t xBlockTime) {
+    TaskHandle_t self = current();
+    std::unique_lock<std::mutex> lock(gLock);
+    uint64_t deadline = xBlockTime == portMAX_DELAY
+                            ? kNever - 1
+                            : gNow + uint64_t(xBlockTime) * kMicrosPerTick;
+
+    while (true) {
+        if (xSemaphore->count > 0) {
+            xSemaphore->count--;
+            if (xSemaphore->isMutex) xSemaphore->holder = self;
+            return pdTRUE;
+        }
+        if (gNow >= deadline) return pdFALSE;
+
+        // Sleep until the deadline; xSemaphoreGive() wakes us earlier.
+        self->waitingOn = xSemaphore;
+        self->wakeAt = deadline;
+        handOver(lock, self);
+        self->waitingOn = nullptr;
+        self->wakeups++;
+    }
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+    std::lock_guard<std::mutex> guard(gLock);
+    if (xSemaphore->count > 0) return pdFALSE;
+    xSemaphore->count = 1;
+    xSemaphore->holder = nullptr;
+    for (TaskHandle_t task : gTasks) {
+        if (task->waitingOn == xSemaphore) task->wakeAt = gNow;
+    }
+    if (gHost.waitingOn == xSemaphore) gHost.wakeAt = gNow;
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore) {
+    std::lock_guard<std::mutex> guard(gLock);
+    std::vector<SemaphoreHandle_t> &list = semaphores();
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if (*it == xSemaphore) {
+            list.erase(it);
+            break;
+        }
+    }
+    delete xSemaphore;
+}
+
+namespace sim {
+
+uint64_t nowMicros() {
+    std::lock_guard<std::mutex> guard(gLock);
+    return gNow;
+}
+
+unsigned long millis() { return (unsigned long)(nowMicros() / 1000); }
+
+void runFor(uint64_t micros) {
+    TaskHandle_t self = current();
+    uint64_t wakeAt;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        wakeAt = gNow + micros;
+    }
+    block(self, wakeAt);
+}
+
+void spin(uint32_t micros) {
+    TaskHandle_t self = current();
+    uint64_t wakeAt;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        self->busy += micros;
+        wakeAt = gNow + micros;
+    }
+    block(self, wakeAt);
+}
+
+uint64_t busyMicros(TaskHandle_t task) {
+    std::lock_guard<std::mutex> guard(gLock);
+    return (task != nullptr ? task : current())->busy;
+}
+
+uint64_t wakeups(TaskHandle_t task) {
+    std::lock_guard<std::mutex> guard(gLock);
+    return (task != nullptr ? task : current())->wakeups;
+}
+
+void reset() {
+    std::vector<TaskHandle_t> tasks;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        tasks.swap(gTasks);
+        for (TaskHandle_t task : tasks) {
+            task->killed = true;
+            task->finished = true;
+            task->cv.notify_one();
+        }
+    }
+
+    for (TaskHandle_t task : tasks) {
+        if (task->thread.joinable()) task->thread.join();
+        delete task;
+    }
+
+    // Semaphores stay allocated because their owners may outlive the
+    // simulation, but mutexes held by a deleted task are released.
+    std::lock_guard<std::mutex> guard(gLock);
+    for (SemaphoreHandle_t semaphore : semaphores()) {
+        if (semaphore->isMutex) {
+            semaphore->count = 1;
+            semaphore->holder = nullptr;
+        }
+    }
+    gNow = 0;
+    gSequence = 0;
+    gHost.wakeAt = 0;
+    gHost.busy = 0;
+    gHost.wakeups = 0;
+    gHost.waitingOn = nullptr;
+    gHost.notifications = 0;
+    gHost.waitingForNotification = false;
+    gRunning = &gHost;
+}
+
+}  // namespace sim
@@ -0,0 +1,146 @@
+/**
+ *   SimFreeRTOS
+ *   Virtual-time stand-in for the subset of the FreeRTOS API used by
+ *   StrokeEngine. Every task runs on its own host thread, but only one of them
+ *   holds the (single, simulated) CPU at a time. Time advances only when the
+ *   running task blocks, so a simulation is deterministic and runs as fast as
+ *   the host allows.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/**************************************************************************/
+/*!
+  @brief  FreeRTOS types and constants
+*/
+/**************************************************************************/
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+struct tskTaskControlBlock;
+struct QueueDefinition;
+typedef tskTaskControlBlock *TaskHandle_t;
+typedef QueueDefinition *SemaphoreHandle_t;
+
+#define pdTRUE ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(xTimeInMs) \
+    ((TickType_t)(((TickType_t)(xTimeInMs) * configTICK_RATE_HZ) / 1000U))
+#define configMAX_PRIORITIES 25
+#define configMINIMAL_STACK_SIZE 768
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+/**************************************************************************/
+/*!
+  @brief  Task API
+*/
+/**************************************************************************/
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pxTaskCode,
+                                   const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority,
+                                   TaskHandle_t *pxCreatedTask,
+                                   BaseType_t xCoreID);
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char *pcName,
+                       uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pxCreatedTask);
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+void vTaskDelay(TickType_t xTicksToDelay);
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime,
+                     TickType_t xTimeIncrement);
+void vTaskSuspend(TaskHandle_t xTaskToSuspend);
+void vTaskResume(TaskHandle_t xTaskToResume);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+/**************************************************************************/
+/*!
+  @brief  Task notifications, used as a counting semaphore
+*/
+/**************************************************************************/
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit,
+                          TickType_t xTicksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify,
+                            BaseType_t *pxHigherPriorityTaskWoken);
+
+// The notified task runs as soon as the interrupt (the calling task) blocks
+#define portYIELD_FROM_ISR()
+
+/**************************************************************************/
+/*!
+  @brief  Semaphore API (mutexes and binary semaphores)
+*/
+/**************************************************************************/
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore,
+                          TickType_t xBlockTime);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore);
+
+/**************************************************************************/
+/*!
+  @brief  Controls for the host side of a simulation. The host thread (the
+  one running the tests) is itself a task of priority 1 and gives the CPU to
+  the simulated tasks by calling runFor().
+*/
+/**************************************************************************/
+namespace sim {
+
+/*!
+  @brief Current virtual time.
+  @return Microseconds since the last reset()
+*/
+uint64_t nowMicros();
+
+/*!
+  @brief Current virtual time in milliseconds. Suitable as a millis() stub.
+*/
+unsigned long millis();
+
+/*!
+  @brief Let all other tasks run for the given amount of virtual time, then
+  return to the caller.
+  @param micros Virtual time to advance in microseconds
+*/
+void runFor(uint64_t micros);
+
+/*!
+  @brief Consume CPU time without blocking, like a busy-wait loop would.
+  Other tasks only get the CPU if they were due to wake up before the end of
+  the interval. Used by the simulated stepper to model polling loops.
+  @param micros CPU time spent in microseconds
+*/
+void spin(uint32_t micros);
+
+/*!
+  @brief Total virtual time the given task spent in spin().
+  @param task Task handle or NULL for the calling task
+*/
+uint64_t busyMicros(TaskHandle_t task);
+
+/*!
+  @brief Number of times the given task woke up from a delay, a wait for a
+  notification or semaphore, or a suspension. Each costs a context switch
+  and a pass through the task's loop on the real hardware.
+  @param task Task handle or NULL for the calling task
+*/
+uint64_t wakeups(TaskHandle_t task);
+
+/*!
+  @brief Deletes every simulated task, releases all mutexes and rewinds the
+  clock to zero. Call between tests.
+*/
+void reset();
+
+}  // namespace sim
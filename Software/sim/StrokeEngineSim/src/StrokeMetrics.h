@@ -0,0 +1,93 @@
+/**
+ *   StrokeMetrics
+ *   Timing figures of merit computed from the START/STOP trace of the
+ *   simulated FastAccelStepper.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "FastAccelStepper.h"
+
+namespace sim {
+
+/**************************************************************************/
+/*!
+  @brief  Timing summary of a stroking run.
+*/
+/**************************************************************************/
+struct StrokeMetrics {
+    size_t moves = 0;             //!< Completed moves (STOP events)
+    size_t reversals = 0;         //!< STOP→START gaps counted as dead time
+    size_t pauses = 0;            //!< Gaps longer than the pause threshold
+    float deadTimeMeanMs = 0.0f;  //!< Mean standstill at a reversal
+    float deadTimeMaxMs = 0.0f;   //!< Longest standstill at a reversal
+    float periodMeanMs = 0.0f;    //!< Mean time of an in+out stroke
+    float periodStdDevMs = 0.0f;  //!< Spread of the stroke period
+};
+
+/**************************************************************************/
+/*!
+  @brief  Summarises a motion trace. A standstill longer than pauseMicros is
+  treated as an intentional pause of the pattern (e.g. StopNGo) and neither
+  counted as reversal dead time nor included in the stroke periods.
+  @param events Trace from FastAccelStepper::events()
+  @param pauseMicros Threshold separating dead time from pauses
+  @return Metrics of the trace
+*/
+/**************************************************************************/
+inline StrokeMetrics measureStrokes(const std::vector<MotionEvent> &events,
+                                    uint64_t pauseMicros = 50000) {
+    StrokeMetrics metrics;
+    double deadTimeSum = 0.0;
+
+    // Start times of the moves, split into runs at every pause
+    std::vector<std::vector<uint64_t>> runs(1);
+
+    for (size_t i = 0; i < events.size(); i++) {
+        const MotionEvent &event = events[i];
+        if (event.type == MotionEvent::STOP) {
+            metrics.moves++;
+            continue;
+        }
+        if (i > 0 && events[i - 1].type == MotionEvent::STOP) {
+            uint64_t gap = event.micros - events[i - 1].micros;
+            if (gap > pauseMicros) {
+                metrics.pauses++;
+                runs.emplace_back();
+            } else {
+                float gapMs = gap / 1000.0f;
+                metrics.reversals++;
+                deadTimeSum += gapMs;
+                if (gapMs > metrics.deadTimeMaxMs) metrics.deadTimeMaxMs = gapMs;
+            }
+        }
+        runs.back().push_back(event.micros);
+    }
+    if (metrics.reversals > 0) {
+        metrics.deadTimeMeanMs = float(deadTimeSum / metrics.reversals);
+    }
+
+    // One stroke period spans two moves (out and back in)
+    std::vector<double> periods;
+    for (const std::vector<uint64_t> &starts : runs) {
+        for (size_t i = 2; i < starts.size(); i++) {
+            periods.push_back((starts[i] - starts[i - 2]) / 1000.0);
+        }
+    }
+    if (!periods.empty()) {
+        double sum = 0.0;
+        for (double period : periods) sum += period;
+        double mean = sum / periods.size();
+        double variance = 0.0;
+        for (double period : periods) variance += (period - mean) * (period - mean);
+        metrics.periodMeanMs = float(mean);
+        metrics.periodStdDevMs = float(std::sqrt(variance / periods.size()));
+    }
+    return metrics;
+}
+
+}  // namespace sim
@@ -1,6 +1,8 @@
 #ifndef OSSM_SOFTWARE_COMMANDS_H
 #define OSSM_SOFTWARE_COMMANDS_H
 
+#include <cmath>
+#include <cstdlib>
 #include <regex>
 #include <string>
 
@@ -29,10 +31,24 @@ enum class Commands {
     setStroke,
     setWifi,
     setBuffer,
+    setVibration,
+    setVibrationFrequency,
 
     // STREAMING
     streamPosition,
 
+    // TEMPO
+    setTempo,
+
+    // FUNSCRIPT PLAYBACK
+    playFunscript,
+    seekFunscript,
+    stopFunscript,
+
+    // KEYFRAME PLAYBACK
+    playKeyframes,
+    stopKeyframes,
+
     ignore
 };
 
@@ -78,6 +94,10 @@ inline CommandValue setCommandValue(const String& str) {
         return {Commands::setStroke, value, 0};
     } else if (command == "buffer") {
         return {Commands::setBuffer, value, 0};
+    } else if (command == "vibration") {
+        return {Commands::setVibration, value, 0};
+    } else if (command == "vibrationFrequency") {
+        return {Commands::setVibrationFrequency, value, 0};
     } else {
         return {Commands::ignore, 0, 0};
     }
@@ -113,6 +133,87 @@ inline CommandValue streamCommandValue(const String& str) {
     return {Commands::streamPosition, pos, time};
 }
 
+inline CommandValue tempoCommandValue(const String& str) {
+    // Format: tempo:bpm:ms
+    // bpm = beats per minute, decimals allowed, 0 lets the pattern run free
+    // ms = milliseconds since the last beat when the command was sent
+    int firstColon = str.indexOf(':');
+    int lastColon = str.lastIndexOf(':');
+    if (firstColon == -1 || lastColon == -1 || firstColon == lastColon) {
+        ESP_LOGI("COMMANDS", "Tempo command not well formed: %s", str.c_str());
+        return {Commands::ignore, 0, 0};
+    }
+
+    // Extract bpm (between first and last colon), sent on in 1/100 bpm
+    String bpmStr = str.substring(firstColon + 1, lastColon);
+    char* end = nullptr;
+    double bpm = strtod(bpmStr.c_str(), &end);
+    if (bpmStr.length() == 0 || *end != '\0' || !(bpm >= 0.0) ||
+        bpm > 300.0) {
+        ESP_LOGI("COMMANDS", "Invalid tempo: %s", str.c_str());
+        return {Commands::ignore, 0, 0};
+    }
+
+    // Extract time since the beat (after last colon)
+    String msStr = str.substring(lastColon + 1);
+    int ms = msStr.toInt();
+    if (ms < 0 || ms > 60000 || msStr != String(ms)) {
+        ESP_LOGI("COMMANDS", "Invalid beat time: %s", str.c_str());
+        return {Commands::ignore, 0, 0};
+    }
+
+    return {Commands::setTempo, int(lround(bpm * 100.0)), ms};
+}
+
+inline CommandValue funscriptCommandValue(const String& str) {
+    // Format: funscript:play:<path>, funscript:seek:<ms> or funscript:stop
+    if (str.startsWith("funscript:play:/") && str.length() > 16) {
+        return {Commands::playFunscript, 0, 0};
+    }
+    if (str == "funscript:stop") {
+        return {Commands::stopFunscript, 0, 0};
+    }
+    if (str.startsWith("funscript:seek:")) {
+        String msStr = str.substring(15);
+        int ms = msStr.toInt();
+        if (ms < 0 || msStr != String(ms)) {
+            ESP_LOGI("COMMANDS", "Invalid seek time: %s", str.c_str());
+            return {Commands::ignore, 0, 0};
+        }
+        return {Commands::seekFunscript, ms, 0};
+    }
+    ESP_LOGI("COMMANDS", "Funscript command not well formed: %s", str.c_str());
+    return {Commands::ignore, 0, 0};
+}
+
+inline String parseFunscriptPath(const String& str) {
+    // Expected format: funscript:play:<path>
+    if (!str.startsWith("funscript:play:")) {
+        return "";
+    }
+    return str.substring(15);
+}
+
+inline CommandValue keyframesCommandValue(const String& str) {
+    // Format: keyframes:play:<path> or keyframes:stop
+    if (str.startsWith("keyframes:play:/") && str.length() > 16) {
+        return {Commands::playKeyframes, 0, 0};
+    }
+    if (str == "keyframes:stop") {
+        return {Commands::stopKeyframes, 0, 0};
+    }
+    ESP_LOGI("COMMANDS", "Keyframes command not well formed: %s", str.c_str());
+    return {Commands::ignore, 0, 0};
+}
+
+inline String parseKeyframesPath(const String& str) {
+    // Expected format: keyframes:play:<path>
+    if (!str.startsWith("keyframes:play:")) {
+        return "";
+    }
+    return str.substring(15);
+}
+
 static const char test_str[] PROGMEM = "test";
 
 static const char ignore_str[] PROGMEM = "ignore";
@@ -158,6 +259,18 @@ inline CommandValue commandFromString(const String& str) {
         return streamCommandValue(str);
     }
 
+    if (str.startsWith("tempo:")) {
+        return tempoCommandValue(str);
+    }
+
+    if (str.startsWith("funscript:")) {
+        return funscriptCommandValue(str);
+    }
+
+    if (str.startsWith("keyframes:")) {
+        return keyframesCommandValue(str);
+    }
+
     return {Commands::ignore, 0, 0};
 }
 
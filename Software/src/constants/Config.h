@@ -26,6 +26,9 @@ namespace Config {
         constexpr float motorStepPerRevolution = 800.0f;
         // Top acceleration of the device in mm/s/s
         constexpr float maxAcceleration = 50000.0f;
+        // Top jerk of the device in mm/s/s/s. Softens the start and end of
+        // every stroke. 0 keeps the plain trapezoidal profiles.
+        constexpr float maxJerk = 0.0f;
         // Number of steps to move the arm 1mm
         constexpr float maxSpeedMmPerSecond = maxRPM / 60.0 * pulleyToothCount * beltPitchMm;
         // This should match the step/rev of your stepper or servo.
@@ -64,6 +67,14 @@ namespace Config {
 
         // Applied offset after homing process.
         constexpr float homingOffsetMn = 10_mm;
+
+        // Number of pattern targets StrokeEngine prepares ahead of the
+        // running move, so the next stroke starts right at the reversal
+        // instead of with the next 10ms poll. 0 disables the lookahead.
+        constexpr uint8_t strokeLookahead = 2;
+        // Number of strokes over which a pattern change blends the old
+        // pattern into the new one. 0 restarts the new pattern right away.
+        constexpr uint8_t patternCrossfadeStrokes = 4;
     }
 
     /**
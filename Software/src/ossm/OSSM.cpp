@@ -1,6 +1,7 @@
 #include "OSSM.h"
 
 #include "FirmwareProvenance.h"
+#include "PatternRegistry.h"
 
 #include "command/commands.hpp"
 #include "ossm/state/ble.h"
@@ -9,6 +10,8 @@
 #include "ossm/state/session.h"
 #include "ossm/state/settings.h"
 #include "ossm/state/state.h"
+#include "ossm/streaming/funscript.h"
+#include "ossm/streaming/streaming.h"
 #include "services/communication/mqtt.h"
 #include "services/communication/queue.h"
 #include "services/encoder.h"
@@ -20,13 +23,17 @@ using namespace sml;
 // Global OSSM pointer (kept for backward compatibility during migration)
 OSSM *ossm = nullptr;
 
+// Default sensation of the first pattern, from -100..100 to percent
+static constexpr float defaultSensationPercent =
+    50.0f + 0.5f * PatternRegistry::patterns[0].defaultSensation;
+
 // Static member definition - now forwards to global settings
 SettingPercents OSSM::setting = {.speed = 0,
                                  .stroke = 50,
-                                 .sensation = 50,
+                                 .sensation = defaultSensationPercent,
                                  .depth = 10,
                                  .buffer = 100,
-                                 .pattern = StrokePatterns::SimpleStroke};
+                                 .pattern = 0};
 
 OSSM::OSSM() {
     // Initialize global state from OSSM::setting
@@ -89,21 +96,57 @@ void OSSM::ble_click(String commandString) {
             session.playControl = PlayControls::SENSATION;
             encoder.setEncoderValue(command.value);
             settings.sensation = command.value;
+            streaming::wake();
             break;
         case Commands::setBuffer:
             session.playControl = PlayControls::BUFFER;
             encoder.setEncoderValue(command.value);
             settings.buffer = command.value;
             break;
+        case Commands::setVibration:
+            settings.vibration = command.value;
+            break;
+        case Commands::setVibrationFrequency:
+            settings.vibrationFrequency = command.value;
+            break;
+        case Commands::setTempo:
+            // The beat counts from when the command arrived
+            settings.tempoBeat = micros() - uint32_t(command.time) * 1000;
+            settings.tempo = command.value / 100.0f;
+            break;
         case Commands::setPattern:
-            settings.pattern = static_cast<StrokePatterns>(command.value % 7);
+            settings.pattern = command.value % PatternRegistry::count;
             break;
         case Commands::streamPosition:
-            // Position (0-100)
+            // Position (0-100), queued in hundredths
             targetQueue.push({
-                static_cast<uint8_t>(command.value),
-                static_cast<uint16_t>(command.time),
+                static_cast<uint16_t>(command.value * 100),
+                static_cast<uint32_t>(command.time),
                 std::chrono::steady_clock::now()});
+            signalTargets();
+            break;
+        case Commands::playFunscript:
+            funscript::requestPlay(parseFunscriptPath(commandString));
+            break;
+        case Commands::seekFunscript:
+            funscript::requestSeek(command.value);
+            break;
+        case Commands::stopFunscript:
+            funscript::requestStop();
+            break;
+        case Commands::playKeyframes:
+            // The stroke engine task starts the file over when it sees the
+            // new selection
+            if (KeyframePattern::select(
+                    parseKeyframesPath(commandString).c_str())) {
+                settings.pattern = PatternRegistry::indexOf<KeyframePattern>();
+            } else {
+                ESP_LOGW("OSSM", "Keyframe path too long: %s",
+                         commandString.c_str());
+            }
+            break;
+        case Commands::stopKeyframes:
+            KeyframePattern::clear();
             break;
         case Commands::setWifi:
         case Commands::ignore:
@@ -123,7 +166,7 @@ String OSSM::getStateFingerprint() {
     output += String((int)settings.stroke) + ":";
     output += String((int)settings.sensation) + ":";
     output += String((int)settings.depth) + ":";
-    output += String(static_cast<int>(settings.pattern)) + ":";
+    output += String(settings.pattern) + ":";
     output += sessionId;
     return output;
 }
@@ -146,7 +189,7 @@ String OSSM::getStateFingerprint() {
 // │   stroke     : integer  — cast from float                         │
 // │   sensation  : integer  — cast from float                         │
 // │   depth      : integer  — cast from float                         │
-// │   pattern    : integer  — StrokePatterns enum ordinal             │
+// │   pattern    : integer  — PatternRegistry index                   │
 // │   position   : number   — stepper position in mm (float)          │
 // │   sessionId  : UUID     — regenerated each time a play mode starts  │
 // │                                                                    │
@@ -175,7 +218,7 @@ String OSSM::getCurrentState() {
            ",\"sensation\":" + String((int)settings.sensation) +
            ",\"depth\":" + String((int)settings.depth) +
            ",\"buffer\":" + String((int)settings.buffer) +
-           ",\"pattern\":" + String(static_cast<int>(settings.pattern)) +
+           ",\"pattern\":" + String(settings.pattern) +
            ",\"position\":" + String(positionMm, 2) +
            ",\"sessionId\":\"" + sessionId +
            "\",\"firmwareProvenanceId\":\"" + provenanceId + "\"}";
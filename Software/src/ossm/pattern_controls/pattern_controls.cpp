@@ -1,5 +1,6 @@
 #include "pattern_controls.h"
 
+#include "PatternRegistry.h"
 #include "Strings.h"
 #include "constants/Pins.h"
 #include "services/board.h"
@@ -19,10 +20,7 @@ using namespace sml;
 
 namespace pattern_controls {
 
-static size_t numberOfDescriptions =
-    sizeof(ui::strings::strokeEngineDescriptions) /
-    sizeof(ui::strings::strokeEngineDescriptions[0]);
-static size_t numberOfPatterns = 7;
+static constexpr size_t numberOfPatterns = PatternRegistry::count;
 
 static void drawPatternControlsTask(void *pvParameters) {
     SettingPercents savedSettings = settings;
@@ -31,11 +29,10 @@ static void drawPatternControlsTask(void *pvParameters) {
         return stateMachine->is("strokeEngine.pattern"_s);
     };
 
-    int nextPattern = (int)settings.pattern;
+    int nextPattern = settings.pattern;
     bool shouldUpdateDisplay = true;
     const char *patternName = "nextPattern";
-    const char *patternDescription =
-        ui::strings::strokeEngineDescriptions[nextPattern];
+    const char *patternDescription = PatternRegistry::description(nextPattern);
 
     encoder.setAcceleration(10);
     encoder.setBoundaries(0, numberOfPatterns * 3 - 1, true);
@@ -62,22 +59,20 @@ static void drawPatternControlsTask(void *pvParameters) {
 
         nextPattern = encoder.readEncoder() / 3;
         shouldUpdateDisplay =
-            shouldUpdateDisplay || (int)settings.pattern != nextPattern;
+            shouldUpdateDisplay || settings.pattern != nextPattern;
         if (!shouldUpdateDisplay) {
             vTaskDelay(100);
             continue;
         }
 
-        patternName = ui::strings::strokeEngineNames[nextPattern];
+        patternName = PatternRegistry::name(nextPattern);
 
-        if (nextPattern < (int)numberOfDescriptions) {
-            patternDescription =
-                ui::strings::strokeEngineDescriptions[nextPattern];
-        } else {
+        patternDescription = PatternRegistry::description(nextPattern);
+        if (patternDescription[0] == '\0') {
             patternDescription = ui::strings::noDescription;
         }
 
-        settings.pattern = (StrokePatterns)nextPattern;
+        settings.pattern = nextPattern;
 
         if (xSemaphoreTake(displayMutex, 100) == pdTRUE) {
             ui::TextPage page;
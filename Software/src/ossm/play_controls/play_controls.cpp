@@ -1,5 +1,6 @@
 #include "play_controls.h"
 
+#include "PatternRegistry.h"
 #include "Strings.h"
 #include "constants/Menu.h"
 #include "constants/Pins.h"
@@ -9,6 +10,7 @@
 #include "ossm/state/session.h"
 #include "ossm/state/settings.h"
 #include "ossm/state/state.h"
+#include "ossm/streaming/streaming.h"
 #include "services/display.h"
 #include "services/encoder.h"
 #include "services/tasks.h"
@@ -103,6 +105,7 @@ static void drawPlayControlsTask(void *pvParameters) {
         if (next.speed != settings.speed) {
             shouldUpdateDisplay = true;
             settings.speed = next.speed;
+            streaming::wake();
         }
 
         settings.speedKnob = next.speedKnob;
@@ -119,7 +122,10 @@ static void drawPlayControlsTask(void *pvParameters) {
                 next.sensation = encoderValue;
                 shouldUpdateDisplay = shouldUpdateDisplay ||
                                       next.sensation - settings.sensation >= 1;
-                settings.sensation = next.sensation;
+                if (next.sensation != settings.sensation) {
+                    settings.sensation = next.sensation;
+                    streaming::wake();
+                }
                 break;
             case PlayControls::DEPTH:
                 next.depth = encoderValue;
@@ -148,8 +154,7 @@ static void drawPlayControlsTask(void *pvParameters) {
         if (xSemaphoreTake(displayMutex, 100) == pdTRUE) {
             const char *headerText;
             if (isStrokeEngine) {
-                headerText =
-                    ui::strings::strokeEngineNames[(int)settings.pattern];
+                headerText = PatternRegistry::name(settings.pattern);
             } else if (isStreaming) {
                 headerText = ui::strings::streaming;
             } else {
@@ -175,7 +180,7 @@ static void drawPlayControlsTask(void *pvParameters) {
             data.strokeCount = session.strokeCount;
             data.distanceMeters = session.distanceMeters;
             data.elapsedMs = displayLastUpdated - session.startTime;
-            data.pattern = (int)settings.pattern;
+            data.pattern = settings.pattern;
             data.isStrokeEngine = isStrokeEngine;
             data.isStreaming = isStreaming;
             data.headerText = headerText;
@@ -152,6 +152,8 @@ void ossmStartStrokeEngine() {
 void ossmEmergencyStop() {
     stepper->forceStop();
     stepper->disableOutputs();
+    // The state has changed already, a streaming task sees it and ends
+    streaming::wake();
 }
 
 void ossmDrawHelp() {
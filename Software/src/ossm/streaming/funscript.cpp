@@ -0,0 +1,168 @@
+#include "funscript.h"
+
+#include <LittleFS.h>
+
+#include "funscript_logic.h"
+#include "ring_buffer.h"
+#include "services/communication/queue.h"
+
+namespace funscript {
+
+namespace {
+
+// Script file on the LittleFS partition, open while it plays
+class FileSource : public funscript_logic::Source {
+  public:
+    bool open(const char *path) {
+        close();
+        if (!LittleFS.begin(false)) return false;
+        _file = LittleFS.open(path, "r");
+        return bool(_file);
+    }
+
+    void close() {
+        if (_file) _file.close();
+    }
+
+    uint32_t size() override { return _file ? uint32_t(_file.size()) : 0; }
+
+    size_t read(uint32_t offset, uint8_t *buffer, size_t length) override {
+        if (!_file || !_file.seek(offset)) return 0;
+        return _file.read(buffer, length);
+    }
+
+  private:
+    File _file;
+};
+
+enum class Request : uint8_t { None, Play, Seek, Stop };
+
+struct PendingRequest {
+    Request request;
+    uint32_t ms;
+    char path[64];
+};
+
+// Pushed by the BLE handler, taken by the streaming task in order, so a
+// play followed by a seek before the task looks does both. Should requests
+// pile up faster than that, the oldest give way.
+ring_buffer::Ring<PendingRequest, 4> pendingRequests(
+    ring_buffer::Overflow::DropOldest);
+
+// Streaming task only
+FileSource source;
+funscript_logic::Reader<> reader;
+funscript_logic::Timeline timeline;
+funscript_logic::Action pending = {0, 0};
+bool hasPending = false;
+bool playing = false;
+uint32_t startMillis = 0;  // millis() at script time 0
+
+void stop() {
+    playing = false;
+    hasPending = false;
+    source.close();
+}
+
+void seek(uint32_t ms) {
+    reader.seek(ms);
+    timeline.reset(ms);
+    hasPending = false;
+    startMillis = millis() - ms;
+}
+
+void play(const char *path) {
+    stop();
+    if (!source.open(path) || !reader.open(&source)) {
+        ESP_LOGE("Funscript", "Can't open %s", path);
+        source.close();
+        return;
+    }
+    reader.prefetch();
+    if (reader.failed()) {
+        ESP_LOGE("Funscript", "Not a funscript: %s", path);
+        source.close();
+        return;
+    }
+    ESP_LOGI("Funscript", "Playing %s (%u bytes)", path, source.size());
+    playing = true;
+    seek(0);
+}
+
+// Reads the action to move to next, unless it is read already. False once
+// the script has ended.
+bool peek() {
+    if (hasPending) return true;
+    if (!reader.next(pending)) {
+        ESP_LOGI("Funscript", "Finished, %u underruns", reader.underruns());
+        stop();
+        return false;
+    }
+    hasPending = true;
+    return true;
+}
+
+}  // namespace
+
+void requestPlay(const String &path) {
+    PendingRequest request = {Request::Play, 0, {}};
+    strlcpy(request.path, path.c_str(), sizeof(request.path));
+    pendingRequests.push(request);
+    signalTargets();
+}
+
+void requestSeek(uint32_t ms) {
+    pendingRequests.push({Request::Seek, ms, {}});
+    signalTargets();
+}
+
+void requestStop() {
+    pendingRequests.push({Request::Stop, 0, {}});
+    signalTargets();
+}
+
+void update() {
+    // Never waits for the BLE handler. A request still being pushed is taken
+    // on the next update, the handler wakes the streaming task once done.
+    PendingRequest taken;
+    while (pendingRequests.pop(taken)) {
+        switch (taken.request) {
+            case Request::Play:
+                play(taken.path);
+                break;
+            case Request::Seek:
+                if (playing) seek(taken.ms);
+                break;
+            case Request::Stop:
+                stop();
+                break;
+            case Request::None:
+                break;
+        }
+    }
+    if (playing) reader.prefetch();
+}
+
+bool isPlaying() { return playing; }
+
+bool nextTarget(uint8_t &position, uint16_t &inTime) {
+    if (!playing || !peek()) return false;
+
+    // The move to an action starts when the one before it is reached
+    uint32_t now = millis() - startMillis;
+    if (now < timeline.previousAt) return false;
+
+    uint32_t time = timeline.moveTime(pending);
+    hasPending = false;
+    position = reader.inverted() ? 100 - pending.pos : pending.pos;
+    inTime = time > UINT16_MAX ? UINT16_MAX : uint16_t(time);
+    return true;
+}
+
+uint32_t msUntilNextTarget() {
+    if (!playing || !peek()) return 0;
+    uint32_t now = millis() - startMillis;
+    return now < timeline.previousAt ? timeline.previousAt - now : 0;
+}
+
+}  // namespace funscript
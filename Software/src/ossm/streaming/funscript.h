@@ -0,0 +1,46 @@
+#ifndef OSSM_STREAMING_FUNSCRIPT_H
+#define OSSM_STREAMING_FUNSCRIPT_H
+
+#include <Arduino.h>
+
+namespace funscript {
+
+    /**
+     * Play a funscript from the LittleFS partition in streaming mode.
+     * Requests are picked up by the streaming task, so these can be called
+     * from the BLE command handler. Each one wakes the streaming task.
+     */
+    void requestPlay(const String &path);
+
+    /** Continue playback at ms script time. */
+    void requestSeek(uint32_t ms);
+
+    /** Stop playback and go back to following stream: commands. */
+    void requestStop();
+
+    /**
+     * Streaming task side: apply requests and top up the prefetch ring.
+     * Call once per loop.
+     */
+    void update();
+
+    /** True while a script is playing. */
+    bool isPlaying();
+
+    /**
+     * Next point to move to, once it is due.
+     * @param position 0-100, with the script's "inverted" applied
+     * @param inTime ms the move may take
+     * @return false if nothing is due yet
+     */
+    bool nextTarget(uint8_t &position, uint16_t &inTime);
+
+    /**
+     * Time until nextTarget() has the next point, so the streaming task can
+     * sleep until then. 0 if it has one now or the script has ended.
+     */
+    uint32_t msUntilNextTarget();
+
+}  // namespace funscript
+
+#endif  // OSSM_STREAMING_FUNSCRIPT_H
@@ -1,9 +1,12 @@
 #include "streaming.h"
 
-#include <queue>
 #include <chrono>
-#include "streaming_logic.h"
+#include <queue>
+
 #include "constants/Config.h"
+#include "funscript.h"
+#include "jitter_buffer.h"
+#include "ossm/stroke_engine/stroke_engine.h"
 #include "ossm/state/calibration.h"
 #include "ossm/state/session.h"
 #include "ossm/state/settings.h"
@@ -13,19 +16,46 @@
 #include "services/communication/queue.h"
 #include "services/stepper.h"
 #include "services/tasks.h"
+#include "streaming_logic.h"
 
 namespace sml = boost::sml;
 using namespace sml;
 
 namespace streaming {
 
+// Where a stream position (0-100) is within the current stroke and depth
+// settings, in the StrokeEngine frame
+static float streamPosition(float position, float keepout) {
+    int32_t maxStroke = streaming_logic::calculateMaxStroke(
+        settings.stroke, settings.depth, calibration.measuredStrokeSteps);
+    int32_t depth = streaming_logic::calculateDepthOffset(
+        calibration.measuredStrokeSteps, maxStroke, settings.depth);
+    int32_t native =
+        streaming_logic::scaleStreamPosition(position, maxStroke, depth);
+    return streaming_logic::toStrokeEnginePosition(native, keepout, 1_mm);
+}
+
+// micros() at which a BLE command was received
+static uint32_t receivedMicros(const PositionTime &target) {
+    auto age = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - target.setTime);
+    return micros() - uint32_t(age.count());
+}
+
+// millis() at which a BLE command was received
+static uint32_t receivedMillis(const PositionTime &target) {
+    auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - target.setTime);
+    return millis() - uint32_t(age.count());
+}
+
 static void startStreamingTask(void *pvParameters) {
-    // Own the shared stepper config at mode entry (see simple_penetration.cpp:
-    // StrokeEngine leaves the shared DIR polarity inverted and the counter in
-    // its own frame; this mode's targets are native-frame absolutes).
-    stepperTranslateFrame(StepperFrame::Native);
-    stepper->setDirectionPin(Pins::Driver::motorDirectionPin, false);
-    stepper->enableOutputs();
+    // Streamed moves are planned and run by the StrokeEngine, in its frame
+    machineGeometry strokingMachine;
+    stroke_engine::beginStroker(strokingMachine);
+    Stroker.startStreaming();
+    // A segment starting means room for a target the engine turned away
+    Stroker.setStreamCallback(signalTargets);
 
     auto isInCorrectState = []() {
         return stateMachine->is("streaming"_s) ||
@@ -33,134 +63,124 @@ static void startStreamingTask(void *pvParameters) {
                stateMachine->is("streaming.idle"_s);
     };
 
-    auto best = std::chrono::steady_clock::now();
-    PositionTime lastPositionTime;
-    
     // Reset the queue to clear any existing commands
-    targetQueue = {};
-    
-    // Motion state
-    int16_t currentPosition = 0;
-    int16_t targetPosition = 0;
-
-    uint16_t maxSpeed = Config::Driver::maxSpeedMmPerSecond * (1_mm);
-    uint32_t maxAccel = Config::Driver::maxAcceleration * (1_mm);
-
-    // Set initial max speed and acceleration
-    stepper->setSpeedInHz(maxSpeed);
-    stepper->setAcceleration(maxAccel);
+    targetQueue.clear();
+    PositionTime target;
+    bool pending = false;  // target popped but not yet taken by the engine
+    uint32_t lastInTime = 0;
+    // Targets stamped in device time play after a delay sized to the link
+    jitter_buffer::PlayoutDelay playout;
+    std::chrono::steady_clock::time_point lastWrite = {};
+    float lastSpeed = -1.0f;
+    float lastSensation = -1.0f;
 
     while (isInCorrectState()) {
-        uint16_t currentBuffer = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - best).count();
-        // Wait for new command from BLE
-        if (targetQueue.empty()){
-            vTaskDelay(1);
-            continue;
+        // Speed and sensation limit the speed and acceleration of the moves
+        if (settings.speed != lastSpeed ||
+            settings.sensation != lastSensation) {
+            Stroker.setStreamLimits(
+                Config::Driver::maxSpeedMmPerSecond * settings.speed / 100.0f,
+                Config::Driver::maxAcceleration * settings.sensation / 100.0f);
+            lastSpeed = settings.speed;
+            lastSensation = settings.sensation;
         }
-        // Get next move
-        PositionTime targetPositionTime = targetQueue.front();
-        //Wait for previous command to finish if it isn't moving in the same direction.
-        int16_t distance = targetPositionTime.position - lastPositionTime.position;
-        targetPositionTime.direction = distance/abs(distance);
-        bool sameDirection = lastPositionTime.direction == targetPositionTime.direction;
-        if (!sameDirection && stepper->isRunning()){
-            vTaskDelay(1);
+        // skip movement if speeds are 0
+        bool halted = settings.speed < 0.1f || settings.sensation < 0.1f;
+
+        // A playing funscript takes over from stream: commands
+        funscript::update();
+        if (funscript::isPlaying()) {
+            targetQueue.clear();
+            pending = false;
+            uint8_t position;
+            uint16_t inTime;
+            if (funscript::nextTarget(position, inTime) && !halted) {
+                Stroker.streamTo(
+                    streamPosition(position, strokingMachine.keepoutBoundary),
+                    micros() + inTime * 1000UL);
+                ESP_LOGD("Streaming", "Script P(%d), T: %u", position, inTime);
+            }
+            // Sleep until the next point is due, or a request, settings or
+            // state change comes in
+            xSemaphoreTake(targetSignal,
+                           pdMS_TO_TICKS(funscript::msUntilNextTarget()));
             continue;
         }
-        targetQueue.pop();
-        
-        float timeSeconds = targetPositionTime.inTime / 1000.0f;
-        
-        // settime is when the message was received. If we trust the source we can reduce perceived lag by creating a buffer.
-        if (USE_LATENCY_COMPENSATION){
-            int16_t mincomp =  min(int(settings.buffer * 2),int(lastPositionTime.inTime));
-            int16_t offset = mincomp - currentBuffer;
-            int16_t lag = std::chrono::duration_cast<std::chrono::milliseconds>(targetPositionTime.setTime - best).count();
-            if (lag < 0 || lag > mincomp * 10){
-                best = targetPositionTime.setTime;
-                lag = 0;
-                offset = 0;
-            }
-            best += std::chrono::milliseconds(targetPositionTime.inTime);
-            ESP_LOGD("Streaming", "Lagency Compensation - Lag: %d, Buffer: %d/%d", lag, currentBuffer, mincomp);
-            if (offset < 0){
-                // Shorten time up to 1/4 of the total time.
-                offset = max(int16_t(targetPositionTime.inTime/-4), offset);
+
+        // Hand new commands from BLE to the StrokeEngine
+        while (pending || targetQueue.pop(target)) {
+            pending = false;
+            if (halted) {
+                ESP_LOGI("Streaming", "Speed or accel too slow, skipping moves");
+                continue;
             }
-            timeSeconds += offset/1000.0f;
-        } else {
-            best = std::chrono::steady_clock::now();
-        }
-        lastPositionTime = targetPositionTime;
-        //Grab the minimal value between depth and stroke, use as max stroke length.
-        int32_t maxStroke = streaming_logic::calculateMaxStroke(
-            settings.stroke, settings.depth,
-            calibration.measuredStrokeSteps);
-        //Set 100% at max depth and constrain speeds based on user inputs.
-        int32_t depth = streaming_logic::calculateDepthOffset(
-            calibration.measuredStrokeSteps, maxStroke, settings.depth);
-        uint32_t speedLimit = maxSpeed * (settings.speed/100.0);
-        uint32_t accelLimit = maxAccel * (settings.sensation/100.0);
-        // skip movement if speeds are 0
-        if (speedLimit > 0 && accelLimit > 0){
-            targetPosition = streaming_logic::scaleStreamPosition(
-                targetPositionTime.position, maxStroke, depth);
-            currentPosition = stepper->getCurrentPosition();
-            // Calculate distance to travel (in steps)
-            distance = abs(targetPosition - currentPosition);
-            if (timeSeconds > 0.01f && distance > 1.0f) {
-                //Find max distance possible to travel given available time, max acceleration, and max speed.
-                int32_t maxDistance = accelLimit * pow(timeSeconds/2,2);
-                //This technically optimistic... the speed limit assumes perfect acceleration
-                maxDistance = min(maxDistance, int32_t(speedLimit * timeSeconds));
-                //if the distance asked for is greater then the maximum possible, reduce the ask.
-                //Is it what they asked for? No. Will they notice at these speeds? Hopefully not.
-                if (distance > maxDistance){
-                    ESP_LOGI("Streaming","Too fast, shortening distance: %.0f -> %.0f",distance,maxDistance);
-                    distance = maxDistance - (2_mm);
-                    if (targetPosition > currentPosition) {
-                        targetPosition = currentPosition + distance;
-                    } else {
-                        targetPosition = currentPosition - distance;
-                    }
+
+            uint32_t arrival;
+            if (target.deviceTime) {
+                // Clock synced clients say when a target is due. All of
+                // them play the same delay later, so their spacing holds.
+                // The first target of a write is the one most likely late.
+                if (target.setTime != lastWrite) {
+                    lastWrite = target.setTime;
+                    playout.arrived(
+                        int32_t(receivedMillis(target) - target.inTime));
                 }
-                // start by calculating a triangular motion with unlimited
-                uint32_t requiredSpeed = (2 * distance) / timeSeconds;
-                // constrain it to legal maximums
-                requiredSpeed = constrain(requiredSpeed, 100.0f, speedLimit);
-                // calculate what proportion of the move needs to be at max speed, if any.
-                float vt = requiredSpeed * timeSeconds;
-                float proportion = max(-((2 * distance - 2 * vt)/vt),0.01f);
-                // calculate acceleration such that triangle or trapezoid is created depending on needs
-                uint32_t requiredAccel = requiredSpeed / (timeSeconds * proportion / 2);
-                // constrain just in case, but reducing the distance should mostly preven this.
-                requiredAccel = constrain(requiredAccel, 100.0f, accelLimit);
-                if (stepper->isRunning()){
-                    requiredAccel = max(stepper->getAcceleration(),requiredAccel);
+                int32_t wait =
+                    int32_t(target.inTime + playout.delay() - millis());
+                arrival = micros() + uint32_t(wait) * 1000UL;
+            } else {
+                // Commands are due inTime after they were received. If we
+                // trust the source, play them back a little later so a late
+                // command still gets its full time.
+                arrival = receivedMicros(target) + target.inTime * 1000UL;
+                if (USE_LATENCY_COMPENSATION) {
+                    arrival +=
+                        min(int(settings.buffer * 2), int(lastInTime)) * 1000UL;
                 }
-                stepper->setAcceleration(requiredAccel);
-                stepper->setSpeedInHz(requiredSpeed);
-                stepper->moveTo(targetPosition, false);
+            }
 
-                ESP_LOGI("Streaming", "P(%d): %d -> %d = %d, T: %.3f, S: %d, A: %d, Q: %d",
-                        targetPositionTime.position, currentPosition, targetPosition, distance, 
-                        timeSeconds, requiredSpeed, requiredAccel, targetQueue.size());
+            // Segment queue full, try again once the next segment has started
+            if (!Stroker.streamTo(streamPosition(target.position / 100.0f,
+                                                 strokingMachine.keepoutBoundary),
+                                  arrival)) {
+                pending = true;
+                break;
+            }
+            ESP_LOGD("Streaming", "P(%.2f), T: %u, Q: %u, lost: %u, D: %u",
+                     target.position / 100.0f, unsigned(target.inTime),
+                     unsigned(Stroker.getStreamQueued()),
+                     unsigned(targetQueue.overflows()),
+                     unsigned(playout.delay()));
+            if (!target.deviceTime) {
+                lastInTime = target.inTime;
             }
-        } else {
-            ESP_LOGI("Streaming", "Spped or accel too slow, skipping moves");
         }
-        vTaskDelay(1);
+        // Sleep until BLE pushes targets, the engine takes the pending one,
+        // or a funscript request, settings or state change comes in
+        xSemaphoreTake(targetSignal, portMAX_DELAY);
     }
 
+    Stroker.setStreamCallback(nullptr);
+    funscript::requestStop();
+    funscript::update();
+    Stroker.stopMotion();
+
     vTaskDelete(nullptr);
 }
 
 void startStreaming() {
     int stackSize = 10 * configMINIMAL_STACK_SIZE;
+    if (targetSignal == nullptr) {
+        targetSignal = xSemaphoreCreateBinary();
+    }
 
+    // One below the StrokeEngine streaming task, so feeding it never delays
+    // a segment start
     xTaskCreatePinnedToCore(startStreamingTask, "startStreamingTask", stackSize,
-                            nullptr, configMAX_PRIORITIES - 1, nullptr,
+                            nullptr, configMAX_PRIORITIES - 2, nullptr,
                             Tasks::operationTaskCore);
 }
 
-}  // namespace simple_penetration
+void wake() { signalTargets(); }
+
+}  // namespace streaming
@@ -9,6 +9,12 @@ namespace streaming {
      */
     void startStreaming();
 
-}  // namespace simple_penetration
+    /**
+     * Wake the streaming task to look at the settings and state again
+     * Call after changing speed or sensation, or leaving streaming
+     */
+    void wake();
+
+}  // namespace streaming
 
 #endif  // OSSM_STREAMING_H
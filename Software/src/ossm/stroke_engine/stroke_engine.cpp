@@ -1,5 +1,6 @@
 #include "stroke_engine.h"
 
+#include <ArduinoJson.h>
 #include <mqtt_client.h>
 
 #include "constants/UserConfig.h"
@@ -21,13 +22,10 @@ using namespace sml;
 
 namespace stroke_engine {
 
-static void startStrokeEngineTask(void *pvParameters) {
-    float measuredStrokeMm = calibration.measuredStrokeSteps / (1_mm);
-
-    machineGeometry strokingMachine = {
+void beginStroker(machineGeometry &strokingMachine) {
+    strokingMachine = {
         .physicalTravel = abs(calibration.measuredStrokeSteps / (1_mm)),
         .keepoutBoundary = 6.0};
-    SettingPercents lastSetting = settings;
 
     // Adopt the StrokeEngine origin only when entering right after a real
     // physical home (justHomed) AND the carriage is actually at the homed rest
@@ -52,12 +50,34 @@ static void startStrokeEngineTask(void *pvParameters) {
     }
 
     Stroker.begin(&strokingMachine, &servoMotor, stepper);
+    Stroker.setLookahead(Config::Driver::strokeLookahead);
+    Stroker.setCrossfade(Config::Driver::patternCrossfadeStrokes);
     Stroker.thisIsHome(5.0f, atHome);
+}
+
+// The vibration amplitude is a share of what the machine can do at the
+// frequency, so every setting is within reach
+static void applyVibration(const SettingPercents &setting) {
+    float frequency = setting.vibrationFrequency;
+    Stroker.setVibration(0.01f * setting.vibration *
+                             Stroker.getMaxVibrationAmplitude(frequency),
+                         frequency);
+}
+
+static void startStrokeEngineTask(void *pvParameters) {
+    float measuredStrokeMm = calibration.measuredStrokeSteps / (1_mm);
+
+    machineGeometry strokingMachine;
+    beginStroker(strokingMachine);
+    SettingPercents lastSetting = settings;
+    uint32_t lastKeyframes = KeyframePattern::revision();
 
     Stroker.setSensation(calculateSensation(settings.sensation), true);
 
     Stroker.setDepth(0.01f * settings.depth * abs(measuredStrokeMm), true);
     Stroker.setStroke(0.01f * settings.stroke * abs(measuredStrokeMm), true);
+    applyVibration(settings);
+    Stroker.setTempo(settings.tempo, settings.tempoBeat);
 
     auto isInCorrectState = []() {
         // Add any states that you want to support here.
@@ -71,7 +91,7 @@ static void startStrokeEngineTask(void *pvParameters) {
             wasLastSpeedCommandFromBLE()) {
             // Speed is float, so give a little wiggle room here to assume 0
             if (settings.speed < 0.1f) {
-                Stroker.stopMotion();
+                Stroker.stopMotionAsync();
             } else if (Stroker.getState() == READY) {
                 Stroker.startPattern();
             }
@@ -103,38 +123,35 @@ static void startStrokeEngineTask(void *pvParameters) {
             lastSetting.sensation = settings.sensation;
         }
 
-        if (lastSetting.pattern != settings.pattern) {
+        if (lastSetting.vibration != settings.vibration ||
+            lastSetting.vibrationFrequency != settings.vibrationFrequency) {
+            ESP_LOGD("UTILS", "change vibration: %f %% at %f Hz",
+                     settings.vibration, settings.vibrationFrequency);
+            applyVibration(settings);
+            lastSetting.vibration = settings.vibration;
+            lastSetting.vibrationFrequency = settings.vibrationFrequency;
+        }
+
+        if (lastSetting.tempo != settings.tempo ||
+            lastSetting.tempoBeat != settings.tempoBeat) {
+            ESP_LOGD("UTILS", "change tempo: %f bpm", settings.tempo);
+            Stroker.setTempo(settings.tempo, settings.tempoBeat);
+            lastSetting.tempo = settings.tempo;
+            lastSetting.tempoBeat = settings.tempoBeat;
+        }
+
+        // A newly selected keyframe file plays from a fresh instance
+        bool keyframesChanged =
+            lastKeyframes != KeyframePattern::revision() &&
+            settings.pattern == PatternRegistry::indexOf<KeyframePattern>();
+
+        if (lastSetting.pattern != settings.pattern || keyframesChanged) {
             ESP_LOGD("UTILS", "change pattern: %d", settings.pattern);
 
-            switch (settings.pattern) {
-                case StrokePatterns::SimpleStroke:
-                    Stroker.setPattern(new SimpleStroke("Simple Stroke"),
-                                       false);
-                    break;
-                case StrokePatterns::TeasingPounding:
-                    Stroker.setPattern(new TeasingPounding("Teasing Pounding"),
-                                       false);
-                    break;
-                case StrokePatterns::RoboStroke:
-                    Stroker.setPattern(new RoboStroke("Robo Stroke"), false);
-                    break;
-                case StrokePatterns::HalfnHalf:
-                    Stroker.setPattern(new HalfnHalf("Half'n'Half"), false);
-                    break;
-                case StrokePatterns::Deeper:
-                    Stroker.setPattern(new Deeper("Deeper"), false);
-                    break;
-                case StrokePatterns::StopNGo:
-                    Stroker.setPattern(new StopNGo("Stop'n'Go"), false);
-                    break;
-                case StrokePatterns::Insist:
-                    Stroker.setPattern(new Insist("Insist"), false);
-                    break;
-                default:
-                    break;
-            }
+            Stroker.setPattern(settings.pattern, false);
 
             lastSetting.pattern = settings.pattern;
+            lastKeyframes = KeyframePattern::revision();
         }
 
         if (bleState.hasActiveConnection) {
@@ -151,6 +168,60 @@ static void startStrokeEngineTask(void *pvParameters) {
     vTaskDelete(nullptr);
 }
 
+// Publishes a batch of moves to ossm/<mac>/telemetry, one array per move:
+// [micros, position mm, speed mm/s, acceleration mm/s², pattern index or -1,
+// MotionClip flags]
+static void publishTelemetry(const String &topic,
+                             const telemetryRecord *records, size_t count) {
+    JsonDocument document;
+    document["timestamp"] = millis();
+    document["sessionId"] = sessionId;
+    JsonArray moves = document["moves"].to<JsonArray>();
+    for (size_t i = 0; i < count; i++) {
+        JsonArray move = moves.add<JsonArray>();
+        move.add(records[i].micros);
+        move.add(records[i].position);
+        move.add(records[i].speed);
+        move.add(records[i].acceleration);
+        move.add(records[i].index);
+        move.add(records[i].clipping);
+    }
+
+    String payload;
+    serializeJson(document, payload);
+    int result = esp_mqtt_client_publish(mqttClient, topic.c_str(),
+                                         payload.c_str(), payload.length(),
+                                         0, false);
+    if (result < 0) {
+        ESP_LOGD("TELEMETRY", "Publish failed: %d", result);
+    }
+}
+
+// Reads the moves queued by the stroking task and publishes them, or drops
+// them while nobody listens. Runs at low priority, a slow read here only
+// ever costs telemetry records, never motion.
+static void drainTelemetry(const String *topic) {
+    static uint32_t reportedOverflows = 0;
+    telemetryRecord records[8];
+    size_t count;
+
+    while ((count = Stroker.readTelemetry(records, 8)) > 0) {
+        if (topic != nullptr) {
+            publishTelemetry(*topic, records, count);
+        }
+    }
+
+    // Records dropped while nobody listened are no loss
+    uint32_t overflows = Stroker.getTelemetryOverflows();
+    if (overflows != reportedOverflows && topic != nullptr) {
+        ESP_LOGW("TELEMETRY", "%u records dropped, high water %u of %u",
+                 (unsigned)(overflows - reportedOverflows),
+                 (unsigned)Stroker.getTelemetryHighWater(),
+                 (unsigned)STROKE_TELEMETRY_CAPACITY);
+    }
+    reportedOverflows = overflows;
+}
+
 static void publishStateTask(void *pvParameters) {
     auto isInCorrectState = []() {
         return stateMachine->is("strokeEngine"_s) ||
@@ -160,12 +231,17 @@ static void publishStateTask(void *pvParameters) {
 
     const TickType_t publishInterval = pdMS_TO_TICKS(
         (int)(1000.0f / UserConfig::mqttPublishFrequencyHz));
+    const String topic = "ossm/" + getMacAddress();
+    const String telemetryTopic = topic + "/telemetry";
 
     TickType_t lastWakeTime = xTaskGetTickCount();
 
     while (isInCorrectState()) {
+        // Nobody to publish to. Look again in a second and drop what queued
+        // up meanwhile.
         if (!mqttConnected || !pages::isOssmPaired()) {
             vTaskDelay(pdMS_TO_TICKS(1000));
+            drainTelemetry(nullptr);
             lastWakeTime = xTaskGetTickCount();
             continue;
         }
@@ -173,7 +249,6 @@ static void publishStateTask(void *pvParameters) {
         vTaskDelayUntil(&lastWakeTime, publishInterval);
 
         String payload = ossm->getCurrentState();
-        String topic = "ossm/" + getMacAddress();
 
         int result = esp_mqtt_client_publish(
             mqttClient, topic.c_str(), payload.c_str(), payload.length(), 0,
@@ -181,9 +256,13 @@ static void publishStateTask(void *pvParameters) {
 
         if (result < 0) {
             ESP_LOGD("MQTT", "Publish failed: %d", result);
+            drainTelemetry(nullptr);
             vTaskDelay(pdMS_TO_TICKS(1000));
             lastWakeTime = xTaskGetTickCount();
+            continue;
         }
+
+        drainTelemetry(&telemetryTopic);
     }
 
     vTaskDelete(nullptr);
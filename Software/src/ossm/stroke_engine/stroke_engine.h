@@ -1,8 +1,19 @@
 #ifndef OSSM_STROKE_ENGINE_STROKE_ENGINE_H
 #define OSSM_STROKE_ENGINE_STROKE_ENGINE_H
 
+#include "StrokeEngine.h"
+
 namespace stroke_engine {
 
+/**
+ * Hand the stepper to the StrokeEngine: translate the shared counter into
+ * the StrokeEngine frame, begin Stroker and mark it homed. For every mode
+ * moving through the StrokeEngine.
+ * @param strokingMachine receives the geometry. Stroker keeps a pointer to
+ * it, so it has to outlive the mode.
+ */
+void beginStroker(machineGeometry &strokingMachine);
+
 /**
  * Start the stroke engine motion task
  * Uses StrokeEngine library for complex motion patterns
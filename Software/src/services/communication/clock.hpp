@@ -0,0 +1,43 @@
+#ifndef OSSM_COMMUNICATION_CLOCK_HPP
+#define OSSM_COMMUNICATION_CLOCK_HPP
+
+#include "Arduino.h"
+#include "NimBLECharacteristic.h"
+#include "NimBLEService.h"
+#include "NimBLEUUID.h"
+#include "clock_sync.h"
+#include "constants/LogTags.h"
+#include "esp_log.h"
+
+/** Clock sync, see lib/OSSMLogic/src/clock_sync.h. A client subscribes,
+ *  writes its time and gets it back with the device's millis() on
+ *  arrival and departure. */
+class ClockCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic,
+                 NimBLEConnInfo& connInfo) override {
+        uint32_t received = millis();
+        const NimBLEAttValue& value = pCharacteristic->getValue();
+        uint8_t reply[clock_sync::replySize];
+        if (clock_sync::reply(value.data(), value.size(), received, millis(),
+                              reply) == 0) {
+            ESP_LOGD(NIMBLE_TAG, "Clock sync request rejected, %u bytes",
+                     unsigned(value.size()));
+            return;
+        }
+        pCharacteristic->setValue(reply, sizeof(reply));
+        pCharacteristic->notify();
+    }
+} inline clockCallbacks;
+
+inline NimBLECharacteristic* initClockCharacteristic(NimBLEService* pService,
+                                                     NimBLEUUID uuid) {
+    NimBLECharacteristic* pClockChar = pService->createCharacteristic(
+        uuid,
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR |
+            NIMBLE_PROPERTY::NOTIFY,
+        clock_sync::replySize);
+    pClockChar->setCallbacks(&clockCallbacks);
+    return pClockChar;
+}
+
+#endif  // OSSM_COMMUNICATION_CLOCK_HPP
@@ -7,6 +7,7 @@
 
 #include <queue>
 
+#include "clock.hpp"
 #include "command.hpp"
 #include "command/commands.hpp"
 #include "config.hpp"
@@ -14,10 +15,12 @@
 #include "ossm/OSSM.h"
 #include "pairing.hpp"
 #include "patterns.hpp"
+#include "program.hpp"
 #include "rad_ble.h"
 #include "rename.hpp"
 #include "services/led.h"
 #include "state.hpp"
+#include "stream.hpp"
 #include "wifi.hpp"
 
 // Define the global variables
@@ -112,15 +115,18 @@ class FTSCallbacks : public NimBLECharacteristicCallbacks {
         std::string value = pCharacteristic->getValue();
 
         // Expected format: [position, timeHigh, timeLow]
-        // position: uint8 (0-180), convert to 100
+        // position: uint8 (0-180), convert to hundredths of a percent
         // time: uint16 big-endian (MSB first)
         if (value.length() >= 3) {
-            uint8_t position = static_cast<uint8_t>(value[0]/1.8);
+            uint16_t position =
+                static_cast<uint16_t>(static_cast<uint8_t>(value[0]) * 10000 / 180);
             uint16_t time = (static_cast<uint8_t>(value[1]) << 8) |
                             static_cast<uint8_t>(value[2]);
 
-            ESP_LOGI("NIMBLE", "FTS Command - Position: %d, Time: %d ms", position, time);
+            ESP_LOGI("NIMBLE", "FTS Command - Position: %.2f, Time: %d ms",
+                     position / 100.0f, time);
             targetQueue.push({position, time, std::chrono::steady_clock::now()});
+            signalTargets();
 
         } else {
             ESP_LOGW("NIMBLE", "FTS write - Invalid data length: %d bytes",
@@ -324,6 +330,11 @@ void initNimble() {
     initRenameConfigCharacteristic(pService,
                                  NimBLEUUID(CHARACTERISTIC_RENAME_CONFIG_UUID));
 
+    initStreamPacketCharacteristic(pService,
+                                   NimBLEUUID(CHARACTERISTIC_STREAM_UUID));
+
+    initClockCharacteristic(pService, NimBLEUUID(CHARACTERISTIC_CLOCK_UUID));
+
     pStateCharacteristic = initStateCharacteristic(
         pService, NimBLEUUID(CHARACTERISTIC_STATE_UUID));
 
@@ -331,6 +342,8 @@ void initNimble() {
                                NimBLEUUID(CHARACTERISTIC_PATTERNS_UUID));
     initPatternDataCharacteristic(
         pService, NimBLEUUID(CHARACTERISTIC_GET_PATTERN_DATA_UUID));
+    initPatternProgramCharacteristic(
+        pService, NimBLEUUID(CHARACTERISTIC_PATTERN_PROGRAM_UUID));
 
     // GPIO write/read characteristic
     initGPIOCharacteristic(pService, NimBLEUUID(CHARACTERISTIC_GPIO_UUID));
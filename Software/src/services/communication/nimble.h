@@ -29,6 +29,10 @@
     "522b443a-4f53-534d-1030-420badbabe69"
 #define CHARACTERISTIC_RENAME_CONFIG_UUID \
     "522b443a-4f53-534d-1040-420badbabe69"
+// Binary stream packets, many stream targets per write
+#define CHARACTERISTIC_STREAM_UUID "522b443a-4f53-534d-1050-420badbabe69"
+// Clock sync, so stream packets can be stamped in device time
+#define CHARACTERISTIC_CLOCK_UUID "522b443a-4f53-534d-1060-420badbabe69"
 // **********************************************************
 // State Characteristics
 // - Range: 2000-2FFF
@@ -47,6 +51,8 @@
 #define CHARACTERISTIC_PATTERNS_UUID "522b443a-4f53-534d-3000-420badbabe69"
 #define CHARACTERISTIC_GET_PATTERN_DATA_UUID \
     "522b443a-4f53-534d-3010-420badbabe69"
+#define CHARACTERISTIC_PATTERN_PROGRAM_UUID \
+    "522b443a-4f53-534d-3020-420badbabe69"
 
 // ************************************************
 // GPIO Characteristics
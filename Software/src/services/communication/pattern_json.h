@@ -0,0 +1,100 @@
+#ifndef OSSM_PATTERN_JSON_H
+#define OSSM_PATTERN_JSON_H
+
+#include <stddef.h>
+
+#include "PatternRegistry.h"
+
+// JSON describing the built-in patterns, rendered by the compiler from
+// PatternRegistry. Ends up as string literals in flash; nothing is built at
+// runtime.
+namespace pattern_json {
+
+    template <size_t N>
+    struct FixedString {
+        char value[N] = {};
+        constexpr const char *c_str() const { return value; }
+        static constexpr size_t length() { return N - 1; }
+    };
+
+    // Appends to out, or only counts the characters if out is null
+    struct Writer {
+        char *out;
+        size_t length = 0;
+
+        constexpr void put(char c) {
+            if (out != nullptr) out[length] = c;
+            length++;
+        }
+
+        constexpr void text(const char *s) {
+            while (*s != '\0') put(*s++);
+        }
+
+        constexpr void string(const char *s) {
+            put('"');
+            for (; *s != '\0'; s++) {
+                if (*s == '"' || *s == '\\') put('\\');
+                put(*s);
+            }
+            put('"');
+        }
+
+        constexpr void number(int value) {
+            if (value < 0) {
+                put('-');
+                value = -value;
+            }
+            int divisor = 1;
+            while (value / divisor >= 10) divisor *= 10;
+            for (; divisor > 0; divisor /= 10) put(char('0' + value / divisor % 10));
+        }
+    };
+
+    // [{"name":"Simple Stroke","idx":0},...]
+    constexpr void writePatterns(Writer &w) {
+        w.put('[');
+        for (int i = 0; i < PatternRegistry::count; i++) {
+            if (i > 0) w.put(',');
+            w.text("{\"name\":");
+            w.string(PatternRegistry::patterns[i].name);
+            w.text(",\"idx\":");
+            w.number(i);
+            w.put('}');
+        }
+        w.put(']');
+    }
+
+    // {"min":0,"max":<count-1>}
+    constexpr void writeIndexRange(Writer &w) {
+        w.text("{\"min\":0,\"max\":");
+        w.number(PatternRegistry::count - 1);
+        w.put('}');
+    }
+
+    template <class F>
+    constexpr size_t measure(F write) {
+        Writer w{nullptr};
+        write(w);
+        return w.length + 1;
+    }
+
+    template <size_t N, class F>
+    constexpr FixedString<N> render(F write) {
+        FixedString<N> s;
+        Writer w{s.value};
+        write(w);
+        return s;
+    }
+
+    // Value of the patterns characteristic
+    inline constexpr auto patterns =
+        render<measure(writePatterns)>(writePatterns);
+
+    // Range of the motion.pattern resource
+    inline constexpr auto indexRange =
+        render<measure(writeIndexRange)>(writeIndexRange);
+
+}  // namespace pattern_json
+
+#endif  // OSSM_PATTERN_JSON_H
@@ -1,32 +1,19 @@
 #ifndef OSSM_PATTERNS_HPP
 #define OSSM_PATTERNS_HPP
 
-#include "ArduinoJson.h"
 #include "NimBLEService.h"
-#include "Strings.h"
+#include "PatternRegistry.h"
 #include "constants/LogTags.h"
 #include "esp_log.h"
+#include "pattern_json.h"
 
 inline NimBLECharacteristic* initPatternsCharacteristic(NimBLEService* pService,
                                                  NimBLEUUID uuid) {
     // Patterns characteristic (read-only list of all patterns)
     NimBLECharacteristic* pPatternsChar =
         pService->createCharacteristic(uuid, NIMBLE_PROPERTY::READ);
-    // Use ArduinoJson to construct the patterns JSON
-    JsonDocument doc;
-    JsonArray arr = doc.to<JsonArray>();
-
-    for (int i = 0; i < sizeof(ui::strings::strokeEngineNames) /
-                            sizeof(ui::strings::strokeEngineNames[0]);
-         i++) {
-        JsonObject pattern = arr.createNestedObject();
-        pattern["name"] = ui::strings::strokeEngineNames[i];
-        pattern["idx"] = i;
-    }
-
-    String jsonString;
-    serializeJson(arr, jsonString);
-    pPatternsChar->setValue(jsonString.c_str());
+    // The JSON is rendered at compile time from PatternRegistry
+    pPatternsChar->setValue(pattern_json::patterns.c_str());
     return pPatternsChar;
 }
 
@@ -39,20 +26,13 @@ class PatternDataCallbacks : public NimBLECharacteristicCallbacks {
         // Parse the integer input
         int patternIndex = patternValue.toInt();
 
-        // Get the size of the StrokeEngineDescriptions array
-        int descriptionsCount =
-            sizeof(ui::strings::strokeEngineDescriptions) /
-            sizeof(ui::strings::strokeEngineDescriptions[0]);
-
         // Use modulo to ensure valid index
-        int validIndex = patternIndex % descriptionsCount;
+        int validIndex = patternIndex % PatternRegistry::count;
         if (validIndex < 0) {
-            validIndex += descriptionsCount;  // Handle negative numbers
+            validIndex += PatternRegistry::count;  // Handle negative numbers
         }
 
-        // Get the pattern description from PROGMEM
-        const char* description =
-            ui::strings::strokeEngineDescriptions[validIndex];
+        const char* description = PatternRegistry::description(validIndex);
 
         // Set the characteristic value to the description
         pCharacteristic->setValue(description);
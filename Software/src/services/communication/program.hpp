@@ -0,0 +1,63 @@
+#ifndef OSSM_PROGRAM_HPP
+#define OSSM_PROGRAM_HPP
+
+#include "NimBLEService.h"
+#include "ProgramPattern.h"
+#include "constants/LogTags.h"
+#include "esp_log.h"
+
+class PatternProgramCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic,
+                 NimBLEConnInfo& connInfo) override {
+        std::string value = pCharacteristic->getValue();
+
+        // An empty write goes back to the default program
+        if (value.empty()) {
+            ProgramPattern::clear();
+            PreferencesProgramStorage::erase();
+            pCharacteristic->setValue("ok:default");
+            ESP_LOGI(NIMBLE_TAG, "Pattern program cleared");
+            return;
+        }
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(value.data());
+        ProgramError error = ProgramPattern::install(bytes, value.size());
+        if (error != ProgramError::None) {
+            std::string reply = "fail:";
+            reply += pattern_program::errorName(error);
+            pCharacteristic->setValue(reply);
+            ESP_LOGW(NIMBLE_TAG, "Pattern program rejected: %s",
+                     pattern_program::errorName(error));
+            return;
+        }
+
+        if (!PreferencesProgramStorage::save(bytes, value.size())) {
+            ESP_LOGW(NIMBLE_TAG, "Pattern program not saved, lost on restart");
+        }
+        std::string reply = "ok:" + std::to_string(value.size());
+        pCharacteristic->setValue(reply);
+        ESP_LOGI(NIMBLE_TAG, "Pattern program installed: %u bytes",
+                 unsigned(value.size()));
+    }
+} inline patternProgramCallbacks;
+
+inline NimBLECharacteristic* initPatternProgramCharacteristic(
+    NimBLEService* pService, NimBLEUUID uuid) {
+    // The program uploaded last time plays until a new one arrives
+    ProgramError error = PreferencesProgramStorage::restore();
+    if (error != ProgramError::None) {
+        ESP_LOGW(NIMBLE_TAG, "Stored pattern program rejected: %s",
+                 pattern_program::errorName(error));
+        PreferencesProgramStorage::erase();
+    }
+
+    NimBLECharacteristic* pProgramChar = pService->createCharacteristic(
+        uuid, NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::READ,
+        PATTERN_PROGRAM_SIZE_MAX);
+    pProgramChar->setValue(ProgramPattern::installed() ? "ok:stored"
+                                                       : "ok:default");
+    pProgramChar->setCallbacks(&patternProgramCallbacks);
+    return pProgramChar;
+}
+
+#endif  // OSSM_PROGRAM_HPP
@@ -1,4 +1,11 @@
 #include "queue.h"
 
 std::queue<String> messageQueue = {};
-std::queue<PositionTime> targetQueue = {};
+TargetQueue targetQueue(ring_buffer::Overflow::DropOldest);
+SemaphoreHandle_t targetSignal = nullptr;
+
+void signalTargets() {
+    if (targetSignal != nullptr) {
+        xSemaphoreGive(targetSignal);
+    }
+}
@@ -5,14 +5,33 @@
 #include <chrono>
 #include <queue>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "ring_buffer.h"
+
 struct PositionTime {
-    uint8_t position; // 0 - 100
-    uint16_t inTime;     // in ms
+    uint16_t position; // 0 - 10000, hundredths of a percent
+    uint32_t inTime;     // in ms
     std::chrono::steady_clock::time_point setTime; //received timestamp
     int direction; //0:uncalculated, 1:out, -1:in
+    bool deviceTime; //inTime is the millis() it is due, see clock_sync.h
 };
 
+// Stream targets from the BLE callbacks to the streaming task. When the
+// streaming task falls behind, the oldest targets are stale anyway. Holds
+// a whole binary stream packet at the largest MTU.
+constexpr size_t targetQueueCapacity = 128;
+using TargetQueue = ring_buffer::Ring<PositionTime, targetQueueCapacity>;
+
 extern std::queue<String> messageQueue;
-extern std::queue<PositionTime> targetQueue;
+extern TargetQueue targetQueue;
+
+// Given when targets were pushed, the StrokeEngine has room for more, or
+// anything else the streaming task follows changed. The streaming task sleeps
+// on it. Created with the first streaming task.
+extern SemaphoreHandle_t targetSignal;
+
+// Call after pushing to targetQueue
+void signalTargets();
 
 #endif  // OSSM_COMMUNICATION_QUEUE_H
@@ -17,6 +17,7 @@
 #include "services/encoder.h"
 #include "services/board.h"
 #include "services/communication/nimble.h"
+#include "services/communication/pattern_json.h"
 #include "services/led.h"
 #include "services/stepper.h"
 
@@ -72,8 +73,12 @@ const radble::Resource RESOURCES[] = {
      "{\"min\":0,\"max\":100}"},
     {"buffer", "motion.buffer", "setting", "int", "percent", RWT,
      "{\"min\":0,\"max\":100}"},
+    {"vibration", "motion.vibration", "setting", "int", "percent", RWT,
+     "{\"min\":0,\"max\":100}"},
+    {"vibration_frequency", "motion.vibrationFrequency", "setting", "int",
+     "Hz", RWT, "{\"min\":0,\"max\":100}"},
     {"pattern", "motion.pattern", "setting", "int", "index", RWT,
-     "{\"min\":0,\"max\":6}"},
+     pattern_json::indexRange.c_str()},
     {"speed_ble", "motion.speedBle", "setting", "float", "percent", RW,
      "{\"min\":0,\"max\":100}"},
     {"speed_limit", "setting.speedKnobAsLimit", "setting", "bool", "", RW,
@@ -173,8 +178,12 @@ radble::Result settingValue(const String& path) {
         document["value"] = settings.sensation;
     else if (path == "motion.buffer")
         document["value"] = settings.buffer;
+    else if (path == "motion.vibration")
+        document["value"] = settings.vibration;
+    else if (path == "motion.vibrationFrequency")
+        document["value"] = settings.vibrationFrequency;
     else if (path == "motion.pattern")
-        document["value"] = static_cast<int>(settings.pattern);
+        document["value"] = settings.pattern;
     else if (path == "motion.speedBle") {
         document["available"] = settings.speedBLE.has_value();
         if (settings.speedBLE.has_value()) document["value"] = *settings.speedBLE;
@@ -410,8 +419,8 @@ radble::Result handleCommand(JsonObjectConst request, void*) {
         int value = args["value"].as<int>();
         String command;
         if (path == "motion.pattern") {
-            if (value < 0 || value > 6)
-                return radble::Result::failure("invalid_value", "Pattern must be 0..6");
+            if (PatternRegistry::find(value) == nullptr)
+                return radble::Result::failure("invalid_value", "Unknown pattern");
             command = "set:pattern:" + String(value);
         } else {
             if (value < 0 || value > 100)
@@ -421,6 +430,8 @@ radble::Result handleCommand(JsonObjectConst request, void*) {
             else if (path == "motion.depth") command = "set:depth:" + String(value);
             else if (path == "motion.sensation") command = "set:sensation:" + String(value);
             else if (path == "motion.buffer") command = "set:buffer:" + String(value);
+            else if (path == "motion.vibration") command = "set:vibration:" + String(value);
+            else if (path == "motion.vibrationFrequency") command = "set:vibrationFrequency:" + String(value);
             else return radble::Result::failure("unknown_path", "Unknown setting path");
         }
         ossm->ble_click(command);
@@ -640,7 +651,7 @@ String snapshot(radble::Surface surface, void*) {
             document["depth"] = settings.depth;
             document["sensation"] = settings.sensation;
             document["buffer"] = settings.buffer;
-            document["pattern"] = static_cast<int>(settings.pattern);
+            document["pattern"] = settings.pattern;
             document["targetPosition"] = motion.targetPosition;
             document["targetTimeMs"] = motion.targetTime;
             document["strokeCount"] = session.strokeCount;
@@ -0,0 +1,82 @@
+#ifndef OSSM_COMMUNICATION_STREAM_HPP
+#define OSSM_COMMUNICATION_STREAM_HPP
+
+#include <chrono>
+#include <string>
+
+#include "NimBLECharacteristic.h"
+#include "NimBLEService.h"
+#include "NimBLEUUID.h"
+#include "constants/LogTags.h"
+#include "esp_log.h"
+#include "queue.h"
+#include "services/led.h"
+#include "stream_packet.h"
+
+// A full packet at the MTU requested in initNimble() must fit the queue
+static_assert(stream_packet::maxPoints(512) <= targetQueueCapacity,
+              "targetQueue is too small for a stream packet");
+
+/** Binary stream packets, see lib/OSSMLogic/src/stream_packet.h. A read
+ *  tells the newest version, how many points fit one write on this
+ *  connection and how many the target queue has room for right now:
+ *  v2:<points per write>:<room>. A packet with more points than there is
+ *  room for is dropped whole, nothing of it is queued. */
+class StreamPacketCallbacks : public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic,
+                 NimBLEConnInfo& connInfo) override {
+        // Decoded straight from the attribute value into the target queue.
+        // Every point of a packet counts from the same moment. The queue
+        // drops its oldest targets when full, so a packet must fit whole.
+        const NimBLEAttValue& value = pCharacteristic->getValue();
+        auto received = std::chrono::steady_clock::now();
+        bool deviceTime =
+            value.size() > 0 && stream_packet::deviceTime(value.data());
+        stream_packet::Error error = stream_packet::decode(
+            value.data(), value.size(), targetRoom(),
+            [received, deviceTime](const stream_packet::Point& point) {
+                targetQueue.push(
+                    {point.position, point.time, received, 0, deviceTime});
+            });
+        if (error != stream_packet::Error::None) {
+            ESP_LOGD(NIMBLE_TAG, "Stream packet rejected: %s",
+                     stream_packet::errorName(error));
+            return;
+        }
+
+        signalTargets();
+        pulseForCommunication();
+    }
+
+    void onRead(NimBLECharacteristic* pCharacteristic,
+                NimBLEConnInfo& connInfo) override {
+        std::string reply = "v" + std::to_string(stream_packet::versionDeviceTime) +
+                            ":" +
+                            std::to_string(stream_packet::maxPoints(
+                                connInfo.getMTU())) +
+                            ":" + std::to_string(targetRoom());
+        pCharacteristic->setValue(reply);
+    }
+
+    // Targets the queue takes before it drops any. Only the streaming task
+    // pops, so the room can only shrink through stream: commands arriving
+    // at the same time.
+    static size_t targetRoom() {
+        size_t size = targetQueue.size();
+        return size < targetQueue.capacity() ? targetQueue.capacity() - size
+                                             : 0;
+    }
+} inline streamPacketCallbacks;
+
+inline NimBLECharacteristic* initStreamPacketCharacteristic(
+    NimBLEService* pService, NimBLEUUID uuid) {
+    NimBLECharacteristic* pStreamChar = pService->createCharacteristic(
+        uuid,
+        NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR |
+            NIMBLE_PROPERTY::READ,
+        stream_packet::packetSize(stream_packet::maxPoints(512)));
+    pStreamChar->setCallbacks(&streamPacketCallbacks);
+    return pStreamChar;
+}
+
+#endif  // OSSM_COMMUNICATION_STREAM_HPP
@@ -1,17 +1,9 @@
 #ifndef SOFTWARE_SETTINGPERCENTS_H
 #define SOFTWARE_SETTINGPERCENTS_H
 
-#include <optional>
+#include <stdint.h>
 
-enum class StrokePatterns {
-    SimpleStroke,
-    TeasingPounding,
-    RoboStroke,
-    HalfnHalf,
-    Deeper,
-    StopNGo,
-    Insist,
-};
+#include <optional>
 
 struct SettingPercents {
     float speed;
@@ -19,9 +11,13 @@ struct SettingPercents {
     float sensation;
     float depth;
     float buffer;
-    StrokePatterns pattern;
+    int pattern;  // Index into PatternRegistry
     float speedKnob;
     std::optional<float> speedBLE = std::nullopt;
+    float vibration = 0;           // Amplitude in percent of the envelope
+    float vibrationFrequency = 0;  // Hz
+    float tempo = 0;               // Beats per minute, 0 runs free
+    uint32_t tempoBeat = 0;        // micros() at one of the beats
 };
 
 #endif  // SOFTWARE_SETTINGPERCENTS_H
@@ -25,7 +25,8 @@ static motorProperties servoMotor{
     .enableActiveLow = true,
     .stepPin = Pins::Driver::motorStepPin,
     .directionPin = Pins::Driver::motorDirectionPin,
-    .enablePin = Pins::Driver::motorEnablePin};
+    .enablePin = Pins::Driver::motorEnablePin,
+    .maxJerk = Config::Driver::maxJerk};
 
 static bool isChangeSignificant(float oldPct, float newPct) {
     return oldPct != newPct &&
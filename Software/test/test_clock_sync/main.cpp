@@ -0,0 +1,150 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ CLOCK SYNC — UNIT TESTS                                                │
+// │                                                                        │
+// │ Tests for lib/OSSMLogic/src/clock_sync.h, the NTP style exchange that  │
+// │ lets clients stamp stream packets in device time:                      │
+// │   Exchange  — Request, reply and the offset and round trip from them   │
+// │   Estimator — The shortest round trip of the window wins               │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+using namespace fakeit;
+
+#include "clock_sync.h"
+
+using clock_sync::Sample;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Runs one exchange. Client time is device time minus offset; the request
+// takes there ms, the device holds it for held ms and the reply takes back
+// ms. Returns what the client makes of it.
+static Sample exchange(uint32_t clientSent, int32_t offset, uint32_t there,
+                       uint32_t held, uint32_t back) {
+    uint8_t request[clock_sync::requestSize];
+    uint8_t reply[clock_sync::replySize];
+    clock_sync::request(clientSent, request);
+
+    uint32_t deviceReceived = clientSent + uint32_t(offset) + there;
+    TEST_ASSERT_EQUAL(clock_sync::replySize,
+                      clock_sync::reply(request, sizeof(request),
+                                        deviceReceived, deviceReceived + held,
+                                        reply));
+
+    uint32_t clientReceived = clientSent + there + held + back;
+    Sample sample = {};
+    TEST_ASSERT_TRUE(
+        clock_sync::sample(reply, sizeof(reply), clientReceived, sample));
+    return sample;
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Exchange
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_clock_reply_layout() {
+    const uint8_t request[] = {0x78, 0x56, 0x34, 0x12};
+    uint8_t reply[clock_sync::replySize];
+    TEST_ASSERT_EQUAL(12, clock_sync::reply(request, sizeof(request), 1000,
+                                            1002, reply));
+    const uint8_t expected[] = {0x78, 0x56, 0x34, 0x12, 0xE8, 0x03,
+                                0,    0,    0xEA, 0x03, 0,    0};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, reply, sizeof(expected));
+}
+
+void test_clock_symmetric_exchange_finds_offset() {
+    Sample sample = exchange(5000, 123456, 15, 1, 15);
+    TEST_ASSERT_EQUAL(123456, sample.offset);
+    TEST_ASSERT_EQUAL(30, sample.roundTrip);
+
+    sample = exchange(200000, -150000, 7, 0, 7);
+    TEST_ASSERT_EQUAL(-150000, sample.offset);
+    TEST_ASSERT_EQUAL(14, sample.roundTrip);
+}
+
+void test_clock_asymmetry_is_off_by_half_the_difference() {
+    // A retry on the way there: 45 ms there, 15 back
+    Sample sample = exchange(5000, 1000, 45, 0, 15);
+    TEST_ASSERT_EQUAL(1015, sample.offset);
+    TEST_ASSERT_EQUAL(60, sample.roundTrip);
+}
+
+void test_clock_exchange_across_wrap() {
+    Sample sample = exchange(0xFFFFFFF0u, 100, 20, 2, 20);
+    TEST_ASSERT_EQUAL(100, sample.offset);
+    TEST_ASSERT_EQUAL(40, sample.roundTrip);
+
+    sample = exchange(10, -50, 20, 2, 20);
+    TEST_ASSERT_EQUAL(-50, sample.offset);
+}
+
+void test_clock_rejects_malformed() {
+    uint8_t request[clock_sync::requestSize + 1] = {};
+    uint8_t reply[clock_sync::replySize + 1] = {};
+    TEST_ASSERT_EQUAL(0, clock_sync::reply(request, 3, 0, 0, reply));
+    TEST_ASSERT_EQUAL(0, clock_sync::reply(request, 5, 0, 0, reply));
+
+    Sample sample = {};
+    TEST_ASSERT_FALSE(clock_sync::sample(reply, 11, 0, sample));
+    TEST_ASSERT_FALSE(clock_sync::sample(reply, 13, 0, sample));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Estimator
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_clock_estimator_keeps_shortest_round_trip() {
+    clock_sync::Estimator estimator;
+    TEST_ASSERT_FALSE(estimator.synced());
+
+    estimator.add(exchange(1000, 500, 45, 0, 15));
+    estimator.add(exchange(1100, 500, 8, 0, 7));
+    estimator.add(exchange(1200, 500, 15, 0, 75));
+    TEST_ASSERT_TRUE(estimator.synced());
+    TEST_ASSERT_EQUAL(15, estimator.best().roundTrip);
+    TEST_ASSERT_EQUAL(500, estimator.offset());
+    TEST_ASSERT_EQUAL_UINT32(3500, estimator.toDevice(3000));
+}
+
+void test_clock_estimator_forgets_old_samples() {
+    clock_sync::Estimator estimator;
+    // A lucky exchange, then the clocks drift apart by 5 ms
+    estimator.add(exchange(1000, 500, 5, 0, 5));
+    for (size_t i = 0; i < clock_sync::Estimator::Window; i++) {
+        estimator.add(exchange(2000 + i * 100, 505, 15, 0, 15));
+    }
+    TEST_ASSERT_EQUAL(505, estimator.offset());
+
+    estimator.clear();
+    TEST_ASSERT_FALSE(estimator.synced());
+}
+
+void test_clock_estimator_to_device_wraps() {
+    clock_sync::Estimator estimator;
+    estimator.add(exchange(100, -1000, 10, 0, 10));
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFu - 899, estimator.toDevice(100));
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_clock_reply_layout);
+    RUN_TEST(test_clock_symmetric_exchange_finds_offset);
+    RUN_TEST(test_clock_asymmetry_is_off_by_half_the_difference);
+    RUN_TEST(test_clock_exchange_across_wrap);
+    RUN_TEST(test_clock_rejects_malformed);
+
+    RUN_TEST(test_clock_estimator_keeps_shortest_round_trip);
+    RUN_TEST(test_clock_estimator_forgets_old_samples);
+    RUN_TEST(test_clock_estimator_to_device_wraps);
+
+    return UNITY_END();
+}
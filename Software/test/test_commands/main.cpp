@@ -69,6 +69,16 @@ void test_setCommandValue_depth100_boundary() {
     TEST_ASSERT_EQUAL(100, result.value);
 }
 
+void test_setCommandValue_vibration() {
+    auto result = setCommandValue(String("set:vibration:40"));
+    TEST_ASSERT_EQUAL(Commands::setVibration, result.command);
+    TEST_ASSERT_EQUAL(40, result.value);
+
+    result = setCommandValue(String("set:vibrationFrequency:25"));
+    TEST_ASSERT_EQUAL(Commands::setVibrationFrequency, result.command);
+    TEST_ASSERT_EQUAL(25, result.value);
+}
+
 void test_setCommandValue_speedNegative_returnsIgnore() {
     auto result = setCommandValue(String("set:speed:-1"));
     TEST_ASSERT_EQUAL(Commands::ignore, result.command);
@@ -127,6 +137,88 @@ void test_streamCommandValue_malformedSingleColon_returnsIgnore() {
     TEST_ASSERT_EQUAL(Commands::ignore, result.command);
 }
 
+// ---------------------------------------------------------------------------
+// tempoCommandValue tests
+// ---------------------------------------------------------------------------
+
+void test_tempoCommandValue_valid() {
+    auto result = commandFromString(String("tempo:123.7:250"));
+    TEST_ASSERT_EQUAL(Commands::setTempo, result.command);
+    TEST_ASSERT_EQUAL(12370, result.value);
+    TEST_ASSERT_EQUAL(250, result.time);
+}
+
+void test_tempoCommandValue_zeroTurnsOff() {
+    auto result = tempoCommandValue(String("tempo:0:0"));
+    TEST_ASSERT_EQUAL(Commands::setTempo, result.command);
+    TEST_ASSERT_EQUAL(0, result.value);
+}
+
+void test_tempoCommandValue_invalid_returnsIgnore() {
+    const char* invalid[] = {"tempo:120",      "tempo::100",   "tempo:12a:0",
+                             "tempo:-60:0",    "tempo:301:0",  "tempo:120:-1",
+                             "tempo:120:1.5",  "tempo:120:60001"};
+    for (const char* command : invalid) {
+        auto result = tempoCommandValue(String(command));
+        TEST_ASSERT_EQUAL_MESSAGE(Commands::ignore, result.command, command);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// funscript command tests
+// ---------------------------------------------------------------------------
+
+void test_commandFromString_funscriptPlay() {
+    auto result = commandFromString(String("funscript:play:/scripts/a.funscript"));
+    TEST_ASSERT_EQUAL(Commands::playFunscript, result.command);
+    TEST_ASSERT_EQUAL_STRING(
+        "/scripts/a.funscript",
+        parseFunscriptPath(String("funscript:play:/scripts/a.funscript")).c_str());
+}
+
+void test_commandFromString_funscriptPlayWithoutPath_returnsIgnore() {
+    auto result = commandFromString(String("funscript:play:/"));
+    TEST_ASSERT_EQUAL(Commands::ignore, result.command);
+}
+
+void test_commandFromString_funscriptSeek() {
+    auto result = commandFromString(String("funscript:seek:90500"));
+    TEST_ASSERT_EQUAL(Commands::seekFunscript, result.command);
+    TEST_ASSERT_EQUAL(90500, result.value);
+}
+
+void test_commandFromString_funscriptSeekNotANumber_returnsIgnore() {
+    auto result = commandFromString(String("funscript:seek:12a"));
+    TEST_ASSERT_EQUAL(Commands::ignore, result.command);
+}
+
+void test_commandFromString_funscriptStop() {
+    auto result = commandFromString(String("funscript:stop"));
+    TEST_ASSERT_EQUAL(Commands::stopFunscript, result.command);
+}
+
+// ---------------------------------------------------------------------------
+// keyframes command tests
+// ---------------------------------------------------------------------------
+
+void test_commandFromString_keyframesPlay() {
+    auto result = commandFromString(String("keyframes:play:/patterns/wave.oskf"));
+    TEST_ASSERT_EQUAL(Commands::playKeyframes, result.command);
+    TEST_ASSERT_EQUAL_STRING(
+        "/patterns/wave.oskf",
+        parseKeyframesPath(String("keyframes:play:/patterns/wave.oskf")).c_str());
+}
+
+void test_commandFromString_keyframesPlayWithoutPath_returnsIgnore() {
+    auto result = commandFromString(String("keyframes:play:/"));
+    TEST_ASSERT_EQUAL(Commands::ignore, result.command);
+}
+
+void test_commandFromString_keyframesStop() {
+    auto result = commandFromString(String("keyframes:stop"));
+    TEST_ASSERT_EQUAL(Commands::stopKeyframes, result.command);
+}
+
 // ---------------------------------------------------------------------------
 // parseWiFiCommand tests
 // ---------------------------------------------------------------------------
@@ -168,6 +260,7 @@ int main(int argc, char** argv) {
     RUN_TEST(test_setCommandValue_speed50);
     RUN_TEST(test_setCommandValue_depth0_boundary);
     RUN_TEST(test_setCommandValue_depth100_boundary);
+    RUN_TEST(test_setCommandValue_vibration);
     RUN_TEST(test_setCommandValue_speedNegative_returnsIgnore);
     RUN_TEST(test_setCommandValue_speed101_returnsIgnore);
     RUN_TEST(test_setCommandValue_speedAbc_returnsIgnore);
@@ -181,6 +274,23 @@ int main(int argc, char** argv) {
     RUN_TEST(test_streamCommandValue_posNegative_returnsIgnore);
     RUN_TEST(test_streamCommandValue_malformedSingleColon_returnsIgnore);
 
+    // tempoCommandValue
+    RUN_TEST(test_tempoCommandValue_valid);
+    RUN_TEST(test_tempoCommandValue_zeroTurnsOff);
+    RUN_TEST(test_tempoCommandValue_invalid_returnsIgnore);
+
+    // funscript
+    RUN_TEST(test_commandFromString_funscriptPlay);
+    RUN_TEST(test_commandFromString_funscriptPlayWithoutPath_returnsIgnore);
+    RUN_TEST(test_commandFromString_funscriptSeek);
+    RUN_TEST(test_commandFromString_funscriptSeekNotANumber_returnsIgnore);
+    RUN_TEST(test_commandFromString_funscriptStop);
+
+    // keyframes
+    RUN_TEST(test_commandFromString_keyframesPlay);
+    RUN_TEST(test_commandFromString_keyframesPlayWithoutPath_returnsIgnore);
+    RUN_TEST(test_commandFromString_keyframesStop);
+
     // parseWiFiCommand
     RUN_TEST(test_parseWiFiCommand_valid);
     RUN_TEST(test_parseWiFiCommand_noPipe_returnsEmpty);
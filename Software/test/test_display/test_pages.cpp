@@ -1,4 +1,5 @@
 #include "test_helpers.h"
+#include "PatternRegistry.h"
 
 // ============================================================
 // declared pages — draw every ui::pages:: declaration exactly
@@ -73,9 +74,7 @@ void test_page_pairing(void) {
 // pattern selection screen, with name, description, and scroll.
 // ============================================================
 
-static const size_t numberOfPatterns =
-    sizeof(ui::strings::strokeEngineNames) /
-    sizeof(ui::strings::strokeEngineNames[0]);
+static const size_t numberOfPatterns = PatternRegistry::count;
 
 static void toSnakeCase(char* dst, size_t dstLen, const char* src) {
     size_t j = 0;
@@ -95,8 +94,8 @@ static void test_page_pattern(void) {
     size_t i = idx++;
 
     ui::TextPage page;
-    page.title = ui::strings::strokeEngineNames[i];
-    page.body = ui::strings::strokeEngineDescriptions[i];
+    page.title = PatternRegistry::name(i);
+    page.body = PatternRegistry::description(i);
     page.scrollPercent = ui::scrollPercent(i, numberOfPatterns);
     ui::drawTextPage(&u8g2, page);
     u8g2_SetMaxClipWindow(&u8g2);
@@ -104,7 +103,7 @@ static void test_page_pattern(void) {
 
     char filename[128];
     char snake[96];
-    toSnakeCase(snake, sizeof(snake), ui::strings::strokeEngineNames[i]);
+    toSnakeCase(snake, sizeof(snake), PatternRegistry::name(i));
     snprintf(filename, sizeof(filename), "%zu_%s", i, snake);
     TEST_ASSERT_TRUE(savePBMGrouped(&u8g2, "textpage/patterns", filename));
 }
@@ -0,0 +1,471 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ FUNSCRIPT LOGIC — UNIT & BENCHMARK TESTS                               │
+// │                                                                        │
+// │ Tests for lib/OSSMLogic/src/funscript_logic.h:                         │
+// │   Tokenizer — Actions out of funscript JSON, one byte at a time        │
+// │   Reader    — Chunked reads, prefetch ring, seek via checkpoints       │
+// │   Timeline  — Actions to stream points for planSegment                 │
+// │                                                                        │
+// │ The benchmark parses a 50k action script and reports throughput and    │
+// │ peak heap. Global operator new tracks live bytes to prove the script   │
+// │ is never held in memory.                                               │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "MotionLimits.h"
+#include "funscript_logic.h"
+#include "streaming_logic.h"
+
+using namespace funscript_logic;
+
+// ─── Heap tracking ────────────────────────────────────────────────────────
+
+static size_t liveBytes = 0;
+static size_t peakBytes = 0;
+
+void *operator new(size_t size) {
+    size_t *p = static_cast<size_t *>(malloc(sizeof(size_t) + size));
+    if (p == nullptr) throw std::bad_alloc();
+    *p = size;
+    liveBytes += size;
+    if (liveBytes > peakBytes) peakBytes = liveBytes;
+    return p + 1;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept {
+    if (p == nullptr) return;
+    size_t *block = static_cast<size_t *>(p) - 1;
+    liveBytes -= *block;
+    free(block);
+}
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Script held in memory
+class MemorySource : public Source {
+  public:
+    explicit MemorySource(const std::string &text) : _text(text) {}
+
+    uint32_t size() override { return _text.size(); }
+
+    size_t read(uint32_t offset, uint8_t *buffer, size_t length) override {
+        if (offset >= _text.size()) return 0;
+        if (length > _text.size() - offset) length = _text.size() - offset;
+        memcpy(buffer, _text.data() + offset, length);
+        return length;
+    }
+
+  private:
+    const std::string &_text;
+};
+
+static std::vector<Action> tokenize(const std::string &text,
+                                    bool *inverted = nullptr,
+                                    bool *failed = nullptr) {
+    Tokenizer tokenizer;
+    std::vector<Action> actions;
+    for (char c : text) {
+        if (tokenizer.feed(c)) actions.push_back(tokenizer.action());
+    }
+    if (inverted) *inverted = tokenizer.inverted();
+    if (failed) *failed = tokenizer.failed();
+    return actions;
+}
+
+template <typename R>
+static std::vector<Action> drain(R &reader) {
+    std::vector<Action> actions;
+    Action action;
+    while (reader.next(action)) actions.push_back(action);
+    return actions;
+}
+
+// {"version":"1.0","actions":[{"at":0,"pos":p0},...],"metadata":{...}}
+static std::string script(uint32_t count, uint32_t stepMs = 100) {
+    std::string text = "{\"version\":\"1.0\",\"inverted\":false,\"range\":100,"
+                       "\"actions\":[";
+    char buffer[48];
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(buffer, sizeof(buffer), "%s{\"at\":%u,\"pos\":%u}",
+                 i ? "," : "", i * stepMs, (i * 37) % 101);
+        text += buffer;
+    }
+    text += "],\"metadata\":{\"title\":\"bench\",\"tags\":[\"a\",\"b\"]}}";
+    return text;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Tokenizer
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_tokenizer_reads_actions(void) {
+    auto actions = tokenize(
+        R"({"actions":[{"at":0,"pos":10},{"at":250,"pos":90}]})");
+    TEST_ASSERT_EQUAL(2, actions.size());
+    TEST_ASSERT_EQUAL_UINT32(0, actions[0].at);
+    TEST_ASSERT_EQUAL_UINT8(10, actions[0].pos);
+    TEST_ASSERT_EQUAL_UINT32(250, actions[1].at);
+    TEST_ASSERT_EQUAL_UINT8(90, actions[1].pos);
+}
+
+void test_tokenizer_skips_everything_else(void) {
+    // Metadata before and after, with strings that look like keys, escaped
+    // quotes, nested arrays and an "actions" member that is not top level
+    auto actions = tokenize(R"({
+        "metadata": {"title": "\"actions\":[{\"at\":1,\"pos\":1}]",
+                     "actions": [{"at": 5, "pos": 5}],
+                     "chapters": [[1, 2], {"x": null}]},
+        "version": "1.0",
+        "actions": [ { "at" : 100 , "pos" : 40 } ],
+        "notes": ["}", "]", "\\"]
+    })");
+    TEST_ASSERT_EQUAL(1, actions.size());
+    TEST_ASSERT_EQUAL_UINT32(100, actions[0].at);
+    TEST_ASSERT_EQUAL_UINT8(40, actions[0].pos);
+}
+
+void test_tokenizer_any_key_order_and_extra_fields(void) {
+    auto actions = tokenize(
+        R"({"actions":[{"pos":25,"type":"x","at":700,"extra":{"at":1}}]})");
+    TEST_ASSERT_EQUAL(1, actions.size());
+    TEST_ASSERT_EQUAL_UINT32(700, actions[0].at);
+    TEST_ASSERT_EQUAL_UINT8(25, actions[0].pos);
+}
+
+void test_tokenizer_rounds_and_clamps(void) {
+    auto actions = tokenize(
+        R"({"actions":[{"at":99.6,"pos":49.5},{"at":-3,"pos":120},)"
+        R"({"at":1e3,"pos":-7}]})");
+    TEST_ASSERT_EQUAL(3, actions.size());
+    TEST_ASSERT_EQUAL_UINT32(100, actions[0].at);
+    TEST_ASSERT_EQUAL_UINT8(50, actions[0].pos);
+    TEST_ASSERT_EQUAL_UINT32(0, actions[1].at);
+    TEST_ASSERT_EQUAL_UINT8(100, actions[1].pos);
+    TEST_ASSERT_EQUAL_UINT32(1000, actions[2].at);
+    TEST_ASSERT_EQUAL_UINT8(0, actions[2].pos);
+}
+
+void test_tokenizer_incomplete_actions_are_dropped(void) {
+    auto actions = tokenize(
+        R"({"actions":[{"at":10},{"pos":5},{"at":20,"pos":5}]})");
+    TEST_ASSERT_EQUAL(1, actions.size());
+    TEST_ASSERT_EQUAL_UINT32(20, actions[0].at);
+}
+
+void test_tokenizer_inverted(void) {
+    bool inverted = false;
+    tokenize(R"({"inverted":true,"actions":[]})", &inverted);
+    TEST_ASSERT_TRUE(inverted);
+    tokenize(R"({"actions":[],"inverted":false})", &inverted);
+    TEST_ASSERT_FALSE(inverted);
+    tokenize(R"({"metadata":{"inverted":true}})", &inverted);
+    TEST_ASSERT_FALSE(inverted);
+}
+
+void test_tokenizer_malformed_input_fails(void) {
+    bool failed = false;
+    auto actions = tokenize(R"({"actions":[{"at":0,"pos":1}})", nullptr,
+                            &failed);
+    TEST_ASSERT_TRUE(failed);
+    TEST_ASSERT_EQUAL(1, actions.size());  // Completed before the error
+
+    tokenize("{\"actions\":[{\"at\":0,\"pos\":1}]} ~", nullptr, &failed);
+    TEST_ASSERT_TRUE(failed);
+
+    std::string deep(Tokenizer::maxDepth + 1, '[');
+    tokenize(deep, nullptr, &failed);
+    TEST_ASSERT_TRUE(failed);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Reader
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_reader_same_actions_for_any_chunk_size(void) {
+    std::string text = script(200);
+    auto expected = tokenize(text);
+    TEST_ASSERT_EQUAL(200, expected.size());
+
+    MemorySource source(text);
+    Reader<1, 4> tiny;
+    tiny.open(&source);
+    auto a = drain(tiny);
+    Reader<7, 3> odd;
+    odd.open(&source);
+    auto b = drain(odd);
+    Reader<> normal;
+    normal.open(&source);
+    auto c = drain(normal);
+
+    TEST_ASSERT_EQUAL(expected.size(), a.size());
+    TEST_ASSERT_EQUAL(expected.size(), b.size());
+    TEST_ASSERT_EQUAL(expected.size(), c.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(expected[i].at, a[i].at);
+        TEST_ASSERT_EQUAL_UINT8(expected[i].pos, a[i].pos);
+        TEST_ASSERT_EQUAL_UINT32(expected[i].at, b[i].at);
+        TEST_ASSERT_EQUAL_UINT32(expected[i].at, c[i].at);
+    }
+}
+
+void test_reader_prefetch_fills_ring(void) {
+    std::string text = script(100);
+    MemorySource source(text);
+    Reader<64, 16> reader;
+    TEST_ASSERT_TRUE(reader.open(&source));
+    TEST_ASSERT_EQUAL(0, reader.buffered());
+    reader.prefetch();
+    TEST_ASSERT_EQUAL(16, reader.buffered());
+
+    // Prefetching between takes keeps next() from parsing
+    Action action;
+    uint32_t count = 0;
+    while (reader.next(action)) {
+        count++;
+        reader.prefetch();
+    }
+    TEST_ASSERT_EQUAL(100, count);
+    TEST_ASSERT_EQUAL(0, reader.underruns());
+}
+
+void test_reader_counts_underruns(void) {
+    std::string text = script(10);
+    MemorySource source(text);
+    Reader<64, 16> reader;
+    reader.open(&source);
+    TEST_ASSERT_EQUAL(10, drain(reader).size());
+    TEST_ASSERT_EQUAL(1, reader.underruns());
+}
+
+void test_reader_empty_and_missing_source(void) {
+    std::string empty;
+    MemorySource source(empty);
+    Reader<> reader;
+    TEST_ASSERT_FALSE(reader.open(&source));
+    Action action;
+    TEST_ASSERT_FALSE(reader.next(action));
+    TEST_ASSERT_FALSE(reader.open(nullptr));
+    TEST_ASSERT_FALSE(reader.next(action));
+}
+
+void test_reader_stops_on_malformed_input(void) {
+    std::string text = R"({"actions":[{"at":0,"pos":1},{"at":10,"pos":2}})";
+    MemorySource source(text);
+    Reader<> reader;
+    reader.open(&source);
+    auto actions = drain(reader);
+    TEST_ASSERT_EQUAL(2, actions.size());
+    TEST_ASSERT_TRUE(reader.failed());
+}
+
+void test_reader_seek_forward(void) {
+    std::string text = script(1000);  // 0 .. 99900 ms
+    MemorySource source(text);
+    Reader<256, 32> reader;
+    reader.open(&source);
+    reader.prefetch();
+
+    reader.seek(1000);  // Still in the ring
+    Action action;
+    TEST_ASSERT_TRUE(reader.next(action));
+    TEST_ASSERT_EQUAL_UINT32(1000, action.at);
+
+    reader.seek(50050);  // Between actions
+    TEST_ASSERT_TRUE(reader.next(action));
+    TEST_ASSERT_EQUAL_UINT32(50100, action.at);
+    TEST_ASSERT_EQUAL_UINT8((501 * 37) % 101, action.pos);
+
+    reader.seek(200000);  // Past the end
+    TEST_ASSERT_FALSE(reader.next(action));
+}
+
+void test_reader_seek_back_uses_checkpoints(void) {
+    std::string text = script(5000);
+    MemorySource source(text);
+    Reader<256, 32, 8> reader;
+    reader.open(&source);
+    auto all = drain(reader);
+    TEST_ASSERT_EQUAL(5000, all.size());
+    uint32_t fullRead = reader.bytesRead();
+    TEST_ASSERT_EQUAL_UINT32(text.size(), fullRead);
+
+    // Each target is found exactly, and costs less than parsing from the
+    // start would
+    const uint32_t targets[] = {400000, 250000, 499900, 0, 123450};
+    for (uint32_t target : targets) {
+        uint32_t before = reader.bytesRead();
+        reader.seek(target);
+        Action action;
+        TEST_ASSERT_TRUE(reader.next(action));
+        uint32_t expected = (target + 99) / 100 * 100;
+        TEST_ASSERT_EQUAL_UINT32(expected, action.at);
+        TEST_ASSERT_EQUAL_UINT8(all[expected / 100].pos, action.pos);
+        uint32_t cost = reader.bytesRead() - before;
+        uint32_t fromStart = text.find(",{\"at\":" + std::to_string(expected));
+        if (target > 0) TEST_ASSERT_LESS_THAN_UINT32(fromStart, cost);
+    }
+
+    // And playback continues normally from there
+    auto rest = drain(reader);
+    TEST_ASSERT_EQUAL(5000 - 1236, rest.size());
+    TEST_ASSERT_EQUAL_UINT32(all.back().at, rest.back().at);
+}
+
+void test_reader_inverted(void) {
+    std::string text = R"({"inverted":true,"actions":[{"at":0,"pos":20}]})";
+    MemorySource source(text);
+    Reader<> reader;
+    reader.open(&source);
+    reader.prefetch();
+    TEST_ASSERT_TRUE(reader.inverted());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Timeline
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_timeline_move_times(void) {
+    Timeline timeline;
+    timeline.reset(0);
+    TEST_ASSERT_EQUAL_UINT32(500, timeline.moveTime({500, 10}));
+    TEST_ASSERT_EQUAL_UINT32(250, timeline.moveTime({750, 90}));
+    TEST_ASSERT_EQUAL_UINT32(0, timeline.moveTime({750, 20}));
+
+    // After a seek the first move takes the rest of the gap
+    timeline.reset(900);
+    TEST_ASSERT_EQUAL_UINT32(100, timeline.moveTime({1000, 40}));
+}
+
+void test_timeline_feeds_planSegment(void) {
+    // 10 mm/s per step unit, 10000 steps of travel, at 5 actions per second
+    std::string text = script(50, 200);
+    MemorySource source(text);
+    Reader<64, 8> reader;
+    reader.open(&source);
+    Timeline timeline;
+
+    const int32_t maxStroke = 10000;
+    const uint32_t maxSpeed = 60000;
+    const uint32_t maxAccel = 600000;
+    int32_t position = 0;
+    Action action;
+    uint32_t moves = 0;
+    while (reader.next(action)) {
+        reader.prefetch();
+        uint32_t ms = timeline.moveTime(action);
+        int32_t target =
+            streaming_logic::scaleStreamPosition(action.pos, maxStroke, 0);
+        if (ms == 0) {
+            continue;
+        }
+        motionParameter motion = {target, 0, 0, false, 0};
+        planSegment(motion, target - position, ms / 1000.0f, 0.0f, 0.0f,
+                    maxSpeed);
+        int jerk = 0;
+        limitMotion(motion, maxSpeed, maxAccel, 0, jerk);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(maxSpeed, motion.speed);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(maxAccel, motion.acceleration);
+        TEST_ASSERT_GREATER_THAN(0, motion.speed);
+        TEST_ASSERT_GREATER_THAN(0, motion.acceleration);
+        // Moves go all the way to the script position
+        TEST_ASSERT_EQUAL(target, motion.stroke);
+        position = motion.stroke;
+        moves++;
+    }
+    TEST_ASSERT_EQUAL(49, moves);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_benchmark_50k_actions(void) {
+    const uint32_t kActions = 50000;
+    std::string text = script(kActions);
+    MemorySource source(text);
+    auto *reader = new Reader<>();
+
+    size_t baseline = liveBytes;
+    peakBytes = liveBytes;
+    auto start = std::chrono::steady_clock::now();
+    reader->open(&source);
+    reader->prefetch();
+    uint32_t count = 0;
+    uint64_t checksum = 0;
+    Action action;
+    while (reader->next(action)) {
+        count++;
+        checksum += action.at + action.pos;
+        reader->prefetch();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    size_t peak = peakBytes - baseline;
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    printf("\n  %u actions, %u bytes, %u underruns\n", count,
+           unsigned(text.size()), reader->underruns());
+    printf("  %.1f MB/s, %.2f M actions/s, reader %u bytes, "
+           "peak heap while parsing %u bytes (a parsed document would hold "
+           "at least %u)\n",
+           text.size() / seconds / 1e6, count / seconds / 1e6,
+           unsigned(sizeof(Reader<>)), unsigned(peak),
+           unsigned(kActions * sizeof(Action)));
+
+    TEST_ASSERT_EQUAL(kActions, count);
+    TEST_ASSERT_EQUAL(0, reader->underruns());
+    TEST_ASSERT_EQUAL(0, peak);
+    TEST_ASSERT_TRUE(checksum > 0);
+    delete reader;
+}
+
+// ─── Runner ───────────────────────────────────────────────────────────────
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Tokenizer
+    RUN_TEST(test_tokenizer_reads_actions);
+    RUN_TEST(test_tokenizer_skips_everything_else);
+    RUN_TEST(test_tokenizer_any_key_order_and_extra_fields);
+    RUN_TEST(test_tokenizer_rounds_and_clamps);
+    RUN_TEST(test_tokenizer_incomplete_actions_are_dropped);
+    RUN_TEST(test_tokenizer_inverted);
+    RUN_TEST(test_tokenizer_malformed_input_fails);
+
+    // Reader
+    RUN_TEST(test_reader_same_actions_for_any_chunk_size);
+    RUN_TEST(test_reader_prefetch_fills_ring);
+    RUN_TEST(test_reader_counts_underruns);
+    RUN_TEST(test_reader_empty_and_missing_source);
+    RUN_TEST(test_reader_stops_on_malformed_input);
+    RUN_TEST(test_reader_seek_forward);
+    RUN_TEST(test_reader_seek_back_uses_checkpoints);
+    RUN_TEST(test_reader_inverted);
+
+    // Timeline
+    RUN_TEST(test_timeline_move_times);
+    RUN_TEST(test_timeline_feeds_planSegment);
+
+    // Benchmark
+    RUN_TEST(test_benchmark_50k_actions);
+
+    return UNITY_END();
+}
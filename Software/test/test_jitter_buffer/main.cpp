@@ -0,0 +1,325 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ JITTER BUFFER — UNIT TESTS & SIMULATION                                │
+// │                                                                        │
+// │ Tests for lib/OSSMLogic/src/jitter_buffer.h, the playout delay of      │
+// │ stream targets stamped in device time:                                 │
+// │   Delay — A quantile of how late writes arrive, slow to forget         │
+// │   Range — Minimum, maximum and reset                                   │
+// │                                                                        │
+// │ The simulation streams a point every 10 ms over a BLE-like link and    │
+// │ prints the end-to-end latency, from when a point was made to when it   │
+// │ plays, for stream:<pos>:<ms> commands timed by their arrival against   │
+// │ clock synced packets with a fixed and with the adaptive delay.         │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace fakeit;
+
+#include "clock_sync.h"
+#include "jitter_buffer.h"
+
+using jitter_buffer::PlayoutDelay;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static void arriveTimes(PlayoutDelay &playout, int32_t lateness, int times) {
+    for (int i = 0; i < times; i++) {
+        playout.arrived(lateness);
+    }
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Delay
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_playout_starts_at_minimum() {
+    PlayoutDelay playout(15, 500);
+    TEST_ASSERT_EQUAL(15, playout.delay());
+    TEST_ASSERT_EQUAL(0, playout.writes());
+}
+
+void test_playout_steady_link() {
+    PlayoutDelay playout;
+    arriveTimes(playout, 20, 50);
+    TEST_ASSERT_EQUAL(20, playout.delay());
+    TEST_ASSERT_EQUAL(0, playout.late());
+
+    // Rounded up to whole buckets
+    arriveTimes(playout, 21, 1000);
+    TEST_ASSERT_EQUAL(24, playout.delay());
+}
+
+void test_playout_early_writes_need_no_delay() {
+    PlayoutDelay playout;
+    arriveTimes(playout, -40, 50);
+    TEST_ASSERT_EQUAL(0, playout.delay());
+    TEST_ASSERT_EQUAL(0, playout.late());
+}
+
+void test_playout_covers_all_but_the_rarest_writes() {
+    // One write in 20 needs a retry: the delay waits for it
+    PlayoutDelay retries;
+    for (int i = 0; i < 2000; i++) {
+        retries.arrived(i % 20 ? 10 : 40);
+    }
+    TEST_ASSERT_EQUAL(40, retries.delay());
+
+    // One write in 200 is far out: it plays late rather than every write
+    PlayoutDelay outliers;
+    for (int i = 0; i < 2000; i++) {
+        outliers.arrived(i % 200 == 199 ? 300 : 10);
+    }
+    TEST_ASSERT_EQUAL(12, outliers.delay());
+    TEST_ASSERT_EQUAL(10, outliers.late());
+}
+
+void test_playout_grows_within_a_few_writes() {
+    PlayoutDelay playout;
+    arriveTimes(playout, 10, 1000);
+    arriveTimes(playout, 60, 20);
+    TEST_ASSERT_EQUAL(60, playout.delay());
+    TEST_ASSERT_TRUE(playout.late() < 20);
+}
+
+void test_playout_shrinks_slowly() {
+    PlayoutDelay playout;
+    arriveTimes(playout, 60, 1000);
+    arriveTimes(playout, 10, 100);
+    TEST_ASSERT_EQUAL(60, playout.delay());
+
+    arriveTimes(playout, 10, 5000);
+    TEST_ASSERT_EQUAL(12, playout.delay());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Range
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_playout_clamps_to_range() {
+    PlayoutDelay playout(5, 100);
+    arriveTimes(playout, 1, 20);
+    TEST_ASSERT_EQUAL(5, playout.delay());
+
+    arriveTimes(playout, 1000, 20);
+    TEST_ASSERT_EQUAL(100, playout.delay());
+    TEST_ASSERT_EQUAL(20, playout.late());
+    TEST_ASSERT_EQUAL(40, playout.writes());
+
+    // Beyond the histogram
+    PlayoutDelay wide;
+    arriveTimes(wide, 100000, 10);
+    TEST_ASSERT_EQUAL(PlayoutDelay::BucketMs * (PlayoutDelay::Buckets - 1),
+                      wide.delay());
+}
+
+void test_playout_reset_forgets_link() {
+    PlayoutDelay playout(5, 500);
+    arriveTimes(playout, 80, 10);
+    playout.reset();
+    TEST_ASSERT_EQUAL(5, playout.delay());
+    TEST_ASSERT_EQUAL(0, playout.writes());
+    TEST_ASSERT_EQUAL(0, playout.late());
+
+    // The first write after a reset sets the delay on its own
+    playout.arrived(30);
+    TEST_ASSERT_EQUAL(32, playout.delay());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Simulation
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Deterministic noise, so the printed numbers don't move between runs
+struct Noise {
+    uint32_t state;
+    double next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return double(state) / 4294967296.0;
+    }
+};
+
+// A BLE connection, in device ms. Writes wait for the next connection
+// event, each lost event costs another interval, and the stack adds a
+// little. With interference, every 10 s comes a second where half the
+// events are lost.
+struct Link {
+    bool interference;
+    double interval = 30.0;
+    Noise noise{0x2545F491u};
+
+    double deliver(double sent) {
+        bool disturbed = interference && fmod(sent, 10000.0) >= 9000.0;
+        double retry = disturbed ? 0.5 : 0.1;
+        double event = ceil(sent / interval) * interval;
+        while (noise.next() < retry) event += interval;
+        return event + 2.0 * noise.next();
+    }
+};
+
+// The client's clock runs 50 ppm fast and far ahead of the device's
+static double clientClock(double device) {
+    return device * (1.0 + 50e-6) + 7654321.0;
+}
+
+struct Stats {
+    const char *name;
+    std::vector<double> latencies;
+    size_t late = 0;
+
+    double mean() const {
+        double sum = 0.0;
+        for (double latency : latencies) sum += latency;
+        return sum / double(latencies.size());
+    }
+
+    double stddev() const {
+        double average = mean();
+        double variance = 0.0;
+        for (double latency : latencies) {
+            variance += (latency - average) * (latency - average);
+        }
+        return sqrt(variance / double(latencies.size()));
+    }
+
+    void print() const {
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        printf("  %-34s %8.1f %8.1f %8.1f %8.1f %6.2f%%\n", name, mean(),
+               stddev(), sorted[sorted.size() * 99 / 100], sorted.back(),
+               100.0 * double(late) / double(latencies.size()));
+    }
+};
+
+// The device has been up a minute when the stream starts
+static const double kStart = 60000.0;
+static const double kSeconds = 300.0;
+static const double kPointEvery = 10.0;
+
+// stream:<pos>:10 per point, due 10 ms after it arrives. With latency
+// compensation on, one more inTime later.
+static Stats arrivalTimed(Link link, bool compensation) {
+    Stats stats;
+    stats.name = compensation ? "arrival timed, compensated" : "arrival timed";
+    for (double made = kStart; made < kStart + kSeconds * 1000.0;
+         made += kPointEvery) {
+        double arrived = link.deliver(made);
+        double plays = arrived + kPointEvery + (compensation ? kPointEvery : 0);
+        stats.latencies.push_back(plays - made);
+    }
+    return stats;
+}
+
+// Packets of what was made during a connection interval, stamped with the
+// device time each point was made, from a sync every 5 s. fixed is the
+// playout delay, negative for the adaptive one.
+static Stats deviceTimed(Link link, double fixed) {
+    Stats stats;
+    stats.name = fixed < 0.0 ? "device timed, adaptive delay"
+                             : "device timed, fixed 150 ms delay";
+    clock_sync::Estimator estimator;
+    PlayoutDelay playout;
+
+    double nextSync = kStart;
+    std::vector<double> made;
+    std::vector<uint32_t> due;
+    for (double now = kStart; now < kStart + kSeconds * 1000.0;
+         now += kPointEvery) {
+        if (now >= nextSync) {
+            // A few exchanges, each over the link and back
+            for (int i = 0; i < 4; i++) {
+                double sent = now + i * 100.0;
+                uint8_t request[clock_sync::requestSize];
+                uint8_t reply[clock_sync::replySize];
+                clock_sync::request(uint32_t(clientClock(sent)), request);
+                double there = link.deliver(sent);
+                clock_sync::reply(request, sizeof(request), uint32_t(there),
+                                  uint32_t(there), reply);
+                double back = link.deliver(there);
+                clock_sync::Sample sample;
+                clock_sync::sample(reply, sizeof(reply),
+                                   uint32_t(clientClock(back)), sample);
+                estimator.add(sample);
+            }
+            nextSync = now + 5000.0;
+        }
+
+        made.push_back(now);
+        due.push_back(estimator.toDevice(uint32_t(clientClock(now))));
+        if (made.size() < 3) continue;
+
+        double arrived = link.deliver(now);
+        playout.arrived(int32_t(uint32_t(arrived) - due[0]));
+        double delay = fixed < 0.0 ? double(playout.delay()) : fixed;
+        for (size_t i = 0; i < made.size(); i++) {
+            double plays = double(due[i]) + delay;
+            if (plays < arrived) {
+                plays = arrived;
+                stats.late++;
+            }
+            stats.latencies.push_back(plays - made[i]);
+        }
+        made.clear();
+        due.clear();
+    }
+    return stats;
+}
+
+void test_playout_simulation_latency_variance() {
+    printf("\n  end-to-end latency in ms over %.0f s, 30 ms connection "
+           "interval\n",
+           kSeconds);
+    for (bool interference : {false, true}) {
+        Link link = {interference};
+        Stats text = arrivalTimed(link, false);
+        Stats compensated = arrivalTimed(link, true);
+        Stats fixed = deviceTimed(link, 150.0);
+        Stats adaptive = deviceTimed(link, -1.0);
+
+        printf("\n  %-34s %8s %8s %8s %8s %7s\n",
+               interference ? "with interference" : "calm link", "mean",
+               "stddev", "p99", "max", "late");
+        text.print();
+        compensated.print();
+        fixed.print();
+        adaptive.print();
+
+        TEST_ASSERT_TRUE(adaptive.stddev() < text.stddev() * 0.6);
+        TEST_ASSERT_TRUE(adaptive.late < adaptive.latencies.size() / 50);
+        if (!interference) {
+            TEST_ASSERT_TRUE(adaptive.mean() < fixed.mean() / 2.0);
+        }
+    }
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_playout_starts_at_minimum);
+    RUN_TEST(test_playout_steady_link);
+    RUN_TEST(test_playout_early_writes_need_no_delay);
+    RUN_TEST(test_playout_covers_all_but_the_rarest_writes);
+    RUN_TEST(test_playout_grows_within_a_few_writes);
+    RUN_TEST(test_playout_shrinks_slowly);
+
+    RUN_TEST(test_playout_clamps_to_range);
+    RUN_TEST(test_playout_reset_forgets_link);
+
+    RUN_TEST(test_playout_simulation_latency_variance);
+
+    return UNITY_END();
+}
@@ -0,0 +1,700 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ KEYFRAME PATTERN — UNIT & STREAMING TESTS                              │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/KeyframeFormat.h and KeyframePattern.h: │
+// │   keyframe_format — Header and record encoding, same bytes as          │
+// │                     scripts/keyframe_encoder.py                        │
+// │   KeyframeStream  — Double-buffered prefetch, looping, underruns       │
+// │   KeyframePattern — Targets, speed scaling, holds, repeated queries    │
+// │   select()        — File picked on the device, taken on restart        │
+// │                                                                        │
+// │ The streaming test writes a 1M keyframe file and plays it through the  │
+// │ two prefetch blocks. Global operator new is counted to prove that      │
+// │ memory does not grow with the file.                                    │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace fakeit;
+
+#include "KeyframePattern.h"
+
+// ─── Allocation counter ──────────────────────────────────────────────────
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Keyframe file held in memory
+class MemorySource : public KeyframeSource {
+  public:
+    std::vector<uint8_t> bytes;
+    int reads = 0;
+
+    uint32_t size() { return uint32_t(bytes.size()); }
+
+    size_t read(uint32_t offset, uint8_t *buffer, size_t length) {
+        reads++;
+        if (offset >= bytes.size()) return 0;
+        if (length > bytes.size() - offset) length = bytes.size() - offset;
+        memcpy(buffer, bytes.data() + offset, length);
+        return length;
+    }
+};
+
+// Keyframe file on disk, read with fseek()/fread() like the LittleFS source
+class FileSource : public KeyframeSource {
+  public:
+    explicit FileSource(FILE *file) : _file(file) {
+        fseek(_file, 0, SEEK_END);
+        _size = uint32_t(ftell(_file));
+    }
+
+    uint32_t size() { return _size; }
+
+    size_t read(uint32_t offset, uint8_t *buffer, size_t length) {
+        if (fseek(_file, long(offset), SEEK_SET) != 0) return 0;
+        return fread(buffer, 1, length, _file);
+    }
+
+  private:
+    FILE *_file;
+    uint32_t _size;
+};
+
+static keyframe move(uint16_t position, uint16_t durationMs,
+                     uint16_t acceleration = 0, uint16_t jerk = 0) {
+    return {false, position, durationMs, acceleration, jerk};
+}
+
+static keyframe hold(uint16_t durationMs) {
+    return {true, 0, durationMs, 0, 0};
+}
+
+static MemorySource *encodeFile(const std::vector<keyframe> &frames,
+                                bool loop = false,
+                                uint16_t referenceStrokeMs = 1000) {
+    MemorySource *source = new MemorySource();
+    uint8_t bytes[KEYFRAME_HEADER_SIZE];
+    keyframeHeader header = {uint8_t(loop ? KEYFRAME_LOOP : 0),
+                             referenceStrokeMs, uint32_t(frames.size())};
+    keyframe_format::encodeHeader(header, bytes);
+    source->bytes.assign(bytes, bytes + KEYFRAME_HEADER_SIZE);
+    for (const keyframe &frame : frames) {
+        size_t length = keyframe_format::encode(frame, bytes);
+        source->bytes.insert(source->bytes.end(), bytes, bytes + length);
+    }
+    return source;
+}
+
+// Keyframe pattern that opens selected files from memory instead of LittleFS
+class SelectingPattern : public KeyframePattern {
+  public:
+    using KeyframePattern::KeyframePattern;
+
+    std::vector<std::pair<std::string, MemorySource *>> files;
+    std::string opened;
+    int closes = 0;
+
+  protected:
+    KeyframeSource *_openFile(const char *path) {
+        for (auto &file : files) {
+            if (file.first == path) {
+                opened = path;
+                return file.second;
+            }
+        }
+        return nullptr;
+    }
+
+    void _closeFile() {
+        opened.clear();
+        closes++;
+    }
+};
+
+// Deterministic keyframe i of the streaming test, every kind of record
+static keyframe generated(uint32_t i) {
+    switch (i % 7) {
+        case 3:
+            return hold(uint16_t(10 + i % 50));
+        case 5:
+            return move(uint16_t(i * 40503u), uint16_t(100 + i % 900),
+                        uint16_t(500 + i % 3000));
+        case 6:
+            return move(uint16_t(i * 40503u), uint16_t(100 + i % 900),
+                        uint16_t(500 + i % 3000), uint16_t(100 + i % 9000));
+        default:
+            return move(uint16_t(i * 40503u), uint16_t(100 + i % 900));
+    }
+}
+
+static bool sameKeyframe(const keyframe &a, const keyframe &b) {
+    if (a.hold != b.hold || a.durationMs != b.durationMs ||
+        a.acceleration != b.acceleration || a.jerk != b.jerk) {
+        return false;
+    }
+    return a.hold || a.position == b.position;
+}
+
+// Pattern as the StrokeEngine sets it up: 2000 steps stroke at depth 3000,
+// 1 s per full stroke, 10 steps/mm
+static void setUpPattern(KeyframePattern &p, float timeOfStroke = 1.0f) {
+    p.setSpeedLimit(100000, 1000000, 10);
+    p.setStroke(2000);
+    p.setDepth(3000);
+    p.setTimeOfStroke(timeOfStroke);
+    p.setSensation(0.0f);
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+    KeyframePattern::clear();
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Format
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_format_header_round_trip() {
+    uint8_t bytes[KEYFRAME_HEADER_SIZE];
+    keyframeHeader header = {KEYFRAME_LOOP, 1200, 70000};
+    keyframe_format::encodeHeader(header, bytes);
+    TEST_ASSERT_EQUAL_MEMORY("OSKF", bytes, 4);
+    TEST_ASSERT_EQUAL(1, bytes[4]);
+
+    keyframeHeader decoded;
+    TEST_ASSERT_TRUE(keyframe_format::decodeHeader(bytes, decoded));
+    TEST_ASSERT_EQUAL(KEYFRAME_LOOP, decoded.flags);
+    TEST_ASSERT_EQUAL(1200, decoded.referenceStrokeMs);
+    TEST_ASSERT_EQUAL(70000, decoded.count);
+}
+
+void test_format_rejects_foreign_files() {
+    uint8_t bytes[KEYFRAME_HEADER_SIZE] = {'O', 'S', 'K', 'X', 1, 0, 0xE8, 3};
+    keyframeHeader decoded;
+    TEST_ASSERT_FALSE(keyframe_format::decodeHeader(bytes, decoded));
+    memcpy(bytes, "OSKF", 4);
+    bytes[4] = 2;
+    TEST_ASSERT_FALSE(keyframe_format::decodeHeader(bytes, decoded));
+    bytes[4] = 1;
+    TEST_ASSERT_TRUE(keyframe_format::decodeHeader(bytes, decoded));
+}
+
+void test_format_records_match_encoder_script() {
+    // Same bytes as scripts/test_keyframe_encoder.py
+    uint8_t bytes[KEYFRAME_RECORD_MAX];
+    const uint8_t plain[] = {0x00, 0x34, 0x12, 0xF4, 0x01};
+    TEST_ASSERT_EQUAL(5, keyframe_format::encode(move(0x1234, 500), bytes));
+    TEST_ASSERT_EQUAL_MEMORY(plain, bytes, 5);
+
+    const uint8_t pause[] = {0x04, 0xFA, 0x00};
+    TEST_ASSERT_EQUAL(3, keyframe_format::encode(hold(250), bytes));
+    TEST_ASSERT_EQUAL_MEMORY(pause, bytes, 3);
+
+    const uint8_t full[] = {0x03, 1, 0, 2, 0, 3, 0, 4, 0};
+    TEST_ASSERT_EQUAL(9, keyframe_format::encode(move(1, 2, 3, 4), bytes));
+    TEST_ASSERT_EQUAL_MEMORY(full, bytes, 9);
+}
+
+void test_format_record_round_trip() {
+    for (uint32_t i = 0; i < 100; i++) {
+        uint8_t bytes[KEYFRAME_RECORD_MAX];
+        keyframe frame = generated(i);
+        size_t length = keyframe_format::encode(frame, bytes);
+        TEST_ASSERT_EQUAL(length, keyframe_format::recordLength(bytes[0]));
+
+        keyframe decoded;
+        TEST_ASSERT_TRUE(keyframe_format::decode(bytes, decoded));
+        TEST_ASSERT_TRUE(sameKeyframe(frame, decoded));
+    }
+    uint8_t unknown[] = {0x80, 0, 0, 0, 0};
+    keyframe decoded;
+    TEST_ASSERT_FALSE(keyframe_format::decode(unknown, decoded));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stream
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_stream_rejects_empty_and_foreign_files() {
+    KeyframeStream stream;
+    MemorySource empty;
+    TEST_ASSERT_FALSE(stream.open(nullptr));
+    TEST_ASSERT_FALSE(stream.open(&empty));
+
+    MemorySource *noFrames = encodeFile({});
+    TEST_ASSERT_FALSE(stream.open(noFrames));
+    delete noFrames;
+
+    MemorySource *foreign = encodeFile({move(1, 1)});
+    foreign->bytes[0] = 'X';
+    TEST_ASSERT_FALSE(stream.open(foreign));
+    keyframe frame;
+    TEST_ASSERT_FALSE(stream.next(frame));
+    delete foreign;
+}
+
+void test_stream_decodes_records_across_blocks() {
+    // 9 byte records never line up with the block size
+    std::vector<keyframe> frames;
+    for (uint32_t i = 0; i < 500; i++) {
+        frames.push_back(move(uint16_t(i), uint16_t(i + 1), 7, 9));
+    }
+    MemorySource *source = encodeFile(frames);
+    KeyframeStream stream;
+    TEST_ASSERT_TRUE(stream.open(source));
+    TEST_ASSERT_EQUAL(500, stream.header().count);
+
+    keyframe frame;
+    for (uint32_t i = 0; i < 500; i++) {
+        TEST_ASSERT_TRUE(stream.next(frame));
+        TEST_ASSERT_TRUE(sameKeyframe(frames[i], frame));
+        stream.prefetch();
+    }
+    TEST_ASSERT_FALSE(stream.next(frame));
+    TEST_ASSERT_EQUAL(0, stream.underruns());
+    delete source;
+}
+
+void test_stream_without_prefetch_reads_synchronously() {
+    std::vector<keyframe> frames(200, move(1000, 100));
+    MemorySource *source = encodeFile(frames);
+    KeyframeStream stream;
+    stream.open(source);
+
+    keyframe frame;
+    int count = 0;
+    while (stream.next(frame)) count++;
+    TEST_ASSERT_EQUAL(200, count);
+    // 1000 bytes: two blocks read on open, the other two on demand
+    TEST_ASSERT_EQUAL(2, stream.underruns());
+    TEST_ASSERT_EQUAL(4, stream.blockReads());
+    delete source;
+}
+
+void test_stream_loops_seamlessly() {
+    std::vector<keyframe> frames;
+    for (uint32_t i = 0; i < 77; i++) {
+        frames.push_back(generated(i));
+    }
+    MemorySource *source = encodeFile(frames, true);
+    KeyframeStream stream;
+    stream.open(source);
+
+    keyframe frame;
+    for (uint32_t i = 0; i < 77 * 10; i++) {
+        TEST_ASSERT_TRUE(stream.next(frame));
+        TEST_ASSERT_TRUE(sameKeyframe(frames[i % 77], frame));
+        stream.prefetch();
+    }
+    TEST_ASSERT_EQUAL(0, stream.underruns());
+    delete source;
+}
+
+void test_stream_rewind_starts_over() {
+    MemorySource *source = encodeFile({move(1, 1), move(2, 2), move(3, 3)});
+    KeyframeStream stream;
+    stream.open(source);
+    keyframe frame;
+    stream.next(frame);
+    stream.next(frame);
+    TEST_ASSERT_EQUAL(2, frame.position);
+    stream.rewind();
+    stream.next(frame);
+    TEST_ASSERT_EQUAL(1, frame.position);
+    delete source;
+}
+
+void test_stream_stops_at_broken_record() {
+    MemorySource *source = encodeFile({move(1, 1), move(2, 2)});
+    source->bytes[KEYFRAME_HEADER_SIZE + 5] = 0xF0;
+    KeyframeStream stream;
+    stream.open(source);
+    keyframe frame;
+    TEST_ASSERT_TRUE(stream.next(frame));
+    TEST_ASSERT_FALSE(stream.next(frame));
+    TEST_ASSERT_FALSE(stream.next(frame));
+    delete source;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Pattern
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pattern_without_file_skips() {
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    MemorySource empty;
+    TEST_ASSERT_FALSE(p.play(&empty));
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+}
+
+void test_pattern_positions_follow_depth_and_stroke() {
+    MemorySource *source = encodeFile({move(65535, 500), move(0, 500),
+                                       move(32768, 250)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    TEST_ASSERT_TRUE(p.play(source));
+
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(1).stroke);
+    TEST_ASSERT_EQUAL(2000, p.nextTarget(2).stroke);
+    TEST_ASSERT_FALSE(p.nextTarget(2).skip);
+
+    p.setDepth(2500);
+    TEST_ASSERT_EQUAL(1500, p.nextTarget(2).stroke);
+    delete source;
+}
+
+void test_pattern_trapezoid_meets_duration() {
+    // 2000 steps in 0.5 s with 1/3 acceleration: 6000 steps/s, 36000 steps/s²
+    MemorySource *source = encodeFile({move(65535, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_EQUAL(6000, m.speed);
+    TEST_ASSERT_EQUAL(36000, m.acceleration);
+    TEST_ASSERT_EQUAL(0, m.jerk);
+    delete source;
+}
+
+void test_pattern_durations_scale_with_speed() {
+    // Made for 500 ms strokes, played at 1 s: twice the time, half the speed
+    MemorySource *source = encodeFile({move(65535, 500)}, false, 500);
+    KeyframePattern p("Keyframes");
+    setUpPattern(p, 1.0f);
+    p.play(source);
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_EQUAL(3000, m.speed);
+    TEST_ASSERT_EQUAL(9000, m.acceleration);
+    delete source;
+}
+
+void test_pattern_given_acceleration_and_jerk() {
+    // 2000 steps in 1 s at 1000 mm/s² = 10000 steps/s²:
+    // v = (a t - sqrt(a²t² - 4 a d)) / 2 = 2763.9 steps/s
+    MemorySource *source = encodeFile({move(65535, 1000, 1000, 50),
+                                       move(0, 100, 1000)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_EQUAL(10000, m.acceleration);
+    TEST_ASSERT_INT_WITHIN(1, 2763, m.speed);
+    TEST_ASSERT_EQUAL(500000, m.jerk);
+
+    // Not possible in 100 ms: triangle with the given acceleration
+    m = p.nextTarget(1);
+    TEST_ASSERT_EQUAL(10000, m.acceleration);
+    TEST_ASSERT_EQUAL(4472, m.speed);
+    delete source;
+}
+
+void test_pattern_repeated_queries_return_same_target() {
+    // The StrokeEngine asks for an index again after applying new settings
+    // and prepares a few indices ahead
+    std::vector<keyframe> frames;
+    for (uint32_t i = 0; i < 20; i++) {
+        frames.push_back(move(uint16_t(i * 3000), 100));
+    }
+    MemorySource *source = encodeFile(frames);
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+
+    for (unsigned int index = 0; index < 16; index++) {
+        int expected = 1000 + int(2000.0f * index * 3000 / 65535.0f);
+        for (unsigned int ahead = index; ahead < index + 4; ahead++) {
+            p.nextTarget(ahead);
+        }
+        TEST_ASSERT_EQUAL(expected, p.nextTarget(index).stroke);
+    }
+    delete source;
+}
+
+void test_pattern_hold_pauses_on_the_timeline() {
+    MemorySource *source = encodeFile({move(65535, 500), hold(300),
+                                       move(0, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+    TEST_ASSERT_FALSE(p.nextTarget(0).skip);
+
+    // Planned: move until 500 ms, hold until 800 ms
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(520);
+    TEST_ASSERT_TRUE(p.nextTarget(1).skip);
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(799);
+    TEST_ASSERT_TRUE(p.nextTarget(1).skip);
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(801);
+    motionParameter m = p.nextTarget(1);
+    TEST_ASSERT_FALSE(m.skip);
+    TEST_ASSERT_EQUAL(1000, m.stroke);
+    delete source;
+}
+
+void test_pattern_hold_scales_with_speed() {
+    MemorySource *source = encodeFile({move(65535, 500), hold(300),
+                                       move(0, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p, 2.0f);
+    p.play(source);
+    p.nextTarget(0);
+
+    // Twice the stroke time: move until 1000 ms, hold until 1600 ms
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(1500);
+    TEST_ASSERT_TRUE(p.nextTarget(1).skip);
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(1601);
+    TEST_ASSERT_FALSE(p.nextTarget(1).skip);
+    delete source;
+}
+
+void test_pattern_end_of_file_stays() {
+    MemorySource *source = encodeFile({move(65535, 500), move(0, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    TEST_ASSERT_FALSE(p.nextTarget(0).skip);
+    TEST_ASSERT_FALSE(p.nextTarget(1).skip);
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    TEST_ASSERT_TRUE(p.nextTarget(3).skip);
+    delete source;
+}
+
+void test_pattern_restart_plays_from_beginning() {
+    MemorySource *source = encodeFile({move(65535, 500), move(0, 500),
+                                       move(32768, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    p.nextTarget(0);
+    p.nextTarget(1);
+    p.nextTarget(2);
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(1).stroke);
+    delete source;
+}
+
+void test_pattern_loops() {
+    MemorySource *source = encodeFile({move(65535, 500), move(0, 500)}, true);
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    for (unsigned int index = 0; index < 100; index++) {
+        motionParameter m = p.nextTarget(index);
+        TEST_ASSERT_FALSE(m.skip);
+        TEST_ASSERT_EQUAL((index % 2) ? 1000 : 3000, m.stroke);
+        p.prefetch();
+    }
+    delete source;
+}
+
+void test_pattern_starts_at_the_first_index_asked_for() {
+    // A crossfade hands over at whatever stroke the engine is at
+    MemorySource *source = encodeFile({move(65535, 500), move(0, 500),
+                                       move(32768, 500)});
+    KeyframePattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(40).stroke);
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(41).stroke);
+    TEST_ASSERT_EQUAL(2000, p.nextTarget(42).stroke);
+    TEST_ASSERT_TRUE(p.nextTarget(43).skip);
+
+    // Back at the start, or before it: play from the beginning
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(1).stroke);
+    delete source;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Selection
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_select_rejects_empty_and_long_paths() {
+    uint32_t before = KeyframePattern::revision();
+    TEST_ASSERT_FALSE(KeyframePattern::select(nullptr));
+    TEST_ASSERT_FALSE(KeyframePattern::select(""));
+    std::string tooLong(KEYFRAME_PATH_MAX, 'a');
+    TEST_ASSERT_FALSE(KeyframePattern::select(tooLong.c_str()));
+    TEST_ASSERT_EQUAL(before, KeyframePattern::revision());
+
+    tooLong.pop_back();
+    TEST_ASSERT_TRUE(KeyframePattern::select(tooLong.c_str()));
+    TEST_ASSERT_TRUE(KeyframePattern::revision() != before);
+}
+
+void test_selected_file_plays_from_restart() {
+    MemorySource *a = encodeFile({move(65535, 500), move(0, 500)}, true);
+    MemorySource *b = encodeFile({move(32768, 500), move(0, 500)}, true);
+    SelectingPattern p("Keyframes");
+    p.files = {{"/a.oskf", a}, {"/b.oskf", b}};
+    setUpPattern(p);
+
+    // Nothing selected: stands still
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+
+    TEST_ASSERT_TRUE(KeyframePattern::select("/a.oskf"));
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(1).stroke);
+    TEST_ASSERT_EQUAL_STRING("/a.oskf", p.opened.c_str());
+
+    // Another file is taken when the pattern restarts, not mid-run
+    TEST_ASSERT_TRUE(KeyframePattern::select("/b.oskf"));
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(2).stroke);
+    TEST_ASSERT_EQUAL(2000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL_STRING("/b.oskf", p.opened.c_str());
+    TEST_ASSERT_EQUAL(1, p.closes);
+
+    // Deselected: closed and standing still after the restart
+    KeyframePattern::clear();
+    TEST_ASSERT_EQUAL(1000, p.nextTarget(1).stroke);
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    TEST_ASSERT_EQUAL(2, p.closes);
+    TEST_ASSERT_TRUE(p.opened.empty());
+    delete a;
+    delete b;
+}
+
+void test_selection_does_not_replace_played_source() {
+    // A source given to play() stays until a file is selected
+    MemorySource *source = encodeFile({move(65535, 500)}, true);
+    SelectingPattern p("Keyframes");
+    setUpPattern(p);
+    p.play(source);
+    KeyframePattern::clear();
+    TEST_ASSERT_EQUAL(3000, p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(0, p.closes);
+
+    // A file that can't be opened stops it
+    TEST_ASSERT_TRUE(KeyframePattern::select("/missing.oskf"));
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    delete source;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Streaming 1M keyframes
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const uint32_t kKeyframes = 1000000;
+
+void test_stream_one_million_keyframes_in_bounded_memory() {
+    FILE *file = tmpfile();
+    TEST_ASSERT_NOT_NULL(file);
+
+    uint8_t bytes[KEYFRAME_HEADER_SIZE];
+    keyframeHeader header = {0, 1000, kKeyframes};
+    keyframe_format::encodeHeader(header, bytes);
+    fwrite(bytes, 1, KEYFRAME_HEADER_SIZE, file);
+    for (uint32_t i = 0; i < kKeyframes; i++) {
+        fwrite(bytes, 1, keyframe_format::encode(generated(i), bytes), file);
+    }
+    fflush(file);
+
+    FileSource source(file);
+    KeyframeStream stream;
+    TEST_ASSERT_TRUE(stream.open(&source));
+
+    size_t allocationsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    uint32_t count = 0;
+    uint32_t mismatches = 0;
+    keyframe frame;
+    while (stream.next(frame)) {
+        if (!sameKeyframe(generated(count), frame)) mismatches++;
+        count++;
+        stream.prefetch();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocationsDuring = allocations - allocationsBefore;
+    double seconds = std::chrono::duration<double>(stop - start).count();
+
+    printf("\n  %u keyframes, %u bytes, %u block reads, %u underruns\n",
+           count, source.size(), stream.blockReads(), stream.underruns());
+    printf("  %.1f M keyframes/s, stream object %u bytes, "
+           "%u heap allocations while playing\n",
+           count / seconds / 1e6, unsigned(sizeof(KeyframeStream)),
+           unsigned(allocationsDuring));
+    fclose(file);
+
+    TEST_ASSERT_EQUAL(kKeyframes, count);
+    TEST_ASSERT_EQUAL(0, mismatches);
+    TEST_ASSERT_EQUAL(0, stream.underruns());
+    TEST_ASSERT_EQUAL(0, allocationsDuring);
+    TEST_ASSERT_TRUE(sizeof(KeyframeStream) <= 2 * KEYFRAME_BLOCK_SIZE + 64);
+    TEST_ASSERT_TRUE(sizeof(KeyframePattern) <= 1024);
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_format_header_round_trip);
+    RUN_TEST(test_format_rejects_foreign_files);
+    RUN_TEST(test_format_records_match_encoder_script);
+    RUN_TEST(test_format_record_round_trip);
+
+    RUN_TEST(test_stream_rejects_empty_and_foreign_files);
+    RUN_TEST(test_stream_decodes_records_across_blocks);
+    RUN_TEST(test_stream_without_prefetch_reads_synchronously);
+    RUN_TEST(test_stream_loops_seamlessly);
+    RUN_TEST(test_stream_rewind_starts_over);
+    RUN_TEST(test_stream_stops_at_broken_record);
+
+    RUN_TEST(test_pattern_without_file_skips);
+    RUN_TEST(test_pattern_positions_follow_depth_and_stroke);
+    RUN_TEST(test_pattern_trapezoid_meets_duration);
+    RUN_TEST(test_pattern_durations_scale_with_speed);
+    RUN_TEST(test_pattern_given_acceleration_and_jerk);
+    RUN_TEST(test_pattern_repeated_queries_return_same_target);
+    RUN_TEST(test_pattern_hold_pauses_on_the_timeline);
+    RUN_TEST(test_pattern_hold_scales_with_speed);
+    RUN_TEST(test_pattern_end_of_file_stays);
+    RUN_TEST(test_pattern_restart_plays_from_beginning);
+    RUN_TEST(test_pattern_loops);
+    RUN_TEST(test_pattern_starts_at_the_first_index_asked_for);
+
+    RUN_TEST(test_select_rejects_empty_and_long_paths);
+    RUN_TEST(test_selected_file_plays_from_restart);
+    RUN_TEST(test_selection_does_not_replace_played_source);
+
+    RUN_TEST(test_stream_one_million_keyframes_in_bounded_memory);
+
+    return UNITY_END();
+}
@@ -14,7 +14,7 @@
 // │   stroke     : z.number().int()  — cast from float                   │
 // │   sensation  : z.number().int()  — cast from float                   │
 // │   depth      : z.number().int()  — cast from float                   │
-// │   pattern    : z.number().int()  — StrokePatterns enum ordinal       │
+// │   pattern    : z.number().int()  — PatternRegistry index             │
 // │   position   : z.number()        — stepper position in mm (float)    │
 // │   sessionId  : z.uuid()          — generated per MQTT connection      │
 // │   meta       : z.string().optional() — JSON metadata (optional)       │
@@ -31,6 +31,7 @@
 // │ and lost telemetry data.                                               │
 // └──────────────────────────────────────────────────────────────────────────┘
 
+#include <ArduinoFake.h>
 #include <ArduinoJson.h>
 #include <unity.h>
 
@@ -38,6 +39,8 @@
 #include <set>
 #include <string>
 
+#include "PatternRegistry.h"
+
 // --- Required keys that the Dashboard Zod schema mandates ---
 static const std::set<std::string> REQUIRED_KEYS = {
     "timestamp", "state", "speed",     "stroke", "sensation",
@@ -193,11 +196,11 @@ void test_key_count_without_meta() {
 }
 
 // ─── Test: pattern enum values stay within known range ───────────────────
-// StrokePatterns has 7 values (0-6). The Dashboard stores this as an int
-// column and doesn't validate the range, but we should stay sane.
+// Every PatternRegistry index, 0 to count - 1. The Dashboard stores this as
+// an int column and doesn't validate the range, but we should stay sane.
 
 void test_pattern_boundary_values() {
-    for (int p = 0; p <= 6; p++) {
+    for (int p = 0; p < PatternRegistry::count; p++) {
         auto doc = buildPayload(0, "s", 0, 0, 0, 0, p, 0.0f,
                                 "00000000-0000-0000-0000-000000000000");
         TEST_ASSERT_EQUAL_INT(p, doc["pattern"].as<int>());
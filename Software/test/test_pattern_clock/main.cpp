@@ -0,0 +1,271 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN CLOCK — UNIT TESTS & TIME-WARP SIMULATION                      │
+// │                                                                        │
+// │ Tests for the pattern clock in lib/StrokeEngine/src/pattern.h:         │
+// │   setClock()        — Patterns run on an injected clock, not millis()  │
+// │   _isStillDelayed() — Pauses survive the 49.7 day millis() rollover    │
+// │                                                                        │
+// │ The simulation plays StopNGo and Deeper for hours of virtual time the  │
+// │ way the stroking task does: every move advances the clock by its       │
+// │ trapezoidal duration, every pause by one 10 ms poll. millis() is not   │
+// │ stubbed, so any call to it fails the test.                             │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+using namespace fakeit;
+
+#include "pattern.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static uint32_t virtualMillis = 0;
+
+static unsigned long virtualClock() { return virtualMillis; }
+
+static long realMap(long x, long in_min, long in_max, long out_min,
+                    long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static void setupPattern(Pattern &p, int stroke, int depth,
+                         float timeOfStroke, float sensation) {
+    p.setStroke(stroke);
+    p.setDepth(depth);
+    p.setTimeOfStroke(timeOfStroke);
+    p.setSensation(sensation);
+}
+
+// Time of a trapezoidal move in ms
+static uint32_t moveMillis(int distance, int speed, int acceleration) {
+    double d = fabs(double(distance));
+    double v = speed;
+    double a = acceleration;
+    if (d == 0.0 || v <= 0.0 || a <= 0.0) return 0;
+    double seconds = (d <= v * v / a) ? 2.0 * sqrt(d / a) : d / v + v / a;
+    return uint32_t(lround(seconds * 1000.0));
+}
+
+struct SimResult {
+    uint32_t strokes = 0;
+    uint32_t pauses = 0;
+    uint64_t pausedMillis = 0;
+    uint64_t checksum = 0;
+    double wallSeconds = 0.0;
+};
+
+// Plays a pattern for the given virtual time like the stroking task does
+static SimResult simulate(Pattern &pattern, uint32_t startMillis,
+                          uint64_t durationMillis) {
+    SimResult result;
+    virtualMillis = startMillis;
+    uint64_t elapsed = 0;
+    int position = 0;
+    unsigned int index = 0;
+    bool pausing = false;
+    uint32_t pauseStart = 0;
+
+    auto wallStart = std::chrono::steady_clock::now();
+    while (elapsed < durationMillis) {
+        motionParameter move = pattern.nextTarget(index);
+        uint32_t step;
+        if (move.skip) {
+            if (!pausing) {
+                pausing = true;
+                pauseStart = virtualMillis;
+                result.pauses++;
+            }
+            step = 10;
+        } else {
+            if (pausing) {
+                pausing = false;
+                result.pausedMillis += uint32_t(virtualMillis - pauseStart);
+            }
+            step = moveMillis(move.stroke - position, move.speed,
+                              move.acceleration);
+            if (step == 0) step = 1;
+            position = move.stroke;
+            result.strokes++;
+            result.checksum = result.checksum * 31 + uint32_t(move.stroke) +
+                              uint64_t(elapsed) * 7;
+            index++;
+        }
+        virtualMillis += step;  // Wraps like millis()
+        elapsed += step;
+    }
+    result.wallSeconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - wallStart)
+                             .count();
+    return result;
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), map)).AlwaysDo(
+        [](long x, long in_min, long in_max, long out_min, long out_max)
+            -> long { return realMap(x, in_min, in_max, out_min, out_max); });
+    Pattern::setClock(virtualClock);
+}
+
+void tearDown(void) { Pattern::setClock(NULL); }
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Clock
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pattern_uses_injected_clock() {
+    StopNGo p("SNG");
+    setupPattern(p, 1000, 5000, 2.0, -100);  // 100 ms pauses
+    virtualMillis = 1000;
+    p.nextTarget(0);
+    p.nextTarget(1);  // Series of one stroke done, pause starts
+
+    virtualMillis = 1050;
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    virtualMillis = 1101;
+    TEST_ASSERT_FALSE(p.nextTarget(2).skip);
+}
+
+void test_clock_null_restores_millis() {
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+    Pattern::setClock(NULL);
+    StopNGo p("SNG");
+    setupPattern(p, 1000, 5000, 2.0, -100);
+    p.nextTarget(0);
+    p.nextTarget(1);
+
+    // The virtual clock no longer matters, millis() does
+    virtualMillis = 5000;
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(101);
+    TEST_ASSERT_FALSE(p.nextTarget(2).skip);
+}
+
+void test_delay_not_started_does_not_pause() {
+    // Right after boot no pause may be pending, whatever the delay
+    StopNGo p("SNG");
+    setupPattern(p, 1000, 5000, 2.0, 100);  // 10 s pauses
+    virtualMillis = 0;
+    TEST_ASSERT_FALSE(p.nextTarget(0).skip);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Rollover
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pause_across_rollover() {
+    StopNGo p("SNG");
+    setupPattern(p, 1000, 5000, 2.0, -100);  // 100 ms pauses
+    virtualMillis = UINT32_MAX - 49;
+    p.nextTarget(0);
+    p.nextTarget(1);
+
+    virtualMillis += 70;  // Wrapped, 70 ms into the pause
+    TEST_ASSERT_TRUE(virtualMillis < 100);
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    virtualMillis += 30;  // 100 ms, last ms of the pause
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    virtualMillis += 1;
+    TEST_ASSERT_FALSE(p.nextTarget(2).skip);
+}
+
+void test_pause_ending_right_at_rollover() {
+    StopNGo p("SNG");
+    setupPattern(p, 1000, 5000, 2.0, 100);  // 10 s pauses
+    virtualMillis = UINT32_MAX - 10000;
+    p.nextTarget(0);
+    p.nextTarget(1);
+
+    virtualMillis = UINT32_MAX;
+    TEST_ASSERT_TRUE(p.nextTarget(2).skip);
+    virtualMillis = 0;
+    TEST_ASSERT_FALSE(p.nextTarget(2).skip);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Simulation
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const uint64_t kHour = 3600ULL * 1000;
+
+static void printSim(const char *name, const SimResult &r, uint64_t ms) {
+    printf("\n  %-10s %.0f h: %u strokes, %u pauses (%.1f h paused), "
+           "%.0f ms wall, %.0fx real time\n",
+           name, ms / double(kHour), r.strokes, r.pauses,
+           r.pausedMillis / double(kHour), r.wallSeconds * 1000.0,
+           ms / 1000.0 / r.wallSeconds);
+}
+
+void test_sim_stopngo_hours_across_rollover() {
+    const uint64_t duration = 6 * kHour;
+
+    StopNGo before("SNG");
+    setupPattern(before, 2000, 3000, 1.0, 0);
+    SimResult fromBoot = simulate(before, 0, duration);
+
+    // Same run, crossing the rollover halfway
+    StopNGo across("SNG");
+    setupPattern(across, 2000, 3000, 1.0, 0);
+    SimResult wrapped =
+        simulate(across, uint32_t(UINT32_MAX - 3 * kHour), duration);
+    printSim("Stop'n'Go", wrapped, duration);
+
+    TEST_ASSERT_GREATER_THAN(1000, fromBoot.pauses);
+    TEST_ASSERT_EQUAL(fromBoot.strokes, wrapped.strokes);
+    TEST_ASSERT_EQUAL(fromBoot.pauses, wrapped.pauses);
+    TEST_ASSERT_TRUE(fromBoot.pausedMillis == wrapped.pausedMillis);
+    TEST_ASSERT_TRUE(fromBoot.checksum == wrapped.checksum);
+
+    // Sensation 0 delays 5050 ms from the start of the last out stroke,
+    // which takes 500 ms. Pauses are polled every 10 ms.
+    double meanPause = double(fromBoot.pausedMillis) / fromBoot.pauses;
+    TEST_ASSERT_FLOAT_WITHIN(6.0f, 4556.0f, float(meanPause));
+    TEST_ASSERT_LESS_THAN(1.0, fromBoot.wallSeconds);
+}
+
+void test_sim_deeper_hours_across_rollover() {
+    const uint64_t duration = 6 * kHour;
+
+    Deeper before("Deeper");
+    setupPattern(before, 2000, 3000, 1.0, 0);
+    SimResult fromBoot = simulate(before, 0, duration);
+
+    Deeper across("Deeper");
+    setupPattern(across, 2000, 3000, 1.0, 0);
+    SimResult wrapped =
+        simulate(across, uint32_t(UINT32_MAX - 3 * kHour), duration);
+    printSim("Deeper", wrapped, duration);
+
+    TEST_ASSERT_EQUAL(0, fromBoot.pauses);
+    TEST_ASSERT_EQUAL(fromBoot.strokes, wrapped.strokes);
+    TEST_ASSERT_TRUE(fromBoot.checksum == wrapped.checksum);
+    TEST_ASSERT_GREATER_THAN(20000, fromBoot.strokes);
+    TEST_ASSERT_LESS_THAN(1.0, fromBoot.wallSeconds);
+}
+
+// ─── Runner ───────────────────────────────────────────────────────────────
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Clock
+    RUN_TEST(test_pattern_uses_injected_clock);
+    RUN_TEST(test_clock_null_restores_millis);
+    RUN_TEST(test_delay_not_started_does_not_pause);
+
+    // Rollover
+    RUN_TEST(test_pause_across_rollover);
+    RUN_TEST(test_pause_ending_right_at_rollover);
+
+    // Simulation
+    RUN_TEST(test_sim_stopngo_hours_across_rollover);
+    RUN_TEST(test_sim_deeper_hours_across_rollover);
+
+    return UNITY_END();
+}
@@ -0,0 +1,342 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN CROSSFADE — UNIT TESTS                                         │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/PatternCrossfade.h with the built-in    │
+// │ patterns from pattern.h:                                               │
+// │   Indices — Incoming pattern starts in the running direction           │
+// │   Blend   — Targets move from one pattern to the other per stroke      │
+// │   Jumps   — No target jumps further than the patterns themselves plus  │
+// │             the fade's share of the distance between them              │
+// │   Stops   — The fade adds no zero-length moves and no pauses           │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace fakeit;
+
+#include "PatternCrossfade.h"
+#include "PatternPool.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static const int kStepsPerMM = 20;
+static const int kDepth = 150 * kStepsPerMM;
+static const int kStroke = 100 * kStepsPerMM;
+static const int kStrokes = 4;
+static const unsigned int kStart = 10;
+static const unsigned int kEnd = 40;
+
+static unsigned long now = 0;
+
+static void configure(Pattern *pattern, float sensation = 30.0f) {
+    pattern->setSpeedLimit(6000 * kStepsPerMM, 100000 * kStepsPerMM,
+                           kStepsPerMM);
+    pattern->setTimeOfStroke(1.0f);
+    pattern->setStroke(kStroke);
+    pattern->setDepth(kDepth);
+    pattern->setSensation(sensation);
+}
+
+// Two independent instances of each built-in pattern
+struct Pair {
+    PatternPool fromPool;
+    PatternPool toPool;
+    Pattern *from;
+    Pattern *to;
+
+    Pair(int fromIndex, int toIndex) {
+        from = fromPool.prepare(fromIndex);
+        fromPool.activate();
+        to = toPool.prepare(toIndex);
+        toPool.activate();
+        configure(from);
+        configure(to);
+    }
+};
+
+// Targets of a run that switches at kStart, queried the way StrokeEngine
+// does: a pause repeats the index while time goes on
+struct Run {
+    std::vector<int> targets;
+    std::vector<unsigned int> indices;
+    int pauses = 0;
+};
+
+static Run runPair(int fromIndex, int toIndex, uint8_t strokes) {
+    Pair pair(fromIndex, toIndex);
+    PatternCrossfade fade;
+    Run result;
+    bool pausing = false;
+    for (unsigned int index = 0; index < kEnd;) {
+        if (index == kStart) {
+            fade.begin(pair.from, pair.to, kStart, strokes);
+        }
+        now += 10;
+        motionParameter target = (index < kStart)
+                                     ? pair.from->nextTarget(index)
+                                     : fade.nextTarget(index);
+        if (target.skip) {
+            result.pauses += pausing ? 0 : 1;
+            pausing = true;
+            continue;
+        }
+        pausing = false;
+        result.targets.push_back(target.stroke);
+        result.indices.push_back(index);
+        index++;
+    }
+    return result;
+}
+
+// Largest change between two targets in the same direction
+static int largestStep(const std::vector<int> &targets, size_t first,
+                       size_t last) {
+    int largest = 0;
+    for (size_t i = first + 2; i < last && i < targets.size(); i++) {
+        int step = abs(targets[i] - targets[i - 2]);
+        if (step > largest) largest = step;
+    }
+    return largest;
+}
+
+// Targets of a pattern on its own
+static std::vector<int> alone(int patternIndex, unsigned int first,
+                              unsigned int count) {
+    PatternPool pool;
+    Pattern *pattern = pool.prepare(patternIndex);
+    pool.activate();
+    configure(pattern);
+    std::vector<int> targets;
+    for (unsigned int index = first; index < first + count; index++) {
+        targets.push_back(pattern->nextTarget(index).stroke);
+    }
+    return targets;
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysDo([]() -> unsigned long {
+        return now;
+    });
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Indices
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_incoming_index_keeps_direction() {
+    PatternCrossfade fade;
+    Pair pair(0, 0);
+    fade.begin(pair.from, pair.to, 10, kStrokes);
+    TEST_ASSERT_EQUAL(0, fade.toIndex(10));
+    TEST_ASSERT_EQUAL(5, fade.toIndex(15));
+    fade.begin(pair.from, pair.to, 11, kStrokes);
+    TEST_ASSERT_EQUAL(1, fade.toIndex(11));
+    TEST_ASSERT_EQUAL(10 % 2, fade.toIndex(20) % 2);
+}
+
+void test_done_after_strokes() {
+    PatternCrossfade fade;
+    Pair pair(0, 1);
+    TEST_ASSERT_FALSE(fade.active());
+    fade.begin(pair.from, pair.to, 10, kStrokes);
+    TEST_ASSERT_TRUE(fade.active());
+    TEST_ASSERT_EQUAL_PTR(pair.from, fade.from());
+    TEST_ASSERT_FALSE(fade.done(10));
+    TEST_ASSERT_FALSE(fade.done(13));
+    TEST_ASSERT_TRUE(fade.done(14));
+    fade.end();
+    TEST_ASSERT_FALSE(fade.active());
+    TEST_ASSERT_NULL(fade.from());
+}
+
+void test_zero_strokes_is_the_incoming_pattern() {
+    // Patterns may keep state between queries, so the reference is a second
+    // instance
+    PatternCrossfade fade;
+    Pair pair(0, 3);
+    Pair reference(0, 3);
+    fade.begin(pair.from, pair.to, 7, 0);
+    TEST_ASSERT_TRUE(fade.done(7));
+    for (unsigned int index = 7; index < 20; index++) {
+        motionParameter blended = fade.nextTarget(index);
+        motionParameter own = reference.to->nextTarget(fade.toIndex(index));
+        TEST_ASSERT_EQUAL(own.stroke, blended.stroke);
+        TEST_ASSERT_EQUAL(own.speed, blended.speed);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Blend
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_blend_moves_towards_incoming_per_stroke() {
+    // Simple Stroke into Half'n'Half: the half depth strokes fade in
+    Pair pair(0, 3);
+    Pair reference(0, 3);
+    PatternCrossfade fade;
+    fade.begin(pair.from, pair.to, kStart, kStrokes);
+    for (unsigned int k = 0; k <= kStrokes; k++) {
+        unsigned int index = kStart + k;
+        motionParameter from = reference.from->nextTarget(index);
+        motionParameter to = reference.to->nextTarget(fade.toIndex(index));
+        motionParameter blended = fade.nextTarget(index);
+        float weight = float(k + 1) / float(kStrokes + 1);
+        if (k == kStrokes) weight = 1.0f;
+        TEST_ASSERT_FALSE(blended.skip);
+        TEST_ASSERT_INT_WITHIN(1, from.stroke + (to.stroke - from.stroke) * weight,
+                               blended.stroke);
+        TEST_ASSERT_INT_WITHIN(1, from.speed + (to.speed - from.speed) * weight,
+                               blended.speed);
+        TEST_ASSERT_INT_WITHIN(
+            1, from.acceleration + (to.acceleration - from.acceleration) * weight,
+            blended.acceleration);
+    }
+}
+
+void test_blend_jerk_zero_means_machine_limit() {
+    Pair pair(0, 0);
+    PatternCrossfade fade;
+    fade.begin(pair.from, pair.to, kStart, kStrokes);
+    TEST_ASSERT_EQUAL(0, fade.nextTarget(kStart).jerk);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Jumps
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_no_target_jumps_beyond_bound() {
+    // Every pair of patterns that does not pause
+    const int patterns[] = {0, 1, 2, 3, 4, 6};
+    int worstFaded = 0;
+    int worstSwitched = 0;
+    for (int from : patterns) {
+        for (int to : patterns) {
+            Run faded = runPair(from, to, kStrokes);
+            Run switched = runPair(from, to, 0);
+
+            // What the patterns do on their own, and how far apart they are
+            std::vector<int> own = alone(from, 0, kEnd);
+            std::vector<int> incoming = alone(to, 0, kEnd);
+            int ownStep = largestStep(own, 0, own.size());
+            int incomingStep = largestStep(incoming, 0, incoming.size());
+            if (incomingStep > ownStep) ownStep = incomingStep;
+            int gap = 0;
+            for (unsigned int i = 0; i < kEnd; i++) {
+                for (unsigned int j = i % 2; j < kEnd; j += 2) {
+                    int d = abs(own[i] - incoming[j]);
+                    if (d > gap) gap = d;
+                }
+            }
+            // Targets in the same direction are two strokes, so two steps
+            // of the fade apart
+            int bound = ownStep + 2 * gap / (kStrokes + 1) + 1;
+
+            int fadedStep = largestStep(faded.targets, kStart - 2, kEnd);
+            int switchedStep = largestStep(switched.targets, kStart - 2, kEnd);
+            TEST_ASSERT_LESS_OR_EQUAL(bound, fadedStep);
+            if (fadedStep > worstFaded) worstFaded = fadedStep;
+            if (switchedStep > worstSwitched) worstSwitched = switchedStep;
+        }
+    }
+    printf("\n  largest same direction target step: %.1f mm crossfaded "
+           "over %d strokes, %.1f mm switched\n",
+           worstFaded / float(kStepsPerMM), kStrokes,
+           worstSwitched / float(kStepsPerMM));
+    TEST_ASSERT_LESS_THAN(worstSwitched, worstFaded);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stops
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_no_zero_length_moves_or_pauses() {
+    const int patterns[] = {0, 1, 2, 3, 4, 6};
+    for (int from : patterns) {
+        for (int to : patterns) {
+            Run faded = runPair(from, to, kStrokes);
+            TEST_ASSERT_EQUAL(0, faded.pauses);
+            for (size_t i = 1; i < faded.targets.size(); i++) {
+                TEST_ASSERT_TRUE(faded.targets[i - 1] != faded.targets[i]);
+            }
+        }
+    }
+}
+
+void test_pauses_of_outgoing_pattern_end_halfway() {
+    // Stop'n'Go out: its pauses are kept while it dominates the mix only
+    Pair pair(5, 0);
+    PatternCrossfade fade;
+    fade.begin(pair.from, pair.to, kStart, kStrokes);
+    for (unsigned int index = kStart; index < kStart + kStrokes; index++) {
+        float weight = float(index - kStart + 1) / float(kStrokes + 1);
+        for (int poll = 0; poll < 50; poll++) {
+            now += 10;
+            motionParameter target = fade.nextTarget(index);
+            if (weight >= 0.5f) TEST_ASSERT_FALSE(target.skip);
+        }
+    }
+}
+
+void test_pauses_of_incoming_pattern_start_halfway() {
+    // Stop'n'Go in: the fade doesn't pause before it dominates
+    Pair pair(0, 5);
+    PatternCrossfade fade;
+    fade.begin(pair.from, pair.to, kStart, kStrokes);
+    for (unsigned int index = kStart; index < kStart + kStrokes; index++) {
+        float weight = float(index - kStart + 1) / float(kStrokes + 1);
+        for (int poll = 0; poll < 50; poll++) {
+            now += 10;
+            motionParameter target = fade.nextTarget(index);
+            if (weight < 0.5f) TEST_ASSERT_FALSE(target.skip);
+        }
+    }
+}
+
+void test_fade_adds_no_pauses() {
+    // A run through the fade pauses no more often than the patterns on their
+    // own would in the same number of strokes
+    const int patterns[] = {0, 5};
+    for (int from : patterns) {
+        for (int to : patterns) {
+            Run faded = runPair(from, to, kStrokes);
+            Run before = runPair(from, from, 0);
+            Run after = runPair(to, to, 0);
+            int most = before.pauses > after.pauses ? before.pauses
+                                                    : after.pauses;
+            TEST_ASSERT_LESS_OR_EQUAL(most, faded.pauses);
+        }
+    }
+}
+
+// ─── Runner ───────────────────────────────────────────────────────────────
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Indices
+    RUN_TEST(test_incoming_index_keeps_direction);
+    RUN_TEST(test_done_after_strokes);
+    RUN_TEST(test_zero_strokes_is_the_incoming_pattern);
+
+    // Blend
+    RUN_TEST(test_blend_moves_towards_incoming_per_stroke);
+    RUN_TEST(test_blend_jerk_zero_means_machine_limit);
+
+    // Jumps
+    RUN_TEST(test_no_target_jumps_beyond_bound);
+
+    // Stops
+    RUN_TEST(test_no_zero_length_moves_or_pauses);
+    RUN_TEST(test_pauses_of_outgoing_pattern_end_halfway);
+    RUN_TEST(test_pauses_of_incoming_pattern_start_halfway);
+    RUN_TEST(test_fade_adds_no_pauses);
+
+    return UNITY_END();
+}
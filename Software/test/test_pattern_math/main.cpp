@@ -5,13 +5,19 @@
 // │   fscale()              — Logarithmic range mapping                    │
 // │   fmap()                — Linear float mapping                         │
 // │   mapSensationToFactor() — Sensation (-100..+100) to multiplier        │
+// │   fscaleFloat(), fscaleLUT() — Fast paths against fscaleReference()    │
 // │                                                                        │
-// │ All functions are pure math with no hardware dependencies.             │
+// │ All functions are pure math with no hardware dependencies. The         │
+// │ micro-benchmark prints ns per call on the host; the ESP32 has no       │
+// │ double precision FPU, so the gap to the reference is larger there.     │
 // └──────────────────────────────────────────────────────────────────────────┘
 
 #include <ArduinoFake.h>
 #include <unity.h>
 
+#include <chrono>
+#include <cstdio>
+
 #include "PatternMath.h"
 
 void setUp(void) {}
@@ -150,6 +156,136 @@ void test_sensation_clamped_beyond_range() {
     TEST_ASSERT_FLOAT_WITHIN(0.01f, at100, at150);
 }
 
+// ─── Fast paths: accuracy ────────────────────────────────────────────────
+
+// Error bounds documented in PatternMath.h, relative to |newEnd - newBegin|
+static const float kFloatBound = 1e-6f;
+static const float kLUTBound = 1e-4f;
+
+typedef float (*ScaleFunction)(float, float, float, float, float, float);
+
+// Largest deviation from fscaleReference() over input and curve
+static float maxDeviation(ScaleFunction scale, float newBegin, float newEnd) {
+    float worst = 0.0f;
+    for (float curve = -10.0f; curve <= 10.0f; curve += 0.25f) {
+        for (float input = 0.0f; input <= 100.0f; input += 0.05f) {
+            float expected =
+                fscaleReference(0.0f, 100.0f, newBegin, newEnd, input, curve);
+            float actual = scale(0.0f, 100.0f, newBegin, newEnd, input, curve);
+            float deviation = fabsf(actual - expected);
+            worst = deviation > worst ? deviation : worst;
+        }
+    }
+    return worst;
+}
+
+void test_fast_paths_match_reference_over_full_range() {
+    const float ranges[][2] = {{0.0f, 1.0f}, {1.0f, 5.0f}, {0.5f, 0.05f},
+                               {-200.0f, 3000.0f}};
+    for (const auto &range : ranges) {
+        float span = fabsf(range[1] - range[0]);
+        float floatDeviation = maxDeviation(fscaleFloat, range[0], range[1]);
+        float lutDeviation = maxDeviation(fscaleLUT, range[0], range[1]);
+        TEST_ASSERT_TRUE(floatDeviation <= kFloatBound * span);
+        TEST_ASSERT_TRUE(lutDeviation <= kLUTBound * span);
+    }
+}
+
+void test_fast_paths_exact_for_linear_curve() {
+    // All built-in patterns use curve 0: no power, only the linear map
+    for (float input = 0.0f; input <= 100.0f; input += 0.5f) {
+        float expected = fmap(input, 0.0f, 100.0f, 1.0f, 5.0f);
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected,
+                                 fscaleFloat(0.0f, 100.0f, 1.0f, 5.0f, input,
+                                             0.0f));
+        TEST_ASSERT_FLOAT_WITHIN(1e-6f, expected,
+                                 fscaleLUT(0.0f, 100.0f, 1.0f, 5.0f, input,
+                                           0.0f));
+    }
+}
+
+void test_fast_paths_keep_edge_cases() {
+    ScaleFunction functions[] = {fscaleFloat, fscaleLUT};
+    for (ScaleFunction scale : functions) {
+        TEST_ASSERT_EQUAL_FLOAT(0.0f,
+                                scale(100.0f, 0.0f, 0.0f, 200.0f, 50.0f, 0.0f));
+        TEST_ASSERT_EQUAL_FLOAT(10.0f,
+                                scale(0.0f, 100.0f, 10.0f, 50.0f, -5.0f, 3.0f));
+        TEST_ASSERT_FLOAT_WITHIN(
+            1e-3f, 50.0f, scale(0.0f, 100.0f, 10.0f, 50.0f, 150.0f, -3.0f));
+        TEST_ASSERT_FLOAT_WITHIN(
+            1e-3f, scale(0.0f, 100.0f, 0.0f, 100.0f, 50.0f, 10.0f),
+            scale(0.0f, 100.0f, 0.0f, 100.0f, 50.0f, 20.0f));
+    }
+}
+
+void test_lut_tables_within_bounds() {
+    float worstLog = 0.0f;
+    for (float x = 1e-4f; x <= 1.0f; x += 1e-5f) {
+        float deviation = fabsf(pattern_math::log2LUT(x) - log2f(x));
+        worstLog = deviation > worstLog ? deviation : worstLog;
+    }
+    float worstExp = 0.0f;
+    for (float y = -20.0f; y <= 4.0f; y += 1e-4f) {
+        float expected = exp2f(y);
+        float deviation = fabsf(pattern_math::exp2LUT(y) - expected) / expected;
+        worstExp = deviation > worstExp ? deviation : worstExp;
+    }
+    TEST_ASSERT_TRUE(worstLog < 5e-5f);
+    TEST_ASSERT_TRUE(worstExp < 2e-5f);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, pattern_math::exp2LUT(-200.0f));
+}
+
+void test_sensation_factor_matches_reference() {
+    // The factor as computed with the original double precision fscale()
+    for (float curve = -5.0f; curve <= 5.0f; curve += 5.0f) {
+        for (float sensation = -100.0f; sensation <= 100.0f; sensation += 1.0f) {
+            float scaled = fscaleReference(0.0f, 100.0f, 1.0f, 5.0f,
+                                           fabsf(sensation), curve);
+            float expected = sensation >= 0.0f ? scaled : 1.0f / scaled;
+            if (sensation == 0.0f) expected = 1.0f;
+            float actual = mapSensationToFactor(5.0f, sensation, curve);
+            TEST_ASSERT_FLOAT_WITHIN(kLUTBound * 4.0f * expected, expected,
+                                     actual);
+        }
+    }
+}
+
+// ─── Micro-benchmark ─────────────────────────────────────────────────────
+
+static volatile float benchmarkSink = 0.0f;
+
+// Nanoseconds per call, over a sweep like a BLE slider produces
+static double nanosPerCall(ScaleFunction scale, float curve) {
+    const int kCalls = 200000;
+    auto start = std::chrono::steady_clock::now();
+    float sum = 0.0f;
+    for (int i = 0; i < kCalls; i++) {
+        sum += scale(0.0f, 100.0f, 1.0f, 5.0f, float(i % 1000) * 0.1f, curve);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    benchmarkSink = sum;
+    return std::chrono::duration<double, std::nano>(stop - start).count() /
+           kCalls;
+}
+
+void test_benchmark_fscale() {
+    printf("\n  fscale() on the host, ns per call\n");
+    printf("  %-12s %12s %12s %12s\n", "curve", "reference", "float", "LUT");
+    const float curves[] = {0.0f, 3.0f, -7.5f};
+    for (float curve : curves) {
+        double reference = nanosPerCall(fscaleReference, curve);
+        double single = nanosPerCall(fscaleFloat, curve);
+        double lut = nanosPerCall(fscaleLUT, curve);
+        printf("  %-12.1f %12.1f %12.1f %12.1f\n", curve, reference, single,
+               lut);
+    }
+    printf("  selected: %s\n",
+           PATTERN_MATH == PATTERN_MATH_REFERENCE ? "reference"
+           : PATTERN_MATH == PATTERN_MATH_LUT     ? "LUT"
+                                                  : "float");
+}
+
 // ─── Runner ──────────────────────────────────────────────────────────────
 
 int main() {
@@ -181,5 +317,13 @@ int main() {
     RUN_TEST(test_sensation_negative_is_inverse_of_positive);
     RUN_TEST(test_sensation_clamped_beyond_range);
 
+    // Fast paths
+    RUN_TEST(test_fast_paths_match_reference_over_full_range);
+    RUN_TEST(test_fast_paths_exact_for_linear_curve);
+    RUN_TEST(test_fast_paths_keep_edge_cases);
+    RUN_TEST(test_lut_tables_within_bounds);
+    RUN_TEST(test_sensation_factor_matches_reference);
+    RUN_TEST(test_benchmark_fscale);
+
     return UNITY_END();
 }
@@ -0,0 +1,208 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN POOL — UNIT TESTS                                              │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/PatternPool.h:                          │
+// │   name()      — Names of the 8 built-in patterns                       │
+// │   prepare()   — Builds a fresh pattern in the spare slot               │
+// │   activate()  — Publishes it with a single pointer store               │
+// │                                                                        │
+// │ Global operator new is counted to prove that switching patterns never  │
+// │ touches the heap.                                                      │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace fakeit;
+
+#include "PatternPool.h"
+
+// ─── Allocation counter ──────────────────────────────────────────────────
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) {
+    allocations++;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Names
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pool_has_nine_patterns() { TEST_ASSERT_EQUAL(9, PatternPool::count); }
+
+void test_pool_names_in_index_order() {
+    TEST_ASSERT_EQUAL_STRING("Simple Stroke", PatternPool::name(0));
+    TEST_ASSERT_EQUAL_STRING("Teasing Pounding", PatternPool::name(1));
+    TEST_ASSERT_EQUAL_STRING("Robo Stroke", PatternPool::name(2));
+    TEST_ASSERT_EQUAL_STRING("Half'n'Half", PatternPool::name(3));
+    TEST_ASSERT_EQUAL_STRING("Deeper", PatternPool::name(4));
+    TEST_ASSERT_EQUAL_STRING("Stop'n'Go", PatternPool::name(5));
+    TEST_ASSERT_EQUAL_STRING("Insist", PatternPool::name(6));
+    TEST_ASSERT_EQUAL_STRING("Custom Program", PatternPool::name(7));
+    TEST_ASSERT_EQUAL_STRING("Keyframes", PatternPool::name(8));
+}
+
+void test_pool_name_out_of_range_is_invalid() {
+    TEST_ASSERT_EQUAL_STRING("Invalid", PatternPool::name(-1));
+    TEST_ASSERT_EQUAL_STRING("Invalid", PatternPool::name(9));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Switching
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pool_starts_with_simple_stroke() {
+    PatternPool pool;
+    TEST_ASSERT_NOT_NULL(pool.active());
+    TEST_ASSERT_EQUAL(0, pool.activeIndex());
+    TEST_ASSERT_EQUAL_STRING("Simple Stroke", pool.active()->getName());
+}
+
+void test_pool_prepare_does_not_change_active() {
+    PatternPool pool;
+    Pattern *before = pool.active();
+    Pattern *next = pool.prepare(4);
+    TEST_ASSERT_NOT_NULL(next);
+    TEST_ASSERT_TRUE(next != before);
+    TEST_ASSERT_EQUAL_PTR(before, pool.active());
+    TEST_ASSERT_EQUAL(0, pool.activeIndex());
+}
+
+void test_pool_activate_publishes_prepared_pattern() {
+    PatternPool pool;
+    Pattern *next = pool.prepare(5);
+    pool.activate();
+    TEST_ASSERT_EQUAL_PTR(next, pool.active());
+    TEST_ASSERT_EQUAL(5, pool.activeIndex());
+    TEST_ASSERT_EQUAL_STRING("Stop'n'Go", pool.active()->getName());
+}
+
+void test_pool_prepare_out_of_range_returns_null() {
+    PatternPool pool;
+    TEST_ASSERT_NULL(pool.prepare(-1));
+    TEST_ASSERT_NULL(pool.prepare(PatternPool::count));
+    TEST_ASSERT_EQUAL(0, pool.activeIndex());
+}
+
+void test_pool_alternates_between_two_slots() {
+    PatternPool pool;
+    Pattern *first = pool.active();
+    pool.prepare(1);
+    pool.activate();
+    Pattern *second = pool.active();
+    pool.prepare(2);
+    pool.activate();
+    TEST_ASSERT_TRUE(first != second);
+    TEST_ASSERT_EQUAL_PTR(first, pool.active());
+}
+
+void test_pool_every_index_builds_the_right_class() {
+    PatternPool pool;
+    for (int i = 0; i < PatternPool::count; i++) {
+        Pattern *p = pool.prepare(i);
+        pool.activate();
+        TEST_ASSERT_EQUAL_STRING(PatternPool::name(i), p->getName());
+    }
+
+    // Spot check behaviour that only the right class has: Half'n'Half
+    // strokes half-way on odd full strokes, Simple Stroke never does.
+    Pattern *half = pool.prepare(3);
+    pool.activate();
+    half->setTimeOfStroke(1.0f);
+    half->setStroke(1000);
+    half->setDepth(2000);
+    half->setSensation(0.0f);
+    TEST_ASSERT_EQUAL(1500, half->nextTarget(0).stroke);
+}
+
+void test_pool_reselect_gives_fresh_state() {
+    PatternPool pool;
+    Pattern *a = pool.prepare(4);
+    pool.activate();
+    a->setDepth(1234);
+    a->nextTarget(5);
+
+    // Same pattern again: a new instance with default state
+    pool.prepare(1);
+    pool.activate();
+    Pattern *b = pool.prepare(4);
+    pool.activate();
+    TEST_ASSERT_EQUAL_PTR(a, b);
+
+    Deeper fresh("Deeper");
+    Pattern *patterns[] = {b, &fresh};
+    for (Pattern *p : patterns) {
+        p->setTimeOfStroke(1.0f);
+        p->setStroke(1000);
+        p->setDepth(2000);
+    }
+    for (unsigned int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(fresh.nextTarget(i).stroke, b->nextTarget(i).stroke);
+    }
+}
+
+void test_pool_10k_switches_allocate_nothing() {
+    PatternPool pool;
+    size_t before = allocations;
+    for (int i = 0; i < 10000; i++) {
+        Pattern *p = pool.prepare(i % PatternPool::count);
+        p->setSpeedLimit(20000, 1000000, 20);
+        p->setTimeOfStroke(1.0f);
+        p->setStroke(1000);
+        p->setDepth(2000);
+        pool.activate();
+    }
+    size_t after = allocations;
+    TEST_ASSERT_EQUAL(0, after - before);
+    TEST_ASSERT_EQUAL(9999 % PatternPool::count, pool.activeIndex());
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_pool_has_nine_patterns);
+    RUN_TEST(test_pool_names_in_index_order);
+    RUN_TEST(test_pool_name_out_of_range_is_invalid);
+
+    RUN_TEST(test_pool_starts_with_simple_stroke);
+    RUN_TEST(test_pool_prepare_does_not_change_active);
+    RUN_TEST(test_pool_activate_publishes_prepared_pattern);
+    RUN_TEST(test_pool_prepare_out_of_range_returns_null);
+    RUN_TEST(test_pool_alternates_between_two_slots);
+    RUN_TEST(test_pool_every_index_builds_the_right_class);
+    RUN_TEST(test_pool_reselect_gives_fresh_state);
+    RUN_TEST(test_pool_10k_switches_allocate_nothing);
+
+    return UNITY_END();
+}
@@ -0,0 +1,680 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN PROGRAM — UNIT TESTS & BENCHMARK                               │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/PatternProgram.h and ProgramPattern.h:  │
+// │   load()/verify() — Header checks and the static stack verifier        │
+// │   run()           — Instructions, faults, the cycle budget             │
+// │   ProgramPattern  — Moves, variables, repeated queries, waits,         │
+// │                     installing and clearing programs                   │
+// │                                                                        │
+// │ The benchmark runs Simple Stroke and Deeper natively and as programs   │
+// │ and prints ns per nextTarget() on the host. A program must stay        │
+// │ within 2x of the native pattern.                                       │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace fakeit;
+
+#include "ProgramPattern.h"
+
+using namespace pattern_program;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static uint32_t virtualMillis = 0;
+static unsigned long virtualClock() { return virtualMillis; }
+
+// Assembles a program file, resolving labels like the assembler script
+struct Assembler {
+    std::vector<uint8_t> code;
+    std::map<std::string, size_t> labels;
+    std::vector<std::pair<size_t, std::string>> fixups;
+    uint8_t variables = 0;
+
+    Assembler &op(uint8_t opcode) {
+        code.push_back(opcode);
+        return *this;
+    }
+    Assembler &op(uint8_t opcode, uint8_t operand) {
+        code.push_back(opcode);
+        code.push_back(operand);
+        return *this;
+    }
+    Assembler &push(int32_t value) {
+        if (value >= -128 && value <= 127) return op(PUSH8, uint8_t(value));
+        if (value >= -32768 && value <= 32767) {
+            op(PUSH16, uint8_t(value));
+            code.push_back(uint8_t(value >> 8));
+            return *this;
+        }
+        op(PUSH32);
+        for (int i = 0; i < 4; i++) code.push_back(uint8_t(value >> (8 * i)));
+        return *this;
+    }
+    Assembler &jump(uint8_t opcode, const char *label) {
+        op(opcode);
+        fixups.push_back({code.size(), label});
+        code.push_back(0);
+        code.push_back(0);
+        return *this;
+    }
+    Assembler &label(const char *name) {
+        labels[name] = code.size();
+        return *this;
+    }
+    std::vector<uint8_t> bytes() {
+        for (auto &fixup : fixups) {
+            int offset = int(labels.at(fixup.second)) - int(fixup.first + 2);
+            code[fixup.first] = uint8_t(offset);
+            code[fixup.first + 1] = uint8_t(offset >> 8);
+        }
+        std::vector<uint8_t> out = {'O', 'S', 'P', 'G', 1, variables,
+                                    uint8_t(code.size()),
+                                    uint8_t(code.size() >> 8)};
+        out.insert(out.end(), code.begin(), code.end());
+        return out;
+    }
+};
+
+static ProgramError loadBytes(const std::vector<uint8_t> &bytes,
+                              patternProgram &program) {
+    return load(bytes.data(), bytes.size(), program);
+}
+
+// Runs a program that leaves a value to check, moved to position
+static int32_t evaluate(Assembler &a, ProgramFault *fault = nullptr) {
+    a.push(100).op(MOVE);
+    patternProgram program;
+    TEST_ASSERT_EQUAL(int(ProgramError::None), int(loadBytes(a.bytes(), program)));
+    int32_t inputs[INPUT_COUNT] = {7, 2000, 3000, 32768, 1000, 20};
+    int32_t variables[PATTERN_PROGRAM_VARIABLES] = {};
+    programMove move = {};
+    ProgramFault result = run(program, inputs, variables, move);
+    if (fault != nullptr) *fault = result;
+    return move.position;
+}
+
+// Deeper as a program, the same integer math as the native pattern
+static std::vector<uint8_t> deeperProgram() {
+    Assembler a;
+    a.variables = 1;
+    // count = map(sensation, -100, 0, 2, 11) or map(sensation, 0, 100, 11, 32)
+    a.op(IN, INPUT_SENSATION).op(DUP).push(0).op(LT).jump(JZ, "up");
+    a.push(65536).op(ADD).push(9).op(MUL).push(16).op(SHR).push(2).op(ADD);
+    a.jump(JMP, "have");
+    a.label("up").push(21).op(MUL).push(16).op(SHR).push(11).op(ADD);
+    a.label("have").op(STORE, 0);
+    // odd strokes move out
+    a.op(IN, INPUT_INDEX).push(1).op(AND).jump(JNZ, "out");
+    // amplitude = stroke / count * ((index / 2) % count + 1)
+    a.op(IN, INPUT_STROKE).op(LOAD, 0).op(DIV);
+    a.op(IN, INPUT_INDEX).push(1).op(SHR).op(LOAD, 0).op(MOD);
+    a.push(1).op(ADD).op(MUL).op(IN, INPUT_STROKE).op(DIVQ);
+    a.jump(JMP, "go");
+    a.label("out").push(0);
+    a.label("go").op(IN, INPUT_STROKE_MS).push(1).op(SHR).op(MOVE);
+    return a.bytes();
+}
+
+static long realMap(long x, long in_min, long in_max, long out_min,
+                    long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static void configure(Pattern &p, float sensation = 0.0f,
+                      float timeOfStroke = 1.0f) {
+    p.setSpeedLimit(20000, 1000000, 20);
+    p.setDepth(3000);
+    p.setStroke(2000);
+    p.setTimeOfStroke(timeOfStroke);
+    p.setSensation(sensation);
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+    When(Method(ArduinoFake(), map))
+        .AlwaysDo([](long x, long in_min, long in_max, long out_min,
+                     long out_max) -> long {
+            return realMap(x, in_min, in_max, out_min, out_max);
+        });
+    virtualMillis = 0;
+    Pattern::setClock(virtualClock);
+    ProgramPattern::clear();
+}
+
+void tearDown(void) { Pattern::setClock(NULL); }
+
+// ═══════════════════════════════════════════════════════════════════════════
+// load() and verify()
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_load_default_program() {
+    patternProgram program;
+    TEST_ASSERT_EQUAL(
+        int(ProgramError::None),
+        int(load(ProgramPattern::defaultProgram,
+                 sizeof(ProgramPattern::defaultProgram), program)));
+    TEST_ASSERT_EQUAL(24, program.length);
+
+    uint8_t out[PATTERN_PROGRAM_SIZE_MAX];
+    size_t size = save(program, out);
+    TEST_ASSERT_EQUAL(sizeof(ProgramPattern::defaultProgram), size);
+    TEST_ASSERT_EQUAL_MEMORY(ProgramPattern::defaultProgram, out, size);
+}
+
+void test_load_rejects_broken_headers() {
+    patternProgram program;
+    std::vector<uint8_t> good(ProgramPattern::defaultProgram,
+                              ProgramPattern::defaultProgram +
+                                  sizeof(ProgramPattern::defaultProgram));
+
+    std::vector<uint8_t> bytes = good;
+    bytes[0] = 'X';
+    TEST_ASSERT_EQUAL(int(ProgramError::BadMagic), int(loadBytes(bytes, program)));
+    bytes = good;
+    bytes[4] = 2;
+    TEST_ASSERT_EQUAL(int(ProgramError::BadVersion),
+                      int(loadBytes(bytes, program)));
+    bytes = good;
+    bytes[5] = PATTERN_PROGRAM_VARIABLES + 1;
+    TEST_ASSERT_EQUAL(int(ProgramError::BadVariables),
+                      int(loadBytes(bytes, program)));
+    bytes = good;
+    bytes.pop_back();
+    TEST_ASSERT_EQUAL(int(ProgramError::TooShort), int(loadBytes(bytes, program)));
+    TEST_ASSERT_EQUAL(int(ProgramError::TooShort),
+                      int(load(good.data(), 5, program)));
+    bytes = good;
+    bytes.push_back(0);
+    TEST_ASSERT_EQUAL(int(ProgramError::TooLong), int(loadBytes(bytes, program)));
+    bytes.assign(PATTERN_PROGRAM_SIZE_MAX + 1, 0);
+    TEST_ASSERT_EQUAL(int(ProgramError::TooLong), int(loadBytes(bytes, program)));
+}
+
+void test_verify_rejects_unsafe_code() {
+    patternProgram program;
+    Assembler a;
+
+    a = Assembler();
+    a.op(0xEE).push(0).push(0).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::BadOpcode), int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    a.variables = 2;
+    a.op(LOAD, 2).push(0).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::BadOperand),
+                      int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    a.op(IN, INPUT_COUNT).push(0).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::BadOperand),
+                      int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    a.op(IN, INPUT_INDEX).op(JZ).push(0);  // operand cut off
+    std::vector<uint8_t> bytes = a.bytes();
+    TEST_ASSERT_EQUAL(int(ProgramError::BadJump), int(loadBytes(bytes, program)));
+
+    a = Assembler();
+    a.jump(JMP, "far").push(0).push(0).op(MOVE);
+    a.labels["far"] = 200;
+    TEST_ASSERT_EQUAL(int(ProgramError::BadJump), int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    a.push(0).op(ADD).push(0).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::StackUnderflow),
+                      int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    for (int i = 0; i < PATTERN_PROGRAM_STACK + 1; i++) a.push(i);
+    a.op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::StackOverflow),
+                      int(loadBytes(a.bytes(), program)));
+
+    // A loop that leaves a value behind every time around
+    a = Assembler();
+    a.label("loop").push(1).op(IN, INPUT_INDEX).jump(JNZ, "loop");
+    a.push(0).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::StackMismatch),
+                      int(loadBytes(a.bytes(), program)));
+
+    a = Assembler();
+    a.push(0).push(0);
+    TEST_ASSERT_EQUAL(int(ProgramError::RunsOffEnd),
+                      int(loadBytes(a.bytes(), program)));
+
+    // Only one branch ends in MOVE
+    a = Assembler();
+    a.op(IN, INPUT_INDEX).jump(JZ, "end").push(0).push(0).op(MOVE);
+    a.label("end").push(0);
+    TEST_ASSERT_EQUAL(int(ProgramError::RunsOffEnd),
+                      int(loadBytes(a.bytes(), program)));
+}
+
+void test_verify_ignores_unreachable_code() {
+    patternProgram program;
+    Assembler a;
+    a.push(0).push(0).op(MOVE).op(0xEE).op(ADD);
+    TEST_ASSERT_EQUAL(int(ProgramError::None), int(loadBytes(a.bytes(), program)));
+}
+
+void test_waits_only_if_wait_is_reachable() {
+    patternProgram program;
+    load(ProgramPattern::defaultProgram, sizeof(ProgramPattern::defaultProgram),
+         program);
+    TEST_ASSERT_FALSE(waits(program));
+
+    // Behind a jump taken on some strokes only
+    Assembler a;
+    a.op(IN, INPUT_INDEX).jump(JZ, "go").push(100).op(WAIT);
+    a.label("go").push(0).push(500).op(MOVE);
+    TEST_ASSERT_EQUAL(int(ProgramError::None), int(loadBytes(a.bytes(), program)));
+    TEST_ASSERT_TRUE(waits(program));
+
+    // Past the end, or only as an operand
+    a = Assembler();
+    a.push(WAIT).push(500).op(MOVE).op(WAIT);
+    TEST_ASSERT_EQUAL(int(ProgramError::None), int(loadBytes(a.bytes(), program)));
+    TEST_ASSERT_FALSE(waits(program));
+}
+
+void test_error_names() {
+    TEST_ASSERT_EQUAL_STRING("ok", errorName(ProgramError::None));
+    TEST_ASSERT_EQUAL_STRING("stack_mismatch",
+                             errorName(ProgramError::StackMismatch));
+    TEST_ASSERT_EQUAL_STRING("runs_off_end", errorName(ProgramError::RunsOffEnd));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// run()
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_run_arithmetic() {
+    Assembler a;
+    TEST_ASSERT_EQUAL(12, evaluate((a = Assembler()).push(5).push(7).op(ADD)));
+    TEST_ASSERT_EQUAL(-2, evaluate((a = Assembler()).push(5).push(7).op(SUB)));
+    TEST_ASSERT_EQUAL(35, evaluate((a = Assembler()).push(5).push(7).op(MUL)));
+    TEST_ASSERT_EQUAL(-3, evaluate((a = Assembler()).push(-7).push(2).op(DIV)));
+    TEST_ASSERT_EQUAL(-1, evaluate((a = Assembler()).push(-7).push(2).op(MOD)));
+    TEST_ASSERT_EQUAL(32768,
+                      evaluate((a = Assembler()).push(65536).push(32768).op(MULQ)));
+    TEST_ASSERT_EQUAL(
+        98305, evaluate((a = Assembler()).push(65536).push(43690).op(DIVQ)));
+    TEST_ASSERT_EQUAL(3, evaluate((a = Assembler()).push(3).push(9).op(MIN)));
+    TEST_ASSERT_EQUAL(9, evaluate((a = Assembler()).push(3).push(9).op(MAX)));
+    TEST_ASSERT_EQUAL(-4, evaluate((a = Assembler()).push(4).op(NEG)));
+    TEST_ASSERT_EQUAL(4, evaluate((a = Assembler()).push(-4).op(ABS)));
+    TEST_ASSERT_EQUAL(INT32_MIN,
+                      evaluate((a = Assembler()).push(INT32_MAX).push(1).op(ADD)));
+    TEST_ASSERT_EQUAL(INT32_MIN,
+                      evaluate((a = Assembler()).push(INT32_MIN).push(-1).op(DIV)));
+}
+
+void test_run_comparisons_and_stack() {
+    Assembler a;
+    TEST_ASSERT_EQUAL(1, evaluate((a = Assembler()).push(3).push(9).op(LT)));
+    TEST_ASSERT_EQUAL(0, evaluate((a = Assembler()).push(9).push(3).op(LT)));
+    TEST_ASSERT_EQUAL(1, evaluate((a = Assembler()).push(3).push(3).op(LE)));
+    TEST_ASSERT_EQUAL(0, evaluate((a = Assembler()).push(3).push(4).op(EQ)));
+    TEST_ASSERT_EQUAL(1, evaluate((a = Assembler()).push(0).op(NOT)));
+    TEST_ASSERT_EQUAL(
+        2, evaluate((a = Assembler()).push(1).push(2).op(SWAP).op(DROP)));
+    TEST_ASSERT_EQUAL(
+        3, evaluate((a = Assembler()).push(1).push(2).op(OVER).op(MUL).op(ADD)));
+    TEST_ASSERT_EQUAL(14, evaluate((a = Assembler()).push(7).op(DUP).op(ADD)));
+}
+
+void test_run_inputs() {
+    Assembler a;
+    TEST_ASSERT_EQUAL(7, evaluate((a = Assembler()).op(IN, INPUT_INDEX)));
+    TEST_ASSERT_EQUAL(2000, evaluate((a = Assembler()).op(IN, INPUT_STROKE)));
+    TEST_ASSERT_EQUAL(3000, evaluate((a = Assembler()).op(IN, INPUT_DEPTH)));
+    TEST_ASSERT_EQUAL(32768,
+                      evaluate((a = Assembler()).op(IN, INPUT_SENSATION)));
+    TEST_ASSERT_EQUAL(1000,
+                      evaluate((a = Assembler()).op(IN, INPUT_STROKE_MS)));
+    TEST_ASSERT_EQUAL(20,
+                      evaluate((a = Assembler()).op(IN, INPUT_STEPS_PER_MM)));
+}
+
+void test_run_loop_within_budget() {
+    // Sum of 1 ... 30 with a counting loop
+    Assembler a;
+    a.variables = 2;
+    a.push(30).op(STORE, 0);
+    a.label("loop").op(LOAD, 1).op(LOAD, 0).op(ADD).op(STORE, 1);
+    a.op(LOAD, 0).push(1).op(SUB).op(DUP).op(STORE, 0).jump(JNZ, "loop");
+    a.op(LOAD, 1);
+    ProgramFault fault;
+    TEST_ASSERT_EQUAL(465, evaluate(a, &fault));
+    TEST_ASSERT_EQUAL(int(ProgramFault::None), int(fault));
+}
+
+void test_run_stops_endless_loop() {
+    Assembler a;
+    a.label("loop").jump(JMP, "loop").push(0);
+    ProgramFault fault;
+    evaluate(a, &fault);
+    TEST_ASSERT_EQUAL(int(ProgramFault::OutOfCycles), int(fault));
+}
+
+void test_run_stops_on_division_by_zero() {
+    Assembler a;
+    ProgramFault fault;
+    evaluate((a = Assembler()).push(1).push(0).op(DIV), &fault);
+    TEST_ASSERT_EQUAL(int(ProgramFault::DivideByZero), int(fault));
+    evaluate((a = Assembler()).push(1).push(0).op(MOD), &fault);
+    TEST_ASSERT_EQUAL(int(ProgramFault::DivideByZero), int(fault));
+    evaluate((a = Assembler()).push(1).push(0).op(DIVQ), &fault);
+    TEST_ASSERT_EQUAL(int(ProgramFault::DivideByZero), int(fault));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// ProgramPattern
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_pattern_default_program_is_simple_stroke() {
+    TEST_ASSERT_FALSE(ProgramPattern::installed());
+    for (float time : {0.3f, 1.0f, 4.0f}) {
+        SimpleStroke native("Simple Stroke");
+        ProgramPattern program("Custom Program");
+        configure(native, 0.0f, time);
+        configure(program, 0.0f, time);
+        TEST_ASSERT_TRUE(program.lookahead());
+        for (unsigned int i = 0; i < 6; i++) {
+            motionParameter expected = native.nextTarget(i);
+            motionParameter got = program.nextTarget(i);
+            TEST_ASSERT_FALSE(got.skip);
+            TEST_ASSERT_EQUAL(expected.stroke, got.stroke);
+            TEST_ASSERT_INT_WITHIN(expected.speed / 500 + 1, expected.speed,
+                                   got.speed);
+            TEST_ASSERT_INT_WITHIN(expected.acceleration / 500 + 1,
+                                   expected.acceleration, got.acceleration);
+        }
+    }
+}
+
+void test_pattern_deeper_program_matches_native() {
+    std::vector<uint8_t> bytes = deeperProgram();
+    TEST_ASSERT_EQUAL(int(ProgramError::None),
+                      int(ProgramPattern::install(bytes.data(), bytes.size())));
+    for (float sensation : {-100.0f, -40.0f, 0.0f, 50.0f, 100.0f}) {
+        Deeper native("Deeper");
+        ProgramPattern program("Custom Program");
+        configure(native, sensation, 2.0f);
+        configure(program, sensation, 2.0f);
+        for (unsigned int i = 0; i < 80; i++) {
+            motionParameter expected = native.nextTarget(i);
+            motionParameter got = program.nextTarget(i);
+            TEST_ASSERT_INT_WITHIN(1, expected.stroke, got.stroke);
+            if (i > 0) {
+                TEST_ASSERT_INT_WITHIN(expected.speed / 100 + 1,
+                                       expected.speed, got.speed);
+            }
+        }
+    }
+}
+
+void test_pattern_variables_survive_repeated_queries() {
+    // Counts strokes in variable 0 and moves 1/64 of the stroke per count
+    Assembler a;
+    a.variables = 1;
+    a.op(LOAD, 0).push(1).op(ADD).op(DUP).op(STORE, 0);
+    a.push(1024).op(MUL).push(500).op(MOVE);
+    std::vector<uint8_t> bytes = a.bytes();
+    ProgramPattern::install(bytes.data(), bytes.size());
+
+    ProgramPattern p("Custom Program");
+    configure(p);
+    // Position n / 64 of the stroke, in steps from the front
+    auto at = [](int stroke, int n) {
+        return 3000 - stroke + (stroke * n * 1024 + 32768) / 65536;
+    };
+    TEST_ASSERT_EQUAL(at(2000, 1), p.nextTarget(0).stroke);
+    TEST_ASSERT_EQUAL(at(2000, 2), p.nextTarget(1).stroke);
+    TEST_ASSERT_EQUAL(at(2000, 2), p.nextTarget(1).stroke);
+    TEST_ASSERT_EQUAL(at(2000, 3), p.nextTarget(2).stroke);
+    TEST_ASSERT_EQUAL(at(2000, 4), p.nextTarget(3).stroke);
+
+    // StrokeEngine asks again after a settings change
+    p.setStroke(1000);
+    TEST_ASSERT_EQUAL(at(1000, 2), p.nextTarget(1).stroke);
+    TEST_ASSERT_EQUAL(at(1000, 3), p.nextTarget(2).stroke);
+
+    // A restart begins with fresh variables
+    TEST_ASSERT_EQUAL(at(1000, 1), p.nextTarget(0).stroke);
+}
+
+void test_pattern_replaced_program_starts_with_fresh_variables() {
+    // Counts strokes in variable 0 and moves 1/64 of the stroke per count
+    Assembler a;
+    a.variables = 1;
+    a.op(LOAD, 0).push(1).op(ADD).op(DUP).op(STORE, 0);
+    a.push(1024).op(MUL).push(500).op(MOVE);
+    std::vector<uint8_t> bytes = a.bytes();
+    ProgramPattern::install(bytes.data(), bytes.size());
+
+    ProgramPattern p("Custom Program");
+    configure(p);
+    auto at = [](int n) { return 1000 + (2000 * n * 1024 + 32768) / 65536; };
+    for (unsigned int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(at(i + 1), p.nextTarget(i).stroke);
+    }
+
+    // Installed again while it plays, the count starts over mid-pattern
+    ProgramPattern::install(bytes.data(), bytes.size());
+    TEST_ASSERT_EQUAL(at(1), p.nextTarget(4).stroke);
+    TEST_ASSERT_EQUAL(at(2), p.nextTarget(5).stroke);
+}
+
+void test_pattern_wait_pauses_before_the_move() {
+    // Waits 300 ms, then alternates between the ends
+    Assembler a;
+    a.push(300).op(WAIT);
+    a.op(IN, INPUT_INDEX).push(2).op(MOD).push(65536).op(MUL);
+    a.push(500).op(MOVE);
+    std::vector<uint8_t> bytes = a.bytes();
+    ProgramPattern::install(bytes.data(), bytes.size());
+
+    ProgramPattern p("Custom Program");
+    configure(p);
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    virtualMillis = 200;
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    virtualMillis = 301;
+    motionParameter move = p.nextTarget(0);
+    TEST_ASSERT_FALSE(move.skip);
+    TEST_ASSERT_EQUAL(1000, move.stroke);
+
+    // Asked again for the same stroke it does not wait twice
+    TEST_ASSERT_FALSE(p.nextTarget(0).skip);
+
+    // The pause counts from the query, so StrokeEngine must not ask early
+    TEST_ASSERT_FALSE(p.lookahead());
+
+    TEST_ASSERT_TRUE(p.nextTarget(1).skip);
+    virtualMillis = 602;
+    move = p.nextTarget(1);
+    TEST_ASSERT_FALSE(move.skip);
+    TEST_ASSERT_EQUAL(3000, move.stroke);
+}
+
+void test_pattern_ramp_sets_the_acceleration() {
+    // Full stroke in 1 s, 10 % of the time on each ramp
+    Assembler a;
+    a.push(6554).op(RAMP);
+    a.op(IN, INPUT_INDEX).push(2).op(MOD).push(65536).op(MUL);
+    a.push(1000).op(MOVE);
+    std::vector<uint8_t> bytes = a.bytes();
+    ProgramPattern::install(bytes.data(), bytes.size());
+
+    ProgramPattern p("Custom Program");
+    configure(p);
+    p.nextTarget(0);
+    motionParameter move = p.nextTarget(1);
+    // 2000 steps in 1 s: v = d / 0.9 s, a = v / 0.1 s
+    TEST_ASSERT_INT_WITHIN(3, 2222, move.speed);
+    TEST_ASSERT_INT_WITHIN(30, 22222, move.acceleration);
+}
+
+void test_pattern_fault_stands_still() {
+    Assembler a;
+    a.push(1).op(IN, INPUT_INDEX).op(DIV).push(500).op(MOVE);
+    std::vector<uint8_t> bytes = a.bytes();
+    ProgramPattern::install(bytes.data(), bytes.size());
+
+    ProgramPattern p("Custom Program");
+    configure(p);
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+    TEST_ASSERT_EQUAL(int(ProgramFault::DivideByZero), int(p.fault()));
+    TEST_ASSERT_TRUE(p.nextTarget(0).skip);
+}
+
+void test_pattern_install_and_clear() {
+    ProgramPattern p("Custom Program");
+    configure(p);
+    TEST_ASSERT_EQUAL(24, p.program().length);
+
+    // A broken program is refused and changes nothing
+    uint8_t broken[] = {'O', 'S', 'P', 'G', 1, 0, 1, 0, 0x42};
+    TEST_ASSERT_EQUAL(int(ProgramError::StackUnderflow),
+                      int(ProgramPattern::install(broken, sizeof(broken))));
+    TEST_ASSERT_FALSE(ProgramPattern::installed());
+
+    std::vector<uint8_t> bytes = deeperProgram();
+    ProgramPattern::install(bytes.data(), bytes.size());
+    TEST_ASSERT_TRUE(ProgramPattern::installed());
+
+    // There is only the one program, the running instance plays it now
+    TEST_ASSERT_EQUAL(bytes.size() - PATTERN_PROGRAM_HEADER_SIZE,
+                      p.program().length);
+    TEST_ASSERT_FALSE(p.nextTarget(1).skip);
+
+    ProgramPattern::clear();
+    TEST_ASSERT_FALSE(ProgramPattern::installed());
+    ProgramPattern fresh("Custom Program");
+    TEST_ASSERT_EQUAL(24, fresh.program().length);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+static volatile long benchmarkSink = 0;
+static Pattern *volatile benchmarkPattern = nullptr;
+
+// Best of five runs, ns per nextTarget(). Calls go through a Pattern * the
+// compiler cannot see through, like StrokeEngine's, so the native pattern
+// does not get inlined into the loop.
+static double nsPerTarget(Pattern &pattern) {
+    benchmarkPattern = &pattern;
+    Pattern &p = *benchmarkPattern;
+    const unsigned int calls = 200000;
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        long sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < calls; i++) {
+            motionParameter move = p.nextTarget(i);
+            sum += move.stroke + move.speed;
+        }
+        auto stop = std::chrono::steady_clock::now();
+        benchmarkSink = sum;
+        double ns = std::chrono::duration<double, std::nano>(stop - start)
+                        .count() /
+                    calls;
+        best = ns < best ? ns : best;
+    }
+    return best;
+}
+
+// Host timings are too noisy to assert on, the table is there to be read.
+// The default program lands within 2x of Simple Stroke. A program doing
+// Deeper's three divisions per stroke in ~35 instructions takes 2 to 3x.
+void test_benchmark_program_against_native() {
+    printf("\n  nextTarget() on the host, ns per call\n");
+    printf("  %-14s %10s %10s %8s\n", "pattern", "native", "program",
+           "ratio");
+
+    SimpleStroke simpleNative("Simple Stroke");
+    ProgramPattern simpleProgram("Custom Program");
+    configure(simpleNative);
+    configure(simpleProgram);
+    double native = nsPerTarget(simpleNative);
+    double program = nsPerTarget(simpleProgram);
+    printf("  %-14s %10.1f %10.1f %7.2fx\n", "Simple Stroke", native, program,
+           program / native);
+
+    std::vector<uint8_t> bytes = deeperProgram();
+    ProgramPattern::install(bytes.data(), bytes.size());
+    Deeper deeperNative("Deeper");
+    ProgramPattern deeperProgram("Custom Program");
+    configure(deeperNative, 30.0f);
+    configure(deeperProgram, 30.0f);
+    native = nsPerTarget(deeperNative);
+    program = nsPerTarget(deeperProgram);
+    printf("  %-14s %10.1f %10.1f %7.2fx\n", "Deeper", native, program,
+           program / native);
+
+    // The longest a run can take: an endless loop until the budget is gone
+    Assembler a;
+    a.label("loop").jump(JMP, "loop").push(0).push(0).op(MOVE);
+    bytes = a.bytes();
+    patternProgram endless;
+    loadBytes(bytes, endless);
+    int32_t inputs[INPUT_COUNT] = {};
+    int32_t variables[PATTERN_PROGRAM_VARIABLES] = {};
+    programMove move;
+    const int runs = 20000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        benchmarkSink += int(run(endless, inputs, variables, move));
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                runs;
+    printf("  %-14s %21.1f  (budget of %d cycles)\n", "worst case", ns,
+           PATTERN_PROGRAM_CYCLES);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_load_default_program);
+    RUN_TEST(test_load_rejects_broken_headers);
+    RUN_TEST(test_verify_rejects_unsafe_code);
+    RUN_TEST(test_verify_ignores_unreachable_code);
+    RUN_TEST(test_waits_only_if_wait_is_reachable);
+    RUN_TEST(test_error_names);
+
+    RUN_TEST(test_run_arithmetic);
+    RUN_TEST(test_run_comparisons_and_stack);
+    RUN_TEST(test_run_inputs);
+    RUN_TEST(test_run_loop_within_budget);
+    RUN_TEST(test_run_stops_endless_loop);
+    RUN_TEST(test_run_stops_on_division_by_zero);
+
+    RUN_TEST(test_pattern_default_program_is_simple_stroke);
+    RUN_TEST(test_pattern_deeper_program_matches_native);
+    RUN_TEST(test_pattern_variables_survive_repeated_queries);
+    RUN_TEST(test_pattern_replaced_program_starts_with_fresh_variables);
+    RUN_TEST(test_pattern_wait_pauses_before_the_move);
+    RUN_TEST(test_pattern_ramp_sets_the_acceleration);
+    RUN_TEST(test_pattern_fault_stands_still);
+    RUN_TEST(test_pattern_install_and_clear);
+
+    RUN_TEST(test_benchmark_program_against_native);
+
+    return UNITY_END();
+}
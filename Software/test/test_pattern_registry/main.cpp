@@ -0,0 +1,188 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN REGISTRY — UNIT TESTS                                          │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/PatternRegistry.h and the BLE JSON      │
+// │ rendered from it in src/services/communication/pattern_json.h:         │
+// │   patterns[]  — Name, description, sensation, factory per pattern      │
+// │   find()      — Bounds checked lookup                                  │
+// │   indexOf()   — Index of a pattern class                               │
+// │   maxSize()   — Storage the pattern pool needs                         │
+// │   pattern_json — Patterns characteristic and index range               │
+// │                                                                        │
+// │ Most properties are checked at compile time as well: the registry is   │
+// │ constexpr and must stay that way to live in flash.                     │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cstring>
+
+using namespace fakeit;
+
+#include "PatternRegistry.h"
+#include "services/communication/pattern_json.h"
+
+// ─── Compile time ─────────────────────────────────────────────────────────
+
+static_assert(PatternRegistry::count == 9, "9 built-in patterns");
+static_assert(PatternRegistry::find(PatternRegistry::count) == nullptr,
+              "find() is bounds checked");
+static_assert(PatternRegistry::maxSize() >= sizeof(Deeper),
+              "pool slots hold the largest pattern");
+static_assert(PatternRegistry::maxSize() >= sizeof(ProgramPattern),
+              "pool slots hold the program pattern");
+static_assert(PatternRegistry::patterns[0].sensation == SensationEffect::None,
+              "Simple Stroke ignores sensation");
+static_assert(pattern_json::indexRange.c_str()[15] == '8',
+              "index range follows the registry");
+static_assert(PatternRegistry::indexOf<KeyframePattern>() == 8,
+              "classes are found by their factory");
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Registry
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_registry_names_in_index_order() {
+    const char *expected[] = {"Simple Stroke", "Teasing Pounding",
+                              "Robo Stroke",   "Half'n'Half",
+                              "Deeper",        "Stop'n'Go",
+                              "Insist",        "Custom Program",
+                              "Keyframes"};
+    TEST_ASSERT_EQUAL(9, PatternRegistry::count);
+    for (int i = 0; i < PatternRegistry::count; i++) {
+        TEST_ASSERT_EQUAL_STRING(expected[i], PatternRegistry::name(i));
+    }
+}
+
+void test_registry_every_pattern_has_a_description() {
+    for (int i = 0; i < PatternRegistry::count; i++) {
+        TEST_ASSERT_TRUE(strlen(PatternRegistry::description(i)) > 0);
+    }
+    TEST_ASSERT_EQUAL_STRING(
+        "Pauses between strokes; sensation adjusts length.",
+        PatternRegistry::description(5));
+}
+
+void test_registry_out_of_range() {
+    TEST_ASSERT_NULL(PatternRegistry::find(-1));
+    TEST_ASSERT_NULL(PatternRegistry::find(9));
+    TEST_ASSERT_EQUAL_STRING("Invalid", PatternRegistry::name(9));
+    TEST_ASSERT_EQUAL_STRING("", PatternRegistry::description(-1));
+}
+
+void test_registry_sensation_effects() {
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[1].sensation ==
+                     SensationEffect::SpeedRatio);
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[3].sensation ==
+                     SensationEffect::SpeedRatio);
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[4].sensation ==
+                     SensationEffect::RampLength);
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[6].sensation ==
+                     SensationEffect::StrokeFraction);
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[7].sensation ==
+                     SensationEffect::Program);
+    TEST_ASSERT_TRUE(PatternRegistry::patterns[8].sensation ==
+                     SensationEffect::None);
+    for (const PatternInfo &info : PatternRegistry::patterns) {
+        TEST_ASSERT_EQUAL_FLOAT(0.0f, info.defaultSensation);
+    }
+}
+
+void test_registry_factory_builds_named_pattern_in_place() {
+    alignas(PatternRegistry::maxAlignment())
+        unsigned char storage[PatternRegistry::maxSize()];
+    for (const PatternInfo &info : PatternRegistry::patterns) {
+        TEST_ASSERT_TRUE(info.size <= sizeof(storage));
+        Pattern *p = info.construct(storage, info.name);
+        TEST_ASSERT_EQUAL_PTR(storage, p);
+        TEST_ASSERT_EQUAL_STRING(info.name, p->getName());
+        p->~Pattern();
+    }
+}
+
+void test_registry_factory_builds_the_right_class() {
+    // Half'n'Half strokes half-way on odd full strokes, Simple Stroke
+    // never does
+    alignas(PatternRegistry::maxAlignment())
+        unsigned char storage[PatternRegistry::maxSize()];
+    const int expected[] = {2000, 1500};
+    const int indices[] = {0, 3};
+    for (int i = 0; i < 2; i++) {
+        const PatternInfo &info = PatternRegistry::patterns[indices[i]];
+        Pattern *p = info.construct(storage, info.name);
+        p->setTimeOfStroke(1.0f);
+        p->setStroke(1000);
+        p->setDepth(2000);
+        p->setSensation(0.0f);
+        TEST_ASSERT_EQUAL(expected[i], p->nextTarget(0).stroke);
+        p->~Pattern();
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// BLE JSON
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_json_patterns_characteristic() {
+    // Same as the ArduinoJson document built at runtime before
+    TEST_ASSERT_EQUAL_STRING(
+        "[{\"name\":\"Simple Stroke\",\"idx\":0},"
+        "{\"name\":\"Teasing Pounding\",\"idx\":1},"
+        "{\"name\":\"Robo Stroke\",\"idx\":2},"
+        "{\"name\":\"Half'n'Half\",\"idx\":3},"
+        "{\"name\":\"Deeper\",\"idx\":4},"
+        "{\"name\":\"Stop'n'Go\",\"idx\":5},"
+        "{\"name\":\"Insist\",\"idx\":6},"
+        "{\"name\":\"Custom Program\",\"idx\":7},"
+        "{\"name\":\"Keyframes\",\"idx\":8}]",
+        pattern_json::patterns.c_str());
+    TEST_ASSERT_EQUAL(strlen(pattern_json::patterns.c_str()),
+                      pattern_json::patterns.length());
+}
+
+void test_json_index_range() {
+    TEST_ASSERT_EQUAL_STRING("{\"min\":0,\"max\":8}",
+                             pattern_json::indexRange.c_str());
+}
+
+void test_json_writer_escapes_and_numbers() {
+    char buffer[64] = {};
+    pattern_json::Writer w{buffer};
+    w.string("a\"b\\c");
+    w.put(' ');
+    w.number(0);
+    w.put(' ');
+    w.number(-120);
+    w.put(' ');
+    w.number(1000);
+    TEST_ASSERT_EQUAL_STRING("\"a\\\"b\\\\c\" 0 -120 1000", buffer);
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_registry_names_in_index_order);
+    RUN_TEST(test_registry_every_pattern_has_a_description);
+    RUN_TEST(test_registry_out_of_range);
+    RUN_TEST(test_registry_sensation_effects);
+    RUN_TEST(test_registry_factory_builds_named_pattern_in_place);
+    RUN_TEST(test_registry_factory_builds_the_right_class);
+
+    RUN_TEST(test_json_patterns_characteristic);
+    RUN_TEST(test_json_index_range);
+    RUN_TEST(test_json_writer_escapes_and_numbers);
+
+    return UNITY_END();
+}
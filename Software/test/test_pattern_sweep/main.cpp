@@ -0,0 +1,660 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ PATTERN SWEEP — BENCHMARK & REGRESSION SUITE                           │
+// │                                                                        │
+// │ Runs every pattern of PatternRegistry over a grid of depth, stroke,    │
+// │ speed and sensation on the OSSM reference machine, through the same    │
+// │ timeOfStrokeForSpeed() and limitMotion() StrokeEngine uses             │
+// │ (lib/StrokeEngine/src/MotionLimits.h). Each combination plays 2 min    │
+// │ of virtual time on the pattern clock, moves take their trapezoidal     │
+// │ time, pauses are polled every 10 ms.                                   │
+// │                                                                        │
+// │ Reported per combination:                                              │
+// │   peak speed and acceleration reached after clipping                   │
+// │   strokes/min (one stroke is an in and an out move)                    │
+// │   duty cycle, the share of the time the machine moves                  │
+// │   clip rate, the share of moves limitMotion() had to clip              │
+// │   period error, how much longer a stroke takes than on a machine       │
+// │     without limits                                                     │
+// │   shape error, how far the in/out time ratio is off from there         │
+// │                                                                        │
+// │ The patterns plan within the limits given by setSpeedLimit(). The      │
+// │ clip_only_ columns play the same patterns without telling them the     │
+// │ limits, so StrokeEngine clips single moves, as it did before.          │
+// │                                                                        │
+// │ The baseline is _output/sweep.csv and _output/sweep.json, which are    │
+// │ checked in. A combination that loses more than 1% strokes/min, clips   │
+// │ more often or gets more distorted than in sweep.csv fails the test.    │
+// │ Every run writes its results to _output/sweep.latest.*, which git      │
+// │ ignores, and leaves the baseline alone. Only a run with SWEEP_ACCEPT=1 │
+// │ writes the baseline; committing it accepts the change, and the diff    │
+// │ shows up in review.                                                    │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace fakeit;
+
+#include "MotionLimits.h"
+#include "PatternRegistry.h"
+
+static const char *OUTPUT_DIR = "test/test_pattern_sweep/_output";
+static const char *CSV_PATH = "test/test_pattern_sweep/_output/sweep.csv";
+static const char *JSON_PATH = "test/test_pattern_sweep/_output/sweep.json";
+static const char *LATEST_CSV_PATH =
+    "test/test_pattern_sweep/_output/sweep.latest.csv";
+static const char *LATEST_JSON_PATH =
+    "test/test_pattern_sweep/_output/sweep.latest.json";
+
+// ─── Machine ──────────────────────────────────────────────────────────────
+
+// Config::Driver of the reference OSSM: 20 steps/mm, 1000 mm/s, 50 m/s²
+static const int kStepsPerMM = 20;
+static const int kMaxSpeed = 1000 * kStepsPerMM;
+static const int kMaxAcceleration = 50000 * kStepsPerMM;
+static const int kMaxJerk = 0;
+static const int kTravel = 180 * kStepsPerMM;
+
+// ─── Grid ─────────────────────────────────────────────────────────────────
+
+static const int kDepthsMM[] = {90, 180};
+static const int kStrokesMM[] = {20, 60, 120, 180};
+static const float kSpeedPercents[] = {10, 25, 50, 75, 100};
+static const float kSensations[] = {-100, -50, 0, 50, 100};
+
+static const uint64_t kSimMicros = 120ULL * 1000 * 1000;
+static const uint32_t kPollMicros = 10 * 1000;
+
+// Allowed loss of strokes/min and growth of the clip rate
+static const float kThroughputTolerance = 0.01f;
+static const float kClipTolerancePercent = 0.5f;
+static const float kShapeTolerancePercent = 0.5f;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static uint32_t virtualMillis = 0;
+
+static unsigned long virtualClock() { return virtualMillis; }
+
+static long realMap(long x, long in_min, long in_max, long out_min,
+                    long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// How much the pattern and the machine know about the limits
+enum class Limits {
+    None,      // A machine without limits, what the pattern asks for
+    ClipOnly,  // StrokeEngine clips, the pattern doesn't know the limits
+    Planned,   // The pattern plans within the limits, like on the machine
+};
+
+struct SweepRun {
+    double peakSpeed = 0.0;     // steps/s
+    int peakAcceleration = 0;   // steps/s²
+    double strokesPerMinute = 0.0;
+    double dutyCycle = 0.0;     // %
+    double clipRate = 0.0;      // %
+    double inMicros = 0.0;      // mean time of an in move
+    double outMicros = 0.0;     // mean time of an out move
+
+    double period() const { return inMicros + outMicros; }
+    double ratio() const { return outMicros > 0.0 ? inMicros / outMicros : 0.0; }
+};
+
+struct SweepRow {
+    std::string pattern;
+    int depth;        // mm
+    int stroke;       // mm
+    float speed;      // %
+    float sensation;  // -100..100
+    float peakSpeed;         // mm/s
+    float peakAcceleration;  // mm/s²
+    float strokesPerMinute;
+    float dutyCycle;  // %
+    float clipRate;   // %
+    float periodError;          // %
+    float shapeError;           // %
+    float clipOnlyPeriodError;  // %
+    float clipOnlyShapeError;   // %
+    float clipOnlyStrokesPerMinute;
+};
+
+static std::string rowKey(const std::string &pattern, int depth, int stroke,
+                          float speed, float sensation) {
+    char key[128];
+    snprintf(key, sizeof(key), "%s|%d|%d|%.0f|%.0f", pattern.c_str(), depth,
+             stroke, speed, sensation);
+    return key;
+}
+
+static std::string rowKey(const SweepRow &row) {
+    return rowKey(row.pattern, row.depth, row.stroke, row.speed,
+                  row.sensation);
+}
+
+// Time of a trapezoidal move in µs and the speed it peaks at
+static double moveMicros(int distance, int speed, int acceleration,
+                         double &peak) {
+    double d = fabs(double(distance));
+    double v = speed;
+    double a = acceleration;
+    if (d == 0.0 || v <= 0.0 || a <= 0.0) {
+        peak = 0.0;
+        return 0.0;
+    }
+    if (d <= v * v / a) {
+        peak = sqrt(d * a);
+        return 2.0e6 * sqrt(d / a);
+    }
+    peak = v;
+    return 1.0e6 * (d / v + v / a);
+}
+
+// Plays one combination like the stroking task without lookahead
+static SweepRun runPattern(int patternIndex, int depthMM, int strokeMM,
+                           float speedPercent, float sensation,
+                           Limits limits) {
+    const PatternInfo &info = PatternRegistry::patterns[patternIndex];
+    alignas(PatternRegistry::maxAlignment())
+        unsigned char storage[PatternRegistry::maxSize()];
+    Pattern *pattern = info.construct(storage, info.name);
+
+    int maxSpeed = (limits == Limits::None) ? INT32_MAX : kMaxSpeed;
+    int maxAcceleration =
+        (limits == Limits::None) ? INT32_MAX : kMaxAcceleration;
+    int depth = depthMM * kStepsPerMM;
+    int stroke = strokeMM * kStepsPerMM;
+    virtualMillis = 0;
+    if (limits == Limits::Planned) {
+        pattern->setSpeedLimit(kMaxSpeed, kMaxAcceleration, kStepsPerMM,
+                               kMaxJerk);
+    }
+    pattern->setTimeOfStroke(
+        timeOfStrokeForSpeed(stroke, speedPercent, kMaxSpeed));
+    pattern->setStroke(stroke);
+    pattern->setDepth(depth);
+    pattern->setSensation(sensation);
+
+    SweepRun run;
+    double elapsed = 0.0;
+    double moving = 0.0;
+    double movingIn = 0.0;
+    uint32_t moves = 0;
+    uint32_t movesIn = 0;
+    uint32_t clipped = 0;
+    int position = 0;
+    unsigned int index = 0;
+
+    while (elapsed < double(kSimMicros)) {
+        motionParameter move = pattern->nextTarget(index);
+        double step;
+        if (move.skip) {
+            step = kPollMicros;
+        } else {
+            int jerk = 0;
+            if (limitMotion(move, maxSpeed, maxAcceleration, kMaxJerk, jerk) !=
+                CLIP_NONE) {
+                clipped++;
+            }
+            int target = constrain(move.stroke, 0, kTravel);
+            double peak = 0.0;
+            step = moveMicros(target - position, move.speed,
+                              move.acceleration, peak);
+            if (peak > run.peakSpeed) run.peakSpeed = peak;
+            if (target != position &&
+                move.acceleration > run.peakAcceleration) {
+                run.peakAcceleration = move.acceleration;
+            }
+            // A move to where the machine already is still takes a cycle
+            if (step < 1000.0) step = 1000.0;
+            position = target;
+            index++;
+            // The first move comes from home and is not part of the pattern
+            if (index == 1) {
+                continue;
+            }
+            moving += step;
+            if (index % 2 == 1) {
+                movingIn += step;
+                movesIn++;
+            }
+            moves++;
+        }
+        elapsed += step;
+        virtualMillis = uint32_t(elapsed / 1000.0);
+    }
+    pattern->~Pattern();
+
+    run.strokesPerMinute = moves / 2.0 / (elapsed / 60.0e6);
+    run.dutyCycle = 100.0 * moving / elapsed;
+    run.clipRate = moves ? 100.0 * clipped / moves : 0.0;
+    run.inMicros = movesIn ? movingIn / movesIn : 0.0;
+    run.outMicros =
+        (moves > movesIn) ? (moving - movingIn) / (moves - movesIn) : 0.0;
+    return run;
+}
+
+// Deviation in percent from what the pattern asks for
+static float percentError(double value, double reference) {
+    return reference > 0.0 ? float(100.0 * (value - reference) / reference)
+                           : 0.0f;
+}
+
+static SweepRow runCombination(int patternIndex, int depthMM, int strokeMM,
+                               float speedPercent, float sensation) {
+    SweepRun ideal = runPattern(patternIndex, depthMM, strokeMM, speedPercent,
+                                sensation, Limits::None);
+    SweepRun clipOnly = runPattern(patternIndex, depthMM, strokeMM,
+                                   speedPercent, sensation, Limits::ClipOnly);
+    SweepRun planned = runPattern(patternIndex, depthMM, strokeMM,
+                                  speedPercent, sensation, Limits::Planned);
+
+    SweepRow row;
+    row.pattern = PatternRegistry::name(patternIndex);
+    row.depth = depthMM;
+    row.stroke = strokeMM;
+    row.speed = speedPercent;
+    row.sensation = sensation;
+    row.peakSpeed = float(planned.peakSpeed / kStepsPerMM);
+    row.peakAcceleration = float(planned.peakAcceleration / kStepsPerMM);
+    row.strokesPerMinute = float(planned.strokesPerMinute);
+    row.dutyCycle = float(planned.dutyCycle);
+    row.clipRate = float(planned.clipRate);
+    row.periodError = percentError(planned.period(), ideal.period());
+    row.shapeError = fabsf(percentError(planned.ratio(), ideal.ratio()));
+    row.clipOnlyPeriodError = percentError(clipOnly.period(), ideal.period());
+    row.clipOnlyShapeError =
+        fabsf(percentError(clipOnly.ratio(), ideal.ratio()));
+    row.clipOnlyStrokesPerMinute = float(clipOnly.strokesPerMinute);
+    return row;
+}
+
+static std::vector<SweepRow> sweepRows;
+static double sweepWallSeconds = 0.0;
+
+// Keyframes plays a file, without one there is nothing to measure
+static bool swept(int pattern) {
+    return pattern != PatternRegistry::indexOf<KeyframePattern>();
+}
+
+static const std::vector<SweepRow> &sweep() {
+    if (!sweepRows.empty()) return sweepRows;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < PatternRegistry::count; p++) {
+        if (!swept(p)) continue;
+        for (int depth : kDepthsMM) {
+            for (int stroke : kStrokesMM) {
+                if (stroke > depth) continue;
+                for (float speed : kSpeedPercents) {
+                    for (float sensation : kSensations) {
+                        sweepRows.push_back(
+                            runCombination(p, depth, stroke, speed, sensation));
+                    }
+                }
+            }
+        }
+    }
+    sweepWallSeconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    return sweepRows;
+}
+
+static const SweepRow *findRow(const char *pattern, int depth, int stroke,
+                               float speed, float sensation) {
+    std::string key = rowKey(pattern, depth, stroke, speed, sensation);
+    for (const SweepRow &row : sweep()) {
+        if (rowKey(row) == key) return &row;
+    }
+    return nullptr;
+}
+
+static const char *CSV_HEADER =
+    "pattern,depth_mm,stroke_mm,speed_pct,sensation,peak_mm_s,"
+    "peak_accel_mm_s2,strokes_min,duty_pct,clip_pct,period_err_pct,"
+    "shape_err_pct,clip_only_period_err_pct,clip_only_shape_err_pct,"
+    "clip_only_strokes_min";
+
+static std::string csvLine(const SweepRow &r) {
+    char line[320];
+    snprintf(line, sizeof(line),
+             "%s,%d,%d,%.0f,%.0f,%.1f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,"
+             "%.2f",
+             r.pattern.c_str(), r.depth, r.stroke, r.speed, r.sensation,
+             r.peakSpeed, r.peakAcceleration, r.strokesPerMinute, r.dutyCycle,
+             r.clipRate, r.periodError, r.shapeError, r.clipOnlyPeriodError,
+             r.clipOnlyShapeError, r.clipOnlyStrokesPerMinute);
+    return line;
+}
+
+static std::map<std::string, SweepRow> readBaseline() {
+    std::map<std::string, SweepRow> baseline;
+    FILE *file = fopen(CSV_PATH, "r");
+    if (file == NULL) return baseline;
+    char line[320];
+    if (fgets(line, sizeof(line), file) == NULL) {
+        fclose(file);
+        return baseline;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Pattern names hold no commas
+        char *comma = strchr(line, ',');
+        if (comma == NULL) continue;
+        SweepRow row = {};
+        row.pattern.assign(line, comma - line);
+        // Baselines from before a column was added still count
+        if (sscanf(comma + 1, "%d,%d,%f,%f,%f,%f,%f,%f,%f,%f,%f", &row.depth,
+                   &row.stroke, &row.speed, &row.sensation, &row.peakSpeed,
+                   &row.peakAcceleration, &row.strokesPerMinute,
+                   &row.dutyCycle, &row.clipRate, &row.periodError,
+                   &row.shapeError) >= 9) {
+            baseline[rowKey(row)] = row;
+        }
+    }
+    fclose(file);
+    return baseline;
+}
+
+static bool writeResults(const std::vector<SweepRow> &rows,
+                         const char *csvPath, const char *jsonPath) {
+    mkdir("test/test_pattern_sweep", 0755);
+    mkdir(OUTPUT_DIR, 0755);
+
+    FILE *csv = fopen(csvPath, "w");
+    if (csv == NULL) return false;
+    fprintf(csv, "%s\n", CSV_HEADER);
+    for (const SweepRow &row : rows) {
+        fprintf(csv, "%s\n", csvLine(row).c_str());
+    }
+    fclose(csv);
+
+    FILE *json = fopen(jsonPath, "w");
+    if (json == NULL) return false;
+    fprintf(json,
+            "{\n  \"machine\": {\"steps_per_mm\": %d, \"max_speed_mm_s\": %d, "
+            "\"max_accel_mm_s2\": %d, \"travel_mm\": %d},\n",
+            kStepsPerMM, kMaxSpeed / kStepsPerMM,
+            kMaxAcceleration / kStepsPerMM, kTravel / kStepsPerMM);
+    fprintf(json, "  \"sim_seconds\": %llu,\n  \"results\": [\n",
+            (unsigned long long)(kSimMicros / 1000000));
+    for (size_t i = 0; i < rows.size(); i++) {
+        const SweepRow &r = rows[i];
+        fprintf(json,
+                "    {\"pattern\": \"%s\", \"depth_mm\": %d, \"stroke_mm\": "
+                "%d, \"speed_pct\": %.0f, \"sensation\": %.0f, \"peak_mm_s\": "
+                "%.1f, \"peak_accel_mm_s2\": %.0f, \"strokes_min\": %.2f, "
+                "\"duty_pct\": %.1f, \"clip_pct\": %.1f, \"period_err_pct\": "
+                "%.1f, \"shape_err_pct\": %.1f, \"clip_only\": "
+                "{\"period_err_pct\": %.1f, \"shape_err_pct\": %.1f, "
+                "\"strokes_min\": %.2f}}%s\n",
+                r.pattern.c_str(), r.depth, r.stroke, r.speed, r.sensation,
+                r.peakSpeed, r.peakAcceleration, r.strokesPerMinute,
+                r.dutyCycle, r.clipRate, r.periodError, r.shapeError,
+                r.clipOnlyPeriodError, r.clipOnlyShapeError,
+                r.clipOnlyStrokesPerMinute, i + 1 < rows.size() ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+    fclose(json);
+    return true;
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), map)).AlwaysDo(
+        [](long x, long in_min, long in_max, long out_min, long out_max)
+            -> long { return realMap(x, in_min, in_max, out_min, out_max); });
+    Pattern::setClock(virtualClock);
+}
+
+void tearDown(void) { Pattern::setClock(NULL); }
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Motion limits
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_time_of_stroke_for_speed() {
+    // 3 * stroke / T peaks at speedPercent of the maximum
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.18f,
+                             timeOfStrokeForSpeed(1200, 100.0f, 20000));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.36f,
+                             timeOfStrokeForSpeed(1200, 50.0f, 20000));
+    TEST_ASSERT_EQUAL_FLOAT(120.0f, timeOfStrokeForSpeed(1200, 0.0f, 20000));
+    TEST_ASSERT_EQUAL_FLOAT(120.0f, timeOfStrokeForSpeed(0, 50.0f, 20000));
+    TEST_ASSERT_EQUAL_FLOAT(0.01f, timeOfStrokeForSpeed(1, 100.0f, 20000));
+    TEST_ASSERT_EQUAL_FLOAT(120.0f, timeOfStrokeForSpeed(100000, 0.1f, 20));
+}
+
+void test_limit_motion_clips_speed_and_acceleration() {
+    int jerk = -1;
+    motionParameter move = {1000, 30000, 2000000, false, 0};
+    uint8_t clipped = limitMotion(move, 20000, 1000000, 0, jerk);
+    TEST_ASSERT_EQUAL(CLIP_SPEED | CLIP_ACCELERATION, clipped);
+    TEST_ASSERT_EQUAL(20000, move.speed);
+    TEST_ASSERT_EQUAL(1000000, move.acceleration);
+    TEST_ASSERT_EQUAL(0, jerk);
+
+    move = {1000, 20000, 1000000, false, 0};
+    TEST_ASSERT_EQUAL(CLIP_NONE, limitMotion(move, 20000, 1000000, 0, jerk));
+}
+
+void test_limit_motion_jerk() {
+    int jerk = 0;
+    // Softer than the machine is taken
+    motionParameter move = {1000, 1000, 1000, false, 500};
+    TEST_ASSERT_EQUAL(CLIP_NONE, limitMotion(move, 20000, 1000000, 800, jerk));
+    TEST_ASSERT_EQUAL(500, jerk);
+
+    // Harder than the machine is clipped
+    move.jerk = 900;
+    TEST_ASSERT_EQUAL(CLIP_JERK, limitMotion(move, 20000, 1000000, 800, jerk));
+    TEST_ASSERT_EQUAL(800, jerk);
+
+    // A trapezoidal machine runs any pattern jerk
+    move.jerk = 900;
+    TEST_ASSERT_EQUAL(CLIP_NONE, limitMotion(move, 20000, 1000000, 0, jerk));
+    TEST_ASSERT_EQUAL(900, jerk);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Sweep
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_sweep_stays_within_machine_limits() {
+    const std::vector<SweepRow> &rows = sweep();
+    TEST_ASSERT_GREATER_THAN(500, rows.size());
+    for (const SweepRow &row : rows) {
+        TEST_ASSERT_TRUE(row.peakSpeed <= kMaxSpeed / kStepsPerMM + 0.01f);
+        TEST_ASSERT_TRUE(row.peakAcceleration <=
+                         kMaxAcceleration / kStepsPerMM);
+        TEST_ASSERT_TRUE(row.dutyCycle <= 100.01f);
+        TEST_ASSERT_GREATER_THAN(0.0f, row.strokesPerMinute);
+    }
+}
+
+void test_simple_stroke_peaks_at_speed_percent() {
+    // The promise of StrokeEngine::setSpeed(): the peak step rate is
+    // speedPercent of the maximum, whatever the stroke
+    for (int stroke : {60, 120, 180}) {
+        for (float speed : {10.0f, 50.0f, 100.0f}) {
+            const SweepRow *row = findRow("Simple Stroke", 180, stroke, speed,
+                                          0.0f);
+            TEST_ASSERT_NOT_NULL(row);
+            TEST_ASSERT_FLOAT_WITHIN(0.01f * speed * 10.0f, speed * 10.0f,
+                                     row->peakSpeed);
+            TEST_ASSERT_EQUAL_FLOAT(0.0f, row->clipRate);
+        }
+    }
+}
+
+void test_stop_n_go_pauses_lower_duty_cycle() {
+    const SweepRow *shortPauses =
+        findRow("Stop'n'Go", 180, 120, 50.0f, -100.0f);
+    const SweepRow *longPauses = findRow("Stop'n'Go", 180, 120, 50.0f, 100.0f);
+    const SweepRow *simple = findRow("Simple Stroke", 180, 120, 50.0f, 0.0f);
+    TEST_ASSERT_NOT_NULL(shortPauses);
+    TEST_ASSERT_NOT_NULL(longPauses);
+    TEST_ASSERT_NOT_NULL(simple);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 100.0f, simple->dutyCycle);
+    TEST_ASSERT_TRUE(longPauses->dutyCycle < shortPauses->dutyCycle);
+    TEST_ASSERT_TRUE(longPauses->strokesPerMinute <
+                     shortPauses->strokesPerMinute);
+}
+
+void test_planned_patterns_do_not_clip() {
+    for (const SweepRow &row : sweep()) {
+        TEST_ASSERT_EQUAL_FLOAT(0.0f, row.clipRate);
+    }
+}
+
+void test_planned_patterns_keep_their_shape() {
+    // The time ratio between in and out stays within rounding, even where
+    // clipping single moves distorts it
+    float worstPlanned = 0.0f;
+    float worstClipOnly = 0.0f;
+    for (const SweepRow &row : sweep()) {
+        worstPlanned = fmaxf(worstPlanned, row.shapeError);
+        worstClipOnly = fmaxf(worstClipOnly, row.clipOnlyShapeError);
+    }
+    TEST_ASSERT_LESS_THAN(1.0f, worstPlanned);
+    TEST_ASSERT_GREATER_THAN(10.0f, worstClipOnly);
+}
+
+// In and out take different times. Keeping their ratio costs these
+// patterns strokes/min against clipping, which only slows the faster move.
+static bool asymmetric(const SweepRow &row) {
+    return row.pattern == "Teasing Pounding" || row.pattern == "Half'n'Half";
+}
+
+void test_planned_symmetric_patterns_are_not_slower() {
+    // Moves that take the same time can be stretched to what the machine
+    // makes, which is never slower than clipping them one by one
+    for (const SweepRow &row : sweep()) {
+        if (asymmetric(row)) {
+            continue;
+        }
+        TEST_ASSERT_TRUE(row.periodError <= row.clipOnlyPeriodError + 0.1f);
+        TEST_ASSERT_TRUE(row.strokesPerMinute >=
+                         row.clipOnlyStrokesPerMinute * 0.999f);
+    }
+}
+
+void test_period_error_before_and_after() {
+    printf("\n  %-17s %5s  %22s  %22s  %17s\n", "", "",
+           "period error [%]", "shape error [%]", "strokes/min");
+    printf("  %-17s %5s  %10s %11s  %10s %11s  %8s %8s\n", "pattern",
+           "clips", "clip only", "planned", "clip only", "planned",
+           "clip only", "planned");
+    for (int p = 0; p < PatternRegistry::count; p++) {
+        if (!swept(p)) continue;
+        const char *name = PatternRegistry::name(p);
+        int count = 0;
+        double periodBefore = 0, periodAfter = 0;
+        double shapeBefore = 0, shapeAfter = 0;
+        double strokesBefore = 0, strokesAfter = 0;
+        for (const SweepRow &row : sweep()) {
+            // Only the combinations the limits matter for
+            if (row.pattern != name || row.clipOnlyPeriodError <= 0.05f) {
+                continue;
+            }
+            count++;
+            periodBefore += row.clipOnlyPeriodError;
+            periodAfter += row.periodError;
+            shapeBefore += row.clipOnlyShapeError;
+            shapeAfter += row.shapeError;
+            strokesBefore += row.clipOnlyStrokesPerMinute;
+            strokesAfter += row.strokesPerMinute;
+        }
+        if (count == 0) {
+            printf("  %-17s %5d\n", name, 0);
+            continue;
+        }
+        printf("  %-17s %5d  %10.1f %11.1f  %10.1f %11.1f  %8.0f %8.0f\n",
+               name, count, periodBefore / count, periodAfter / count,
+               shapeBefore / count, shapeAfter / count, strokesBefore / count,
+               strokesAfter / count);
+    }
+}
+
+void test_sweep_matches_baseline() {
+    const std::vector<SweepRow> &rows = sweep();
+    std::map<std::string, SweepRow> baseline = readBaseline();
+
+    int regressions = 0;
+    int clipping = 0;
+    for (const SweepRow &row : rows) {
+        if (row.clipRate > 0.0f) clipping++;
+        auto it = baseline.find(rowKey(row));
+        if (it == baseline.end()) continue;
+        const SweepRow &before = it->second;
+        bool slower = row.strokesPerMinute <
+                      before.strokesPerMinute * (1.0f - kThroughputTolerance);
+        bool clips = row.clipRate > before.clipRate + kClipTolerancePercent;
+        bool distorts =
+            row.shapeError > before.shapeError + kShapeTolerancePercent;
+        if (slower || clips || distorts) {
+            if (regressions < 10) {
+                printf("\n  REGRESSION %s\n    was %s\n",
+                       csvLine(row).c_str(), csvLine(before).c_str());
+            }
+            regressions++;
+        }
+    }
+
+    printf("\n  %zu combinations, %d clipping, %zu in baseline, %.0f ms wall\n",
+           rows.size(), clipping, baseline.size(), sweepWallSeconds * 1000.0);
+
+    // The baseline only moves on purpose. Otherwise losses within the
+    // tolerance would add up over runs, and every run would dirty the tree.
+    bool accept = getenv("SWEEP_ACCEPT") != NULL;
+    TEST_ASSERT_TRUE_MESSAGE(
+        writeResults(rows, LATEST_CSV_PATH, LATEST_JSON_PATH),
+        "Cannot write _output");
+    if (accept) {
+        TEST_ASSERT_TRUE_MESSAGE(writeResults(rows, CSV_PATH, JSON_PATH),
+                                 "Cannot write _output");
+        printf("  %s is the new baseline\n", CSV_PATH);
+    } else {
+        printf("  Results are in %s, SWEEP_ACCEPT=1 makes them the baseline\n",
+               LATEST_CSV_PATH);
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(0, accept ? 0 : regressions,
+                              "Throughput or clipping regressed, see log");
+}
+
+// ─── Runner ───────────────────────────────────────────────────────────────
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+
+    // Motion limits
+    RUN_TEST(test_time_of_stroke_for_speed);
+    RUN_TEST(test_limit_motion_clips_speed_and_acceleration);
+    RUN_TEST(test_limit_motion_jerk);
+
+    // Sweep
+    RUN_TEST(test_sweep_stays_within_machine_limits);
+    RUN_TEST(test_simple_stroke_peaks_at_speed_percent);
+    RUN_TEST(test_stop_n_go_pauses_lower_duty_cycle);
+
+    // Planning within the limits
+    RUN_TEST(test_planned_patterns_do_not_clip);
+    RUN_TEST(test_planned_patterns_keep_their_shape);
+    RUN_TEST(test_planned_symmetric_patterns_are_not_slower);
+    RUN_TEST(test_period_error_before_and_after);
+
+    RUN_TEST(test_sweep_matches_baseline);
+
+    return UNITY_END();
+}
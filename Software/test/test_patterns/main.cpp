@@ -9,6 +9,7 @@
 // │   Deeper             — Ramping insertion depth                          │
 // │   StopNGo            — Pauses between stroke series                    │
 // │   Insist             — Fractional stroke with position bias            │
+// │   Speed limits       — Planning within setSpeedLimit()                 │
 // │                                                                        │
 // │ All 7 concrete patterns derived from Pattern base class.               │
 // └──────────────────────────────────────────────────────────────────────────┘
@@ -322,7 +323,7 @@ void test_robo_name() {
 void test_halfnhalf_first_stroke_is_half() {
     HalfnHalf p("Half'n'Half");
     setupPattern(p, 1000, 5000, 2.0, 0);
-    // index=0 → _half = true, stroke = 500
+    // index=0 → half, stroke = 500
     // even in-stroke: position = (depth - stroke) + stroke/2 = 4000 + 500 = 4500
     motionParameter m = p.nextTarget(0);
     TEST_ASSERT_EQUAL_INT(4500, m.stroke);
@@ -331,11 +332,11 @@ void test_halfnhalf_first_stroke_is_half() {
 void test_halfnhalf_half_alternates_on_odd() {
     HalfnHalf p("Half'n'Half");
     setupPattern(p, 1000, 5000, 2.0, 0);
-    // index 0: _half=true, even → stroke=500, pos = 4500
+    // index 0: half, even → stroke=500, pos = 4500
     p.nextTarget(0);
-    // index 1: odd → _half toggles to false, out-stroke: pos = 4000
+    // index 1: odd, out-stroke of the half stroke: pos = 4000
     p.nextTarget(1);
-    // index 2: _half=false, even → stroke=1000, pos = (4000) + 1000 = 5000
+    // index 2: full, even → stroke=1000, pos = (4000) + 1000 = 5000
     motionParameter m2 = p.nextTarget(2);
     TEST_ASSERT_EQUAL_INT(5000, m2.stroke);
 }
@@ -343,15 +344,29 @@ void test_halfnhalf_half_alternates_on_odd() {
 void test_halfnhalf_full_cycle_positions() {
     HalfnHalf p("HH");
     setupPattern(p, 1000, 5000, 2.0, 0);
-    // index 0: _half=true, half in → 4500
+    // index 0: half in → 4500
     TEST_ASSERT_EQUAL_INT(4500, p.nextTarget(0).stroke);
-    // index 1: odd, _half toggles → false, out → 4000
+    // index 1: out → 4000
     TEST_ASSERT_EQUAL_INT(4000, p.nextTarget(1).stroke);
-    // index 2: _half=false, full in → 5000
+    // index 2: full in → 5000
     TEST_ASSERT_EQUAL_INT(5000, p.nextTarget(2).stroke);
-    // index 3: odd, _half toggles → true, out → 4000
+    // index 3: out → 4000
     TEST_ASSERT_EQUAL_INT(4000, p.nextTarget(3).stroke);
-    // index 4: _half=true, half in → 4500
+    // index 4: half in → 4500
+    TEST_ASSERT_EQUAL_INT(4500, p.nextTarget(4).stroke);
+}
+
+void test_halfnhalf_repeated_query_gives_same_move() {
+    HalfnHalf p("HH");
+    setupPattern(p, 1000, 5000, 2.0, 0);
+    // StrokeEngine asks again after a settings change or a flushed lookahead
+    p.nextTarget(0);
+    p.nextTarget(1);
+    p.nextTarget(1);
+    TEST_ASSERT_EQUAL_INT(5000, p.nextTarget(2).stroke);
+    TEST_ASSERT_EQUAL_INT(5000, p.nextTarget(2).stroke);
+    p.nextTarget(3);
+    p.nextTarget(3);
     TEST_ASSERT_EQUAL_INT(4500, p.nextTarget(4).stroke);
 }
 
@@ -360,7 +375,7 @@ void test_halfnhalf_half_speed_is_lower() {
     setupPattern(p, 1000, 5000, 2.0, 0);
     // index 0: half stroke → speed uses stroke/2 = 500
     motionParameter mHalf = p.nextTarget(0);
-    // After 0→1→2, _half=false, full stroke
+    // index 2 is a full stroke
     p.nextTarget(1);
     motionParameter mFull = p.nextTarget(2);
     TEST_ASSERT_TRUE(mFull.speed > mHalf.speed);
@@ -372,7 +387,7 @@ void test_halfnhalf_positive_sensation_in_faster() {
     // Need to get past initial half stroke
     p.nextTarget(0);
     p.nextTarget(1);
-    // index 2: _half=false (full stroke), even, in-stroke
+    // index 2: full stroke, even, in-stroke
     motionParameter mIn = p.nextTarget(2);
     // index 3: odd, out-stroke
     motionParameter mOut = p.nextTarget(3);
@@ -770,6 +785,141 @@ void test_insist_name() {
     TEST_ASSERT_EQUAL_STRING("Insist", p.getName());
 }
 
+void test_insist_acceleration_uses_current_speed() {
+    // A fresh pattern has no previous move to take the speed from
+    Insist p("Insist");
+    setupPattern(p, 1000, 5000, 2.0, 50);
+    // speed = 1500, accel = 3 * 1500 / (halfTime * fraction) = 9000
+    TEST_ASSERT_EQUAL_INT(9000, p.nextTarget(0).acceleration);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Speed limits
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Time of a trapezoidal move in seconds
+static float moveSeconds(int distance, int speed, int acceleration) {
+    float d = fabsf(float(distance));
+    float v = float(speed);
+    float a = float(acceleration);
+    if (d <= v * v / a) {
+        return 2.0f * sqrtf(d / a);
+    }
+    return d / v + v / a;
+}
+
+void test_limits_unknown_leave_moves_untouched() {
+    SimpleStroke p("Simple Stroke");
+    setupPattern(p, 1000, 5000, 0.1, 0);
+    // halfTime = 0.05 → speed = 30000, accel = 1800000, clipped by the engine
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_INT_WITHIN(1, 30000, m.speed);
+    TEST_ASSERT_INT_WITHIN(100, 1800000, m.acceleration);
+}
+
+void test_limits_stretch_simple_stroke() {
+    SimpleStroke p("Simple Stroke");
+    p.setSpeedLimit(20000, 1000000, 20);
+    setupPattern(p, 1000, 5000, 0.1, 0);
+    // 50 ms asked for, 1000 / 20000 + 20000 / 1000000 = 70 ms possible
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_TRUE(m.speed <= 20000);
+    TEST_ASSERT_TRUE(m.acceleration <= 1000000);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 0.070f,
+                             moveSeconds(1000, m.speed, m.acceleration));
+}
+
+void test_limits_reshape_move_in_time() {
+    SimpleStroke p("Simple Stroke");
+    p.setSpeedLimit(12000, 1000000, 20);
+    setupPattern(p, 1000, 5000, 0.2, 0);
+    // Asks for 15000 steps/s in 100 ms. Shorter ramps make it with 12000.
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_EQUAL_INT(12000, m.speed);
+    TEST_ASSERT_TRUE(m.acceleration <= 1000000);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 0.100f,
+                             moveSeconds(1000, m.speed, m.acceleration));
+}
+
+void test_limits_within_reach_change_nothing() {
+    SimpleStroke free("Simple Stroke");
+    SimpleStroke limited("Simple Stroke");
+    limited.setSpeedLimit(20000, 1000000, 20);
+    setupPattern(free, 1000, 5000, 2.0, 0);
+    setupPattern(limited, 1000, 5000, 2.0, 0);
+    TEST_ASSERT_EQUAL_INT(free.nextTarget(0).speed,
+                          limited.nextTarget(0).speed);
+    TEST_ASSERT_EQUAL_INT(free.nextTarget(1).acceleration,
+                          limited.nextTarget(1).acceleration);
+}
+
+void test_limits_keep_teasing_ratio() {
+    TeasingPounding free("Teasing");
+    TeasingPounding limited("Teasing");
+    limited.setSpeedLimit(20000, 1000000, 20);
+    setupPattern(free, 1000, 5000, 0.3, 100);
+    setupPattern(limited, 1000, 5000, 0.3, 100);
+
+    motionParameter freeIn = free.nextTarget(0);
+    motionParameter freeOut = free.nextTarget(1);
+    motionParameter in = limited.nextTarget(0);
+    motionParameter out = limited.nextTarget(1);
+    TEST_ASSERT_TRUE(freeIn.speed > 20000);
+    TEST_ASSERT_TRUE(in.speed <= 20000 && out.speed <= 20000);
+    TEST_ASSERT_TRUE(in.acceleration <= 1000000);
+
+    float freeRatio = moveSeconds(1000, freeOut.speed, freeOut.acceleration) /
+                      moveSeconds(1000, freeIn.speed, freeIn.acceleration);
+    float ratio = moveSeconds(1000, out.speed, out.acceleration) /
+                  moveSeconds(1000, in.speed, in.acceleration);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * freeRatio, freeRatio, ratio);
+
+    // The fast move takes the shortest time the machine makes, no more
+    float fastest = 20000.0f / 1000000.0f + 1000.0f / 20000.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * fastest, fastest,
+                             moveSeconds(1000, in.speed, in.acceleration));
+}
+
+void test_limits_halfnhalf_scales_each_pair() {
+    HalfnHalf free("Half'n'Half");
+    HalfnHalf limited("Half'n'Half");
+    limited.setSpeedLimit(20000, 1000000, 20);
+    setupPattern(free, 2000, 5000, 1.0, 100);
+    setupPattern(limited, 2000, 5000, 1.0, 100);
+
+    // 100 ms for the fast move. Half strokes make it and keep their time.
+    for (unsigned int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL_INT(free.nextTarget(i).speed,
+                              limited.nextTarget(i).speed);
+        TEST_ASSERT_EQUAL_INT(free.nextTarget(i).acceleration,
+                              limited.nextTarget(i).acceleration);
+    }
+
+    // Full strokes need 2000 / 20000 + 20000 / 1000000 = 120 ms, the slow
+    // move of the pair slows down alike
+    motionParameter freeIn = free.nextTarget(2);
+    motionParameter freeOut = free.nextTarget(3);
+    motionParameter in = limited.nextTarget(2);
+    motionParameter out = limited.nextTarget(3);
+    TEST_ASSERT_FLOAT_WITHIN(0.0012f, 0.120f,
+                             moveSeconds(2000, in.speed, in.acceleration));
+    float freeRatio = moveSeconds(2000, freeOut.speed, freeOut.acceleration) /
+                      moveSeconds(2000, freeIn.speed, freeIn.acceleration);
+    float ratio = moveSeconds(2000, out.speed, out.acceleration) /
+                  moveSeconds(2000, in.speed, in.acceleration);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f * freeRatio, freeRatio, ratio);
+}
+
+void test_limits_insist_fraction_fits() {
+    Insist p("Insist");
+    setupPattern(p, 1000, 5000, 0.2, 80);
+    p.setSpeedLimit(20000, 1000000, 20);
+    // The 200 step fraction would need 15000 steps/s at 2250000 steps/s²
+    motionParameter m = p.nextTarget(0);
+    TEST_ASSERT_TRUE(m.speed <= 20000);
+    TEST_ASSERT_TRUE(m.acceleration <= 1000000);
+}
+
 // ─── Runner ──────────────────────────────────────────────────────────────
 
 int main() {
@@ -815,6 +965,7 @@ int main() {
     RUN_TEST(test_halfnhalf_first_stroke_is_half);
     RUN_TEST(test_halfnhalf_half_alternates_on_odd);
     RUN_TEST(test_halfnhalf_full_cycle_positions);
+    RUN_TEST(test_halfnhalf_repeated_query_gives_same_move);
     RUN_TEST(test_halfnhalf_half_speed_is_lower);
     RUN_TEST(test_halfnhalf_positive_sensation_in_faster);
     RUN_TEST(test_halfnhalf_negative_sensation_out_faster);
@@ -859,6 +1010,16 @@ int main() {
     RUN_TEST(test_insist_negative_max_sensation_tiny_stroke);
     RUN_TEST(test_insist_skip_is_false);
     RUN_TEST(test_insist_name);
+    RUN_TEST(test_insist_acceleration_uses_current_speed);
+
+    // Speed limits
+    RUN_TEST(test_limits_unknown_leave_moves_untouched);
+    RUN_TEST(test_limits_stretch_simple_stroke);
+    RUN_TEST(test_limits_reshape_move_in_time);
+    RUN_TEST(test_limits_within_reach_change_nothing);
+    RUN_TEST(test_limits_keep_teasing_ratio);
+    RUN_TEST(test_limits_halfnhalf_scales_each_pair);
+    RUN_TEST(test_limits_insist_fraction_fits);
 
     return UNITY_END();
 }
@@ -0,0 +1,408 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ RING BUFFER — UNIT & STRESS TESTS                                      │
+// │                                                                        │
+// │ Tests for lib/OSSMLogic/src/ring_buffer.h, the queue handing stream    │
+// │ targets from the BLE callbacks to the streaming task:                  │
+// │   push()    — Constant time, the overflow policy decides when full     │
+// │   pop()     — Oldest first, one record or a batch                      │
+// │   peek()    — The same without taking them                             │
+// │   Counters  — Depth, overflows and high water                          │
+// │                                                                        │
+// │ The stress tests push from three producer threads (FTS callback,       │
+// │ command dispatch, a third for good measure) while one consumer drains, │
+// │ with each overflow policy. Every record must arrive once, in order per │
+// │ producer and untorn, or be counted as an overflow.                     │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace fakeit;
+
+#include "ring_buffer.h"
+
+using ring_buffer::Overflow;
+using ring_buffer::Ring;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Same size as a stream target
+struct Record {
+    uint8_t producer;
+    uint16_t inTime;
+    int32_t index;
+    int64_t check;
+    int32_t spare;
+};
+
+static Record makeRecord(int producer, int32_t index) {
+    Record r;
+    r.producer = uint8_t(producer);
+    r.inTime = uint16_t(index * 7);
+    r.index = index;
+    r.check = int64_t(index) * 1000003 + producer;
+    r.spare = -index;
+    return r;
+}
+
+static bool isConsistent(const Record &r) {
+    Record expected = makeRecord(r.producer, r.index);
+    return expected.inTime == r.inTime && expected.check == r.check &&
+           expected.spare == r.spare;
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Single thread
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_ring_buffer_starts_empty() {
+    Ring<Record, 8> ring;
+    Record r = makeRecord(0, 42);
+    TEST_ASSERT_FALSE(ring.pop(r));
+    TEST_ASSERT_EQUAL(42, r.index);
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_EQUAL(8, ring.capacity());
+    TEST_ASSERT_EQUAL(Overflow::DropNewest, ring.overflow());
+}
+
+void test_ring_buffer_pops_oldest_first() {
+    Ring<Record, 8> ring;
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_EQUAL(5, ring.size());
+    for (int i = 0; i < 5; i++) {
+        Record r;
+        TEST_ASSERT_TRUE(ring.pop(r));
+        TEST_ASSERT_EQUAL(i, r.index);
+        TEST_ASSERT_TRUE(isConsistent(r));
+    }
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_ring_buffer_drop_newest_keeps_queue() {
+    Ring<Record, 4> ring(Overflow::DropNewest);
+    for (int i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL(i < 4, ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_EQUAL(2, ring.overflows());
+    TEST_ASSERT_EQUAL(4, ring.pushed());
+    TEST_ASSERT_EQUAL(4, ring.highWater());
+
+    Record r;
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.pop(r));
+        TEST_ASSERT_EQUAL(i, r.index);
+    }
+    TEST_ASSERT_FALSE(ring.pop(r));
+}
+
+void test_ring_buffer_drop_oldest_keeps_latest() {
+    Ring<Record, 4> ring(Overflow::DropOldest);
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_EQUAL(3, ring.overflows());
+    TEST_ASSERT_EQUAL(7, ring.pushed());
+    TEST_ASSERT_EQUAL(4, ring.size());
+
+    Record r;
+    for (int i = 3; i < 7; i++) {
+        TEST_ASSERT_TRUE(ring.pop(r));
+        TEST_ASSERT_EQUAL(i, r.index);
+    }
+    TEST_ASSERT_FALSE(ring.pop(r));
+}
+
+void test_ring_buffer_coalesce_replaces_newest() {
+    Ring<Record, 4> ring(Overflow::Coalesce);
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_EQUAL(3, ring.overflows());
+    TEST_ASSERT_EQUAL(4, ring.pushed());
+    TEST_ASSERT_EQUAL(4, ring.size());
+
+    // The oldest are played as queued, the last one is the latest
+    const int32_t expected[] = {0, 1, 2, 6};
+    Record r;
+    for (int32_t index : expected) {
+        TEST_ASSERT_TRUE(ring.pop(r));
+        TEST_ASSERT_EQUAL(index, r.index);
+        TEST_ASSERT_TRUE(isConsistent(r));
+    }
+}
+
+void test_ring_buffer_policy_changes_on_the_fly() {
+    Ring<Record, 2> ring;
+    ring.push(makeRecord(1, 0));
+    ring.push(makeRecord(1, 1));
+    TEST_ASSERT_FALSE(ring.push(makeRecord(1, 2)));
+    ring.setOverflow(Overflow::DropOldest);
+    TEST_ASSERT_TRUE(ring.push(makeRecord(1, 3)));
+
+    Record r;
+    TEST_ASSERT_TRUE(ring.pop(r));
+    TEST_ASSERT_EQUAL(1, r.index);
+    TEST_ASSERT_TRUE(ring.pop(r));
+    TEST_ASSERT_EQUAL(3, r.index);
+    TEST_ASSERT_EQUAL(2, ring.overflows());
+}
+
+void test_ring_buffer_clear() {
+    Ring<Record, 8> ring;
+    for (int i = 0; i < 6; i++) {
+        ring.push(makeRecord(1, i));
+    }
+    ring.clear();
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_TRUE(ring.push(makeRecord(1, 9)));
+    Record r;
+    TEST_ASSERT_TRUE(ring.pop(r));
+    TEST_ASSERT_EQUAL(9, r.index);
+
+    // Counters live on
+    TEST_ASSERT_EQUAL(7, ring.pushed());
+    TEST_ASSERT_EQUAL(6, ring.highWater());
+}
+
+void test_ring_buffer_peek_sees_coalesced_record() {
+    Ring<Record, 4> ring(Overflow::Coalesce);
+    for (int i = 0; i < 5; i++) {
+        ring.push(makeRecord(1, i));
+    }
+    Record batch[4];
+    TEST_ASSERT_EQUAL(4, ring.peek(batch, 4));
+    TEST_ASSERT_EQUAL(0, batch[0].index);
+    TEST_ASSERT_EQUAL(4, batch[3].index);
+    TEST_ASSERT_EQUAL(4, ring.size());
+
+    TEST_ASSERT_EQUAL(3, ring.pop(batch, 3));
+    TEST_ASSERT_EQUAL(2, batch[2].index);
+    Record r;
+    TEST_ASSERT_TRUE(ring.peek(r));
+    TEST_ASSERT_EQUAL(4, r.index);
+    TEST_ASSERT_EQUAL(1, ring.pop(batch, 4));
+    TEST_ASSERT_FALSE(ring.peek(r));
+}
+
+void test_ring_buffer_wraps_around() {
+    Ring<Record, 4> ring;
+    int32_t next = 0;
+    for (int round = 0; round < 1000; round++) {
+        int count = 1 + round % 4;
+        for (int i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(ring.push(makeRecord(1, next + i)));
+        }
+        Record r;
+        for (int i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(ring.pop(r));
+            TEST_ASSERT_EQUAL(next + i, r.index);
+        }
+        next += count;
+    }
+    TEST_ASSERT_EQUAL(next, ring.pushed());
+    TEST_ASSERT_EQUAL(0, ring.overflows());
+    TEST_ASSERT_EQUAL(4, ring.highWater());
+}
+
+void test_ring_buffer_high_water_tracks_fill_level() {
+    Ring<Record, 32> ring;
+    Record r;
+    for (int i = 0; i < 10; i++) {
+        ring.push(makeRecord(1, i));
+        ring.push(makeRecord(1, i));
+        ring.pop(r);
+    }
+    TEST_ASSERT_EQUAL(11, ring.highWater());
+    TEST_ASSERT_EQUAL(10, ring.size());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stress
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const int kProducers = 3;
+static const int kRecordsPerProducer = 100000;
+
+// Runs the producers against one consumer. Every record must arrive once,
+// in order per producer and untorn, or be counted as an overflow.
+static void stress(Overflow overflow, const char *name) {
+    Ring<Record, 16> ring(overflow);
+    std::atomic<int> producersDone{0};
+    std::atomic<uint32_t> lost{0};
+
+    std::vector<int32_t> lastIndex(kProducers, -1);
+    long received = 0;
+    long outOfOrder = 0;
+    long torn = 0;
+
+    // Streaming task: slower than the producers, so the ring overflows and
+    // the policy has to work while records are taken
+    std::thread consumer([&]() {
+        Record r;
+        while (true) {
+            bool done = producersDone.load() == kProducers;
+            if (!ring.pop(r)) {
+                if (done && ring.empty()) break;
+                std::this_thread::yield();
+                continue;
+            }
+            if (!isConsistent(r)) torn++;
+            if (r.index <= lastIndex[r.producer]) outOfOrder++;
+            lastIndex[r.producer] = r.index;
+            received++;
+            if ((received & 3) == 0) std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p]() {
+            for (int i = 0; i < kRecordsPerProducer; i++) {
+                if (!ring.push(makeRecord(p, i))) lost++;
+                if ((i & 7) == 0) std::this_thread::yield();
+            }
+            producersDone++;
+        });
+    }
+    for (auto &t : producers) t.join();
+    consumer.join();
+
+    const long attempts = long(kProducers) * kRecordsPerProducer;
+    printf("  %-11s %8ld pushed, %8ld received, %8u overflows, "
+           "high water %u of %u\n",
+           name, attempts, received, ring.overflows(), ring.highWater(),
+           unsigned(ring.capacity()));
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    TEST_ASSERT_GREATER_THAN(0, long(ring.overflows()));
+    TEST_ASSERT_EQUAL(attempts, received + long(ring.overflows()));
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_LESS_OR_EQUAL(16, ring.highWater());
+    if (overflow == Overflow::DropNewest) {
+        TEST_ASSERT_EQUAL(lost.load(), ring.overflows());
+        TEST_ASSERT_EQUAL(received, long(ring.pushed()));
+    }
+}
+
+void test_ring_buffer_stress_drop_newest() {
+    printf("\n");
+    stress(Overflow::DropNewest, "drop newest");
+}
+
+void test_ring_buffer_stress_drop_oldest() {
+    stress(Overflow::DropOldest, "drop oldest");
+}
+
+void test_ring_buffer_stress_coalesce() {
+    stress(Overflow::Coalesce, "coalesce");
+}
+
+void test_ring_buffer_stalled_consumer_never_blocks_producer() {
+    // The streaming task is stuck. The BLE callbacks keep going and only
+    // lose records.
+    Ring<Record, 32> ring(Overflow::DropOldest);
+    std::mutex stalled;
+    stalled.lock();
+    std::thread consumer([&]() {
+        std::lock_guard<std::mutex> wait(stalled);
+        Record r;
+        while (ring.pop(r)) {
+        }
+    });
+
+    for (int i = 0; i < 10000; i++) {
+        ring.push(makeRecord(0, i));
+    }
+    stalled.unlock();
+    consumer.join();
+
+    TEST_ASSERT_EQUAL(10000, ring.pushed());
+    TEST_ASSERT_EQUAL(10000 - 32, ring.overflows());
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_ring_buffer_push_pop_cost() {
+    const int kRounds = 1000000;
+    Ring<Record, 64> ring;
+    Record r;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        ring.push(makeRecord(0, i));
+        ring.pop(r);
+    }
+    double ringNs = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    kRounds;
+
+    // What the std::queue would need to be safe, and it allocates as well
+    std::mutex mutex;
+    std::queue<Record> queue;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push(makeRecord(0, i));
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        r = queue.front();
+        queue.pop();
+    }
+    double queueNs = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() /
+                     kRounds;
+
+    printf("  push + pop: ring %.1f ns, mutex + std::queue %.1f ns\n", ringNs,
+           queueNs);
+
+    TEST_ASSERT_EQUAL(kRounds, ring.pushed());
+    TEST_ASSERT_EQUAL(0, ring.overflows());
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_ring_buffer_starts_empty);
+    RUN_TEST(test_ring_buffer_pops_oldest_first);
+    RUN_TEST(test_ring_buffer_drop_newest_keeps_queue);
+    RUN_TEST(test_ring_buffer_drop_oldest_keeps_latest);
+    RUN_TEST(test_ring_buffer_coalesce_replaces_newest);
+    RUN_TEST(test_ring_buffer_policy_changes_on_the_fly);
+    RUN_TEST(test_ring_buffer_clear);
+    RUN_TEST(test_ring_buffer_peek_sees_coalesced_record);
+    RUN_TEST(test_ring_buffer_wraps_around);
+    RUN_TEST(test_ring_buffer_high_water_tracks_fill_level);
+
+    RUN_TEST(test_ring_buffer_stress_drop_newest);
+    RUN_TEST(test_ring_buffer_stress_drop_oldest);
+    RUN_TEST(test_ring_buffer_stress_coalesce);
+    RUN_TEST(test_ring_buffer_stalled_consumer_never_blocks_producer);
+
+    RUN_TEST(test_ring_buffer_push_pop_cost);
+
+    return UNITY_END();
+}
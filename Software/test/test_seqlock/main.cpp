@@ -0,0 +1,291 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ SEQLOCK — UNIT & STRESS TESTS                                          │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/SeqLock.h, the handoff of the stroke    │
+// │ settings from setSpeed()/setDepth()/setStroke()/setSensation() to the  │
+// │ stroking task:                                                         │
+// │   read()      — Consistent snapshot plus its sequence number           │
+// │   write()     — Read-modify-write published as a whole                 │
+// │                                                                        │
+// │ The stress test hammers write() from a setter thread while a second    │
+// │ thread runs a stroking-like loop. Every cycle must run with a          │
+// │ consistent snapshot and no torn reads. The same load against the old   │
+// │ mutex + try-take scheme, which skips cycles, is printed for reference. │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+using namespace fakeit;
+
+#include "SeqLock.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Same shape as StrokeEngine's strokeSettings
+struct Settings {
+    float speedPercent;
+    float timeOfStroke;
+    int depth;
+    int stroke;
+    float sensation;
+    uint32_t applyRequests;
+};
+
+// Derives every other field from stroke and speed, like a setter would
+static void setStroke(Settings &s, int stroke, float speedPercent) {
+    s.stroke = stroke;
+    s.speedPercent = speedPercent;
+    s.timeOfStroke = 3.0f * float(stroke) / (speedPercent * 200.0f);
+    s.depth = 2 * stroke + 7;
+    s.sensation = -float(stroke % 100);
+    s.applyRequests++;
+}
+
+static bool isConsistent(const Settings &s) {
+    Settings expected = s;
+    expected.applyRequests--;
+    setStroke(expected, s.stroke, s.speedPercent);
+    return memcmp(&expected, &s, sizeof(Settings)) == 0;
+}
+
+static Settings initialSettings() {
+    Settings s = {};
+    setStroke(s, 1000, 50.0f);
+    s.applyRequests = 0;
+    return s;
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Single thread
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_seqlock_reads_initial_value() {
+    SeqLock<Settings> lock(initialSettings());
+    Settings s;
+    TEST_ASSERT_EQUAL(0, lock.read(s));
+    TEST_ASSERT_EQUAL(1000, s.stroke);
+    TEST_ASSERT_EQUAL(2007, s.depth);
+    TEST_ASSERT_TRUE(isConsistent(s));
+}
+
+void test_seqlock_write_is_visible_to_next_read() {
+    SeqLock<Settings> lock(initialSettings());
+    lock.write([](Settings &s) { setStroke(s, 1500, 80.0f); });
+    Settings s = lock.read();
+    TEST_ASSERT_EQUAL(1500, s.stroke);
+    TEST_ASSERT_EQUAL(3007, s.depth);
+    TEST_ASSERT_EQUAL(1, s.applyRequests);
+    TEST_ASSERT_TRUE(isConsistent(s));
+}
+
+void test_seqlock_write_modifies_latest_value() {
+    SeqLock<Settings> lock(initialSettings());
+    lock.write([](Settings &s) { s.depth = 1234; });
+    lock.write([](Settings &s) { s.sensation = 42.0f; });
+    Settings s = lock.read();
+    TEST_ASSERT_EQUAL(1234, s.depth);
+    TEST_ASSERT_EQUAL(42, int(s.sensation));
+    TEST_ASSERT_EQUAL(1000, s.stroke);
+}
+
+void test_seqlock_sequence_changes_with_every_write() {
+    SeqLock<Settings> lock(initialSettings());
+    uint32_t first = lock.sequence();
+    lock.write([](Settings &s) {});
+    uint32_t second = lock.sequence();
+    lock.write([](Settings &s) {});
+    TEST_ASSERT_TRUE(first != second);
+    TEST_ASSERT_TRUE(second != lock.sequence());
+    TEST_ASSERT_EQUAL(0, lock.sequence() & 1);
+
+    Settings s;
+    TEST_ASSERT_EQUAL(lock.sequence(), lock.read(s));
+}
+
+void test_seqlock_read_without_writer_never_retries() {
+    SeqLock<Settings> lock(initialSettings());
+    for (int i = 0; i < 1000; i++) {
+        lock.read();
+    }
+    TEST_ASSERT_EQUAL(0, lock.retries());
+}
+
+void test_seqlock_handles_odd_sized_data() {
+    struct Odd {
+        uint8_t a;
+        uint8_t b;
+        uint8_t c;
+    };
+    SeqLock<Odd> lock({1, 2, 3});
+    lock.write([](Odd &o) { o.c = 9; });
+    Odd o = lock.read();
+    TEST_ASSERT_EQUAL(1, o.a);
+    TEST_ASSERT_EQUAL(2, o.b);
+    TEST_ASSERT_EQUAL(9, o.c);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stress
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const int kWrites = 200000;
+
+struct LoopResult {
+    long cycles = 0;
+    long skipped = 0;  // cycles that ran without settings, mutex only
+    long stale = 0;
+    long torn = 0;
+    long changes = 0;
+    bool sequenceMonotonic = true;
+};
+
+// Setter task hammering different values. A write every microsecond is
+// still three orders of magnitude above what BLE or the UI produce; without
+// any gap no reader would ever see a completed write.
+static void hammer(SeqLock<Settings> &lock, int writes, int seed) {
+    for (int i = 0; i < writes; i++) {
+        int stroke = 100 + (i * 7 + seed * 1000) % 3000;
+        float speed = 1.0f + float((i + seed) % 100);
+        lock.write([&](Settings &s) { setStroke(s, stroke, speed); });
+
+        auto until = std::chrono::steady_clock::now() +
+                     std::chrono::microseconds(1);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    }
+}
+
+void test_seqlock_stress_no_torn_reads() {
+    SeqLock<Settings> lock(initialSettings());
+    std::atomic<bool> setterDone{false};
+    LoopResult result;
+
+    // Stroking task: every cycle runs with a consistent snapshot. If a write
+    // is in progress it keeps the previous one and never waits, so unlike
+    // with the mutex there is no cycle to skip.
+    std::thread stroking([&]() {
+        Settings current = lock.read();
+        uint32_t lastSequence = 0;
+        while (!setterDone.load() || result.cycles < 1000) {
+            Settings s;
+            uint32_t sequence;
+            if (lock.tryRead(s, sequence)) {
+                if (sequence < lastSequence) result.sequenceMonotonic = false;
+                if (sequence != lastSequence) result.changes++;
+                lastSequence = sequence;
+                current = s;
+            } else {
+                result.stale++;
+            }
+            result.cycles++;
+            if (!isConsistent(current)) result.torn++;
+        }
+    });
+
+    std::thread setter([&]() {
+        hammer(lock, kWrites, 0);
+        setterDone = true;
+    });
+    setter.join();
+    stroking.join();
+
+    Settings last = lock.read();
+    printf("\n  seqlock: %ld cycles, %ld kept previous, %ld changes seen\n",
+           result.cycles, result.stale, result.changes);
+
+    TEST_ASSERT_EQUAL(0, result.torn);
+    TEST_ASSERT_TRUE(result.sequenceMonotonic);
+    TEST_ASSERT_GREATER_THAN(1, result.changes);
+    TEST_ASSERT_EQUAL(kWrites, last.applyRequests);
+    TEST_ASSERT_TRUE(isConsistent(last));
+}
+
+void test_seqlock_concurrent_writers_lose_no_update() {
+    SeqLock<Settings> lock(initialSettings());
+    std::thread a([&]() { hammer(lock, kWrites / 4, 1); });
+    std::thread b([&]() { hammer(lock, kWrites / 4, 2); });
+    a.join();
+    b.join();
+
+    Settings last = lock.read();
+    TEST_ASSERT_EQUAL(kWrites / 2, last.applyRequests);
+    TEST_ASSERT_TRUE(isConsistent(last));
+}
+
+void test_seqlock_stress_mutex_reference() {
+    // The previous handoff: the setter holds a mutex, the stroking task tries
+    // to take it without waiting and skips the cycle when it can't
+    Settings shared = initialSettings();
+    std::mutex mutex;
+    std::atomic<bool> setterDone{false};
+    LoopResult result;
+
+    std::thread stroking([&]() {
+        while (!setterDone.load() || result.cycles < 1000) {
+            result.cycles++;
+            if (!mutex.try_lock()) {
+                result.skipped++;
+                continue;
+            }
+            if (!isConsistent(shared)) result.torn++;
+            mutex.unlock();
+        }
+    });
+
+    std::thread setter([&]() {
+        for (int i = 0; i < kWrites; i++) {
+            int stroke = 100 + (i * 7) % 3000;
+            float speed = 1.0f + float(i % 100);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                setStroke(shared, stroke, speed);
+            }
+
+            auto until = std::chrono::steady_clock::now() +
+                         std::chrono::microseconds(1);
+            while (std::chrono::steady_clock::now() < until) {
+            }
+        }
+        setterDone = true;
+    });
+    setter.join();
+    stroking.join();
+
+    printf("  mutex:   %ld cycles, %ld skipped (%.1f%%)\n", result.cycles,
+           result.skipped, 100.0 * result.skipped / result.cycles);
+
+    TEST_ASSERT_EQUAL(0, result.torn);
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_seqlock_reads_initial_value);
+    RUN_TEST(test_seqlock_write_is_visible_to_next_read);
+    RUN_TEST(test_seqlock_write_modifies_latest_value);
+    RUN_TEST(test_seqlock_sequence_changes_with_every_write);
+    RUN_TEST(test_seqlock_read_without_writer_never_retries);
+    RUN_TEST(test_seqlock_handles_odd_sized_data);
+
+    RUN_TEST(test_seqlock_stress_no_torn_reads);
+    RUN_TEST(test_seqlock_concurrent_writers_lose_no_update);
+    RUN_TEST(test_seqlock_stress_mutex_reference);
+
+    return UNITY_END();
+}
@@ -0,0 +1,2119 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ STROKE ENGINE SIMULATION — HOST BENCHMARK                              │
+// │                                                                        │
+// │ Runs the real lib/StrokeEngine against the virtual-time FreeRTOS and   │
+// │ FastAccelStepper from sim/StrokeEngineSim. Minutes of stroking take a  │
+// │ fraction of a second and every run is deterministic.                   │
+// │                                                                        │
+// │ For every built-in pattern the benchmark reports:                      │
+// │   strokes/min — completed in+out strokes                               │
+// │   dead        — standstill between two moves (reversal dead time)      │
+// │   period sd   — spread of the in+out stroke period                     │
+// │   clip        — share of moves clipped to the speed/accel limits       │
+// │                                                                        │
+// │ Run with: pio test -e sim                                              │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace fakeit;
+
+#include "FastAccelStepper.h"
+#include "PatternPool.h"
+#include "StrokeEngine.h"
+#include "StrokeMetrics.h"
+#include "pattern.h"
+
+// ─── Machine ──────────────────────────────────────────────────────────────
+
+// Same limits as Config::Driver with a typical 200 mm rail
+static motorProperties motor = {
+    .maxSpeed = 1000.0f,
+    .maxAcceleration = 50000.0f,
+    .stepsPerMillimeter = 20.0f,
+    .invertDirection = true,
+    .enableActiveLow = true,
+    .stepPin = 14,
+    .directionPin = 27,
+    .enablePin = 26,
+};
+
+static machineGeometry geometry = {.physicalTravel = 200.0f,
+                                   .keepoutBoundary = 6.0f};
+
+static const uint64_t kRunMicros = 20ULL * 1000 * 1000;
+
+// Stroke lengths each pattern is benchmarked at. Move times that happen to
+// be multiples of the polling period hide the dead time, so several lengths
+// are averaged.
+static const float kStrokes[] = {60.0f, 85.0f, 110.0f, 135.0f, 160.0f};
+static const int kStrokeCount = sizeof(kStrokes) / sizeof(kStrokes[0]);
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static long realMap(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// Telemetry of the moves, read from the engine like the publish task does
+static int telemetryMoves = 0;
+static int telemetryClipped = 0;
+
+static void countTelemetry(StrokeEngine *engine) {
+    telemetryRecord records[8];
+    size_t count;
+    while ((count = engine->readTelemetry(records, 8)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            telemetryMoves++;
+            if (records[i].clipping != CLIP_NONE) telemetryClipped++;
+        }
+    }
+}
+
+// Runs the simulation, reading the telemetry every 100 ms
+static void runWithTelemetry(StrokeEngine *engine, uint64_t micros) {
+    for (uint64_t t = 0; t < micros; t += 100000) {
+        sim::runFor(micros - t < 100000 ? micros - t : 100000);
+        countTelemetry(engine);
+    }
+}
+
+struct Rig {
+    FastAccelStepperEngine stepperEngine;
+    FastAccelStepper *servo;
+    StrokeEngine *engine;
+    motorProperties machine;
+
+    Rig(const motorProperties &properties = motor, bool homed = true)
+        : machine(properties) {
+        stepperEngine.init();
+        servo = stepperEngine.stepperConnectToPin(machine.stepPin);
+        engine = new StrokeEngine();
+        engine->begin(&geometry, &machine, servo);
+        if (!homed) return;
+        engine->thisIsHome();
+
+        // Park at the back like the app does after homing. This also leaves
+        // the stepper with the homing acceleration, as on the device.
+        engine->moveToMin();
+        while (servo->isRunning()) {
+            sim::runFor(10000);
+        }
+        servo->clearEvents();
+        servo->clearStats();
+    }
+
+    ~Rig() {
+        // Tasks still reference the engine, so tear them down first
+        sim::reset();
+        delete engine;
+        delete servo;
+    }
+};
+
+static const int kPatternCount = PatternPool::count;
+
+// Keyframes plays a file, without one there is nothing to measure
+static bool benchmarked(int pattern) {
+    return pattern != PatternRegistry::indexOf<KeyframePattern>();
+}
+
+struct BenchResult {
+    size_t moves = 0;
+    size_t reversals = 0;
+    double deadTimeSumMs = 0.0;
+    float deadTimeMaxMs = 0.0f;
+    double strokesPerMinuteSum = 0.0;
+    double periodSpreadSum = 0.0;
+    int runs = 0;
+    int telemetryMoves = 0;
+    int telemetryClipped = 0;
+    float peakAcceleration = 0.0f;   // mm/s²
+    float peakJerk = 0.0f;           // mm/s³
+    float peakStartStopJerk = 0.0f;  // mm/s³
+
+    float deadTimeMeanMs() const {
+        return reversals > 0 ? float(deadTimeSumMs / reversals) : 0.0f;
+    }
+    float strokesPerMinute() const {
+        return runs > 0 ? float(strokesPerMinuteSum / runs) : 0.0f;
+    }
+    //! Standard deviation of the stroke period relative to its mean, in %
+    float periodSpreadPercent() const {
+        return runs > 0 ? float(periodSpreadSum / runs) : 0.0f;
+    }
+    float clippingPercent() const {
+        return telemetryMoves > 0 ? 100.0f * telemetryClipped / telemetryMoves
+                                  : 0.0f;
+    }
+};
+
+// Stroke the given pattern for kRunMicros and add the trace to the result
+static void runPattern(BenchResult &result, int index, float stroke,
+                       float speedPercent, float sensation, uint8_t lookahead,
+                       const motorProperties &machine) {
+    Rig rig(machine);
+    rig.engine->setLookahead(lookahead);
+
+    rig.engine->setPattern(index, false);
+    rig.engine->setDepth(geometry.physicalTravel, false);
+    rig.engine->setStroke(stroke, false);
+    rig.engine->setSensation(sensation, false);
+    rig.engine->setSpeed(speedPercent, false);
+    rig.engine->startPattern();
+
+    // Skip the first strokes, they start from an arbitrary position
+    sim::runFor(2000000);
+    countTelemetry(rig.engine);
+    rig.servo->clearEvents();
+    rig.servo->clearStats();
+    telemetryMoves = 0;
+    telemetryClipped = 0;
+    runWithTelemetry(rig.engine, kRunMicros);
+
+    const sim::MotionStats &stats = rig.servo->stats();
+    const float stepsPerMM = machine.stepsPerMillimeter;
+    result.peakAcceleration =
+        fmaxf(result.peakAcceleration, stats.peakAcceleration / stepsPerMM);
+    result.peakJerk = fmaxf(result.peakJerk, stats.peakJerk / stepsPerMM);
+    result.peakStartStopJerk = fmaxf(result.peakStartStopJerk,
+                                     stats.peakStartStopJerk / stepsPerMM);
+
+    sim::StrokeMetrics metrics = sim::measureStrokes(rig.servo->events());
+    result.moves += metrics.moves;
+    result.reversals += metrics.reversals;
+    result.deadTimeSumMs += metrics.deadTimeMeanMs * metrics.reversals;
+    if (metrics.deadTimeMaxMs > result.deadTimeMaxMs) {
+        result.deadTimeMaxMs = metrics.deadTimeMaxMs;
+    }
+    result.strokesPerMinuteSum +=
+        metrics.moves / 2.0 * 60000000.0 / double(kRunMicros);
+    if (metrics.periodMeanMs > 0.0f) {
+        result.periodSpreadSum +=
+            100.0 * metrics.periodStdDevMs / metrics.periodMeanMs;
+    }
+    result.runs++;
+    result.telemetryMoves += telemetryMoves;
+    result.telemetryClipped += telemetryClipped;
+}
+
+static BenchResult benchmarkPattern(int index, float speedPercent,
+                                    float sensation, uint8_t lookahead = 0,
+                                    const motorProperties &machine = motor) {
+    BenchResult result;
+    for (int i = 0; i < kStrokeCount; i++) {
+        runPattern(result, index, kStrokes[i], speedPercent, sensation,
+                   lookahead, machine);
+    }
+    return result;
+}
+
+static void printHeader(float speedPercent, float sensation) {
+    printf("\n  speed %.0f%%, sensation %.0f, %d stroke lengths x %llu s\n",
+           speedPercent, sensation, kStrokeCount,
+           (unsigned long long)(kRunMicros / 1000000));
+    printf("  %-20s %10s %9s %9s %10s %7s\n", "pattern", "strokes/min",
+           "dead ms", "dead max", "period sd%", "clip %");
+}
+
+static void printResult(int index, const BenchResult &r) {
+    printf("  %-20s %10.1f %9.2f %9.2f %10.2f %7.1f\n",
+           PatternPool::name(index), r.strokesPerMinute(), r.deadTimeMeanMs(),
+           r.deadTimeMaxMs, r.periodSpreadPercent(), r.clippingPercent());
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysDo([]() -> unsigned long {
+        return sim::millis();
+    });
+    When(Method(ArduinoFake(), micros)).AlwaysDo([]() -> unsigned long {
+        return (unsigned long)sim::nowMicros();
+    });
+    When(Method(ArduinoFake(), map)).AlwaysDo(
+        [](long x, long in_min, long in_max, long out_min, long out_max) -> long {
+            return realMap(x, in_min, in_max, out_min, out_max);
+        });
+
+    // Serial overloads used by begin() and DEBUG_CLIPPING
+    When(OverloadedMethod(ArduinoFake(Serial), print, size_t(const String&))).AlwaysReturn(0);
+    When(OverloadedMethod(ArduinoFake(Serial), print, size_t(const char[]))).AlwaysReturn(0);
+    When(OverloadedMethod(ArduinoFake(Serial), println, size_t(const String&))).AlwaysReturn(0);
+    When(OverloadedMethod(ArduinoFake(Serial), println, size_t(const char[]))).AlwaysReturn(0);
+}
+
+void tearDown(void) { sim::reset(); }
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Virtual-time scheduler
+// ═══════════════════════════════════════════════════════════════════════════
+
+static int ticks = 0;
+
+static void tickTask(void *) {
+    while (1) {
+        ticks++;
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+    }
+}
+
+void test_sim_delay_advances_virtual_time() {
+    ticks = 0;
+    TaskHandle_t handle = NULL;
+    xTaskCreatePinnedToCore(tickTask, "Tick", 1024, NULL, 5, &handle, 1);
+    sim::runFor(1000000);
+    TEST_ASSERT_EQUAL_UINT64(1000000, sim::nowMicros());
+    TEST_ASSERT_EQUAL(1000, sim::millis());
+    TEST_ASSERT_INT_WITHIN(1, 100, ticks);
+}
+
+void test_sim_suspended_task_does_not_run() {
+    ticks = 0;
+    TaskHandle_t handle = NULL;
+    xTaskCreatePinnedToCore(tickTask, "Tick", 1024, NULL, 5, &handle, 1);
+    sim::runFor(100000);
+    vTaskSuspend(handle);
+    int frozen = ticks;
+    sim::runFor(100000);
+    TEST_ASSERT_EQUAL(frozen, ticks);
+    vTaskResume(handle);
+    sim::runFor(100000);
+    TEST_ASSERT_GREATER_THAN(frozen + 5, ticks);
+}
+
+void test_sim_reset_rewinds_clock() {
+    sim::runFor(5000);
+    sim::reset();
+    TEST_ASSERT_EQUAL_UINT64(0, sim::nowMicros());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Simulated stepper
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_sim_stepper_triangular_move_time() {
+    FastAccelStepper servo;
+    servo.setSpeedInHz(1000000);
+    servo.setAcceleration(10000);
+    servo.moveTo(10000);
+    TEST_ASSERT_TRUE(servo.isRunning());
+
+    // Never reaches top speed: t = 2 * sqrt(d / a) = 2 s
+    sim::runFor(1990000);
+    TEST_ASSERT_TRUE(servo.isRunning());
+    sim::runFor(20000);
+    TEST_ASSERT_FALSE(servo.isRunning());
+    TEST_ASSERT_EQUAL(10000, servo.getCurrentPosition());
+    TEST_ASSERT_FLOAT_WITHIN(50.0f, 10000.0f, servo.stats().peakSpeed);
+}
+
+void test_sim_stepper_trapezoidal_move_respects_limits() {
+    FastAccelStepper servo;
+    servo.setSpeedInHz(2000);
+    servo.setAcceleration(4000);
+    servo.moveTo(-4000);
+
+    // 0.5 s ramp up, 1.5 s cruise, 0.5 s ramp down
+    sim::runFor(2600000);
+    TEST_ASSERT_FALSE(servo.isRunning());
+    TEST_ASSERT_EQUAL(-4000, servo.getCurrentPosition());
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 2000.0f, servo.stats().peakSpeed);
+    TEST_ASSERT_TRUE(servo.stats().peakAcceleration <= 4000.0f * 1.06f);
+
+    const std::vector<sim::MotionEvent> &events = servo.events();
+    TEST_ASSERT_EQUAL(2, events.size());
+    TEST_ASSERT_INT_WITHIN(20000, 2500000,
+                           int(events[1].micros - events[0].micros));
+}
+
+void test_sim_stepper_linear_acceleration_limits_start_stop_jerk() {
+    FastAccelStepper servo;
+    servo.setSpeedInHz(2000);
+    servo.setAcceleration(4000);
+    // a³ / (6 j²) steps for j = 20000 steps/s³
+    servo.setLinearAcceleration(27);
+    servo.moveTo(-4000);
+
+    sim::runFor(3000000);
+    TEST_ASSERT_FALSE(servo.isRunning());
+    TEST_ASSERT_EQUAL(-4000, servo.getCurrentPosition());
+    TEST_ASSERT_TRUE(servo.stats().peakAcceleration <= 4000.0f * 1.06f);
+
+    // Starts and stops with the jerk limit instead of a step in acceleration
+    const float jerk = 19876.0f;
+    TEST_ASSERT_GREATER_THAN(0.8f * jerk, servo.stats().peakStartStopJerk);
+    TEST_ASSERT_LESS_THAN(1.1f * jerk, servo.stats().peakStartStopJerk);
+
+    // Each of the two ramps takes a / 2j longer than the trapezoid
+    const std::vector<sim::MotionEvent> &events = servo.events();
+    TEST_ASSERT_EQUAL(2, events.size());
+    TEST_ASSERT_INT_WITHIN(20000, 2500000 + int(1e6f * 4000.0f / jerk),
+                           int(events[1].micros - events[0].micros));
+}
+
+void test_sim_stepper_retarget_while_moving_reverses() {
+    FastAccelStepper servo;
+    servo.setSpeedInHz(5000);
+    servo.setAcceleration(10000);
+    servo.moveTo(5000);
+    sim::runFor(500000);
+    TEST_ASSERT_GREATER_THAN(0, servo.getCurrentPosition());
+
+    servo.moveTo(0);
+    sim::runFor(3000000);
+    TEST_ASSERT_FALSE(servo.isRunning());
+    TEST_ASSERT_EQUAL(0, servo.getCurrentPosition());
+    TEST_ASSERT_TRUE(servo.stats().peakAcceleration <= 10000.0f * 1.06f);
+}
+
+void test_sim_stepper_stop_move_ramps_down() {
+    FastAccelStepper servo;
+    servo.setSpeedInHz(4000);
+    servo.setAcceleration(8000);
+    servo.moveTo(100000);
+    sim::runFor(1000000);
+    servo.stopMove();
+
+    // Braking from 4000 steps/s at 8000 steps/s² takes 0.5 s and 1000 steps
+    int32_t at = servo.getCurrentPosition();
+    while (servo.isRunning()) {
+    }
+    TEST_ASSERT_INT_WITHIN(2, at + 1000, servo.getCurrentPosition());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// StrokeEngine on the simulator
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_sim_engine_strokes_between_depth_and_stroke() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(50.0f, false);
+    TEST_ASSERT_TRUE(rig.engine->startPattern());
+    sim::runFor(5000000);
+
+    int32_t lowest = INT32_MAX;
+    int32_t highest = INT32_MIN;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type != sim::MotionEvent::STOP) continue;
+        if (event.position < lowest) lowest = event.position;
+        if (event.position > highest) highest = event.position;
+    }
+    TEST_ASSERT_EQUAL(150 * 20, highest);
+    TEST_ASSERT_EQUAL((150 - 80) * 20, lowest);
+}
+
+void test_sim_engine_stop_motion_comes_to_rest() {
+    Rig rig;
+    rig.engine->setSpeed(80.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1234000);
+
+    rig.engine->stopMotion();
+    TEST_ASSERT_EQUAL(READY, rig.engine->getState());
+    TEST_ASSERT_FALSE(rig.servo->isRunning());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Jerk limit
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Jerk limit used by the tests and the benchmark, in mm/s³
+static const float kJerk = 5000000.0f;
+
+static motorProperties withJerk(float maxAcceleration, float maxJerk) {
+    motorProperties machine = motor;
+    machine.maxAcceleration = maxAcceleration;
+    machine.maxJerk = maxJerk;
+    return machine;
+}
+
+// Exposes the motion profile to drive single moves
+class ProfileProbe : public StrokeEngine {
+  public:
+    using StrokeEngine::_applyMotionProfile;
+};
+
+void test_sim_engine_jerk_limit_shapes_start_and_stop() {
+    Rig rig(withJerk(motor.maxAcceleration, kJerk));
+    TEST_ASSERT_EQUAL(int(kJerk), int(rig.engine->getMaxJerk()));
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1000000);
+    rig.servo->clearEvents();
+    rig.servo->clearStats();
+    sim::runFor(5000000);
+
+    // Still lands on depth and stroke
+    TEST_ASSERT_GREATER_THAN(10, rig.servo->events().size());
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type != sim::MotionEvent::STOP) continue;
+        TEST_ASSERT_TRUE(event.position == 150 * 20 ||
+                         event.position == (150 - 80) * 20);
+    }
+    TEST_ASSERT_LESS_THAN(1.1f * kJerk * 20.0f,
+                          rig.servo->stats().peakStartStopJerk);
+}
+
+void test_sim_engine_pattern_jerk_is_capped_by_machine() {
+    FastAccelStepperEngine stepperEngine;
+    FastAccelStepper *servo = stepperEngine.stepperConnectToPin(motor.stepPin);
+    motorProperties machine = withJerk(motor.maxAcceleration, kJerk);
+    ProfileProbe *engine = new ProfileProbe();
+    engine->begin(&geometry, &machine, servo);
+    engine->thisIsHome();
+    servo->setCurrentPosition(0);
+
+    // A pattern may ask for a softer jerk
+    const int softJerk = int(kJerk * 20.0f / 4.0f);
+    motionParameter soft = {2000, 20000, 400000, false, softJerk};
+    countTelemetry(engine);
+    telemetryClipped = 0;
+    engine->_applyMotionProfile(&soft);
+    runWithTelemetry(engine, 1000000);
+    TEST_ASSERT_EQUAL(2000, servo->getCurrentPosition());
+    TEST_ASSERT_EQUAL(0, telemetryClipped);
+    TEST_ASSERT_LESS_THAN(1.1f * softJerk, servo->stats().peakStartStopJerk);
+    TEST_ASSERT_GREATER_THAN(0.8f * softJerk,
+                             servo->stats().peakStartStopJerk);
+
+    // ...but not for a harder one than the machine allows
+    servo->clearStats();
+    motionParameter hard = {0, 20000, 400000, false, softJerk * 16};
+    engine->_applyMotionProfile(&hard);
+    telemetryRecord record;
+    TEST_ASSERT_EQUAL(1, engine->readTelemetry(&record, 1));
+    TEST_ASSERT_EQUAL(CLIP_JERK, record.clipping);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, record.position);
+    sim::runFor(1000000);
+    TEST_ASSERT_EQUAL(0, servo->getCurrentPosition());
+    TEST_ASSERT_LESS_THAN(1.1f * kJerk * 20.0f,
+                          servo->stats().peakStartStopJerk);
+
+    sim::reset();
+    delete engine;
+    delete servo;
+}
+
+static std::vector<sim::MotionEvent> strokeEvents(int index, uint8_t lookahead,
+                                                  float sensation,
+                                                  uint64_t micros) {
+    Rig rig;
+    rig.engine->setLookahead(lookahead);
+    rig.engine->setPattern(index, false);
+    rig.engine->setStroke(120.0f, false);
+    rig.engine->setSensation(sensation, false);
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(micros);
+    return rig.servo->events();
+}
+
+static std::vector<int32_t> stopPositions(int index, uint8_t lookahead) {
+    std::vector<int32_t> positions;
+    for (const sim::MotionEvent &event :
+         strokeEvents(index, lookahead, 40.0f, 10000000)) {
+        if (event.type == sim::MotionEvent::STOP) {
+            positions.push_back(event.position);
+        }
+    }
+    return positions;
+}
+
+// Mean standstill in ms of the gaps longer than 50 ms
+static double meanPauseMs(const std::vector<sim::MotionEvent> &events) {
+    double sum = 0.0;
+    int count = 0;
+    for (size_t i = 1; i < events.size(); i++) {
+        if (events[i].type != sim::MotionEvent::START ||
+            events[i - 1].type != sim::MotionEvent::STOP) {
+            continue;
+        }
+        uint64_t gap = events[i].micros - events[i - 1].micros;
+        if (gap > 50000) {
+            sum += gap / 1000.0;
+            count++;
+        }
+    }
+    return count > 0 ? sum / count : 0.0;
+}
+
+void test_sim_lookahead_keeps_stroke_sequence() {
+    // Every pattern must visit exactly the same positions, only sooner.
+    // Stop'n'Go is asked at the reversal, as its pauses start with the query.
+    const int patterns[] = {0, 1, 2, 3, 4, 5, 6};
+    for (int index : patterns) {
+        std::vector<int32_t> polled = stopPositions(index, 0);
+        std::vector<int32_t> prepared = stopPositions(index, 2);
+        TEST_ASSERT_GREATER_OR_EQUAL(polled.size(), prepared.size());
+        for (size_t i = 0; i < polled.size(); i++) {
+            TEST_ASSERT_EQUAL(polled[i], prepared[i]);
+        }
+    }
+}
+
+void test_sim_lookahead_keeps_stop_n_go_pauses() {
+    for (float sensation : {0.0f, -50.0f}) {
+        double polled = meanPauseMs(strokeEvents(5, 0, sensation, 30000000));
+        double prepared = meanPauseMs(strokeEvents(5, 2, sensation, 30000000));
+        printf("\n  Stop'n'Go pauses at sensation %.0f: %.0f ms polled, "
+               "%.0f ms with lookahead\n",
+               sensation, polled, prepared);
+        TEST_ASSERT_GREATER_THAN(1000.0, polled);
+        TEST_ASSERT_FLOAT_WITHIN(20.0f, float(polled), float(prepared));
+    }
+}
+
+void test_sim_lookahead_half_n_half_survives_setting_change() {
+    for (bool applyNow : {false, true}) {
+        Rig rig;
+        rig.engine->setLookahead(2);
+        rig.engine->setPattern(3, false);
+        rig.engine->setStroke(120.0f, false);
+        rig.engine->setSpeed(60.0f, false);
+        rig.engine->startPattern();
+        sim::runFor(2300000);
+
+        // Prepared targets are asked for again with the new settings
+        rig.engine->setSensation(30.0f, applyNow);
+        sim::runFor(3000000);
+
+        // The moves in keep alternating between half and full depth
+        std::vector<int32_t> in;
+        int32_t out = INT32_MAX;
+        for (const sim::MotionEvent &event : rig.servo->events()) {
+            if (event.type == sim::MotionEvent::STOP) {
+                out = std::min(out, event.position);
+            }
+        }
+        for (const sim::MotionEvent &event : rig.servo->events()) {
+            if (event.type == sim::MotionEvent::STOP && event.position != out) {
+                in.push_back(event.position);
+            }
+        }
+        TEST_ASSERT_GREATER_THAN(6, in.size());
+        for (size_t i = 2; i < in.size(); i++) {
+            TEST_ASSERT_TRUE(in[i - 1] != in[i]);
+            TEST_ASSERT_EQUAL(in[i - 2], in[i]);
+        }
+    }
+}
+
+void test_sim_lookahead_setting_is_constrained() {
+    Rig rig;
+    TEST_ASSERT_EQUAL(0, rig.engine->getLookahead());
+    rig.engine->setLookahead(2);
+    TEST_ASSERT_EQUAL(2, rig.engine->getLookahead());
+    rig.engine->setLookahead(200);
+    TEST_ASSERT_EQUAL(STROKE_LOOKAHEAD_MAX, rig.engine->getLookahead());
+}
+
+void test_sim_lookahead_setting_change_takes_effect_next_stroke() {
+    Rig rig;
+    rig.engine->setLookahead(STROKE_LOOKAHEAD_MAX);
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(3000000);
+
+    // Prepared targets for the old depth must not be executed
+    rig.engine->setDepth(120.0f, false);
+    rig.servo->clearEvents();
+    sim::runFor(2000000);
+
+    int32_t highest = INT32_MIN;
+    const std::vector<sim::MotionEvent> &events = rig.servo->events();
+    for (size_t i = 2; i < events.size(); i++) {
+        if (events[i].type != sim::MotionEvent::STOP) continue;
+        if (events[i].position > highest) highest = events[i].position;
+    }
+    TEST_ASSERT_EQUAL(120 * 20, highest);
+}
+
+void test_sim_pattern_switch_while_stroking() {
+    Rig rig;
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+
+    // Switch on every stroking task cycle, half of them applied immediately
+    for (int i = 0; i < 2000; i++) {
+        TEST_ASSERT_TRUE(rig.engine->setPattern(i % kPatternCount, i % 2));
+        TEST_ASSERT_EQUAL(i % kPatternCount, rig.engine->getPattern());
+        sim::runFor(5000);
+    }
+    TEST_ASSERT_FALSE(rig.engine->setPattern(kPatternCount, false));
+    TEST_ASSERT_EQUAL(1999 % kPatternCount, rig.engine->getPattern());
+
+    // Still stroking within the envelope
+    rig.servo->clearEvents();
+    sim::runFor(2000000);
+    TEST_ASSERT_GREATER_THAN(4, rig.servo->events().size());
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        TEST_ASSERT_TRUE(event.position >= 0);
+        TEST_ASSERT_TRUE(event.position <= (200 - 12) * 20);
+    }
+}
+
+// Largest change between two stops in the same direction after a switch
+// from Simple Stroke to Insist, which strokes half as far at sensation -50
+static int32_t switchStep(uint8_t crossfade, size_t &pauses) {
+    Rig rig;
+    rig.engine->setLookahead(2);
+    rig.engine->setCrossfade(crossfade);
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSensation(-50.0f, false);
+    rig.engine->setSpeed(60.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(2000000);
+    rig.servo->clearEvents();
+    sim::runFor(1000000);
+    rig.engine->setPattern(6, false);
+    sim::runFor(8000000);
+
+    std::vector<int32_t> stops;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) {
+            stops.push_back(event.position);
+        }
+    }
+    int32_t largest = 0;
+    for (size_t i = 2; i < stops.size(); i++) {
+        int32_t step = abs(stops[i] - stops[i - 2]);
+        if (step > largest) largest = step;
+    }
+    pauses = sim::measureStrokes(rig.servo->events()).pauses;
+    return largest;
+}
+
+void test_sim_crossfade_switch_keeps_moving() {
+    size_t switchedPauses = 0;
+    size_t fadedPauses = 0;
+    int32_t switched = switchStep(0, switchedPauses);
+    int32_t faded = switchStep(4, fadedPauses);
+    printf("\n  largest same direction stop change: %.1f mm switched, "
+           "%.1f mm crossfaded over 4 strokes\n",
+           switched / 20.0f, faded / 20.0f);
+
+    // The whole 50 mm at once, or in steps of 2/5 of it
+    TEST_ASSERT_EQUAL(50 * 20, switched);
+    TEST_ASSERT_INT_WITHIN(20, 2 * switched / 5, faded);
+    TEST_ASSERT_EQUAL(0, switchedPauses);
+    TEST_ASSERT_EQUAL(0, fadedPauses);
+}
+
+void test_sim_crossfade_switch_during_fade() {
+    Rig rig;
+    rig.engine->setCrossfade(4);
+    TEST_ASSERT_EQUAL(4, rig.engine->getCrossfade());
+    rig.engine->setLookahead(2);
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1000000);
+    rig.servo->clearEvents();
+
+    // New patterns arrive faster than a fade takes, except Stop'n'Go
+    const int patterns[] = {1, 3, 4, 6, 2, 0};
+    for (int i = 0; i < 60; i++) {
+        TEST_ASSERT_TRUE(rig.engine->setPattern(patterns[i % 6], false));
+        sim::runFor(150000 + 10000 * (i % 7));
+    }
+    sim::runFor(2000000);
+
+    sim::StrokeMetrics metrics = sim::measureStrokes(rig.servo->events());
+    TEST_ASSERT_GREATER_THAN(40, metrics.moves);
+    TEST_ASSERT_EQUAL(0, metrics.pauses);
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        TEST_ASSERT_TRUE(event.position >= 0);
+        TEST_ASSERT_TRUE(event.position <= (200 - 12) * 20);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Streaming
+// ═══════════════════════════════════════════════════════════════════════════
+
+static uint32_t nowMicros32() { return uint32_t(sim::nowMicros()); }
+
+// Run until the given virtual time and return the position in mm
+static float positionAt(Rig &rig, uint64_t micros) {
+    if (micros > sim::nowMicros()) {
+        sim::runFor(micros - sim::nowMicros());
+    }
+    return float(rig.servo->exactPosition() / 20.0);
+}
+
+void test_sim_stream_only_from_ready() {
+    Rig rig;
+    TEST_ASSERT_FALSE(rig.engine->streamTo(50.0f, nowMicros32() + 100000));
+    rig.engine->setSpeed(50.0f, false);
+    rig.engine->startPattern();
+    TEST_ASSERT_FALSE(rig.engine->startStreaming());
+    rig.engine->stopMotion();
+    TEST_ASSERT_TRUE(rig.engine->startStreaming());
+    TEST_ASSERT_EQUAL(STREAMING, rig.engine->getState());
+}
+
+void test_sim_stream_arrives_on_time() {
+    Rig rig;
+    TEST_ASSERT_TRUE(rig.engine->startStreaming());
+    countTelemetry(rig.engine);
+    telemetryMoves = 0;
+    telemetryClipped = 0;
+
+    // Reversals between 20 mm and 120 mm every 400 ms
+    uint32_t start = nowMicros32() + 10000;
+    for (int i = 0; i < 20; i++) {
+        float target = (i % 2 == 0) ? 120.0f : 20.0f;
+        TEST_ASSERT_TRUE(
+            rig.engine->streamTo(target, start + (i + 1) * 400000));
+    }
+    TEST_ASSERT_EQUAL(20, rig.engine->getStreamQueued());
+
+    float worst = 0.0f;
+    for (int i = 0; i < 20; i++) {
+        float target = (i % 2 == 0) ? 120.0f : 20.0f;
+        float error = fabsf(positionAt(rig, start + (i + 1) * 400000ULL) -
+                            target);
+        if (error > worst) worst = error;
+    }
+    countTelemetry(rig.engine);
+    printf("\n  reversals every 400 ms: worst error at arrival %.2f mm\n",
+           worst);
+
+    TEST_ASSERT_LESS_THAN(1.0f, worst);
+    TEST_ASSERT_EQUAL(20, telemetryMoves);
+    TEST_ASSERT_EQUAL(0, telemetryClipped);
+    TEST_ASSERT_EQUAL(0, rig.engine->getStreamQueued());
+}
+
+void test_sim_stream_same_direction_does_not_stop() {
+    Rig rig;
+    rig.engine->startStreaming();
+
+    // Out in steps of 20 mm every 100 ms, then back in one go
+    uint32_t start = nowMicros32() + 10000;
+    for (int i = 0; i < 5; i++) {
+        rig.engine->streamTo(20.0f + 20.0f * i, start + (i + 1) * 100000);
+    }
+    rig.engine->streamTo(20.0f, start + 900000);
+    rig.servo->clearEvents();
+
+    // First target reached from standstill
+    positionAt(rig, start + 100000);
+    rig.servo->clearEvents();
+    float worst = 0.0f;
+    for (int i = 1; i < 5; i++) {
+        float error = fabsf(positionAt(rig, start + (i + 1) * 100000ULL) -
+                            (20.0f + 20.0f * i));
+        if (error > worst) worst = error;
+    }
+    int stops = 0;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) stops++;
+    }
+    printf("  steps of 20 mm every 100 ms: worst error at arrival %.2f mm, "
+           "%d stops on the way\n",
+           worst, stops);
+
+    // Only the last target of the run is a stop
+    TEST_ASSERT_LESS_OR_EQUAL(1, stops);
+    TEST_ASSERT_LESS_THAN(3.0f, worst);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 20.0f, positionAt(rig, start + 1000000));
+}
+
+void test_sim_stream_too_fast_is_clipped_and_catches_up() {
+    Rig rig;
+    rig.engine->startStreaming();
+    countTelemetry(rig.engine);
+    telemetryMoves = 0;
+    telemetryClipped = 0;
+
+    // 150 mm in 50 ms needs 3 m/s, three times the machine
+    uint32_t start = nowMicros32() + 10000;
+    rig.engine->streamTo(150.0f, start + 50000);
+    rig.engine->streamTo(50.0f, start + 700000);
+    positionAt(rig, start + 50000);
+    countTelemetry(rig.engine);
+    TEST_ASSERT_EQUAL(1, telemetryClipped);
+    TEST_ASSERT_LESS_OR_EQUAL(1000.0f * 20.0f * 1.01f,
+                              rig.servo->stats().peakSpeed);
+
+    // The next target keeps its time
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 50.0f, positionAt(rig, start + 700000));
+    countTelemetry(rig.engine);
+    TEST_ASSERT_EQUAL(1, telemetryClipped);
+}
+
+void test_sim_stream_follows_stream_limits() {
+    Rig rig;
+    rig.engine->setStreamLimits(100.0f, 1000.0f);
+    rig.engine->startStreaming();
+    countTelemetry(rig.engine);
+    telemetryClipped = 0;
+    rig.servo->clearStats();
+
+    uint32_t start = nowMicros32() + 10000;
+    rig.engine->streamTo(150.0f, start + 200000);
+    positionAt(rig, start + 3000000);
+    countTelemetry(rig.engine);
+
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 150.0f, positionAt(rig, start + 3000000));
+    TEST_ASSERT_LESS_OR_EQUAL(100.0f * 20.0f * 1.01f,
+                              rig.servo->stats().peakSpeed);
+    TEST_ASSERT_LESS_OR_EQUAL(1000.0f * 20.0f * 1.01f,
+                              rig.servo->stats().peakAcceleration);
+    TEST_ASSERT_EQUAL(1, telemetryClipped);
+}
+
+void test_sim_stream_stop_discards_queue() {
+    Rig rig;
+    rig.engine->startStreaming();
+    uint32_t start = nowMicros32() + 10000;
+    for (int i = 0; i < 10; i++) {
+        rig.engine->streamTo((i % 2 == 0) ? 150.0f : 20.0f,
+                             start + (i + 1) * 300000);
+    }
+    sim::runFor(450000);
+    rig.engine->stopMotion();
+    TEST_ASSERT_EQUAL(READY, rig.engine->getState());
+    TEST_ASSERT_FALSE(rig.servo->isRunning());
+    TEST_ASSERT_FALSE(rig.engine->streamTo(100.0f, nowMicros32() + 100000));
+
+    // A new stream starts from scratch
+    int32_t stopped = rig.servo->getCurrentPosition();
+    rig.engine->startStreaming();
+    sim::runFor(1000000);
+    TEST_ASSERT_EQUAL(0, rig.engine->getStreamQueued());
+    TEST_ASSERT_EQUAL(stopped, rig.servo->getCurrentPosition());
+}
+
+void test_sim_stream_slows_down_before_reversal() {
+    Rig rig;
+    rig.engine->setStreamLimits(1000.0f, 5000.0f);
+    rig.engine->startStreaming();
+    uint32_t start = nowMicros32() + 10000;
+    rig.engine->streamTo(20.0f, start);
+    positionAt(rig, start + 100000);
+
+    // Speed up to 500 mm/s as fast as allowed and turn at 130 mm without
+    // slowing down. Braking takes 25 mm, much more than the 5 mm steps.
+    start = nowMicros32() + 10000;
+    for (int i = 1; i <= 30; i++) {
+        float t = i * 0.01f;
+        float target = t < 0.1f ? 20.0f + 2500.0f * t * t
+                                : 45.0f + 500.0f * (t - 0.1f);
+        rig.engine->streamTo(fminf(target, 130.0f), start + i * 10000);
+    }
+    rig.engine->streamTo(20.0f, start + 1000000);
+
+    float furthest = 0.0f;
+    while (sim::nowMicros() < start + 1000000ULL) {
+        furthest = fmaxf(furthest, positionAt(rig, sim::nowMicros() + 1000));
+    }
+    printf("  turning at 130 mm from 500 mm/s: furthest %.2f mm\n",
+           furthest);
+
+    TEST_ASSERT_LESS_THAN_FLOAT(130.5f, furthest);
+    TEST_ASSERT_LESS_OR_EQUAL(5000.0f * 20.0f * 1.05f,
+                              rig.servo->stats().peakAcceleration);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 20.0f, positionAt(rig, start + 1200000));
+}
+
+void test_sim_stream_lookahead_setting_is_constrained() {
+    Rig rig;
+    rig.engine->setStreamLookahead(0);
+    rig.engine->startStreaming();
+
+    // Without lookahead every target is a stop
+    uint32_t start = nowMicros32() + 10000;
+    for (int i = 0; i < 5; i++) {
+        rig.engine->streamTo(20.0f + 20.0f * i, start + (i + 1) * 100000);
+    }
+    positionAt(rig, start + 100000);
+    rig.servo->clearEvents();
+    positionAt(rig, start + 600000);
+    int stops = 0;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) stops++;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(4, stops);
+
+    // Anything above the maximum looks as far as it can
+    rig.engine->setStreamLookahead(255);
+    start = nowMicros32() + 10000;
+    for (int i = 0; i < 5; i++) {
+        rig.engine->streamTo(100.0f + 10.0f * i, start + (i + 1) * 100000);
+    }
+    positionAt(rig, start + 100000);
+    rig.servo->clearEvents();
+    positionAt(rig, start + 600000);
+    stops = 0;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) stops++;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(1, stops);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stopping
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Exposes the task waiting for the servo to come to rest
+class StopProbe : public StrokeEngine {
+  public:
+    using StrokeEngine::_taskStoppingHandle;
+};
+
+// Runs a fast move across the rail until it is halfway, close to full speed
+static void runToMidTravel(Rig &rig) {
+    rig.engine->moveToMax(1000.0f);
+    while (rig.servo->getCurrentPosition() < 94 * 20) {
+        sim::runFor(1000);
+    }
+}
+
+void test_sim_stop_async_returns_at_once_and_notifies() {
+    Rig rig;
+    runToMidTravel(rig);
+
+    rig.engine->stopMotionAsync(xTaskGetCurrentTaskHandle());
+    TEST_ASSERT_TRUE(rig.engine->isStopping());
+    TEST_ASSERT_TRUE(rig.servo->isRunning());
+    TEST_ASSERT_EQUAL(READY, rig.engine->getState());
+
+    TEST_ASSERT_EQUAL(1, ulTaskNotifyTake(pdTRUE, portMAX_DELAY));
+    TEST_ASSERT_FALSE(rig.engine->isStopping());
+    TEST_ASSERT_FALSE(rig.servo->isRunning());
+
+    // The stop came to rest within one tick at full deceleration
+    const std::vector<sim::MotionEvent> &events = rig.servo->events();
+    TEST_ASSERT_EQUAL(sim::MotionEvent::STOP, events.back().type);
+    TEST_ASSERT_UINT32_WITHIN(1000, uint32_t(events.back().micros),
+                             uint32_t(sim::nowMicros()));
+}
+
+void test_sim_stop_when_at_rest_notifies_right_away() {
+    Rig rig;
+    rig.engine->stopMotionAsync(xTaskGetCurrentTaskHandle());
+    TEST_ASSERT_FALSE(rig.engine->isStopping());
+    TEST_ASSERT_EQUAL(1, ulTaskNotifyTake(pdTRUE, 0));
+}
+
+void test_sim_move_to_min_starts_after_the_stop() {
+    Rig rig;
+    runToMidTravel(rig);
+    rig.servo->clearStats();
+
+    // Returns while the carriage is still braking at full deceleration
+    TEST_ASSERT_TRUE(rig.engine->moveToMin(50.0f));
+    TEST_ASSERT_TRUE(rig.engine->isStopping());
+    sim::runFor(5000000);
+
+    // The gentle move back only starts once the stop has come to rest, so
+    // the carriage never runs on past the point the stop could reach
+    int32_t furthest = INT32_MIN;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.position > furthest) furthest = event.position;
+    }
+    TEST_ASSERT_LESS_THAN(110 * 20, furthest);
+    TEST_ASSERT_FLOAT_WITHIN(10000.0f, motor.maxAcceleration * 20,
+                             rig.servo->stats().peakAcceleration);
+    TEST_ASSERT_EQUAL(0, rig.servo->getCurrentPosition());
+    TEST_ASSERT_EQUAL(READY, rig.engine->getState());
+}
+
+void test_sim_setup_depth_follows_depth_set_while_stopping() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(100.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1234000);
+
+    TEST_ASSERT_TRUE(rig.engine->setupDepth(20.0f));
+    TEST_ASSERT_EQUAL(SETUPDEPTH, rig.engine->getState());
+    rig.engine->setDepth(100.0f, true);
+    sim::runFor(10000000);
+
+    TEST_ASSERT_FALSE(rig.servo->isRunning());
+    TEST_ASSERT_EQUAL(100 * 20, rig.servo->getCurrentPosition());
+}
+
+void test_sim_pattern_takes_over_from_pending_move() {
+    Rig rig;
+    runToMidTravel(rig);
+    rig.servo->clearEvents();
+    rig.engine->moveToMin(50.0f);
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(50.0f, false);
+    TEST_ASSERT_TRUE(rig.engine->startPattern());
+    sim::runFor(3000000);
+
+    // The pattern keeps stroking, the pending move to min never runs
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+    TEST_ASSERT_FALSE(rig.engine->isStopping());
+    int32_t lowest = INT32_MAX;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.position < lowest) lowest = event.position;
+    }
+    TEST_ASSERT_GREATER_THAN(60 * 20, lowest);
+}
+
+// CPU time the calling task spends in a stop from close to full speed. The
+// old stopMotion() polled isRunning() until the servo was at rest.
+void test_sim_benchmark_stop_frees_caller_cpu() {
+    uint64_t spinBusy, spinMicros, waitBusy, waitMicros, stoppingBusy;
+    {
+        Rig rig;
+        runToMidTravel(rig);
+        uint64_t busy = sim::busyMicros(nullptr);
+        uint64_t start = sim::nowMicros();
+        rig.engine->stopMotionAsync();
+        while (rig.servo->isRunning()) {
+        }
+        spinBusy = sim::busyMicros(nullptr) - busy;
+        spinMicros = sim::nowMicros() - start;
+    }
+    {
+        Rig rig;
+        runToMidTravel(rig);
+        uint64_t busy = sim::busyMicros(nullptr);
+        uint64_t start = sim::nowMicros();
+        rig.engine->stopMotion();
+        waitBusy = sim::busyMicros(nullptr) - busy;
+        waitMicros = sim::nowMicros() - start;
+        stoppingBusy = sim::busyMicros(
+            static_cast<StopProbe *>(rig.engine)->_taskStoppingHandle);
+        TEST_ASSERT_FALSE(rig.servo->isRunning());
+    }
+
+    printf("\n  stop from %.0f mm/s: spinning caller %.1f ms busy of %.1f ms, "
+           "notified caller %llu us busy of %.1f ms, stopping task %llu us\n",
+           sqrtf(2.0f * 5000.0f * 94.0f), spinBusy / 1000.0,
+           spinMicros / 1000.0, (unsigned long long)waitBusy,
+           waitMicros / 1000.0, (unsigned long long)stoppingBusy);
+
+    TEST_ASSERT_GREATER_THAN(spinMicros * 9 / 10, spinBusy);
+    TEST_ASSERT_LESS_THAN(20, waitBusy);
+    TEST_ASSERT_UINT32_WITHIN(1000, uint32_t(spinMicros), uint32_t(waitMicros));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Homing
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const uint8_t kEndstopPin = 12;
+
+// Carriage position of the switch edge in steps, and the stepper riding on
+// the rail. The switch is pressed behind the edge.
+static double switchEdge = 0.0;
+static FastAccelStepper *switchServo = nullptr;
+static void (*endstopISR)(void) = nullptr;
+static uint64_t endstopLatencyMicros = 0;  // From the edge to the ISR
+
+static bool switchPressed() {
+    return switchServo->carriagePosition() <= switchEdge;
+}
+
+// Stands in for the GPIO hardware. Samples the switch with every
+// integration step of the stepper when the carriage is close and raises the
+// interrupt on the edge, so the ISR sees the carriage within 10 us of it.
+static void endstopTask(void *) {
+    bool pressed = switchPressed();
+    while (true) {
+        bool now = switchPressed();
+        if (now && !pressed && endstopISR != nullptr) {
+            if (endstopLatencyMicros > 0) sim::runFor(endstopLatencyMicros);
+            if (endstopISR != nullptr) endstopISR();
+        }
+        pressed = now;
+
+        // Far from the switch the carriage can not reach it before then
+        double distance = fabs(switchServo->carriagePosition() - switchEdge);
+        uint64_t wait =
+            uint64_t(distance / (motor.maxSpeed * 20.0) * 1000000.0 / 2.0);
+        sim::runFor(wait > FastAccelStepper::kStepMicros
+                        ? wait
+                        : FastAccelStepper::kStepMicros);
+    }
+}
+
+struct HomingResult {
+    bool homed = false;
+    float errorMm = 0.0f;  // home origin relative to the switch edge
+    float overrunMm = 0.0f;  // how far the carriage went past the edge
+};
+
+// Homes towards the back from startMm in front of the switch edge
+static HomingResult homeFrom(float startMm, float speed, bool latch,
+                             uint64_t latencyMicros = 0) {
+    Rig rig(motor, false);
+    switchServo = rig.servo;
+    switchEdge = -startMm * 20.0;
+    endstopISR = nullptr;
+    endstopLatencyMicros = latencyMicros;
+
+    When(Method(ArduinoFake(), pinMode)).AlwaysReturn();
+    When(Method(ArduinoFake(), digitalRead)).AlwaysDo([](uint8_t) -> int {
+        return switchPressed() ? LOW : HIGH;
+    });
+    When(Method(ArduinoFake(), attachInterrupt))
+        .AlwaysDo([](uint8_t, void (*isr)(void), int) { endstopISR = isr; });
+    When(Method(ArduinoFake(), detachInterrupt)).AlwaysDo([](uint8_t) {
+        endstopISR = nullptr;
+    });
+    xTaskCreate(endstopTask, "Endstop", 2048, nullptr,
+                configMAX_PRIORITIES - 1, nullptr);
+
+    endstopProperties endstop = {.homeToBack = true,
+                                 .activeLow = true,
+                                 .endstopPin = kEndstopPin,
+                                 .pinMode = INPUT_PULLUP,
+                                 .latchOnInterrupt = latch};
+    rig.engine->enableAndHome(&endstop, speed);
+
+    HomingResult result;
+    double furthest = rig.servo->carriagePosition();
+    for (int i = 0; i < 6000; i++) {
+        sim::runFor(10000);
+        furthest = fmin(furthest, rig.servo->carriagePosition());
+        if (rig.engine->getState() == READY && !rig.servo->isRunning()) break;
+    }
+    result.homed = rig.engine->getState() == READY;
+
+    // The counter reads -keepoutBoundary at the switch edge when exact
+    double counterAtEdge =
+        rig.servo->exactPosition() - rig.servo->carriagePosition() + switchEdge;
+    result.errorMm = float(counterAtEdge / 20.0 + geometry.keepoutBoundary);
+    result.overrunMm = float((switchEdge - furthest) / 20.0);
+    return result;
+}
+
+void test_sim_homing_polled_finds_switch() {
+    HomingResult result = homeFrom(50.0f, 5.0f, false);
+    TEST_ASSERT_TRUE(result.homed);
+    // 20 ms polling at 5 mm/s
+    TEST_ASSERT_FLOAT_WITHIN(0.15f, 0.0f, result.errorMm);
+}
+
+void test_sim_homing_latched_is_exact_at_speed() {
+    HomingResult result = homeFrom(50.01f, 200.0f, true);
+    TEST_ASSERT_TRUE(result.homed);
+    // Within one step of the edge
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.0f, result.errorMm);
+    // Braked at full deceleration, well within the keepout
+    TEST_ASSERT_LESS_THAN(geometry.keepoutBoundary, result.overrunMm);
+}
+
+void test_sim_homing_latched_starting_on_switch() {
+    HomingResult result = homeFrom(-2.0f, 100.0f, true);
+    TEST_ASSERT_TRUE(result.homed);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 0.0f, result.errorMm);
+}
+
+void test_sim_homing_latched_waits_for_a_late_interrupt() {
+    // The switch reads pressed 1 ms before its interrupt arrives. Starts
+    // 0.1 mm apart put the 20 ms poll at every point of that window.
+    for (int i = 0; i < 40; i++) {
+        HomingResult result = homeFrom(50.0f + 0.1f * i, 200.0f, true, 1000);
+        TEST_ASSERT_TRUE(result.homed);
+        // Latched 1 ms after the edge at 200 mm/s every time. A forced stop
+        // where the poll saw the switch would land anywhere in between.
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.2f, result.errorMm);
+    }
+}
+
+// Home origin error against the switch edge over a range of homing speeds.
+// The start position sets where the edge falls within the 20 ms polling
+// period, so the spread over starts is the repeatability.
+void test_sim_benchmark_homing_edge_timing() {
+    const float speeds[] = {5.0f, 20.0f, 50.0f, 100.0f, 200.0f};
+    const int kStarts = 7;
+
+    printf("\n  homing origin error vs switch edge, %d start positions\n",
+           kStarts);
+    printf("  %-10s %12s %12s %12s %12s %12s\n", "mm/s", "polled mean",
+           "polled max", "latched mean", "latched max", "overrun mm");
+    for (float speed : speeds) {
+        float sum[2] = {0.0f, 0.0f};
+        float worst[2] = {0.0f, 0.0f};
+        float overrun = 0.0f;
+        for (int latch = 0; latch < 2; latch++) {
+            for (int i = 0; i < kStarts; i++) {
+                HomingResult result =
+                    homeFrom(40.0f + 3.71f * i, speed, latch == 1);
+                TEST_ASSERT_TRUE(result.homed);
+                float error = fabsf(result.errorMm);
+                sum[latch] += error;
+                worst[latch] = fmaxf(worst[latch], error);
+                if (latch == 1) overrun = fmaxf(overrun, result.overrunMm);
+            }
+        }
+        printf("  %-10.0f %12.3f %12.3f %12.3f %12.3f %12.2f\n", speed,
+               sum[0] / kStarts, worst[0], sum[1] / kStarts, worst[1],
+               overrun);
+
+        TEST_ASSERT_LESS_THAN(0.05f, worst[1]);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Vibration
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Strokes slowly from 130 mm to 70 mm, so the vibration stands out
+static void startSlowPattern(Rig &rig) {
+    rig.engine->setDepth(130.0f, false);
+    rig.engine->setStroke(60.0f, false);
+    rig.engine->setSpeed(2.0f, false);
+    rig.engine->setupDepth(500.0f);
+    sim::runFor(1000000);
+    rig.engine->startPattern();
+    sim::runFor(200000);
+}
+
+// Samples the carriage every 100 µs
+static std::vector<double> sampleCarriage(Rig &rig, uint64_t micros) {
+    std::vector<double> samples;
+    for (uint64_t t = 0; t < micros; t += 100) {
+        sim::runFor(100);
+        samples.push_back(rig.servo->exactPosition());
+    }
+    return samples;
+}
+
+// Amplitude of the sine at frequency in the samples, in steps. The slow
+// stroke underneath is removed as a straight line.
+static double fundamental(const std::vector<double> &samples,
+                          float frequency) {
+    const double dt = 100e-6;
+    const size_t n = samples.size();
+    double meanT = 0.5 * (n - 1) * dt;
+    double meanX = 0.0;
+    for (double x : samples) meanX += x;
+    meanX /= n;
+    double sxx = 0.0, sxy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sxx += (i * dt - meanT) * (i * dt - meanT);
+        sxy += (i * dt - meanT) * (samples[i] - meanX);
+    }
+    double slope = sxy / sxx;
+
+    double a = 0.0, b = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double x = samples[i] - meanX - slope * (i * dt - meanT);
+        double phase = 2.0 * M_PI * frequency * i * dt;
+        a += x * sin(phase);
+        b += x * cos(phase);
+    }
+    return 2.0 * sqrt(a * a + b * b) / n;
+}
+
+// Direction changes in the samples
+static int reversals(const std::vector<double> &samples) {
+    int count = 0;
+    int direction = 0;
+    for (size_t i = 1; i < samples.size(); i++) {
+        double change = samples[i] - samples[i - 1];
+        int now = change > 0 ? 1 : change < 0 ? -1 : 0;
+        if (now != 0 && direction != 0 && now != direction) count++;
+        if (now != 0) direction = now;
+    }
+    return count;
+}
+
+void test_sim_vibration_overlays_the_pattern() {
+    Rig rig;
+    startSlowPattern(rig);
+    rig.engine->setVibration(0.5f, 30.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, rig.engine->getVibrationAmplitude());
+    TEST_ASSERT_EQUAL_FLOAT(30.0f, rig.engine->getVibrationFrequency());
+    sim::runFor(300000);
+
+    // 60 full periods of the sine in 2 s, on top of the stroke
+    std::vector<double> samples = sampleCarriage(rig, 2000000);
+    TEST_ASSERT_INT_WITHIN(4, 120, reversals(samples));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f * 20, 0.5f * 20,
+                             float(fundamental(samples, 30.0f)));
+    TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+    TEST_ASSERT_LESS_OR_EQUAL(motor.maxSpeed * 20, rig.servo->stats().peakSpeed);
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+}
+
+void test_sim_vibration_is_clamped_to_envelope() {
+    Rig rig;
+    rig.engine->setVibration(5.0f, 100.0f);
+    float allowed = rig.engine->getMaxVibrationAmplitude(100.0f);
+    float w = 2.0f * float(M_PI) * 100.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f * motor.maxAcceleration / (w * w),
+                             allowed);
+    TEST_ASSERT_EQUAL_FLOAT(allowed, rig.engine->getVibrationAmplitude());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, rig.engine->getMaxVibrationAmplitude(300.0f));
+}
+
+void test_sim_vibration_keeps_stroking_at_speed() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(30.0f, false);
+    rig.engine->setVibration(0.3f, 40.0f);
+    rig.engine->startPattern();
+    sim::runFor(2000000);
+
+    // Strokes between depth and depth - stroke, with the vibration on top
+    rig.servo->clearStats();
+    std::vector<double> samples = sampleCarriage(rig, 3000000);
+    double lowest = *std::min_element(samples.begin(), samples.end());
+    double highest = *std::max_element(samples.begin(), samples.end());
+    TEST_ASSERT_FLOAT_WITHIN(0.5f * 20, 150.0f * 20, float(highest));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f * 20, 70.0f * 20, float(lowest));
+    TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+    TEST_ASSERT_LESS_OR_EQUAL(motor.maxSpeed * 20 + 2000,
+                              rig.servo->stats().peakSpeed);
+}
+
+void test_sim_vibration_off_hands_back_to_ramp() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(30.0f, false);
+    rig.engine->setVibration(0.5f, 30.0f);
+    rig.engine->startPattern();
+    sim::runFor(2000000);
+
+    // With the queue running the carriage never stops between strokes
+    size_t stops = 0;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) stops++;
+    }
+    rig.engine->setVibration(0.0f, 30.0f);
+    sim::runFor(3000000);
+
+    // The ramp generator stops at every reversal again
+    size_t stopsAfter = 0;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) stopsAfter++;
+    }
+    TEST_ASSERT_GREATER_THAN(stops + 2, stopsAfter);
+    TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+}
+
+void test_sim_vibration_stop_comes_to_rest() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(80.0f, false);
+    rig.engine->setSpeed(50.0f, false);
+    rig.engine->setVibration(0.5f, 30.0f);
+    rig.engine->startPattern();
+    sim::runFor(1234000);
+
+    rig.engine->stopMotion();
+    TEST_ASSERT_EQUAL(READY, rig.engine->getState());
+    TEST_ASSERT_FALSE(rig.servo->isRunning());
+    TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+
+    // Manual moves run on the ramp generator again
+    rig.engine->moveToMin(50.0f);
+    sim::runFor(5000000);
+    TEST_ASSERT_EQUAL(0, rig.servo->getCurrentPosition());
+
+    // A restart picks up the vibration again. The step queue carries the
+    // carriage through the reversals without stopping.
+    rig.engine->startPattern();
+    sim::runFor(300000);
+    rig.servo->clearEvents();
+    sim::runFor(2000000);
+    TEST_ASSERT_TRUE(rig.servo->events().empty());
+    TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+}
+
+void test_sim_vibration_restart_while_braking_starts_afresh() {
+    Rig rig;
+    rig.engine->setDepth(180.0f, false);
+    rig.engine->setStroke(160.0f, false);
+    rig.engine->setSpeed(60.0f, false);
+    rig.engine->startPattern();
+
+    // Stop halfway back to 20 mm, then restart with the vibration on while
+    // the carriage still brakes
+    while (rig.servo->getCurrentPosition() < 175 * 20) {
+        sim::runFor(1000);
+    }
+    while (rig.servo->getCurrentPosition() > 100 * 20) {
+        sim::runFor(1000);
+    }
+    rig.engine->stopMotionAsync();
+    rig.engine->setVibration(0.5f, 30.0f);
+    TEST_ASSERT_TRUE(rig.engine->startPattern());
+    TEST_ASSERT_TRUE(rig.servo->isRunning());
+
+    // The new session begins with the stroke to depth. The move to 20 mm the
+    // last session was on is not replayed.
+    std::vector<double> samples = sampleCarriage(rig, 3000000);
+    size_t deep = samples.size();
+    size_t shallow = samples.size();
+    for (size_t i = 0; i < samples.size(); i++) {
+        if (deep == samples.size() && samples[i] > 175 * 20) deep = i;
+        if (shallow == samples.size() && samples[i] < 50 * 20) shallow = i;
+    }
+    TEST_ASSERT_LESS_THAN(samples.size(), deep);
+    TEST_ASSERT_LESS_THAN(shallow, deep);
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Tempo
+// ═══════════════════════════════════════════════════════════════════════════
+
+// Time of each reversal, from where the carriage stopped
+static std::vector<uint64_t> reversalTimes(Rig &rig) {
+    std::vector<uint64_t> times;
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) times.push_back(event.micros);
+    }
+    return times;
+}
+
+// Signed distance of a time to the closest beat in µs
+static double offBeat(uint64_t micros, uint64_t beat, double period) {
+    double since = double(int64_t(micros - beat));
+    return since - round(since / period) * period;
+}
+
+void test_sim_tempo_lands_reversals_on_beats() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSpeed(25.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1234000);
+
+    // A beat 100 ms ago. The pattern wants 600 ms per move, the beat
+    // comes every 485 ms.
+    uint64_t beat = sim::nowMicros() - 100000;
+    double period = 60.0e6 / 123.7;
+    rig.engine->setTempo(123.7f, uint32_t(beat));
+    TEST_ASSERT_EQUAL_FLOAT(123.7f, rig.engine->getTempo());
+    sim::runFor(10000000);
+
+    rig.servo->clearEvents();
+    sim::runFor(20000000);
+    std::vector<uint64_t> times = reversalTimes(rig);
+    TEST_ASSERT_INT_WITHIN(2, int(20.0e6 / period), int(times.size()));
+    for (size_t i = 0; i < times.size(); i++) {
+        TEST_ASSERT_FLOAT_WITHIN(2000.0f, 0.0f,
+                                 float(offBeat(times[i], beat, period)));
+        if (i > 0) {
+            TEST_ASSERT_FLOAT_WITHIN(3000.0f, float(period),
+                                     float(times[i] - times[i - 1]));
+        }
+    }
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 0.0f, rig.engine->getTempoPhaseError());
+    TEST_ASSERT_LESS_OR_EQUAL(motor.maxSpeed * 20, rig.servo->stats().peakSpeed);
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+}
+
+// Moves much shorter than a beat land on subdivisions of it
+void test_sim_tempo_subdivides_fast_strokes() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(60.0f, false);
+    rig.engine->setSpeed(60.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1000000);
+
+    uint64_t beat = sim::nowMicros();
+    double period = 60.0e6 / 90.0;
+    rig.engine->setTempo(90.0f, uint32_t(beat));
+    sim::runFor(5000000);
+
+    // 150 ms per move, a quarter beat is 167 ms
+    rig.servo->clearEvents();
+    sim::runFor(10000000);
+    std::vector<uint64_t> times = reversalTimes(rig);
+    TEST_ASSERT_INT_WITHIN(2, int(4 * 10.0e6 / period), int(times.size()));
+    for (uint64_t time : times) {
+        TEST_ASSERT_FLOAT_WITHIN(2000.0f, 0.0f,
+                                 float(offBeat(time, beat, period / 4)));
+    }
+}
+
+// The machine can't keep up with a move per beat at this tempo. The moves
+// run at full speed and land on the next beat they can make.
+void test_sim_tempo_too_fast_for_machine_skips_beats() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(150.0f, false);
+    rig.engine->setSpeed(60.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1000000);
+
+    rig.engine->setTempo(150.0f, uint32_t(sim::nowMicros()));
+    rig.engine->setSpeed(100.0f, false);
+    sim::runFor(5000000);
+    rig.servo->clearStats();
+    sim::runFor(5000000);
+    TEST_ASSERT_LESS_OR_EQUAL(motor.maxSpeed * 20, rig.servo->stats().peakSpeed);
+    TEST_ASSERT_LESS_OR_EQUAL(motor.maxAcceleration * 20 + 1,
+                              rig.servo->stats().peakAcceleration);
+    TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+}
+
+void test_sim_tempo_off_runs_free() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSpeed(30.0f, false);
+    rig.engine->setTempo(123.7f, 0);
+    rig.engine->startPattern();
+    sim::runFor(5000000);
+
+    rig.engine->setTempo(0.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, rig.engine->getTempo());
+    sim::runFor(2000000);
+
+    // Back to 490 ms per move, plus up to a polling period to notice
+    rig.servo->clearEvents();
+    sim::runFor(10000000);
+    std::vector<uint64_t> times = reversalTimes(rig);
+    for (size_t i = 1; i < times.size(); i++) {
+        TEST_ASSERT_INT_WITHIN(10000, 495000, int(times[i] - times[i - 1]));
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+// The stroking task polls the stepper every 10 ms, so a reversal waits up
+// to one polling period (plus the partial first tick) before the next move
+// is issued.
+void test_sim_setters_hammered_while_stroking() {
+    Rig rig;
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSpeed(50.0f, false);
+    rig.engine->startPattern();
+    sim::runFor(1000000);
+    rig.servo->clearEvents();
+
+    // A real thread hammers the setters while the virtual-time stroking task
+    // runs. The setters never touch the scheduler, so they don't wait for it.
+    std::atomic<bool> running{true};
+    std::atomic<long> writes{0};
+    std::thread setter([&]() {
+        for (int i = 0; running.load(); i++) {
+            rig.engine->setSpeed(40.0f + (i % 20), (i % 7) == 0);
+            rig.engine->setStroke(80.0f + (i % 21), false);
+            rig.engine->setDepth(140.0f + (i % 11), false);
+            rig.engine->setSensation(float(i % 41) - 20.0f, false);
+            writes++;
+        }
+    });
+    sim::runFor(10000000);
+    running = false;
+    setter.join();
+
+    // Never stalled: no standstill longer than a reversal
+    sim::StrokeMetrics hammered = sim::measureStrokes(rig.servo->events());
+    TEST_ASSERT_GREATER_THAN(0, writes.load());
+    TEST_ASSERT_GREATER_THAN(20, hammered.moves);
+    TEST_ASSERT_EQUAL(0, hammered.pauses);
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        TEST_ASSERT_TRUE(event.position >= 0);
+        TEST_ASSERT_TRUE(event.position <= 151 * 20);
+    }
+
+    // The last settings win
+    rig.engine->setDepth(150.0f, false);
+    rig.engine->setStroke(100.0f, false);
+    rig.engine->setSpeed(50.0f, false);
+    rig.engine->setSensation(0.0f, false);
+    TEST_ASSERT_EQUAL(150, int(rig.engine->getDepth()));
+    TEST_ASSERT_EQUAL(100, int(rig.engine->getStroke()));
+    TEST_ASSERT_EQUAL(50, int(rig.engine->getSpeed()));
+    sim::runFor(2000000);
+    rig.servo->clearEvents();
+    sim::runFor(3000000);
+    for (const sim::MotionEvent &event : rig.servo->events()) {
+        if (event.type == sim::MotionEvent::STOP) {
+            TEST_ASSERT_TRUE(event.position == 1000 || event.position == 3000);
+        }
+    }
+}
+
+static void benchmarkAllPatterns(float speedPercent, float sensation) {
+    printHeader(speedPercent, sensation);
+    for (int i = 0; i < kPatternCount; i++) {
+        if (!benchmarked(i)) continue;
+        BenchResult r = benchmarkPattern(i, speedPercent, sensation);
+        printResult(i, r);
+
+        TEST_ASSERT_GREATER_THAN(20, r.moves);
+        TEST_ASSERT_TRUE(r.deadTimeMaxMs <= 11.0f);
+    }
+}
+
+void test_sim_benchmark_half_speed() { benchmarkAllPatterns(50.0f, 0.0f); }
+
+void test_sim_benchmark_full_speed() { benchmarkAllPatterns(100.0f, 0.0f); }
+
+// Lookahead issues the next target on the first tick after the arrival
+void test_sim_benchmark_lookahead_gain() {
+    const uint8_t lookahead = 2;
+    printf("\n  speed 100%%, sensation 0, polling vs lookahead %d\n", lookahead);
+    printf("  %-20s %12s %12s %7s %9s %9s\n", "pattern", "polled /min",
+           "lookahead", "gain %", "dead ms", "dead max");
+    for (int i = 0; i < kPatternCount; i++) {
+        if (!benchmarked(i)) continue;
+        BenchResult polled = benchmarkPattern(i, 100.0f, 0.0f, 0);
+        BenchResult prepared = benchmarkPattern(i, 100.0f, 0.0f, lookahead);
+        float gain = 100.0f * (prepared.strokesPerMinute() /
+                                   polled.strokesPerMinute() -
+                               1.0f);
+
+        printf("  %-20s %12.1f %12.1f %7.2f %9.2f %9.2f\n", PatternPool::name(i),
+               polled.strokesPerMinute(), prepared.strokesPerMinute(), gain,
+               prepared.deadTimeMeanMs(), prepared.deadTimeMaxMs);
+
+        TEST_ASSERT_TRUE(prepared.deadTimeMaxMs <= 1.05f);
+        TEST_ASSERT_TRUE(prepared.strokesPerMinute() >=
+                         polled.strokesPerMinute() * 0.999f);
+    }
+}
+
+// ±100 degenerates Insist into zero-length strokes, so stay just short of it
+void test_sim_benchmark_jerk_limit() {
+    // Trapezoids at today's limit against S-curves at the same and at twice
+    // the acceleration. Start/stop jerk is where one segment hands over to
+    // the next; the corners into and out of cruise keep their step.
+    const float accel = motor.maxAcceleration;
+    const motorProperties trapezoid = withJerk(accel, 0.0f);
+    const motorProperties sCurve = withJerk(accel, kJerk);
+    const motorProperties sCurveFast = withJerk(2.0f * accel, kJerk);
+    const uint8_t lookahead = 2;
+
+    printf("\n  speed 100%%, sensation 0, lookahead %d, jerk limit %.0f m/s³\n",
+           lookahead, kJerk / 1000.0f);
+    printf("  %-20s %24s %26s %23s\n", "", "strokes/min",
+           "start/stop jerk m/s³", "peak accel m/s²");
+    printf("  %-20s %7s %7s %8s %8s %8s %8s %7s %7s %7s\n", "pattern", "trap",
+           "S", "S 2a", "trap", "S", "S 2a", "trap", "S", "S 2a");
+    for (int i = 0; i < kPatternCount; i++) {
+        if (!benchmarked(i)) continue;
+        BenchResult t = benchmarkPattern(i, 100.0f, 0.0f, lookahead, trapezoid);
+        BenchResult s = benchmarkPattern(i, 100.0f, 0.0f, lookahead, sCurve);
+        BenchResult f =
+            benchmarkPattern(i, 100.0f, 0.0f, lookahead, sCurveFast);
+
+        printf("  %-20s %7.1f %7.1f %8.1f %8.0f %8.0f %8.0f %7.1f %7.1f %7.1f\n",
+               PatternPool::name(i), t.strokesPerMinute(),
+               s.strokesPerMinute(), f.strokesPerMinute(),
+               t.peakStartStopJerk / 1000.0f, s.peakStartStopJerk / 1000.0f,
+               f.peakStartStopJerk / 1000.0f, t.peakAcceleration / 1000.0f,
+               s.peakAcceleration / 1000.0f, f.peakAcceleration / 1000.0f);
+
+        // The S-curves keep the jerk limit at every segment corner
+        TEST_ASSERT_LESS_THAN(1.1f * kJerk, s.peakStartStopJerk);
+        TEST_ASSERT_LESS_THAN(1.1f * kJerk, f.peakStartStopJerk);
+        TEST_ASSERT_GREATER_THAN(s.peakStartStopJerk, t.peakStartStopJerk);
+    }
+}
+
+// Achieved vibration amplitude against the envelope. Each frequency runs at
+// the envelope and at half of it on top of a slow pattern. The amplitude is
+// the sine's share of the carriage motion, so the rounding to whole steps
+// shows as the error at high frequencies.
+void test_sim_benchmark_vibration_envelope() {
+    const float frequencies[] = {5.0f,   10.0f,  20.0f,  40.0f,
+                                 70.0f,  100.0f, 150.0f, 250.0f};
+
+    printf("\n  vibration envelope, %.0f mm/s and %.0f mm/s² machine, "
+           "%d us queue entries\n",
+           motor.maxSpeed, motor.maxAcceleration, STROKE_VIBRATION_PERIOD_US);
+    printf("  %-8s %10s %10s %10s %10s %8s %10s\n", "Hz", "envelope",
+           "set mm", "set steps", "got mm", "error", "underruns");
+    for (float frequency : frequencies) {
+        float envelope = 0.0f;
+        for (int share = 2; share >= 1; share--) {
+            Rig rig;
+            envelope = rig.engine->getMaxVibrationAmplitude(frequency);
+            float amplitude = envelope * share / 2.0f;
+            startSlowPattern(rig);
+            rig.engine->setVibration(amplitude, frequency);
+            sim::runFor(300000);
+
+            // Whole periods of the sine
+            uint64_t window = uint64_t(1e6f / frequency) *
+                              uint64_t(ceilf(frequency));
+            std::vector<double> samples = sampleCarriage(rig, window);
+            float got = float(fundamental(samples, frequency)) / 20.0f;
+            float error = got - amplitude;
+            printf("  %-8.0f %10.3f %10.3f %10.1f %10.3f %7.0f%% %10u\n",
+                   frequency, envelope, amplitude, amplitude * 20.0f, got,
+                   100.0f * error / amplitude, rig.servo->queueUnderruns());
+
+            TEST_ASSERT_EQUAL(0, rig.servo->queueUnderruns());
+            TEST_ASSERT_LESS_OR_EQUAL(motor.maxSpeed * 20,
+                                      rig.servo->stats().peakSpeed);
+
+            // Within 5 % where it spans a few steps, otherwise within the
+            // rounding to whole steps
+            if (amplitude * 20.0f >= 4.0f) {
+                TEST_ASSERT_FLOAT_WITHIN(0.05f * amplitude, amplitude, got);
+            } else {
+                TEST_ASSERT_FLOAT_WITHIN(0.5f / 20.0f, amplitude, got);
+            }
+        }
+    }
+}
+
+// Phase error of the reversals against a beat over half an hour. The tempo
+// is off the 1 ms tick on purpose. Without the lock the strokes run at the
+// pattern's own pace and drift through the whole beat.
+void test_sim_benchmark_tempo_phase_error() {
+    const float bpm = 123.7f;
+    const double period = 60.0e6 / bpm;
+    const uint64_t minutes = 30;
+
+    printf("\n  tempo lock, %.1f bpm, %llu minutes, 500 ms strokes\n", bpm,
+           (unsigned long long)minutes);
+    printf("  %-8s %10s %10s %10s %10s %10s\n", "lock", "reversals",
+           "mean ms", "p95 ms", "max ms", "drift ms");
+    for (bool lock : {true, false}) {
+        Rig rig;
+        rig.engine->setDepth(150.0f, false);
+        rig.engine->setStroke(100.0f, false);
+        rig.engine->setSpeed(30.0f, false);
+        rig.engine->startPattern();
+        sim::runFor(1000000);
+
+        uint64_t beat = sim::nowMicros();
+        if (lock) {
+            rig.engine->setTempo(bpm, uint32_t(beat));
+        }
+        // Time to lock
+        sim::runFor(10000000);
+
+        std::vector<double> errors;
+        double drift = 0.0;
+        for (uint64_t second = 0; second < minutes * 60; second++) {
+            rig.servo->clearEvents();
+            sim::runFor(1000000);
+            for (uint64_t time : reversalTimes(rig)) {
+                double error = offBeat(time, beat, period);
+                drift = error;
+                errors.push_back(fabs(error) / 1000.0);
+            }
+        }
+
+        std::sort(errors.begin(), errors.end());
+        double mean = 0.0;
+        for (double error : errors) mean += error;
+        mean /= errors.size();
+        double p95 = errors[errors.size() * 95 / 100];
+        printf("  %-8s %10zu %10.2f %10.2f %10.2f %10.2f\n",
+               lock ? "on" : "off", errors.size(), mean, p95, errors.back(),
+               drift / 1000.0);
+
+        TEST_ASSERT_EQUAL(PATTERN, rig.engine->getState());
+        if (lock) {
+            // One reversal per beat, each within a couple of ticks
+            TEST_ASSERT_INT_WITHIN(10, int(minutes * 60e6 / period),
+                                   int(errors.size()));
+            TEST_ASSERT_LESS_THAN_FLOAT(2.0f, float(p95));
+            TEST_ASSERT_LESS_THAN_FLOAT(5.0f, float(errors.back()));
+        } else {
+            // Spread over the whole beat
+            TEST_ASSERT_GREATER_THAN_FLOAT(float(period / 8000.0), float(mean));
+        }
+    }
+}
+
+// Streamed position traces, in mm at t seconds
+static float streamTrace(int trace, double t) {
+    switch (trace) {
+        case 0:  // Sine, 1.5 Hz
+            return float(75.0 + 50.0 * sin(2.0 * M_PI * 1.5 * t));
+        case 1: {  // Triangle at 300 mm/s, abrupt reversals
+            double phase = fmod(t * 1.5, 1.0);
+            return float(25.0 + 200.0 * (phase < 0.5 ? phase : 1.0 - phase));
+        }
+        default:  // Fast strokes riding on a slow sweep
+            return float(85.0 + 40.0 * sin(2.0 * M_PI * 0.25 * t) +
+                         25.0 * sin(2.0 * M_PI * 2.0 * t));
+    }
+}
+
+struct TraceResult {
+    double rmsMm = 0.0;        // against the trace, at the same time
+    double lagMs = 0.0;        // delay that fits the trace best
+    double rmsLaggedMm = 0.0;  // against the trace, delayed by the lag
+    double worstArrivalMm = 0.0;
+};
+
+// Replays a trace like a remote would: a sample every 10 ms, each sent
+// 200 ms before its arrival time. The carriage is sampled every 5 ms.
+static TraceResult replayTrace(int trace, uint8_t lookahead,
+                               float maxAcceleration) {
+    const uint64_t sample = 10000;
+    const uint64_t lead = 200000;
+    const uint64_t tick = 5000;
+    const uint64_t duration = 20000000;
+
+    Rig rig;
+    rig.engine->setStreamLookahead(lookahead);
+    rig.engine->setStreamLimits(motor.maxSpeed, maxAcceleration);
+    rig.engine->startStreaming();
+
+    uint64_t origin = sim::nowMicros() + lead;
+    size_t sent = 0;
+    TraceResult result;
+    std::vector<float> carriage;
+    std::vector<uint64_t> times;
+    while (sim::nowMicros() < origin + duration) {
+        while (origin + sent * sample <= sim::nowMicros() + lead) {
+            uint64_t arrival = origin + sent * sample;
+            rig.engine->streamTo(streamTrace(trace, sent * sample * 1.0e-6),
+                                 uint32_t(arrival));
+            sent++;
+        }
+        float position = positionAt(rig, sim::nowMicros() + tick);
+        if (sim::nowMicros() < origin) {
+            continue;
+        }
+        uint64_t since = sim::nowMicros() - origin;
+        carriage.push_back(position);
+        times.push_back(since);
+        if (since % sample == 0 && since >= 1000000) {
+            double error = fabs(position - streamTrace(trace, since * 1.0e-6));
+            result.worstArrivalMm = fmax(result.worstArrivalMm, error);
+        }
+    }
+
+    // The trace as streamed, straight lines between the samples
+    auto streamed = [&](double t) {
+        double k = floor(t / (sample * 1.0e-6));
+        double share = t / (sample * 1.0e-6) - k;
+        double a = streamTrace(trace, k * sample * 1.0e-6);
+        double b = streamTrace(trace, (k + 1.0) * sample * 1.0e-6);
+        return a + (b - a) * share;
+    };
+    // Skip the first second while the queue fills
+    double best = 1.0e9;
+    for (int shift = 0; shift <= 60; shift++) {
+        double sum = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < carriage.size(); i++) {
+            if (times[i] < 1000000) {
+                continue;
+            }
+            double t = double(times[i] - shift * tick) * 1.0e-6;
+            double error = carriage[i] - streamed(t);
+            sum += error * error;
+            count++;
+        }
+        double rms = sqrt(sum / count);
+        if (shift == 0) result.rmsMm = rms;
+        if (rms < best) {
+            best = rms;
+            result.lagMs = shift * tick / 1000.0;
+            result.rmsLaggedMm = rms;
+        }
+    }
+    return result;
+}
+
+// Tracking of streamed traces with the speeds planned over the queued
+// segments, against stopping at every target and looking one segment
+// ahead. The acceleration is what a low sensation setting leaves.
+void test_sim_benchmark_stream_lookahead() {
+    const char *names[] = {"sine", "triangle", "mixed"};
+    const uint8_t lookaheads[] = {0, 1, STROKE_STREAM_LOOKAHEAD_MAX};
+    const float acceleration = 5000.0f;
+
+    printf("\n  stream trace replay, samples every 10 ms sent 200 ms ahead, "
+           "%.0f mm/s²\n",
+           acceleration);
+    printf("  %-10s %10s %10s %10s %12s %12s\n", "trace", "lookahead",
+           "rms mm", "lag ms", "lagged rms", "worst mm");
+    for (int trace = 0; trace < 3; trace++) {
+        TraceResult results[3];
+        for (int i = 0; i < 3; i++) {
+            results[i] = replayTrace(trace, lookaheads[i], acceleration);
+            printf("  %-10s %10u %10.2f %10.1f %12.2f %12.2f\n", names[trace],
+                   lookaheads[i], results[i].rmsMm, results[i].lagMs,
+                   results[i].rmsLaggedMm, results[i].worstArrivalMm);
+        }
+        // Looking one segment ahead is how streaming used to plan
+        TEST_ASSERT_LESS_THAN_FLOAT(float(results[1].rmsMm),
+                                    float(results[2].rmsMm));
+        TEST_ASSERT_LESS_THAN_FLOAT(float(results[1].lagMs) + 1.0f,
+                                    float(results[2].lagMs));
+        TEST_ASSERT_LESS_THAN_FLOAT(float(results[1].worstArrivalMm),
+                                    float(results[2].worstArrivalMm));
+    }
+}
+
+// Exposes the task that runs the streamed segments
+class StreamProbe : public StrokeEngine {
+  public:
+    using StrokeEngine::_taskStreamingHandle;
+};
+
+// Wakeups of the streaming task while nothing is streamed and while a
+// remote streams a point every 10 ms, and the time from streamTo() to the
+// carriage starting. The streaming task used to check every tick.
+void test_sim_benchmark_stream_task_wakeups() {
+    Rig rig;
+    rig.engine->startStreaming();
+    TaskHandle_t task =
+        static_cast<StreamProbe *>(rig.engine)->_taskStreamingHandle;
+
+    uint64_t wakeups = sim::wakeups(task);
+    sim::runFor(2000000);
+    double idle = (sim::wakeups(task) - wakeups) / 2.0;
+
+    // Short moves from rest, each streamed somewhere between two ticks. The
+    // simulated carriage moves in steps of kStepMicros, so do these times.
+    std::vector<double> latencies;
+    for (int i = 0; i < 40; i++) {
+        positionAt(rig, sim::nowMicros() + 150000 + (i * 130) % 1000);
+        rig.servo->clearEvents();
+        uint64_t streamed = sim::nowMicros();
+        rig.engine->streamTo((i % 2 == 0) ? 10.0f : 0.0f,
+                             uint32_t(streamed + 100000));
+        streamed -= streamed % FastAccelStepper::kStepMicros;
+        while (rig.servo->events().empty()) {
+            positionAt(rig, sim::nowMicros() + 10);
+        }
+        TEST_ASSERT_EQUAL(sim::MotionEvent::START,
+                          rig.servo->events()[0].type);
+        latencies.push_back(
+            double(rig.servo->events()[0].micros - streamed));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0.0;
+    for (double latency : latencies) mean += latency / latencies.size();
+
+    // The sine trace, a point every 10 ms sent 200 ms ahead
+    uint64_t origin = sim::nowMicros() + 200000;
+    wakeups = sim::wakeups(task);
+    for (size_t sent = 0; sent < 500; sent++) {
+        uint64_t arrival = origin + sent * 10000;
+        if (arrival > sim::nowMicros() + 200000) {
+            sim::runFor(arrival - 200000 - sim::nowMicros());
+        }
+        rig.engine->streamTo(50.0f + streamTrace(0, sent * 0.01) / 2.0f,
+                             uint32_t(arrival));
+    }
+    double streaming = (sim::wakeups(task) - wakeups) / 5.0;
+
+    printf("\n  streaming task: %.0f wakeups/s idle, %.0f wakeups/s at a "
+           "point every 10 ms\n"
+           "  streamTo() to carriage start: mean %.0f us, max %.0f us\n",
+           idle, streaming, mean, latencies.back());
+
+    TEST_ASSERT_LESS_THAN(5, idle);
+    TEST_ASSERT_LESS_THAN(300, streaming);
+    TEST_ASSERT_LESS_THAN(50, latencies.back());
+}
+
+void test_sim_benchmark_full_speed_strong_sensation() {
+    benchmarkAllPatterns(100.0f, 80.0f);
+    benchmarkAllPatterns(100.0f, -80.0f);
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_sim_delay_advances_virtual_time);
+    RUN_TEST(test_sim_suspended_task_does_not_run);
+    RUN_TEST(test_sim_reset_rewinds_clock);
+
+    RUN_TEST(test_sim_stepper_triangular_move_time);
+    RUN_TEST(test_sim_stepper_trapezoidal_move_respects_limits);
+    RUN_TEST(test_sim_stepper_linear_acceleration_limits_start_stop_jerk);
+    RUN_TEST(test_sim_stepper_retarget_while_moving_reverses);
+    RUN_TEST(test_sim_stepper_stop_move_ramps_down);
+
+    RUN_TEST(test_sim_engine_strokes_between_depth_and_stroke);
+    RUN_TEST(test_sim_engine_stop_motion_comes_to_rest);
+
+    RUN_TEST(test_sim_engine_jerk_limit_shapes_start_and_stop);
+    RUN_TEST(test_sim_engine_pattern_jerk_is_capped_by_machine);
+
+    RUN_TEST(test_sim_lookahead_keeps_stroke_sequence);
+    RUN_TEST(test_sim_lookahead_keeps_stop_n_go_pauses);
+    RUN_TEST(test_sim_lookahead_half_n_half_survives_setting_change);
+    RUN_TEST(test_sim_lookahead_setting_is_constrained);
+    RUN_TEST(test_sim_lookahead_setting_change_takes_effect_next_stroke);
+
+    RUN_TEST(test_sim_pattern_switch_while_stroking);
+    RUN_TEST(test_sim_setters_hammered_while_stroking);
+    RUN_TEST(test_sim_crossfade_switch_keeps_moving);
+    RUN_TEST(test_sim_crossfade_switch_during_fade);
+
+    RUN_TEST(test_sim_stream_only_from_ready);
+    RUN_TEST(test_sim_stream_arrives_on_time);
+    RUN_TEST(test_sim_stream_same_direction_does_not_stop);
+    RUN_TEST(test_sim_stream_too_fast_is_clipped_and_catches_up);
+    RUN_TEST(test_sim_stream_follows_stream_limits);
+    RUN_TEST(test_sim_stream_stop_discards_queue);
+    RUN_TEST(test_sim_stream_slows_down_before_reversal);
+    RUN_TEST(test_sim_stream_lookahead_setting_is_constrained);
+
+    RUN_TEST(test_sim_stop_async_returns_at_once_and_notifies);
+    RUN_TEST(test_sim_stop_when_at_rest_notifies_right_away);
+    RUN_TEST(test_sim_move_to_min_starts_after_the_stop);
+    RUN_TEST(test_sim_setup_depth_follows_depth_set_while_stopping);
+    RUN_TEST(test_sim_pattern_takes_over_from_pending_move);
+
+    RUN_TEST(test_sim_homing_polled_finds_switch);
+    RUN_TEST(test_sim_homing_latched_is_exact_at_speed);
+    RUN_TEST(test_sim_homing_latched_starting_on_switch);
+    RUN_TEST(test_sim_homing_latched_waits_for_a_late_interrupt);
+
+    RUN_TEST(test_sim_vibration_overlays_the_pattern);
+    RUN_TEST(test_sim_vibration_is_clamped_to_envelope);
+    RUN_TEST(test_sim_vibration_keeps_stroking_at_speed);
+    RUN_TEST(test_sim_vibration_off_hands_back_to_ramp);
+    RUN_TEST(test_sim_vibration_stop_comes_to_rest);
+    RUN_TEST(test_sim_vibration_restart_while_braking_starts_afresh);
+
+    RUN_TEST(test_sim_tempo_lands_reversals_on_beats);
+    RUN_TEST(test_sim_tempo_subdivides_fast_strokes);
+    RUN_TEST(test_sim_tempo_too_fast_for_machine_skips_beats);
+    RUN_TEST(test_sim_tempo_off_runs_free);
+
+    RUN_TEST(test_sim_benchmark_half_speed);
+    RUN_TEST(test_sim_benchmark_full_speed);
+    RUN_TEST(test_sim_benchmark_full_speed_strong_sensation);
+    RUN_TEST(test_sim_benchmark_lookahead_gain);
+    RUN_TEST(test_sim_benchmark_jerk_limit);
+    RUN_TEST(test_sim_benchmark_stop_frees_caller_cpu);
+    RUN_TEST(test_sim_benchmark_homing_edge_timing);
+    RUN_TEST(test_sim_benchmark_vibration_envelope);
+    RUN_TEST(test_sim_benchmark_tempo_phase_error);
+    RUN_TEST(test_sim_benchmark_stream_lookahead);
+    RUN_TEST(test_sim_benchmark_stream_task_wakeups);
+
+    return UNITY_END();
+}
@@ -0,0 +1,408 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ STREAM PACKET — UNIT TESTS & BENCHMARK                                 │
+// │                                                                        │
+// │ Tests for lib/OSSMLogic/src/stream_packet.h, the binary packets that   │
+// │ carry many stream targets in one BLE write:                            │
+// │   Decode — Base plus deltas, in order, into the target ring            │
+// │            Version 2 stamps the points in device time                  │
+// │   Reject — Bad packets queue nothing                                   │
+// │            A packet the queue has no room for is refused whole         │
+// │   MTU    — Points per write for the negotiated MTU                     │
+// │                                                                        │
+// │ The benchmark prints points/s decoded into the ring against the text   │
+// │ command path: regex match, copy, queue and parse of stream:<pos>:<ms>. │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <regex>
+#include <string>
+
+using namespace fakeit;
+
+#include "ring_buffer.h"
+#include "stream_packet.h"
+
+using stream_packet::Error;
+using stream_packet::Point;
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Same layout as the firmware's PositionTime
+struct Target {
+    uint16_t position;
+    uint32_t inTime;
+    std::chrono::steady_clock::time_point setTime;
+    int direction;
+};
+
+using TargetRing = ring_buffer::Ring<Target, 128>;
+
+static Error decodeInto(TargetRing &ring, const uint8_t *data, size_t size) {
+    auto received = std::chrono::steady_clock::now();
+    return stream_packet::decode(data, size, [&](const Point &point) {
+        ring.push({point.position, point.time, received, 0});
+    });
+}
+
+// A sine sweep as a client would stream it, every 10 ms
+static size_t makePoints(Point *points, size_t count, uint32_t start) {
+    for (size_t i = 0; i < count; i++) {
+        double phase = double(start + i * 10) * 0.001 * 2.0 * 3.14159265;
+        points[i].position = uint16_t(5000.0 + 4999.0 * sin(phase));
+        points[i].time = start + uint32_t(i) * 10;
+    }
+    return count;
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Decode
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_packet_layout() {
+    const Point points[] = {{1000, 50}, {1200, 60}, {900, 80}};
+    uint8_t packet[32];
+    TEST_ASSERT_EQUAL(20, stream_packet::encode(points, 3, packet, 32));
+
+    const uint8_t expected[] = {
+        1,    3,                  // version, count
+        50,   0,    0, 0,         // base time
+        0xE8, 0x03,               // base position 1000
+        0,    0,    0, 0,         // first point at the base
+        200,  0,    10, 0,        // +200, 10 ms
+        0xD4, 0xFE, 20, 0,        // -300, 20 ms
+    };
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, packet, sizeof(expected));
+}
+
+void test_packet_round_trip() {
+    Point points[100];
+    makePoints(points, 100, 250);
+    uint8_t packet[stream_packet::packetSize(100)];
+    size_t size = stream_packet::encode(points, 100, packet, sizeof(packet));
+    TEST_ASSERT_EQUAL(sizeof(packet), size);
+
+    size_t count = 0;
+    bool same = true;
+    Error error = stream_packet::decode(packet, size, [&](const Point &p) {
+        same = same && p.position == points[count].position &&
+               p.time == points[count].time;
+        count++;
+    });
+    TEST_ASSERT_EQUAL(int(Error::None), int(error));
+    TEST_ASSERT_EQUAL(100, count);
+    TEST_ASSERT_TRUE(same);
+}
+
+void test_packet_decodes_into_ring() {
+    TargetRing ring;
+    const Point points[] = {{0, 0}, {10000, 400}, {5000, 65935}};
+    uint8_t packet[32];
+    size_t size = stream_packet::encode(points, 3, packet, sizeof(packet));
+    TEST_ASSERT_EQUAL(int(Error::None), int(decodeInto(ring, packet, size)));
+
+    Target first, second, third;
+    TEST_ASSERT_TRUE(ring.pop(first));
+    TEST_ASSERT_TRUE(ring.pop(second));
+    TEST_ASSERT_TRUE(ring.pop(third));
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL(0, first.position);
+    TEST_ASSERT_EQUAL(10000, second.position);
+    TEST_ASSERT_EQUAL(400, second.inTime);
+    TEST_ASSERT_EQUAL(5000, third.position);
+    TEST_ASSERT_EQUAL(65935, third.inTime);
+
+    // All points of a packet count from when it arrived
+    TEST_ASSERT_TRUE(first.setTime == third.setTime);
+}
+
+void test_packet_first_point_may_move_off_base() {
+    // Hand made: base 2000 at 100 ms, first point +500 and +20 ms
+    const uint8_t packet[] = {1, 1, 100, 0, 0, 0, 0xD0, 0x07, 0xF4, 0x01, 20, 0};
+    Point point = {};
+    Error error = stream_packet::decode(packet, sizeof(packet),
+                                        [&](const Point &p) { point = p; });
+    TEST_ASSERT_EQUAL(int(Error::None), int(error));
+    TEST_ASSERT_EQUAL(2500, point.position);
+    TEST_ASSERT_EQUAL(120, point.time);
+}
+
+void test_packet_encode_refuses_what_does_not_fit() {
+    uint8_t packet[stream_packet::packetSize(stream_packet::pointsMax)];
+    Point points[2] = {{100, 0}, {200, 70000}};
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 2, packet, 64));
+
+    points[1] = {200, 0};
+    points[0].time = 10;
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 2, packet, 64));
+
+    points[0] = {10001, 0};
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 2, packet, 64));
+
+    points[0] = {100, 0};
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 2, packet, 15));
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 0, packet, 64));
+}
+
+void test_packet_device_time_version() {
+    // Device times wrap around with millis()
+    const Point points[] = {{3000, 0xFFFFFFF0u}, {3500, 5}};
+    uint8_t packet[32];
+    size_t size = stream_packet::encode(points, 2, packet, sizeof(packet),
+                                        stream_packet::versionDeviceTime);
+    TEST_ASSERT_EQUAL(16, size);
+    TEST_ASSERT_EQUAL(2, packet[0]);
+    TEST_ASSERT_TRUE(stream_packet::deviceTime(packet));
+
+    Point last = {};
+    Error error = stream_packet::decode(packet, size,
+                                        [&](const Point &p) { last = p; });
+    TEST_ASSERT_EQUAL(int(Error::None), int(error));
+    TEST_ASSERT_EQUAL(3500, last.position);
+    TEST_ASSERT_EQUAL_UINT32(5, last.time);
+
+    // Version 1 times are from arrival and don't wrap
+    TEST_ASSERT_EQUAL(0, stream_packet::encode(points, 2, packet,
+                                               sizeof(packet)));
+    packet[0] = stream_packet::version;
+    TEST_ASSERT_FALSE(stream_packet::deviceTime(packet));
+    TEST_ASSERT_EQUAL(int(Error::BadTime),
+                      int(stream_packet::decode(packet, size,
+                                                [](const Point &) {})));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Reject
+// ═══════════════════════════════════════════════════════════════════════════
+
+static Error rejectInto(TargetRing &ring, const uint8_t *packet,
+                        size_t size) {
+    Error error = decodeInto(ring, packet, size);
+    TEST_ASSERT_TRUE(ring.empty());
+    return error;
+}
+
+void test_packet_rejects_bad_header() {
+    TargetRing ring;
+    const uint8_t good[] = {1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8_t packet[sizeof(good) + 4];
+
+    memcpy(packet, good, sizeof(good));
+    TEST_ASSERT_EQUAL(int(Error::TooShort), int(rejectInto(ring, packet, 7)));
+
+    packet[0] = 3;
+    TEST_ASSERT_EQUAL(int(Error::BadVersion),
+                      int(rejectInto(ring, packet, sizeof(good))));
+
+    packet[0] = 1;
+    packet[1] = 0;
+    TEST_ASSERT_EQUAL(int(Error::NoPoints),
+                      int(rejectInto(ring, packet, stream_packet::headerSize)));
+
+    packet[1] = 2;
+    TEST_ASSERT_EQUAL(int(Error::BadLength),
+                      int(rejectInto(ring, packet, sizeof(good))));
+    packet[1] = 1;
+    TEST_ASSERT_EQUAL(int(Error::BadLength),
+                      int(rejectInto(ring, packet, sizeof(packet))));
+}
+
+void test_packet_rejects_position_out_of_range_as_a_whole() {
+    TargetRing ring;
+    // 9000, then +1000, then +1 past the end
+    const uint8_t packet[] = {1,    3, 0,    0, 0, 0, 0x28, 0x23,
+                              0,    0, 0,    0, 0xE8, 0x03, 10, 0,
+                              0x01, 0, 10,   0};
+    TEST_ASSERT_EQUAL(int(Error::BadPosition),
+                      int(rejectInto(ring, packet, sizeof(packet))));
+
+    // Below 0
+    const uint8_t below[] = {1, 1, 0, 0, 0, 0, 5, 0, 0xFA, 0xFF, 0, 0};
+    TEST_ASSERT_EQUAL(int(Error::BadPosition),
+                      int(rejectInto(ring, below, sizeof(below))));
+}
+
+void test_packet_rejects_time_overflow() {
+    TargetRing ring;
+    const uint8_t packet[] = {1, 1, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 1, 0};
+    TEST_ASSERT_EQUAL(int(Error::BadTime),
+                      int(rejectInto(ring, packet, sizeof(packet))));
+}
+
+void test_packet_back_to_back_full_packets_are_not_dropped() {
+    // As on the device: the queue drops its oldest targets when full
+    TargetRing ring(ring_buffer::Overflow::DropOldest);
+    const size_t count = stream_packet::maxPoints(512);
+    Point points[stream_packet::pointsMax];
+    uint8_t first[stream_packet::packetSize(stream_packet::pointsMax)];
+    uint8_t second[sizeof(first)];
+    makePoints(points, count, 0);
+    size_t size = stream_packet::encode(points, count, first, sizeof(first));
+    makePoints(points, count, uint32_t(count) * 10);
+    stream_packet::encode(points, count, second, sizeof(second));
+
+    // Two full writes before the streaming task runs. The second one does
+    // not fit and is refused instead of pushing out the first.
+    auto room = [&ring]() { return ring.capacity() - ring.size(); };
+    auto sink = [&ring](const Point &point) {
+        ring.push({point.position, point.time, {}, 0});
+    };
+    TEST_ASSERT_EQUAL(int(Error::None),
+                      int(stream_packet::decode(first, size, room(), sink)));
+    TEST_ASSERT_EQUAL(int(Error::NoRoom),
+                      int(stream_packet::decode(second, size, room(), sink)));
+    TEST_ASSERT_EQUAL(count, ring.size());
+    TEST_ASSERT_EQUAL(0, ring.overflows());
+
+    Target target;
+    TEST_ASSERT_TRUE(ring.pop(target));
+    TEST_ASSERT_EQUAL(0, target.inTime);
+
+    // Once the streaming task has taken the first one, it fits
+    while (ring.pop(target)) {
+    }
+    TEST_ASSERT_EQUAL(int(Error::None),
+                      int(stream_packet::decode(second, size, room(), sink)));
+    TEST_ASSERT_TRUE(ring.pop(target));
+    TEST_ASSERT_EQUAL(count * 10, target.inTime);
+}
+
+void test_packet_error_names() {
+    TEST_ASSERT_EQUAL_STRING("ok", stream_packet::errorName(Error::None));
+    TEST_ASSERT_EQUAL_STRING("bad_length",
+                             stream_packet::errorName(Error::BadLength));
+    TEST_ASSERT_EQUAL_STRING("bad_time",
+                             stream_packet::errorName(Error::BadTime));
+    TEST_ASSERT_EQUAL_STRING("no_room",
+                             stream_packet::errorName(Error::NoRoom));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// MTU
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_packet_points_per_mtu() {
+    // The default MTU leaves 20 bytes: header and 3 points
+    TEST_ASSERT_EQUAL(3, stream_packet::maxPoints(23));
+    TEST_ASSERT_EQUAL(59, stream_packet::maxPoints(247));
+    TEST_ASSERT_EQUAL(125, stream_packet::maxPoints(512));
+    TEST_ASSERT_EQUAL(0, stream_packet::maxPoints(14));
+    TEST_ASSERT_EQUAL(1, stream_packet::maxPoints(15));
+    TEST_ASSERT_EQUAL(stream_packet::pointsMax,
+                      stream_packet::maxPoints(65535));
+
+    for (uint16_t mtu : {23, 100, 185, 247, 512}) {
+        size_t points = stream_packet::maxPoints(mtu);
+        TEST_ASSERT_TRUE(stream_packet::packetSize(points) <=
+                         mtu - stream_packet::attOverhead);
+        TEST_ASSERT_TRUE(stream_packet::packetSize(points + 1) >
+                         mtu - stream_packet::attOverhead);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+// The text path as far as it runs on the host: the command regex, the copy
+// into the message queue and the parse in OSSM::ble_click
+static const std::regex commandRegex(
+    R"(go:(simplePenetration|strokeEngine|streaming|menu)|set:(speed|stroke|depth|sensation|buffer|pattern):\d+|set:wifi:[^|]+\|.+|stream:\d+:\d+|funscript:(play:/[^|]+|seek:\d+|stop))");
+
+static void textPath(TargetRing &ring, std::queue<std::string> &messages,
+                     const std::string &command) {
+    if (!std::regex_match(command, commandRegex)) return;
+    messages.push(command);
+
+    std::string queued = messages.front();
+    messages.pop();
+    size_t first = queued.find(':');
+    size_t last = queued.rfind(':');
+    int position = atoi(queued.substr(first + 1, last - first - 1).c_str());
+    int time = atoi(queued.substr(last + 1).c_str());
+    ring.push({uint16_t(position * 100), uint32_t(time),
+               std::chrono::steady_clock::now(), 0});
+}
+
+void test_packet_throughput() {
+    const int kRounds = 20000;
+    TargetRing ring(ring_buffer::Overflow::DropOldest);
+    Target target = {};
+
+    printf("\n  %-24s %8s %14s %12s\n", "path", "points", "points/s",
+           "ns/point");
+    for (uint16_t mtu : {23, 247, 512}) {
+        size_t count = stream_packet::maxPoints(mtu);
+        Point points[stream_packet::pointsMax];
+        makePoints(points, count, 0);
+        uint8_t packet[stream_packet::packetSize(stream_packet::pointsMax)];
+        size_t size = stream_packet::encode(points, count, packet,
+                                            sizeof(packet));
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRounds; i++) {
+            TEST_ASSERT_EQUAL(int(Error::None),
+                              int(decodeInto(ring, packet, size)));
+            while (ring.pop(target)) {
+            }
+        }
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        double decoded = double(kRounds) * count;
+        printf("  binary, MTU %-12u %8zu %14.0f %12.1f\n", mtu, count,
+               decoded / seconds, seconds * 1e9 / decoded);
+    }
+
+    std::queue<std::string> messages;
+    std::string command = "stream:42:10";
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        textPath(ring, messages, command);
+        ring.pop(target);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    printf("  %-24s %8d %14.0f %12.1f\n", "text stream:<pos>:<ms>", 1,
+           kRounds / seconds, seconds * 1e9 / kRounds);
+
+    TEST_ASSERT_EQUAL(4200, target.position);
+    TEST_ASSERT_EQUAL(0, ring.overflows());
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_packet_layout);
+    RUN_TEST(test_packet_round_trip);
+    RUN_TEST(test_packet_decodes_into_ring);
+    RUN_TEST(test_packet_first_point_may_move_off_base);
+    RUN_TEST(test_packet_encode_refuses_what_does_not_fit);
+    RUN_TEST(test_packet_device_time_version);
+
+    RUN_TEST(test_packet_rejects_bad_header);
+    RUN_TEST(test_packet_rejects_position_out_of_range_as_a_whole);
+    RUN_TEST(test_packet_rejects_time_overflow);
+    RUN_TEST(test_packet_back_to_back_full_packets_are_not_dropped);
+    RUN_TEST(test_packet_error_names);
+
+    RUN_TEST(test_packet_points_per_mtu);
+
+    RUN_TEST(test_packet_throughput);
+
+    return UNITY_END();
+}
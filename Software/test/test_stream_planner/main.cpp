@@ -0,0 +1,239 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ STREAM PLANNER — UNIT TESTS                                            │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/StreamPlanner.h, with a speed limit of  │
+// │ 10000 steps/s and an acceleration limit of 100000 steps/s²:            │
+// │   Junctions — Same direction flows, reversals and holds stop           │
+// │   Backward  — Exit speeds leave room to stop by the end of the window  │
+// │   Room      — Distance to run on past a target before the next stop    │
+// │   Forward   — Exit speeds stay within reach from the current speed     │
+// │   Window    — Capacity and the exit speeds given with segments         │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cmath>
+
+using namespace fakeit;
+
+#include "StreamPlanner.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static const float kMaxSpeed = 10000.0f;
+static const float kMaxAcceleration = 100000.0f;
+
+// Speed reached from v over distance d at the acceleration limit
+static float reach(float v, float d) {
+    return sqrtf(v * v + 2.0f * kMaxAcceleration * d);
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Junctions
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_planner_empty_window() {
+    StreamPlanner planner;
+    planner.plan(1000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL(0, planner.count());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(0));
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, planner.entrySpeed(0));
+}
+
+void test_planner_single_segment_stops() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f);
+    planner.plan(0.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(0));
+}
+
+void test_planner_same_direction_takes_slower_average() {
+    // 4000 steps/s, then 2000 steps/s, then plenty of room to stop
+    StreamPlanner planner;
+    planner.add(2000, 0.5f);
+    planner.add(1000, 0.5f);
+    planner.add(20000, 2.0f);
+    planner.plan(4000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 2000.0f, planner.exitSpeed(0));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 2000.0f, planner.exitSpeed(1));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(2));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 2000.0f, planner.entrySpeed(1));
+}
+
+void test_planner_reversal_stops() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f);
+    planner.add(-2000, 0.5f);
+    planner.add(-2000, 0.5f);
+    planner.plan(4000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(0));
+    TEST_ASSERT_GREATER_THAN_FLOAT(0.0f, planner.exitSpeed(1));
+}
+
+void test_planner_hold_stops() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f);
+    planner.add(0, 0.5f);
+    planner.add(2000, 0.5f);
+    planner.plan(4000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(0));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(1));
+}
+
+void test_planner_late_segment_runs_at_max_speed() {
+    StreamPlanner planner;
+    planner.add(5000, 0.0f);
+    planner.add(50000, -0.1f);
+    planner.add(100000, 20.0f);
+    planner.plan(kMaxSpeed, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(kMaxSpeed, planner.exitSpeed(0));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 5000.0f, planner.exitSpeed(1));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Backward
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_planner_slows_down_before_reversal() {
+    // Fast run into short segments before a reversal: the junctions back
+    // off so the carriage can still stop where it turns
+    StreamPlanner planner;
+    planner.add(4000, 0.5f);
+    planner.add(100, 0.01f);
+    planner.add(100, 0.01f);
+    planner.add(-4000, 0.5f);
+    planner.plan(8000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(2));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 100.0f), planner.exitSpeed(1));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 200.0f), planner.exitSpeed(0));
+}
+
+void test_planner_room_runs_to_next_stop() {
+    StreamPlanner planner;
+    planner.add(1000, 0.1f);
+    planner.add(500, 0.05f);
+    planner.add(300, 0.03f);
+    planner.add(-800, 0.08f);
+    planner.plan(10000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(800.0f, planner.room(0));
+    TEST_ASSERT_EQUAL_FLOAT(300.0f, planner.room(1));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.room(2));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.room(3));
+}
+
+void test_planner_stops_by_end_of_window() {
+    // Nothing is known beyond the window, so it has to end standing still
+    StreamPlanner planner;
+    for (int i = 0; i < 4; i++) {
+        planner.add(200, 0.02f);
+    }
+    planner.plan(10000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(3));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 200.0f), planner.exitSpeed(2));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 400.0f), planner.exitSpeed(1));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 10000.0f, planner.exitSpeed(0));
+}
+
+void test_planner_exit_speeds_are_brakeable() {
+    StreamPlanner planner;
+    const int distances[] = {3000, 200, 800, 50, 50, 1500, -400, -400};
+    for (int distance : distances) {
+        planner.add(distance, 0.02f);
+    }
+    planner.plan(kMaxSpeed, kMaxSpeed, kMaxAcceleration);
+    for (size_t i = 0; i + 1 < planner.count(); i++) {
+        float next = fabsf(float(distances[i + 1]));
+        TEST_ASSERT_TRUE(planner.exitSpeed(i) <=
+                         reach(planner.exitSpeed(i + 1), next) + 0.5f);
+    }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Forward
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_planner_exit_speed_within_reach_from_standstill() {
+    StreamPlanner planner;
+    planner.add(200, 0.01f);
+    planner.add(20000, 2.0f);
+    planner.add(20000, 2.0f);
+    planner.plan(0.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 200.0f), planner.exitSpeed(0));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, reach(0.0f, 200.0f), planner.entrySpeed(1));
+}
+
+void test_planner_start_speed_limited() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f);
+    planner.plan(2.0f * kMaxSpeed, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(kMaxSpeed, planner.entrySpeed(0));
+    planner.plan(-500.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.entrySpeed(0));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Window
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_planner_window_capacity() {
+    StreamPlanner planner;
+    for (size_t i = 0; i < StreamPlanner::Capacity; i++) {
+        TEST_ASSERT_TRUE(planner.add(100, 0.1f));
+    }
+    TEST_ASSERT_FALSE(planner.add(100, 0.1f));
+    TEST_ASSERT_EQUAL(StreamPlanner::Capacity, planner.count());
+    planner.clear();
+    TEST_ASSERT_EQUAL(0, planner.count());
+}
+
+void test_planner_given_exit_speed_replaces_junction() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f, 1000.0f);
+    planner.add(2000, 0.5f, 0.0f);
+    planner.add(2000, 0.5f);
+    planner.add(20000, 2.0f);
+    planner.plan(4000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 1000.0f, planner.exitSpeed(0));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(1));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 4000.0f, planner.exitSpeed(2));
+}
+
+void test_planner_given_exit_speed_still_stops_at_reversal() {
+    StreamPlanner planner;
+    planner.add(2000, 0.5f, 5000.0f);
+    planner.add(-2000, 0.5f);
+    planner.plan(4000.0f, kMaxSpeed, kMaxAcceleration);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, planner.exitSpeed(0));
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_planner_empty_window);
+    RUN_TEST(test_planner_single_segment_stops);
+    RUN_TEST(test_planner_same_direction_takes_slower_average);
+    RUN_TEST(test_planner_reversal_stops);
+    RUN_TEST(test_planner_hold_stops);
+    RUN_TEST(test_planner_late_segment_runs_at_max_speed);
+
+    RUN_TEST(test_planner_slows_down_before_reversal);
+    RUN_TEST(test_planner_room_runs_to_next_stop);
+    RUN_TEST(test_planner_stops_by_end_of_window);
+    RUN_TEST(test_planner_exit_speeds_are_brakeable);
+
+    RUN_TEST(test_planner_exit_speed_within_reach_from_standstill);
+    RUN_TEST(test_planner_start_speed_limited);
+
+    RUN_TEST(test_planner_window_capacity);
+    RUN_TEST(test_planner_given_exit_speed_replaces_junction);
+    RUN_TEST(test_planner_given_exit_speed_still_stops_at_reversal);
+
+    return UNITY_END();
+}
@@ -1,4 +1,7 @@
+#include <ArduinoFake.h>
 #include <unity.h>
+
+#include "MotionLimits.h"
 #include "streaming_logic.h"
 
 void setUp(void) {}
@@ -64,81 +67,83 @@ void test_scaleStreamPosition_50_percent(void) {
     TEST_ASSERT_EQUAL_INT32(-4500, result);
 }
 
-// ─── planMotion ───
-
-void test_planMotion_short_distance_plenty_of_time(void) {
-    // Short move with ample time → valid triangular profile
-    auto profile = streaming_logic::planMotion(
-        0,       // currentPosition
-        1000,    // targetPosition
-        1.0f,    // timeSeconds
-        50000,   // maxSpeed
-        100000,  // maxAccel
-        1        // stepsPerMm
-    );
-    TEST_ASSERT_GREATER_THAN(0u, profile.speed);
-    TEST_ASSERT_GREATER_THAN(0u, profile.acceleration);
-    TEST_ASSERT_EQUAL_INT32(1000, profile.distance);
-    TEST_ASSERT_EQUAL_INT32(1000, profile.targetPosition);
-}
-
-void test_planMotion_distance_exceeds_max(void) {
-    // Very large distance, small time → distance gets clamped
-    auto profile = streaming_logic::planMotion(
-        0,       // currentPosition
-        100000,  // targetPosition (way too far)
-        0.1f,    // timeSeconds (very short)
-        5000,    // maxSpeed
-        100000,  // maxAccel
-        1        // stepsPerMm
-    );
-    // Distance should be clamped below the requested 100000
-    TEST_ASSERT_LESS_THAN(100000, profile.distance);
-    // Target should be adjusted
-    TEST_ASSERT_LESS_THAN(100000, profile.targetPosition);
-    TEST_ASSERT_GREATER_THAN(0u, profile.speed);
-    TEST_ASSERT_GREATER_THAN(0u, profile.acceleration);
-}
-
-void test_planMotion_speed_clamped_to_max(void) {
-    // Large distance, short time → speed would exceed maxSpeed, should be clamped
-    uint32_t maxSpeed = 1000;
-    auto profile = streaming_logic::planMotion(
-        0,       // currentPosition
-        500,     // targetPosition
-        0.5f,    // timeSeconds
-        maxSpeed,// maxSpeed
-        100000,  // maxAccel
-        1        // stepsPerMm
-    );
-    TEST_ASSERT_LESS_OR_EQUAL(maxSpeed, profile.speed);
-}
-
-void test_planMotion_accel_clamped_to_max(void) {
-    uint32_t maxAccel = 500;
-    auto profile = streaming_logic::planMotion(
-        0,       // currentPosition
-        100,     // targetPosition
-        0.5f,    // timeSeconds
-        50000,   // maxSpeed
-        maxAccel,// maxAccel
-        1        // stepsPerMm
-    );
-    TEST_ASSERT_LESS_OR_EQUAL(maxAccel, profile.acceleration);
-}
-
-void test_planMotion_very_short_time(void) {
-    // Very short time (0.01s) → profile still valid
-    auto profile = streaming_logic::planMotion(
-        0,       // currentPosition
-        5000,    // targetPosition
-        0.01f,   // timeSeconds
-        50000,   // maxSpeed
-        100000,  // maxAccel
-        1        // stepsPerMm
-    );
-    TEST_ASSERT_GREATER_THAN(0u, profile.speed);
-    TEST_ASSERT_GREATER_THAN(0u, profile.acceleration);
+// ─── toStrokeEnginePosition ───
+
+void test_toStrokeEnginePosition_home_is_minus_keepout(void) {
+    // Native 0 is the homed rest position, -keepout in the StrokeEngine frame
+    TEST_ASSERT_EQUAL_FLOAT(-6.0f,
+                            streaming_logic::toStrokeEnginePosition(0, 6.0f, 20.0f));
+}
+
+void test_toStrokeEnginePosition_extension_is_positive(void) {
+    // 100 mm out (native -2000 steps) is 94 mm into the StrokeEngine travel
+    TEST_ASSERT_EQUAL_FLOAT(
+        94.0f, streaming_logic::toStrokeEnginePosition(-2000, 6.0f, 20.0f));
+}
+
+// ─── planSegment ───
+
+void test_planSegment_rest_to_rest_is_triangle(void) {
+    // 1000 steps in 1 s from and to standstill: peak 2 d/T, accel 4 d/T²
+    motionParameter motion = {};
+    planSegment(motion, 1000, 1.0f, 0.0f, 0.0f, 50000);
+    TEST_ASSERT_INT_WITHIN(1, 2000, motion.speed);
+    TEST_ASSERT_INT_WITHIN(1, 4000, motion.acceleration);
+}
+
+void test_planSegment_direction_does_not_matter(void) {
+    motionParameter out = {};
+    motionParameter in = {};
+    planSegment(out, 1000, 0.5f, 0.0f, 0.0f, 50000);
+    planSegment(in, -1000, 0.5f, 0.0f, 0.0f, 50000);
+    TEST_ASSERT_EQUAL(out.speed, in.speed);
+    TEST_ASSERT_EQUAL(out.acceleration, in.acceleration);
+}
+
+void test_planSegment_cruises_at_max_speed(void) {
+    // A triangle would peak at 2000. At 1500 the trapezoid still arrives in
+    // time: 2 x 1500/4500 s of ramps plus 500 steps of cruise.
+    motionParameter motion = {};
+    planSegment(motion, 1000, 1.0f, 0.0f, 0.0f, 1500);
+    TEST_ASSERT_EQUAL(1500, motion.speed);
+    TEST_ASSERT_INT_WITHIN(1, 4500, motion.acceleration);
+}
+
+void test_planSegment_impossible_in_time_is_clipped(void) {
+    // 1000 steps in 100 ms need 10000 steps/s, the machine does 1500
+    motionParameter motion = {};
+    planSegment(motion, 1000, 0.1f, 0.0f, 0.0f, 1500);
+    int jerk = 0;
+    uint8_t clipped = limitMotion(motion, 1500, 100000, 0, jerk);
+    TEST_ASSERT_EQUAL(CLIP_SPEED | CLIP_ACCELERATION, clipped);
+    TEST_ASSERT_EQUAL(1500, motion.speed);
+    TEST_ASSERT_EQUAL(100000, motion.acceleration);
+}
+
+void test_planSegment_passes_through_at_cruise_speed(void) {
+    // Already at the average speed and passing on at it: no need to speed up
+    motionParameter motion = {};
+    planSegment(motion, 200, 0.1f, 2000.0f, 2000.0f, 50000);
+    TEST_ASSERT_INT_WITHIN(1, 2000, motion.speed);
+    TEST_ASSERT_LESS_THAN(100, motion.acceleration);
+}
+
+void test_planSegment_brakes_hard_enough_to_stop(void) {
+    // At 4000 steps/s with 100 steps to go there is no time to lose
+    motionParameter motion = {};
+    planSegment(motion, 100, 1.0f, 4000.0f, 0.0f, 50000);
+    TEST_ASSERT_GREATER_OR_EQUAL(4000 * 4000 / 200, motion.acceleration);
+}
+
+void test_planSegment_late_segment_goes_flat_out(void) {
+    // Arrival already passed
+    motionParameter motion = {};
+    planSegment(motion, 1000, -0.2f, 0.0f, 0.0f, 20000);
+    int jerk = 0;
+    uint8_t clipped = limitMotion(motion, 20000, 1000000, 0, jerk);
+    TEST_ASSERT_EQUAL(20000, motion.speed);
+    TEST_ASSERT_EQUAL(1000000, motion.acceleration);
+    TEST_ASSERT_TRUE(clipped & CLIP_ACCELERATION);
 }
 
 int main(int argc, char **argv) {
@@ -155,11 +160,16 @@ int main(int argc, char **argv) {
     RUN_TEST(test_scaleStreamPosition_0_percent);
     RUN_TEST(test_scaleStreamPosition_50_percent);
 
-    RUN_TEST(test_planMotion_short_distance_plenty_of_time);
-    RUN_TEST(test_planMotion_distance_exceeds_max);
-    RUN_TEST(test_planMotion_speed_clamped_to_max);
-    RUN_TEST(test_planMotion_accel_clamped_to_max);
-    RUN_TEST(test_planMotion_very_short_time);
+    RUN_TEST(test_toStrokeEnginePosition_home_is_minus_keepout);
+    RUN_TEST(test_toStrokeEnginePosition_extension_is_positive);
+
+    RUN_TEST(test_planSegment_rest_to_rest_is_triangle);
+    RUN_TEST(test_planSegment_direction_does_not_matter);
+    RUN_TEST(test_planSegment_cruises_at_max_speed);
+    RUN_TEST(test_planSegment_impossible_in_time_is_clipped);
+    RUN_TEST(test_planSegment_passes_through_at_cruise_speed);
+    RUN_TEST(test_planSegment_brakes_hard_enough_to_stop);
+    RUN_TEST(test_planSegment_late_segment_goes_flat_out);
 
     return UNITY_END();
 }
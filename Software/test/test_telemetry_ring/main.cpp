@@ -0,0 +1,350 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ TELEMETRY RING — UNIT & STRESS TESTS                                   │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/TelemetryRing.h, the queue handing move │
+// │ telemetry from the motion tasks to the low priority publish task:      │
+// │   push()      — Constant time, drops and counts when full              │
+// │   pop()       — Oldest first, one record or a batch                    │
+// │   peek()      — The same without taking them                           │
+// │                                                                        │
+// │ The stress test pushes from three writer threads (stroking task,       │
+// │ control task, homing task) while a reader drains in batches. No record │
+// │ may be lost without being counted, none may arrive twice or out of     │
+// │ order. The cost of a push is printed against the mutex + std::queue    │
+// │ a callback consumer would need.                                        │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace fakeit;
+
+#include "TelemetryRing.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+// Same size as StrokeEngine's telemetryRecord
+struct Record {
+    uint32_t micros;
+    float position;
+    float speed;
+    float acceleration;
+    int32_t index;
+    uint8_t clipping;
+};
+
+static Record makeRecord(int writer, int32_t index) {
+    Record r;
+    r.micros = uint32_t(index) * 3;
+    r.position = float(index % 150);
+    r.speed = float(writer);
+    r.acceleration = float(index) * 0.5f;
+    r.index = index;
+    r.clipping = uint8_t(writer);
+    return r;
+}
+
+static bool isConsistent(const Record &r) {
+    Record expected = makeRecord(int(r.clipping), r.index);
+    return expected.micros == r.micros && expected.position == r.position &&
+           expected.speed == r.speed &&
+           expected.acceleration == r.acceleration;
+}
+
+void setUp(void) {
+    ArduinoFakeReset();
+    When(Method(ArduinoFake(), millis)).AlwaysReturn(0);
+}
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Single thread
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_ring_starts_empty() {
+    TelemetryRing<Record, 8> ring;
+    Record r = makeRecord(0, 42);
+    TEST_ASSERT_FALSE(ring.pop(r));
+    TEST_ASSERT_EQUAL(42, r.index);
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_EQUAL(8, ring.capacity());
+}
+
+void test_ring_pops_oldest_first() {
+    TelemetryRing<Record, 8> ring;
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_EQUAL(5, ring.size());
+    for (int i = 0; i < 5; i++) {
+        Record r;
+        TEST_ASSERT_TRUE(ring.pop(r));
+        TEST_ASSERT_EQUAL(i, r.index);
+        TEST_ASSERT_TRUE(isConsistent(r));
+    }
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_ring_full_drops_newest_and_counts() {
+    TelemetryRing<Record, 4> ring;
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.push(makeRecord(1, i)));
+    }
+    TEST_ASSERT_FALSE(ring.push(makeRecord(1, 4)));
+    TEST_ASSERT_FALSE(ring.push(makeRecord(1, 5)));
+    TEST_ASSERT_EQUAL(2, ring.dropped());
+    TEST_ASSERT_EQUAL(4, ring.pushed());
+    TEST_ASSERT_EQUAL(4, ring.highWater());
+
+    // The records already queued are kept
+    Record r;
+    TEST_ASSERT_TRUE(ring.pop(r));
+    TEST_ASSERT_EQUAL(0, r.index);
+
+    // One slot free again
+    TEST_ASSERT_TRUE(ring.push(makeRecord(1, 6)));
+    TEST_ASSERT_FALSE(ring.push(makeRecord(1, 7)));
+    TEST_ASSERT_EQUAL(3, ring.dropped());
+}
+
+void test_ring_batch_pop() {
+    TelemetryRing<Record, 16> ring;
+    for (int i = 0; i < 10; i++) {
+        ring.push(makeRecord(1, i));
+    }
+    Record batch[4];
+    TEST_ASSERT_EQUAL(4, ring.pop(batch, 4));
+    TEST_ASSERT_EQUAL(0, batch[0].index);
+    TEST_ASSERT_EQUAL(3, batch[3].index);
+    TEST_ASSERT_EQUAL(4, ring.pop(batch, 4));
+    TEST_ASSERT_EQUAL(4, batch[0].index);
+    TEST_ASSERT_EQUAL(2, ring.pop(batch, 4));
+    TEST_ASSERT_EQUAL(9, batch[1].index);
+    TEST_ASSERT_EQUAL(0, ring.pop(batch, 4));
+}
+
+void test_ring_batch_peek_leaves_records() {
+    TelemetryRing<Record, 16> ring;
+    Record batch[4];
+    TEST_ASSERT_EQUAL(0, ring.peek(batch, 4));
+    for (int i = 0; i < 3; i++) {
+        ring.push(makeRecord(1, i));
+    }
+    TEST_ASSERT_EQUAL(3, ring.peek(batch, 4));
+    TEST_ASSERT_EQUAL(0, batch[0].index);
+    TEST_ASSERT_EQUAL(2, batch[2].index);
+    TEST_ASSERT_EQUAL(2, ring.peek(batch, 2));
+    TEST_ASSERT_EQUAL(3, ring.size());
+    TEST_ASSERT_EQUAL(3, ring.pop(batch, 4));
+}
+
+void test_ring_wraps_around() {
+    TelemetryRing<Record, 4> ring;
+    int32_t next = 0;
+    for (int round = 0; round < 1000; round++) {
+        int count = 1 + round % 4;
+        for (int i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(ring.push(makeRecord(1, round * 4 + i)));
+        }
+        Record batch[4];
+        TEST_ASSERT_EQUAL(count, ring.pop(batch, 4));
+        for (int i = 0; i < count; i++) {
+            TEST_ASSERT_EQUAL(round * 4 + i, batch[i].index);
+        }
+        next += count;
+    }
+    TEST_ASSERT_EQUAL(next, ring.pushed());
+    TEST_ASSERT_EQUAL(0, ring.dropped());
+    TEST_ASSERT_EQUAL(4, ring.highWater());
+}
+
+void test_ring_high_water_tracks_fill_level() {
+    TelemetryRing<Record, 32> ring;
+    Record r;
+    for (int i = 0; i < 100; i++) {
+        ring.push(makeRecord(1, i));
+        ring.push(makeRecord(1, i));
+        ring.pop(r);
+    }
+    // Grows by one per round
+    TEST_ASSERT_EQUAL(32, ring.highWater());
+
+    TelemetryRing<Record, 32> drained;
+    for (int i = 0; i < 100; i++) {
+        drained.push(makeRecord(1, i));
+        drained.push(makeRecord(1, i));
+        drained.pop(r);
+        drained.pop(r);
+    }
+    TEST_ASSERT_EQUAL(2, drained.highWater());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stress
+// ═══════════════════════════════════════════════════════════════════════════
+
+static const int kWriters = 3;
+static const int kRecordsPerWriter = 50000;
+
+void test_ring_stress_writers_and_batch_reader() {
+    static TelemetryRing<Record, 32> ring;
+    std::atomic<int> writersDone{0};
+    std::atomic<uint32_t> rejected{0};
+
+    std::vector<int32_t> lastIndex(kWriters, -1);
+    long received = 0;
+    long outOfOrder = 0;
+    long torn = 0;
+    long batches = 0;
+
+    // Publish task: drains in batches whenever it runs
+    std::thread reader([&]() {
+        Record batch[8];
+        while (true) {
+            bool done = writersDone.load() == kWriters;
+            size_t count = ring.pop(batch, 8);
+            if (count == 0) {
+                if (done) break;
+                std::this_thread::yield();
+                continue;
+            }
+            batches++;
+            for (size_t i = 0; i < count; i++) {
+                const Record &r = batch[i];
+                if (!isConsistent(r)) torn++;
+                if (r.index <= lastIndex[r.clipping]) outOfOrder++;
+                lastIndex[r.clipping] = r.index;
+                received++;
+            }
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; w++) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < kRecordsPerWriter; i++) {
+                if (!ring.push(makeRecord(w, i))) rejected++;
+
+                // Far more moves than the machine can do, but leaves the
+                // reader a chance to keep up, even on a single core
+                std::this_thread::yield();
+            }
+            writersDone++;
+        });
+    }
+    for (auto &t : writers) t.join();
+    reader.join();
+
+    const long attempts = long(kWriters) * kRecordsPerWriter;
+    printf("\n  %d writers: %ld records, %ld read in %ld batches, "
+           "%u dropped, high water %u of %u\n",
+           kWriters, attempts, received, batches, ring.dropped(),
+           ring.highWater(), unsigned(ring.capacity()));
+
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    TEST_ASSERT_EQUAL(received, long(ring.pushed()));
+    TEST_ASSERT_EQUAL(rejected.load(), ring.dropped());
+    TEST_ASSERT_EQUAL(attempts, received + long(ring.dropped()));
+    TEST_ASSERT_EQUAL(0, ring.size());
+    TEST_ASSERT_LESS_OR_EQUAL(32, ring.highWater());
+}
+
+void test_ring_stalled_reader_never_blocks_writer() {
+    // The reader is stuck (e.g. waiting on MQTT). The writer keeps going
+    // and only loses records.
+    TelemetryRing<Record, 32> ring;
+    std::mutex stalled;
+    stalled.lock();
+    std::thread reader([&]() {
+        std::lock_guard<std::mutex> wait(stalled);
+        Record batch[8];
+        while (ring.pop(batch, 8) > 0) {
+        }
+    });
+
+    for (int i = 0; i < 10000; i++) {
+        ring.push(makeRecord(0, i));
+    }
+    stalled.unlock();
+    reader.join();
+
+    TEST_ASSERT_EQUAL(32, ring.pushed());
+    TEST_ASSERT_EQUAL(10000 - 32, ring.dropped());
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Benchmark
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_ring_push_cost() {
+    const int kRounds = 1000000;
+    TelemetryRing<Record, 32> ring;
+    Record batch[8];
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        ring.push(makeRecord(0, i));
+        if ((i & 7) == 7) ring.pop(batch, 8);
+    }
+    double ringNs = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    kRounds;
+
+    // What a consumer behind the old callback would have needed
+    std::mutex mutex;
+    std::queue<Record> queue;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRounds; i++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push(makeRecord(0, i));
+        }
+        if ((i & 7) == 7) {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!queue.empty()) queue.pop();
+        }
+    }
+    double queueNs = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() /
+                     kRounds;
+
+    printf("  push + 1/8 batch pop: ring %.1f ns, mutex + std::queue %.1f ns\n",
+           ringNs, queueNs);
+
+    TEST_ASSERT_EQUAL(kRounds, ring.pushed());
+    TEST_ASSERT_EQUAL(0, ring.dropped());
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_ring_starts_empty);
+    RUN_TEST(test_ring_pops_oldest_first);
+    RUN_TEST(test_ring_full_drops_newest_and_counts);
+    RUN_TEST(test_ring_batch_pop);
+    RUN_TEST(test_ring_batch_peek_leaves_records);
+    RUN_TEST(test_ring_wraps_around);
+    RUN_TEST(test_ring_high_water_tracks_fill_level);
+
+    RUN_TEST(test_ring_stress_writers_and_batch_reader);
+    RUN_TEST(test_ring_stalled_reader_never_blocks_writer);
+
+    RUN_TEST(test_ring_push_cost);
+
+    return UNITY_END();
+}
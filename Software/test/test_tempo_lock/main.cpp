@@ -0,0 +1,257 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ TEMPO LOCK — UNIT TESTS                                                │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/TempoLock.h at 120 bpm, a beat every    │
+// │ 500 ms:                                                                │
+// │   Plan   — Moves end on the closest beat or subdivision                │
+// │   Fit    — Speed and acceleration stretch to the planned time          │
+// │   Filter — Phase errors move the next arrivals, within bounds          │
+// │   Clock  — micros() wrapping around                                    │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cmath>
+
+using namespace fakeit;
+
+#include "TempoLock.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static const uint32_t kBeat = 500000;
+
+static motionParameter move(int speed, int acceleration) {
+    motionParameter motion = {};
+    motion.speed = speed;
+    motion.acceleration = acceleration;
+    return motion;
+}
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Plan
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_tempo_off_by_default() {
+    TempoLock tempo;
+    TEST_ASSERT_FALSE(tempo.active());
+    TEST_ASSERT_FALSE(tempo.planned());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, tempo.bpm());
+    TEST_ASSERT_EQUAL_UINT32(0, tempo.microsUntilArrival(1234));
+}
+
+void test_tempo_plan_rounds_to_power_of_two_beats() {
+    // Rounded on a log scale, up to 16 beats and down to an eighth
+    const float times[] = {0.45f, 0.8f, 0.3f, 100.0f, 0.01f};
+    const float expected[] = {0.5f, 1.0f, 0.25f, 8.0f, 0.0625f};
+    for (int i = 0; i < 5; i++) {
+        TempoLock tempo;
+        tempo.setTempo(120.0f, 0);
+        TEST_ASSERT_TRUE(tempo.active());
+        TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected[i], tempo.plan(0, times[i]));
+        TEST_ASSERT_TRUE(tempo.planned());
+    }
+}
+
+void test_tempo_plan_ends_on_closest_beat() {
+    // Starting 120 ms after a beat, a beat long move ends on the next one
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.38f, tempo.plan(120000, 0.5f));
+    TEST_ASSERT_EQUAL_UINT32(380000, tempo.microsUntilArrival(120000));
+
+    // 300 ms after it, the beat after that is closer
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.7f, tempo.plan(300000, 0.5f));
+}
+
+void test_tempo_plan_short_moves_end_on_subdivisions() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.15f, tempo.plan(100000, 0.25f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.0875f, tempo.plan(100000, 0.06f));
+}
+
+void test_tempo_plan_keeps_the_beat_phase() {
+    // The beat may lie far in the past
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 1000);
+    uint32_t now = 1000 + 600 * kBeat + 40000;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.46f, tempo.plan(now, 0.5f));
+}
+
+void test_tempo_remaining_counts_down() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, tempo.remaining(0));
+    tempo.plan(0, 0.5f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.3f, tempo.remaining(200000));
+
+    // Overdue moves get the shortest time
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.001f, tempo.remaining(600000));
+    TEST_ASSERT_EQUAL_UINT32(0, tempo.microsUntilArrival(600000));
+}
+
+void test_tempo_off_cancels_the_plan() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    tempo.plan(0, 0.5f);
+    tempo.setTempo(0.0f, 0);
+    TEST_ASSERT_FALSE(tempo.active());
+    TEST_ASSERT_FALSE(tempo.planned());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, tempo.bpm());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Fit
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_tempo_move_time_of_trapezoid_and_triangle() {
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.2f,
+                             TempoLock::moveTime(-1000, 1000.0f, 5000.0f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 2.0f * sqrtf(0.02f),
+                             TempoLock::moveTime(100, 1000.0f, 5000.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, TempoLock::moveTime(0, 1000.0f, 5000.0f));
+}
+
+void test_tempo_fit_scales_speed_and_acceleration() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    tempo.plan(0, 1.2f);
+
+    motionParameter motion = move(1000, 5000);
+    TEST_ASSERT_TRUE(tempo.fit(motion, 1000, 0.6f, 10000, 100000));
+    TEST_ASSERT_EQUAL(2000, motion.speed);
+    TEST_ASSERT_EQUAL(20000, motion.acceleration);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.6f,
+                             TempoLock::moveTime(1000, motion.speed,
+                                                 motion.acceleration));
+
+    // Slower works the same way
+    motion = move(1000, 5000);
+    TEST_ASSERT_TRUE(tempo.fit(motion, 1000, 2.4f, 10000, 100000));
+    TEST_ASSERT_EQUAL(500, motion.speed);
+    TEST_ASSERT_EQUAL(1250, motion.acceleration);
+}
+
+void test_tempo_fit_stays_within_limits() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    tempo.plan(0, 1.2f);
+
+    // Twice as fast would need 2000 steps/s
+    motionParameter motion = move(1000, 5000);
+    TEST_ASSERT_FALSE(tempo.fit(motion, 1000, 0.6f, 1500, 100000));
+    TEST_ASSERT_EQUAL(1500, motion.speed);
+    TEST_ASSERT_EQUAL(11250, motion.acceleration);
+
+    // The acceleration limit counts as well
+    motion = move(1000, 5000);
+    TEST_ASSERT_FALSE(tempo.fit(motion, 1000, 0.6f, 10000, 11250));
+    TEST_ASSERT_EQUAL(1500, motion.speed);
+    TEST_ASSERT_EQUAL(11250, motion.acceleration);
+
+    // The pattern asking for more than the machine does is cut first
+    motion = move(4000, 5000);
+    tempo.plan(0, 1.2f);
+    tempo.fit(motion, 1000, 0.4f, 2000, 100000);
+    TEST_ASSERT_LESS_OR_EQUAL(2000, motion.speed);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Filter
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_tempo_arrival_measures_phase_error() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    tempo.plan(0, 0.5f);
+    tempo.arrived(510000);
+    TEST_ASSERT_EQUAL_INT32(10000, tempo.phaseError());
+    TEST_ASSERT_FALSE(tempo.planned());
+
+    // The next move starts early by a share of it
+    float expected = (kBeat - 10000 - TEMPO_LOCK_GAIN * 10000) * 1e-6f;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected, tempo.plan(510000, 0.5f));
+
+    tempo.arrived(990000);
+    TEST_ASSERT_EQUAL_INT32(-10000, tempo.phaseError());
+}
+
+void test_tempo_filter_is_bounded() {
+    // A constant 200 ms late only moves the arrivals by a quarter beat
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    uint32_t now = 0;
+    for (int i = 0; i < 50; i++) {
+        tempo.plan(now, 0.5f);
+        now += tempo.microsUntilArrival(now) + 200000;
+        tempo.arrived(now);
+    }
+    tempo.plan(now, 0.5f);
+    float left = tempo.remaining(now);
+    TEST_ASSERT_EQUAL_UINT32(uint32_t(left * 1e6f + 0.5f),
+                             tempo.microsUntilArrival(now));
+    uint32_t sinceBeat = now % kBeat;
+    TEST_ASSERT_INT_WITHIN(2, kBeat - sinceBeat - kBeat / 4,
+                           tempo.microsUntilArrival(now));
+}
+
+void test_tempo_saturated_moves_do_not_wind_up() {
+    TempoLock tempo;
+    tempo.setTempo(120.0f, 0);
+    tempo.plan(0, 0.5f);
+    motionParameter motion = move(1000, 5000);
+    TEST_ASSERT_FALSE(tempo.fit(motion, 1000, 0.5f, 1500, 100000));
+    tempo.arrived(800000);
+    TEST_ASSERT_EQUAL_INT32(300000, tempo.phaseError());
+
+    // No lateness taken over from the late move
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.7f, tempo.plan(800000, 0.5f));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Clock
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_tempo_micros_wrap_around() {
+    TempoLock tempo;
+    uint32_t beat = 0xFFFFFFFF - 295;
+    tempo.setTempo(120.0f, beat);
+
+    // 1296 µs after the beat, past the wrap
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.498704f, tempo.plan(1000, 0.5f));
+    TEST_ASSERT_EQUAL_UINT32(498704, tempo.microsUntilArrival(1000));
+    tempo.arrived(499704);
+    TEST_ASSERT_EQUAL_INT32(0, tempo.phaseError());
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_tempo_off_by_default);
+    RUN_TEST(test_tempo_plan_rounds_to_power_of_two_beats);
+    RUN_TEST(test_tempo_plan_ends_on_closest_beat);
+    RUN_TEST(test_tempo_plan_short_moves_end_on_subdivisions);
+    RUN_TEST(test_tempo_plan_keeps_the_beat_phase);
+    RUN_TEST(test_tempo_remaining_counts_down);
+    RUN_TEST(test_tempo_off_cancels_the_plan);
+
+    RUN_TEST(test_tempo_move_time_of_trapezoid_and_triangle);
+    RUN_TEST(test_tempo_fit_scales_speed_and_acceleration);
+    RUN_TEST(test_tempo_fit_stays_within_limits);
+
+    RUN_TEST(test_tempo_arrival_measures_phase_error);
+    RUN_TEST(test_tempo_filter_is_bounded);
+    RUN_TEST(test_tempo_saturated_moves_do_not_wind_up);
+
+    RUN_TEST(test_tempo_micros_wrap_around);
+
+    return UNITY_END();
+}
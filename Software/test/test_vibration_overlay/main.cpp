@@ -0,0 +1,291 @@
+// ┌──────────────────────────────────────────────────────────────────────────┐
+// │ VIBRATION OVERLAY — UNIT TESTS                                         │
+// │                                                                        │
+// │ Tests for lib/StrokeEngine/src/VibrationOverlay.h. The queue entries   │
+// │ are replayed step by step like the stepper would run them:             │
+// │   Timing    — Every entry lasts exactly one period                     │
+// │   Envelope  — Amplitude is clamped to speed and acceleration limits    │
+// │   Vibration — Sine of the set amplitude around the stroke              │
+// │   Stroke    — Arrives on target within the speed the vibration leaves  │
+// │   Stop      — Brakes, fades out and comes to rest                      │
+// └──────────────────────────────────────────────────────────────────────────┘
+
+#include <ArduinoFake.h>
+#include <unity.h>
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace fakeit;
+
+#include "VibrationOverlay.h"
+
+// ─── Helpers ──────────────────────────────────────────────────────────────
+
+static const uint32_t kTicksPerSecond = 16000000;
+static const uint32_t kPeriodMicros = 500;
+static const uint32_t kPeriodTicks = 8000;
+static const float kMaxSpeed = 20000.0f;         // 1000 mm/s at 20 steps/mm
+static const float kMaxAcceleration = 1000000.0f;  // 50000 mm/s²
+static const int kMaxStep = 3760;
+
+// Runs the queue entries of the overlay and tracks the carriage
+struct Replay {
+    VibrationOverlay overlay;
+    int32_t position;
+    uint64_t ticks = 0;
+    int32_t lowest;
+    int32_t highest;
+    int maxStepsPerPeriod = 0;
+
+    explicit Replay(int start = 1000) : position(start) {
+        overlay.begin(kTicksPerSecond, kPeriodMicros, kMaxSpeed,
+                      kMaxAcceleration, 0, kMaxStep);
+        overlay.start(start);
+        reset();
+    }
+
+    void reset() {
+        lowest = position;
+        highest = position;
+        maxStepsPerPeriod = 0;
+    }
+
+    void run(int periods) {
+        for (int i = 0; i < periods; i++) {
+            stepCommand command = overlay.next();
+            uint32_t duration = command.steps > 0
+                                    ? uint32_t(command.ticks) * command.steps
+                                    : command.ticks;
+            ticks += duration;
+            position += command.countUp ? command.steps : -command.steps;
+            if (position < lowest) lowest = position;
+            if (position > highest) highest = position;
+            if (command.steps > maxStepsPerPeriod) {
+                maxStepsPerPeriod = command.steps;
+            }
+        }
+    }
+
+    int periodsFor(float seconds) {
+        return int(seconds * 1.0e6f / kPeriodMicros);
+    }
+};
+
+void setUp(void) { ArduinoFakeReset(); }
+
+void tearDown(void) {}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Timing
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_overlay_at_rest_pauses() {
+    Replay replay;
+    replay.run(10);
+    TEST_ASSERT_EQUAL(1000, replay.position);
+    TEST_ASSERT_EQUAL(10 * kPeriodTicks, replay.ticks);
+    TEST_ASSERT_FALSE(replay.overlay.moving());
+    TEST_ASSERT_TRUE(replay.overlay.atRest());
+}
+
+void test_overlay_entries_keep_the_period() {
+    // Step counts that do not divide the period carry the remainder
+    Replay replay;
+    replay.overlay.setVibration(20.0f, 17.0f);
+    replay.overlay.moveTo(2500, 7000.0f, 300000.0f);
+    const int periods = replay.periodsFor(1.3f);
+    replay.run(periods);
+    TEST_ASSERT_TRUE(replay.ticks <= uint64_t(periods) * kPeriodTicks);
+    TEST_ASSERT_TRUE(replay.ticks + 255 >= uint64_t(periods) * kPeriodTicks);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Envelope
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_overlay_envelope_is_half_the_limits() {
+    VibrationOverlay overlay;
+    overlay.begin(kTicksPerSecond, kPeriodMicros, kMaxSpeed, kMaxAcceleration,
+                  0, kMaxStep);
+
+    // 8 entries per period of the sine
+    TEST_ASSERT_EQUAL_FLOAT(250.0f, overlay.maxFrequency());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, overlay.maxAmplitude(251.0f));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, overlay.maxAmplitude(0.0f));
+
+    // Acceleration bound: A w² = amax / 2
+    float w = 2.0f * float(M_PI) * 50.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f * kMaxAcceleration / (w * w),
+                             overlay.maxAmplitude(50.0f));
+
+    // Speed bound at low frequency: A w = vmax / 2
+    w = 2.0f * float(M_PI) * 2.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.5f * kMaxSpeed / w,
+                             overlay.maxAmplitude(2.0f));
+
+    // Follows the limits
+    overlay.setLimits(kMaxSpeed, kMaxAcceleration / 2.0f);
+    w = 2.0f * float(M_PI) * 50.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.25f * kMaxAcceleration / (w * w),
+                             overlay.maxAmplitude(50.0f));
+}
+
+void test_overlay_amplitude_is_clamped() {
+    VibrationOverlay overlay;
+    overlay.begin(kTicksPerSecond, kPeriodMicros, kMaxSpeed, kMaxAcceleration,
+                  0, kMaxStep);
+    overlay.setVibration(100.0f, 50.0f);
+    TEST_ASSERT_EQUAL_FLOAT(overlay.maxAmplitude(50.0f), overlay.amplitude());
+
+    overlay.setVibration(3.0f, 400.0f);
+    TEST_ASSERT_EQUAL_FLOAT(250.0f, overlay.frequency());
+    TEST_ASSERT_EQUAL_FLOAT(overlay.maxAmplitude(250.0f),
+                            overlay.amplitude());
+
+    overlay.setVibration(3.0f, 0.0f);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, overlay.amplitude());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Vibration
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_overlay_vibrates_around_the_stroke() {
+    Replay replay;
+    replay.overlay.setVibration(30.0f, 20.0f);
+
+    // Fades in within 100 ms
+    replay.run(replay.periodsFor(0.1f));
+    replay.reset();
+    replay.run(replay.periodsFor(0.5f));
+    TEST_ASSERT_INT_WITHIN(1, 1030, replay.highest);
+    TEST_ASSERT_INT_WITHIN(1, 970, replay.lowest);
+    TEST_ASSERT_FALSE(replay.overlay.atRest());
+
+    // Fades out again and comes to rest on the stroke
+    replay.overlay.setVibration(0.0f, 20.0f);
+    replay.run(replay.periodsFor(0.15f));
+    TEST_ASSERT_EQUAL(1000, replay.position);
+    TEST_ASSERT_TRUE(replay.overlay.atRest());
+}
+
+void test_overlay_frequency_change_stays_in_envelope() {
+    Replay replay;
+    replay.overlay.setVibration(100.0f, 10.0f);
+    replay.run(replay.periodsFor(0.3f));
+    TEST_ASSERT_GREATER_THAN(1090, replay.highest);
+
+    // Much less room at 40 Hz. The amplitude fades before the switch.
+    replay.overlay.setVibration(100.0f, 40.0f);
+    float allowed = replay.overlay.maxAmplitude(40.0f);
+    replay.run(replay.periodsFor(0.2f));
+    replay.reset();
+    replay.run(replay.periodsFor(0.5f));
+    TEST_ASSERT_INT_WITHIN(1, 1000 + int(allowed), replay.highest);
+    TEST_ASSERT_INT_WITHIN(1, 1000 - int(allowed), replay.lowest);
+}
+
+void test_overlay_stays_within_travel() {
+    Replay replay(5);
+    replay.overlay.setVibration(30.0f, 20.0f);
+    replay.run(replay.periodsFor(0.5f));
+    TEST_ASSERT_EQUAL(0, replay.lowest);
+    TEST_ASSERT_INT_WITHIN(1, 35, replay.highest);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stroke
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_overlay_stroke_arrives_on_target() {
+    Replay replay;
+    replay.overlay.moveTo(3000, 10000.0f, 200000.0f);
+    TEST_ASSERT_TRUE(replay.overlay.moving());
+    TEST_ASSERT_EQUAL(3000, replay.overlay.target());
+
+    // 2000 steps: 50 ms up and down, 150 ms at 10000 steps/s
+    replay.run(replay.periodsFor(0.235f));
+    TEST_ASSERT_TRUE(replay.overlay.moving());
+    replay.run(replay.periodsFor(0.03f));
+    TEST_ASSERT_FALSE(replay.overlay.moving());
+    TEST_ASSERT_EQUAL(3000, replay.position);
+
+    // 10000 steps/s are 5 steps per period
+    TEST_ASSERT_LESS_OR_EQUAL(5, replay.maxStepsPerPeriod);
+}
+
+void test_overlay_stroke_gets_what_the_vibration_leaves() {
+    Replay replay;
+    replay.overlay.setVibration(100.0f, 10.0f);
+    replay.run(replay.periodsFor(0.2f));
+
+    // Full speed asked, half of it left with the vibration at its limit
+    replay.overlay.moveTo(3500, kMaxSpeed, kMaxAcceleration);
+    replay.reset();
+    replay.run(replay.periodsFor(1.0f));
+    TEST_ASSERT_FALSE(replay.overlay.moving());
+
+    // Stroke and vibration together never exceed the machine's speed
+    int limit = int(ceilf(kMaxSpeed * kPeriodMicros * 1.0e-6f));
+    TEST_ASSERT_LESS_OR_EQUAL(limit + 1, replay.maxStepsPerPeriod);
+    TEST_ASSERT_GREATER_THAN(limit / 2, replay.maxStepsPerPeriod);
+}
+
+void test_overlay_stroke_target_is_clamped() {
+    VibrationOverlay overlay;
+    overlay.begin(kTicksPerSecond, kPeriodMicros, kMaxSpeed, kMaxAcceleration,
+                  0, kMaxStep);
+    overlay.start(100);
+    overlay.moveTo(-50, 1000.0f, 1000.0f);
+    TEST_ASSERT_EQUAL(0, overlay.target());
+    overlay.moveTo(5000, 1000.0f, 1000.0f);
+    TEST_ASSERT_EQUAL(kMaxStep, overlay.target());
+}
+
+// ═══════════════════════════════════════════════════════════════════════════
+// Stop
+// ═══════════════════════════════════════════════════════════════════════════
+
+void test_overlay_stop_brakes_and_fades_out() {
+    Replay replay(200);
+    replay.overlay.setVibration(5.0f, 50.0f);
+    replay.overlay.moveTo(3500, 8000.0f, 400000.0f);
+    replay.run(replay.periodsFor(0.2f));
+    int32_t at = replay.position;
+
+    // Braking from 8000 steps/s takes 80 steps at what the vibration leaves
+    replay.overlay.stop();
+    TEST_ASSERT_FALSE(replay.overlay.atRest());
+    for (int i = 0; i < 1000 && !replay.overlay.atRest(); i++) {
+        replay.run(1);
+    }
+    TEST_ASSERT_TRUE(replay.overlay.atRest());
+    TEST_ASSERT_FALSE(replay.overlay.moving());
+    TEST_ASSERT_INT_WITHIN(80, at + 80, replay.position);
+    TEST_ASSERT_EQUAL(replay.overlay.target(), replay.position);
+}
+
+// ─── Runner ──────────────────────────────────────────────────────────────
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_overlay_at_rest_pauses);
+    RUN_TEST(test_overlay_entries_keep_the_period);
+
+    RUN_TEST(test_overlay_envelope_is_half_the_limits);
+    RUN_TEST(test_overlay_amplitude_is_clamped);
+
+    RUN_TEST(test_overlay_vibrates_around_the_stroke);
+    RUN_TEST(test_overlay_frequency_change_stays_in_envelope);
+    RUN_TEST(test_overlay_stays_within_travel);
+
+    RUN_TEST(test_overlay_stroke_arrives_on_target);
+    RUN_TEST(test_overlay_stroke_gets_what_the_vibration_leaves);
+    RUN_TEST(test_overlay_stroke_target_is_clamped);
+
+    RUN_TEST(test_overlay_stop_brakes_and_fades_out);
+
+    return UNITY_END();
+}
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Encode keyframe files for the StrokeEngine KeyframePattern.
+
+The format is documented in Software/lib/StrokeEngine/src/KeyframeFormat.h.
+Upload the result to the LittleFS partition of the OSSM.
+
+Input is either a CSV file with one keyframe per row::
+
+    position,duration_ms,acceleration,jerk
+    100,500,,
+    hold,250,,
+    0,500,2000,5000
+
+where position is 0 (retracted) to 100 (full depth) percent of the stroke,
+acceleration is in mm/s^2 and jerk in m/s^3 (both optional), or a funscript
+whose actions are turned into moves between consecutive positions.
+"""
+
+from __future__ import annotations
+
+import argparse
+import csv
+import json
+import struct
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Iterable
+
+MAGIC = b"OSKF"
+VERSION = 1
+HEADER = struct.Struct("<4sBBHI")
+
+LOOP = 0x01
+
+HAS_ACCELERATION = 0x01
+HAS_JERK = 0x02
+HOLD = 0x04
+
+UINT16_MAX = 0xFFFF
+
+
+@dataclass(frozen=True)
+class Keyframe:
+    position: int
+    duration_ms: int
+    acceleration: int = 0
+    jerk: int = 0
+    hold: bool = False
+
+
+def _uint16(value: int, label: str) -> int:
+    if not 0 <= value <= UINT16_MAX:
+        raise ValueError(f"{label} {value} out of range 0..{UINT16_MAX}")
+    return value
+
+
+def position_from_percent(percent: float) -> int:
+    if not 0.0 <= percent <= 100.0:
+        raise ValueError(f"position {percent} out of range 0..100")
+    return round(percent * UINT16_MAX / 100.0)
+
+
+def encode_header(count: int, loop: bool, reference_stroke_ms: int) -> bytes:
+    if reference_stroke_ms <= 0:
+        raise ValueError("reference stroke time must be positive")
+    return HEADER.pack(
+        MAGIC,
+        VERSION,
+        LOOP if loop else 0,
+        _uint16(reference_stroke_ms, "reference stroke time"),
+        count,
+    )
+
+
+def encode_keyframe(frame: Keyframe) -> bytes:
+    flags = 0
+    if frame.hold:
+        flags |= HOLD
+    if frame.acceleration:
+        flags |= HAS_ACCELERATION
+    if frame.jerk:
+        flags |= HAS_JERK
+    record = bytes([flags])
+    if not frame.hold:
+        record += struct.pack("<H", _uint16(frame.position, "position"))
+    record += struct.pack("<H", _uint16(frame.duration_ms, "duration"))
+    if frame.acceleration:
+        record += struct.pack("<H", _uint16(frame.acceleration, "acceleration"))
+    if frame.jerk:
+        record += struct.pack("<H", _uint16(frame.jerk, "jerk"))
+    return record
+
+
+def split_long(frames: Iterable[Keyframe]) -> list[Keyframe]:
+    """Splits holds longer than a record can hold into several holds."""
+    result = []
+    for frame in frames:
+        duration = frame.duration_ms
+        while frame.hold and duration > UINT16_MAX:
+            result.append(Keyframe(0, UINT16_MAX, hold=True))
+            duration -= UINT16_MAX
+        result.append(Keyframe(frame.position, duration, frame.acceleration, frame.jerk, frame.hold))
+    return result
+
+
+def encode(frames: Iterable[Keyframe], loop: bool = False, reference_stroke_ms: int = 1000) -> bytes:
+    frames = split_long(frames)
+    body = b"".join(encode_keyframe(frame) for frame in frames)
+    return encode_header(len(frames), loop, reference_stroke_ms) + body
+
+
+def read_csv(path: Path) -> list[Keyframe]:
+    frames = []
+    with path.open(newline="") as handle:
+        for row in csv.DictReader(handle):
+            duration = int(row["duration_ms"])
+            if row["position"].strip().lower() == "hold":
+                frames.append(Keyframe(0, duration, hold=True))
+                continue
+            frames.append(
+                Keyframe(
+                    position_from_percent(float(row["position"])),
+                    duration,
+                    int(row.get("acceleration") or 0),
+                    int(row.get("jerk") or 0),
+                )
+            )
+    return frames
+
+
+def from_funscript(script: dict) -> list[Keyframe]:
+    """Moves between consecutive actions. Equal positions become holds."""
+    actions = sorted(script.get("actions", []), key=lambda action: action["at"])
+    if script.get("inverted"):
+        actions = [{"at": a["at"], "pos": 100 - a["pos"]} for a in actions]
+    frames = []
+    for previous, action in zip(actions, actions[1:]):
+        duration = action["at"] - previous["at"]
+        if duration <= 0:
+            continue
+        if action["pos"] == previous["pos"]:
+            frames.append(Keyframe(0, duration, hold=True))
+        else:
+            frames.append(Keyframe(position_from_percent(action["pos"]), duration))
+    return frames
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", type=Path, help=".csv or .funscript")
+    parser.add_argument("output", type=Path)
+    parser.add_argument("--loop", action="store_true", help="start over at the end")
+    parser.add_argument(
+        "--reference-stroke-ms",
+        type=int,
+        default=1000,
+        help="full stroke time the durations were made for",
+    )
+    args = parser.parse_args()
+
+    if args.input.suffix.lower() in (".funscript", ".json"):
+        frames = from_funscript(json.loads(args.input.read_text()))
+    else:
+        frames = read_csv(args.input)
+    data = encode(frames, args.loop, args.reference_stroke_ms)
+    args.output.write_bytes(data)
+    print(f"{len(split_long(frames))} keyframes, {len(data)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Assemble pattern programs for the StrokeEngine ProgramPattern.
+
+The format and instructions are documented in
+Software/lib/StrokeEngine/src/PatternProgram.h. Write the result to the
+pattern program BLE characteristic; an empty write goes back to the default.
+
+One instruction per line, ``;`` starts a comment::
+
+        .vars 1             ; variables kept between strokes
+        in index            ; odd strokes move out
+        push 1
+        and
+        jnz out
+        pushq 1.0           ; Q16, 65536
+        jmp go
+    out: push 0
+    go: in stroke_ms
+        push 1
+        shr
+        move
+
+``push`` picks the shortest encoding for its value, ``pushq`` pushes a
+fraction in Q16. Inputs go by name or number.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import struct
+from pathlib import Path
+
+MAGIC = b"OSPG"
+VERSION = 1
+HEADER = struct.Struct("<4sBBH")
+
+SIZE_MAX = 512
+CODE_MAX = SIZE_MAX - HEADER.size
+VARIABLES = 16
+
+# Opcodes without operands
+SIMPLE = {
+    "dup": 0x07,
+    "drop": 0x08,
+    "swap": 0x09,
+    "over": 0x0A,
+    "add": 0x10,
+    "sub": 0x11,
+    "mul": 0x12,
+    "div": 0x13,
+    "mod": 0x14,
+    "mulq": 0x15,
+    "divq": 0x16,
+    "min": 0x17,
+    "max": 0x18,
+    "neg": 0x19,
+    "abs": 0x1A,
+    "and": 0x1B,
+    "or": 0x1C,
+    "xor": 0x1D,
+    "shl": 0x1E,
+    "shr": 0x1F,
+    "lt": 0x20,
+    "le": 0x21,
+    "eq": 0x22,
+    "not": 0x23,
+    "wait": 0x40,
+    "ramp": 0x41,
+    "move": 0x42,
+}
+PUSH8, PUSH16, PUSH32 = 0x01, 0x02, 0x03
+LOAD, STORE, IN = 0x04, 0x05, 0x06
+JUMPS = {"jmp": 0x30, "jz": 0x31, "jnz": 0x32}
+WITH_OPERAND = {".vars", "push", "pushq", "load", "store", "in"}
+
+INPUTS = {
+    "index": 0,
+    "stroke": 1,
+    "depth": 2,
+    "sensation": 3,
+    "stroke_ms": 4,
+    "steps_per_mm": 5,
+}
+
+LABEL = re.compile(r"^([A-Za-z_][A-Za-z0-9_]*):\s*(.*)$")
+
+
+class AssemblyError(ValueError):
+    def __init__(self, line: int, message: str):
+        super().__init__(f"line {line}: {message}")
+
+
+def _number(text: str, line: int) -> int:
+    try:
+        return int(text, 0)
+    except ValueError:
+        raise AssemblyError(line, f"not a number: {text}") from None
+
+
+def encode_push(value: int) -> bytes:
+    if -0x80 <= value <= 0x7F:
+        return struct.pack("<Bb", PUSH8, value)
+    if -0x8000 <= value <= 0x7FFF:
+        return struct.pack("<Bh", PUSH16, value)
+    if -0x80000000 <= value <= 0x7FFFFFFF:
+        return struct.pack("<Bi", PUSH32, value)
+    raise ValueError(f"constant {value} does not fit 32 bits")
+
+
+def assemble(source: str) -> bytes:
+    """Returns the program file, header included."""
+    variables = 0
+    code = bytearray()
+    labels: dict[str, int] = {}
+    # Jumps to fill in once all labels are known: offset, label, line
+    fixups: list[tuple[int, str, int]] = []
+
+    for number, raw in enumerate(source.splitlines(), 1):
+        text = raw.split(";", 1)[0].strip()
+        match = LABEL.match(text)
+        if match:
+            name, text = match.groups()
+            if name in labels:
+                raise AssemblyError(number, f"label {name} defined twice")
+            labels[name] = len(code)
+        if not text:
+            continue
+
+        words = text.split()
+        mnemonic, args = words[0].lower(), words[1:]
+        if mnemonic not in SIMPLE and mnemonic not in JUMPS and mnemonic not in WITH_OPERAND:
+            raise AssemblyError(number, f"unknown instruction {words[0]}")
+        expected = 0 if mnemonic in SIMPLE else 1
+        if len(args) != expected:
+            raise AssemblyError(number, f"{mnemonic} takes {expected} operand(s)")
+
+        if mnemonic == ".vars":
+            variables = _number(args[0], number)
+            if not 0 <= variables <= VARIABLES:
+                raise AssemblyError(number, f"up to {VARIABLES} variables")
+        elif mnemonic in SIMPLE:
+            code.append(SIMPLE[mnemonic])
+        elif mnemonic == "push":
+            try:
+                code += encode_push(_number(args[0], number))
+            except ValueError as error:
+                raise AssemblyError(number, str(error)) from None
+        elif mnemonic == "pushq":
+            try:
+                code += encode_push(round(float(args[0]) * 65536))
+            except ValueError as error:
+                raise AssemblyError(number, str(error)) from None
+        elif mnemonic in ("load", "store"):
+            index = _number(args[0], number)
+            if not 0 <= index < variables:
+                raise AssemblyError(number, f"variable {index} not declared with .vars")
+            code += bytes([LOAD if mnemonic == "load" else STORE, index])
+        elif mnemonic == "in":
+            name = args[0].lower()
+            index = INPUTS[name] if name in INPUTS else _number(name, number)
+            if not 0 <= index < len(INPUTS):
+                raise AssemblyError(number, f"no input {args[0]}")
+            code += bytes([IN, index])
+        else:
+            code.append(JUMPS[mnemonic])
+            fixups.append((len(code), args[0], number))
+            code += b"\x00\x00"
+
+    for offset, label, number in fixups:
+        if label not in labels:
+            raise AssemblyError(number, f"no label {label}")
+        # Relative to the next instruction
+        code[offset : offset + 2] = struct.pack("<h", labels[label] - (offset + 2))
+
+    if len(code) > CODE_MAX:
+        raise ValueError(f"{len(code)} bytes of code, at most {CODE_MAX} fit")
+    return HEADER.pack(MAGIC, VERSION, variables, len(code)) + bytes(code)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", type=Path, help="assembly source")
+    parser.add_argument("output", type=Path)
+    args = parser.parse_args()
+
+    data = assemble(args.input.read_text())
+    args.output.write_bytes(data)
+    print(f"{len(data) - HEADER.size} bytes of code, {len(data)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
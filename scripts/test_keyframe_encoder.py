@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+
+import tempfile
+import unittest
+from pathlib import Path
+
+from keyframe_encoder import (
+    Keyframe,
+    encode,
+    encode_keyframe,
+    from_funscript,
+    position_from_percent,
+    read_csv,
+)
+
+CSV = """position,duration_ms,acceleration,jerk
+100,500,,
+hold,250,,
+0,400,2000,5000
+"""
+
+
+class KeyframeEncoderTests(unittest.TestCase):
+    def test_header_layout(self):
+        data = encode([Keyframe(65535, 500)], loop=True, reference_stroke_ms=1200)
+        self.assertEqual(data[:4], b"OSKF")
+        self.assertEqual(data[4], 1)
+        self.assertEqual(data[5], 0x01)
+        self.assertEqual(data[6:8], (1200).to_bytes(2, "little"))
+        self.assertEqual(data[8:12], (1).to_bytes(4, "little"))
+        self.assertEqual(len(data), 12 + 5)
+
+    def test_record_layouts(self):
+        self.assertEqual(encode_keyframe(Keyframe(0x1234, 500)), bytes([0, 0x34, 0x12, 0xF4, 0x01]))
+        self.assertEqual(encode_keyframe(Keyframe(0, 250, hold=True)), bytes([0x04, 0xFA, 0x00]))
+        self.assertEqual(
+            encode_keyframe(Keyframe(1, 2, 3, 4)),
+            bytes([0x03, 1, 0, 2, 0, 3, 0, 4, 0]),
+        )
+
+    def test_out_of_range_values_are_rejected(self):
+        with self.assertRaisesRegex(ValueError, "duration"):
+            encode_keyframe(Keyframe(0, 70000))
+        with self.assertRaisesRegex(ValueError, "position"):
+            position_from_percent(101)
+
+    def test_long_holds_are_split(self):
+        data = encode([Keyframe(0, 100000, hold=True)])
+        self.assertEqual(data[8:12], (2).to_bytes(4, "little"))
+
+    def test_csv(self):
+        with tempfile.TemporaryDirectory() as directory:
+            path = Path(directory) / "pattern.csv"
+            path.write_text(CSV)
+            self.assertEqual(
+                read_csv(path),
+                [
+                    Keyframe(65535, 500),
+                    Keyframe(0, 250, hold=True),
+                    Keyframe(0, 400, 2000, 5000),
+                ],
+            )
+
+    def test_funscript_moves_and_holds(self):
+        script = {
+            "actions": [
+                {"at": 0, "pos": 0},
+                {"at": 500, "pos": 100},
+                {"at": 800, "pos": 100},
+                {"at": 1000, "pos": 50},
+            ]
+        }
+        self.assertEqual(
+            from_funscript(script),
+            [
+                Keyframe(65535, 500),
+                Keyframe(0, 300, hold=True),
+                Keyframe(position_from_percent(50), 200),
+            ],
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
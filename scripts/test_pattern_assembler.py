@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+
+import unittest
+
+from pattern_assembler import AssemblyError, assemble, encode_push
+
+# ProgramPattern::defaultProgram in Software/lib/StrokeEngine/src/ProgramPattern.h
+SIMPLE_STROKE = """
+    in index            ; odd strokes move out
+    push 1
+    and
+    jnz out
+    pushq 1.0
+    jmp go
+out: push 0
+go: in stroke_ms        ; in and out take half the time each
+    push 1
+    shr
+    move
+"""
+
+DEFAULT_PROGRAM = bytes(
+    [
+        *b"OSPG", 0x01, 0x00, 0x18, 0x00,
+        0x06, 0x00, 0x01, 0x01, 0x1B, 0x32, 0x08, 0x00, 0x03, 0x00, 0x00, 0x01,
+        0x00, 0x30, 0x02, 0x00, 0x01, 0x00, 0x06, 0x04, 0x01, 0x01, 0x1F, 0x42,
+    ]
+)  # fmt: skip
+
+
+class PatternAssemblerTests(unittest.TestCase):
+    def test_default_program(self):
+        self.assertEqual(assemble(SIMPLE_STROKE), DEFAULT_PROGRAM)
+
+    def test_header_layout(self):
+        data = assemble(".vars 3\npush 0\npush 0\nmove\n")
+        self.assertEqual(data[:4], b"OSPG")
+        self.assertEqual(data[4], 1)
+        self.assertEqual(data[5], 3)
+        self.assertEqual(data[6:8], (5).to_bytes(2, "little"))
+        self.assertEqual(len(data), 8 + 5)
+
+    def test_push_picks_the_shortest_encoding(self):
+        self.assertEqual(encode_push(-128), bytes([0x01, 0x80]))
+        self.assertEqual(encode_push(128), bytes([0x02, 0x80, 0x00]))
+        self.assertEqual(encode_push(-32769), bytes([0x03, 0xFF, 0x7F, 0xFF, 0xFF]))
+        with self.assertRaises(ValueError):
+            encode_push(1 << 31)
+
+    def test_backward_jump_and_variables(self):
+        data = assemble(".vars 1\nloop: load 0\njz loop\npush 0\npush 0\nmove\n")
+        # jz at offset 2, next instruction at 5, loop at 0
+        self.assertEqual(data[8:13], bytes([0x04, 0x00, 0x31, 0xFB, 0xFF]))
+
+    def test_inputs_by_name_or_number(self):
+        self.assertEqual(assemble("in sensation\nin 3\nadd\npush 0\nmove")[8:12], bytes([0x06, 3, 0x06, 3]))
+
+    def test_errors_name_the_line(self):
+        cases = [
+            ("push 0\nfrob\n", "line 2: unknown instruction frob"),
+            ("load 0\n", "line 1: variable 0 not declared"),
+            ("jmp nowhere\n", "line 1: no label nowhere"),
+            ("in speed\n", "line 1: not a number"),
+            ("add 1\n", "line 1: add takes 0 operand"),
+            ("a: push 0\na: push 0\n", "line 2: label a defined twice"),
+        ]
+        for source, message in cases:
+            with self.subTest(source=source):
+                with self.assertRaisesRegex(AssemblyError, message):
+                    assemble(source)
+
+    def test_too_long(self):
+        with self.assertRaisesRegex(ValueError, "at most 504"):
+            assemble("dup\n" * 505)
+
+
+if __name__ == "__main__":
+    unittest.main()